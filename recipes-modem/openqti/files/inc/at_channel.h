@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: MIT */
+
+#ifndef _AT_CHANNEL_H_
+#define _AT_CHANNEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * AT command channel
+ *  A single thread owns the AT port (SMD_SEC_AT) and runs every AT
+ *  command openQTI needs. Requests can be queued from any thread, they
+ *  are sent one after the other as soon as the previous one finishes
+ *  and the responses are tokenized as they arrive, so callers don't need
+ *  to sleep between commands anymore.
+ */
+
+#define AT_CMD_MAX_SZ 256
+#define AT_LINE_MAX_SZ 512
+#define AT_RESPONSE_MAX_SZ 1024
+#define AT_MAX_URC_HANDLERS 8
+#define AT_MAX_QUEUED_REQUESTS 128
+#define AT_DEFAULT_TIMEOUT_MS 1500
+
+/* Request status */
+enum {
+  AT_STATUS_PENDING = 0,
+  AT_STATUS_OK,
+  AT_STATUS_ERROR,   // ERROR, +CME ERROR, +CMS ERROR...
+  AT_STATUS_TIMEOUT,
+  AT_STATUS_IO_ERROR,
+};
+
+/*
+ * Called from the channel thread once a request finishes. response holds
+ * every line received for it (CRLF separated), including the final result
+ */
+typedef void (*at_response_cb)(uint8_t status, const char *response,
+                               size_t len, void *data);
+/* Called from the channel thread for every unsolicited line matching */
+typedef void (*at_urc_cb)(const char *line, void *data);
+
+struct at_request {
+  char cmd[AT_CMD_MAX_SZ];
+  size_t cmd_len;
+  uint32_t timeout_ms;
+  uint64_t deadline; // ms, monotonic
+
+  char response[AT_RESPONSE_MAX_SZ];
+  size_t response_len;
+  uint8_t status;
+
+  at_response_cb callback;
+  void *data;
+  struct at_request *next;
+};
+
+struct at_urc_handler {
+  char prefix[32];
+  at_urc_cb callback;
+  void *data;
+};
+
+/* Queue a command and wait for its response */
+int at_channel_send(const char *cmd, size_t cmdlen, char *response,
+                    size_t response_sz, uint32_t timeout_ms);
+/* Queue a command and get the response through a callback */
+int at_channel_send_async(const char *cmd, size_t cmdlen, uint32_t timeout_ms,
+                          at_response_cb callback, void *data);
+/* Get notified about unsolicited responses starting with prefix */
+int at_channel_register_urc(const char *prefix, at_urc_cb callback,
+                            void *data);
+/* Number of requests waiting to be sent */
+uint32_t at_channel_get_queue_depth(void);
+#endif
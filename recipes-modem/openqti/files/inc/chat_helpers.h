@@ -74,6 +74,9 @@ enum {
   CMD_ID_ACTION_INTERNAL_NETWORK_START,
   CMD_ID_ACTION_INTERNAL_NETWORK_STOP,
   CMD_ID_GET_RUNNING_CONFIG,
+  CMD_ID_ACTION_ENABLE_PACKET_TRACING,
+  CMD_ID_ACTION_DISABLE_PACKET_TRACING,
+  CMD_ID_GET_PACKET_TRACE,
   /* Previously called "partial commands" */
   CMD_ID_SET_MODEM_NAME,
   CMD_ID_SET_OWNER_NAME,
@@ -95,6 +98,8 @@ enum {
 void cmd_get_running_config();
 void cmd_get_rmnet_stats();
 void cmd_get_gps_stats();
+void cmd_set_packet_tracing(bool en);
+void cmd_get_packet_trace();
 void cmd_get_help();
 
 int cmd_get_uptime();
@@ -203,6 +203,14 @@ static const struct {
     {CMD_ID_ACTION_INTERNAL_NETWORK_STOP, 0, CMD_CATEGORY_NETWORK, "ifdown",
      "Stopping internal networking ",
      "Stops an active data session on the modem's userspace"},
+    {CMD_ID_ACTION_ENABLE_PACKET_TRACING, 0, CMD_CATEGORY_LOGGING,
+     "enable packet tracing", "Packet tracing: enabled",
+     "Measures how long each QMI message spends inside the proxy"},
+    {CMD_ID_ACTION_DISABLE_PACKET_TRACING, 0, CMD_CATEGORY_LOGGING,
+     "disable packet tracing", "Packet tracing: disabled",
+     "Stops measuring QMI messages in the proxy"},
+    {CMD_ID_GET_PACKET_TRACE, 0, CMD_CATEGORY_LOGGING, "packet trace",
+     "Packet trace", "Shows the slowest QMI messages and saves the full trace"},
     {CMD_ID_SET_MODEM_NAME, 1, CMD_CATEGORY_SYSTEM, "set name ",
      "Set Modem Name", "Set a new name for the modem"},
     {CMD_ID_SET_OWNER_NAME, 1, CMD_CATEGORY_SYSTEM, "set user name ",
@@ -4,16 +4,39 @@
 #define _CONFIG_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define PERSIST_CUSTOM_ALERT_TONE "cust_alert_tone"
 #define CONFIG_FILE_PATH "/persist/openqti.conf"
+#define CONFIG_FILE_PATH_TMP "/persist/openqti.conf.tmp"
 #define SCHEDULER_DATA_FILE_PATH "/persist/sched.raw"
 #define PERSISTENT_PATH "/persist/"
 #define VOLATILE_PATH "/tmp/"
 #define MAX_NAME_SZ 128
 #define MAX_APN_FIELD_SZ 128
 
+/* Coalesce setting changes for this long before writing them to flash */
+#define CONFIG_WRITE_DELAY_MS 2000
+/* Replaced setting snapshots are freed after this many seconds */
+#define CONFIG_RECLAIM_GRACE_SECS 30
+/* Must be a power of two, and bigger than the number of keys */
+#define CONFIG_KEY_HASH_SZ 64
+
+enum {
+  CFG_TYPE_U8 = 0,
+  CFG_TYPE_STR,
+};
+
+/* Describes where and how a key from the config file is stored */
+struct config_key {
+  const char *key;
+  uint8_t type;
+  size_t offset; // in struct config_prototype
+  long min;      // CFG_TYPE_U8: valid range
+  long max;      // CFG_TYPE_STR: size of the buffer
+};
+
 struct config_prototype {
   uint8_t custom_alert_tone;
   uint8_t persistent_logging;
@@ -62,6 +85,13 @@ void do_sync_fs(void);
 
 int set_initial_config(void);
 int read_settings_from_file(void);
+const struct config_key *find_config_key(const char *key);
+
+/* Store settings now / after CONFIG_WRITE_DELAY_MS without further changes */
+int write_settings_to_storage(void);
+void schedule_settings_write(void);
+/* Write pending changes right away, ie. before rebooting */
+void flush_pending_settings(void);
 
 /* Signal tracking */
 uint8_t is_signal_tracking_enabled(void);
@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: MIT */
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Runtime metrics
+ *  Counters and latency histograms live in a shared memory file so they
+ *  can be read by oqtistat without asking openqti for anything.
+ *
+ *  Every thread that records something gets its own slot, and is the only
+ *  one writing to it. Slots of threads that exited are handed to new ones,
+ *  counts included. Each slot is protected by a sequence counter, so a
+ *  reader can retry if it catches a slot halfway through an update.
+ *  Gauges are single 32bit values written atomically and need no lock.
+ */
+
+#define METRICS_SHM_PATH "/tmp/openqti.metrics"
+#define METRICS_MAGIC 0x4d54514f // "OQTM"
+#define METRICS_VERSION 1
+#define METRICS_MAX_SLOTS 24
+/* Bucket n holds samples in [2^(n-1), 2^n) us, bucket 0 is < 1us */
+#define METRICS_HIST_BUCKETS 28
+
+enum {
+  METRICS_CTR_RMNET_ALLOWED = 0,
+  METRICS_CTR_RMNET_BYPASSED,
+  METRICS_CTR_RMNET_DISCARDED,
+  METRICS_CTR_RMNET_FAILED,
+  METRICS_CTR_RMNET_EMPTY,
+  METRICS_CTR_RMNET_BYTES,
+  METRICS_CTR_GPS_ALLOWED,
+  METRICS_CTR_GPS_DISCARDED,
+  METRICS_CTR_GPS_FAILED,
+  METRICS_CTR_QMI_INTERNAL_TX,
+  METRICS_CTR_QMI_INTERNAL_RX,
+  METRICS_CTR_SMS_QUEUED,
+  METRICS_CTR_SMS_DELIVERED,
+  METRICS_CTR_AUDIO_XRUNS,
+  METRICS_CTR_LAST,
+};
+
+enum {
+  METRICS_HIST_PKT_FORWARD = 0, // rmnet: read to write
+  METRICS_HIST_QMI_ROUNDTRIP,   // internal client: request to response
+  METRICS_HIST_SMS_DELIVERY,    // queued to acked by the host
+  METRICS_HIST_LAST,
+};
+
+enum {
+  METRICS_GAUGE_THERMAL_ZONE0 = 0,
+  METRICS_GAUGE_THERMAL_ZONE6 = 6,
+  METRICS_GAUGE_QMI_CLIENTS,
+  METRICS_GAUGE_SMS_QUEUE_DEPTH,
+  METRICS_GAUGE_QMI_PENDING,
+  METRICS_GAUGE_AT_QUEUE_DEPTH,
+  METRICS_GAUGE_LAST,
+};
+
+struct metrics_histogram {
+  uint64_t count;
+  uint64_t sum_us;
+  uint64_t max_us;
+  uint32_t buckets[METRICS_HIST_BUCKETS];
+};
+
+struct metrics_slot {
+  uint32_t seq; // odd while the owner is updating it
+  int32_t tid;
+  uint64_t counters[METRICS_CTR_LAST];
+  struct metrics_histogram histograms[METRICS_HIST_LAST];
+} __attribute__((aligned(64)));
+
+struct metrics_shm {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;
+  int32_t pid;
+  uint64_t start_time; // CLOCK_MONOTONIC, ms
+  uint32_t num_slots;
+  int32_t gauges[METRICS_GAUGE_LAST];
+  struct metrics_slot slots[METRICS_MAX_SLOTS];
+};
+
+int metrics_init(void);
+void metrics_add(uint8_t counter, uint64_t val);
+void metrics_inc(uint8_t counter);
+void metrics_set_gauge(uint8_t gauge, int32_t val);
+void metrics_record_latency(uint8_t histogram, uint64_t usecs);
+uint64_t metrics_get_time_us(void);
+uint64_t metrics_elapsed_us(struct timespec *since);
+
+/* Reader side, used by oqtistat */
+const char *metrics_counter_name(uint8_t counter);
+const char *metrics_histogram_name(uint8_t histogram);
+const char *metrics_gauge_name(uint8_t gauge);
+int metrics_read_snapshot(const struct metrics_shm *shm, uint64_t *counters,
+                          struct metrics_histogram *histograms);
+uint64_t metrics_histogram_percentile(const struct metrics_histogram *hist,
+                                      uint8_t percentile);
+#endif
@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: MIT */
+
+#ifndef _PKT_TRACE_H_
+#define _PKT_TRACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Packet tracing
+ *  Opt-in timing of every QMI packet going through rmnet_proxy(). Each
+ *  packet gets monotonic timestamps when it's read, once its service and
+ *  message are known, after the interceptors ran and once written. Time is
+ *  accumulated per direction, service and message ID in a fixed size table
+ *  with log-linear histograms, so nothing is allocated in the hot path and
+ *  the logger is never involved.
+ *
+ *  Tracing is toggled with a chat command or SIGUSR2, and the table can be
+ *  dumped with a chat command or SIGUSR1
+ */
+
+#define PKT_TRACE_FILE "pkt_trace.txt"
+#define PKT_TRACE_MAX_ENTRIES 64
+/*
+ * Log-linear buckets: values under 8us get their own bucket, then every
+ * power of two is split in 8 (~12% error), up to 2^24us (~16s)
+ */
+#define PKT_TRACE_SUB_BUCKET_BITS 3
+#define PKT_TRACE_SUB_BUCKETS (1 << PKT_TRACE_SUB_BUCKET_BITS)
+#define PKT_TRACE_MAX_EXPONENT 24
+#define PKT_TRACE_BUCKETS                                                      \
+  (PKT_TRACE_SUB_BUCKETS +                                                     \
+   (PKT_TRACE_MAX_EXPONENT - PKT_TRACE_SUB_BUCKET_BITS) * PKT_TRACE_SUB_BUCKETS)
+
+enum {
+  PKT_TRACE_STAGE_READ = 0,
+  PKT_TRACE_STAGE_CLASSIFY, // service and message ID known
+  PKT_TRACE_STAGE_HANDLER,  // process_packet() returned
+  PKT_TRACE_STAGE_WRITE,    // forwarded (or dropped)
+  PKT_TRACE_STAGE_LAST,
+};
+
+/* One packet on its way through the proxy */
+struct pkt_trace {
+  bool active;
+  uint8_t source;
+  uint8_t service;
+  uint16_t message_id;
+  struct timespec stages[PKT_TRACE_STAGE_LAST];
+};
+
+struct pkt_trace_entry {
+  bool in_use;
+  uint8_t source;
+  uint8_t service;
+  uint16_t message_id;
+  uint32_t count;
+  /* Time from the previous stage, per stage after READ */
+  uint64_t stage_sum_us[PKT_TRACE_STAGE_LAST];
+  uint32_t stage_max_us[PKT_TRACE_STAGE_LAST];
+  /* Read to write */
+  uint32_t total_max_us;
+  uint32_t buckets[PKT_TRACE_BUCKETS];
+};
+
+/* Blocks SIGUSR1/SIGUSR2 and starts the thread handling them */
+void pkt_trace_init(void);
+void pkt_trace_set_enabled(bool en);
+bool pkt_trace_is_enabled(void);
+void pkt_trace_reset(void);
+
+void pkt_trace_begin(struct pkt_trace *trace, uint8_t source);
+void pkt_trace_classify(struct pkt_trace *trace, uint8_t service,
+                        uint16_t message_id);
+void pkt_trace_mark(struct pkt_trace *trace, uint8_t stage);
+void pkt_trace_end(struct pkt_trace *trace);
+
+int pkt_trace_dump(void);
+size_t pkt_trace_get_summary(char *buf, size_t max_len);
+#endif
@@ -0,0 +1,446 @@
+// SPDX-License-Identifier: MIT
+
+#include "at_channel.h"
+#include "devices.h"
+#include "logger.h"
+#include "metrics.h"
+#include "openqti.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+struct {
+  pthread_mutex_t lock;
+  pthread_cond_t done_cond;
+  pthread_once_t thread_once;
+  int fd;
+  int wakeup[2];
+  /* Requests waiting to be sent */
+  struct at_request *head;
+  struct at_request *tail;
+  uint32_t queued;
+  /* Request we're waiting a response for. Only the channel thread uses it */
+  struct at_request *inflight;
+  /* Partial line being tokenized */
+  char line[AT_LINE_MAX_SZ];
+  size_t line_len;
+  struct at_urc_handler urc_handlers[AT_MAX_URC_HANDLERS];
+  uint8_t num_urc_handlers;
+} at_rt = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .done_cond = PTHREAD_COND_INITIALIZER,
+    .thread_once = PTHREAD_ONCE_INIT,
+    .fd = -1,
+    .wakeup = {-1, -1},
+};
+
+/* Final result codes: any of these ends the current command */
+static const struct {
+  const char *prefix;
+  uint8_t status;
+} at_final_results[] = {
+    {"OK", AT_STATUS_OK},
+    {"ERROR", AT_STATUS_ERROR},
+    {"+CME ERROR:", AT_STATUS_ERROR},
+    {"+CMS ERROR:", AT_STATUS_ERROR},
+    {"NO CARRIER", AT_STATUS_ERROR},
+    {"NO DIALTONE", AT_STATUS_ERROR},
+    {"NO ANSWER", AT_STATUS_ERROR},
+    {"BUSY", AT_STATUS_ERROR},
+};
+
+static uint64_t get_monotonic_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void wake_channel_thread(void) {
+  char c = 0;
+  if (at_rt.wakeup[1] >= 0 && write(at_rt.wakeup[1], &c, 1) < 0 &&
+      errno != EAGAIN) {
+    logger(MSG_ERROR, "%s: Failed to wake up the AT channel\n", __func__);
+  }
+}
+
+/* Runs the callback and frees the request. Never called with the lock */
+static void complete_request(struct at_request *req, uint8_t status) {
+  req->status = status;
+  logger(MSG_DEBUG, "%s: %s -> %u\n", __func__, req->cmd, status);
+  if (req->callback != NULL) {
+    req->callback(status, req->response, req->response_len, req->data);
+  }
+  free(req);
+}
+
+static void append_response_line(struct at_request *req, const char *line,
+                                  size_t len) {
+  if (req->response_len + len + 2 >= AT_RESPONSE_MAX_SZ) {
+    logger(MSG_WARN, "%s: Response to %s is too long, truncating\n", __func__,
+           req->cmd);
+    return;
+  }
+  memcpy(req->response + req->response_len, line, len);
+  req->response_len += len;
+  memcpy(req->response + req->response_len, "\r\n", 2);
+  req->response_len += 2;
+  req->response[req->response_len] = 0;
+}
+
+static uint8_t get_final_result(const char *line) {
+  for (uint8_t i = 0; i < sizeof(at_final_results) / sizeof(at_final_results[0]);
+       i++) {
+    if (strncmp(line, at_final_results[i].prefix,
+                strlen(at_final_results[i].prefix)) == 0)
+      return at_final_results[i].status;
+  }
+  return AT_STATUS_PENDING;
+}
+
+/*
+ * Lines starting with "+XXXX" belong to the command in flight if it is
+ * AT+XXXX, otherwise we give URC handlers a chance to claim them
+ */
+static bool is_response_to(const struct at_request *req, const char *line) {
+  size_t len = 0;
+  const char *cmd = req->cmd + 2; // skip "AT"
+  if (line[0] != '+')
+    return true;
+  while (cmd[len] != 0 && cmd[len] != '=' && cmd[len] != '?' &&
+         cmd[len] != '\r')
+    len++;
+  return len > 1 && strncmp(line, cmd, len) == 0;
+}
+
+/*
+ * Handlers can be registered from any thread, so take a copy of the table
+ * under the lock and run the callbacks without it
+ */
+static bool dispatch_urc(const char *line) {
+  struct at_urc_handler handlers[AT_MAX_URC_HANDLERS];
+  uint8_t num_handlers;
+  bool handled = false;
+
+  pthread_mutex_lock(&at_rt.lock);
+  num_handlers = at_rt.num_urc_handlers;
+  memcpy(handlers, at_rt.urc_handlers,
+         num_handlers * sizeof(struct at_urc_handler));
+  pthread_mutex_unlock(&at_rt.lock);
+
+  for (uint8_t i = 0; i < num_handlers; i++) {
+    if (strncmp(line, handlers[i].prefix, strlen(handlers[i].prefix)) == 0) {
+      handlers[i].callback(line, handlers[i].data);
+      handled = true;
+    }
+  }
+  return handled;
+}
+
+static void handle_line(const char *line, size_t len) {
+  struct at_request *req = at_rt.inflight;
+  uint8_t status;
+
+  if (len == 0)
+    return;
+
+  if (req == NULL) {
+    if (!dispatch_urc(line))
+      logger(MSG_DEBUG, "%s: Unsolicited: %s\n", __func__, line);
+    return;
+  }
+
+  /* Echo of the command itself */
+  if (strncmp(line, req->cmd, len) == 0 && req->cmd[len] == '\r')
+    return;
+
+  if (!is_response_to(req, line) && dispatch_urc(line))
+    return;
+
+  append_response_line(req, line, len);
+  status = get_final_result(line);
+  if (status != AT_STATUS_PENDING) {
+    at_rt.inflight = NULL;
+    complete_request(req, status);
+  }
+}
+
+/* Streaming tokenizer: feeds complete lines, keeps the rest for later */
+static void tokenize(const char *buf, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (buf[i] == '\r' || buf[i] == '\n') {
+      at_rt.line[at_rt.line_len] = 0;
+      handle_line(at_rt.line, at_rt.line_len);
+      at_rt.line_len = 0;
+    } else if (at_rt.line_len < AT_LINE_MAX_SZ - 1) {
+      at_rt.line[at_rt.line_len++] = buf[i];
+    }
+  }
+}
+
+static void close_at_port(void) {
+  if (at_rt.fd >= 0)
+    close(at_rt.fd);
+  at_rt.fd = -1;
+  at_rt.line_len = 0;
+}
+
+static struct at_request *pop_request(void) {
+  struct at_request *req;
+  pthread_mutex_lock(&at_rt.lock);
+  req = at_rt.head;
+  if (req != NULL) {
+    at_rt.head = req->next;
+    if (at_rt.head == NULL)
+      at_rt.tail = NULL;
+    at_rt.queued--;
+    metrics_set_gauge(METRICS_GAUGE_AT_QUEUE_DEPTH, at_rt.queued);
+  }
+  pthread_mutex_unlock(&at_rt.lock);
+  return req;
+}
+
+static void start_next_request(void) {
+  struct at_request *req = pop_request();
+  if (req == NULL)
+    return;
+
+  logger(MSG_DEBUG, "%s: Sending %s\n", __func__, req->cmd);
+  req->deadline = get_monotonic_ms() + req->timeout_ms;
+  if (write(at_rt.fd, req->cmd, req->cmd_len) < 0) {
+    logger(MSG_ERROR, "%s: Failed to write to %s\n", __func__, SMD_SEC_AT);
+    close_at_port();
+    complete_request(req, AT_STATUS_IO_ERROR);
+    return;
+  }
+  at_rt.inflight = req;
+}
+
+static void *at_channel_thread(void *arg) {
+  struct pollfd fds[2];
+  char buf[AT_LINE_MAX_SZ];
+  struct at_request *req;
+  int timeout, ret;
+  uint64_t now;
+
+  logger(MSG_INFO, "%s: Starting AT command channel\n", __func__);
+  while (1) {
+    if (at_rt.fd < 0) {
+      at_rt.fd = open(SMD_SEC_AT, O_RDWR);
+      if (at_rt.fd < 0) {
+        logger(MSG_ERROR, "%s: Cannot open %s\n", __func__, SMD_SEC_AT);
+        /* Nobody can get an answer now, let them know */
+        while ((req = pop_request()) != NULL)
+          complete_request(req, AT_STATUS_IO_ERROR);
+        sleep(1);
+        continue;
+      }
+    }
+
+    if (at_rt.inflight == NULL)
+      start_next_request();
+
+    timeout = -1;
+    if (at_rt.inflight != NULL) {
+      now = get_monotonic_ms();
+      timeout = at_rt.inflight->deadline > now
+                    ? (int)(at_rt.inflight->deadline - now)
+                    : 0;
+    }
+
+    fds[0].fd = at_rt.wakeup[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = at_rt.fd;
+    fds[1].events = POLLIN;
+    ret = poll(fds, at_rt.fd >= 0 ? 2 : 1, timeout);
+    if (ret < 0 && errno != EINTR) {
+      logger(MSG_ERROR, "%s: Poll failed: %s\n", __func__, strerror(errno));
+      sleep(1);
+      continue;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      while (read(at_rt.wakeup[0], buf, sizeof(buf)) > 0)
+        ;
+    }
+
+    if (at_rt.fd >= 0 && (fds[1].revents & (POLLIN | POLLERR | POLLHUP))) {
+      ret = read(at_rt.fd, buf, sizeof(buf));
+      if (ret > 0) {
+        tokenize(buf, ret);
+      } else {
+        logger(MSG_ERROR, "%s: Failed to read from %s\n", __func__,
+               SMD_SEC_AT);
+        close_at_port();
+        if (at_rt.inflight != NULL) {
+          req = at_rt.inflight;
+          at_rt.inflight = NULL;
+          complete_request(req, AT_STATUS_IO_ERROR);
+        }
+        continue;
+      }
+    }
+
+    if (at_rt.inflight != NULL && get_monotonic_ms() >= at_rt.inflight->deadline) {
+      logger(MSG_ERROR, "%s: No response in time for %s\n", __func__,
+             at_rt.inflight->cmd);
+      req = at_rt.inflight;
+      at_rt.inflight = NULL;
+      complete_request(req, AT_STATUS_TIMEOUT);
+    }
+  }
+
+  return NULL;
+}
+
+static void start_at_channel_thread(void) {
+  pthread_t thread;
+  if (pipe(at_rt.wakeup) < 0) {
+    logger(MSG_ERROR, "%s: Can't create wakeup pipe\n", __func__);
+    return;
+  }
+  fcntl(at_rt.wakeup[0], F_SETFL, O_NONBLOCK);
+  fcntl(at_rt.wakeup[1], F_SETFL, O_NONBLOCK);
+  if (pthread_create(&thread, NULL, &at_channel_thread, NULL)) {
+    logger(MSG_ERROR, "%s: Error creating AT channel thread\n", __func__);
+    return;
+  }
+  pthread_detach(thread);
+}
+
+int at_channel_send_async(const char *cmd, size_t cmdlen, uint32_t timeout_ms,
+                          at_response_cb callback, void *data) {
+  struct at_request *req;
+  size_t len = strnlen(cmd, cmdlen);
+
+  /* Callers may or may not include the terminating CR */
+  while (len > 0 && (cmd[len - 1] == '\r' || cmd[len - 1] == '\n'))
+    len--;
+  if (len < 2 || len + 1 >= AT_CMD_MAX_SZ) {
+    logger(MSG_ERROR, "%s: Invalid command size (%zu)\n", __func__, len);
+    return -EINVAL;
+  }
+
+  pthread_once(&at_rt.thread_once, start_at_channel_thread);
+  if (at_rt.wakeup[1] < 0)
+    return -EIO;
+
+  req = calloc(1, sizeof(struct at_request));
+  if (req == NULL)
+    return -ENOMEM;
+  memcpy(req->cmd, cmd, len);
+  req->cmd[len] = '\r';
+  req->cmd_len = len + 1;
+  req->timeout_ms = timeout_ms > 0 ? timeout_ms : AT_DEFAULT_TIMEOUT_MS;
+  req->status = AT_STATUS_PENDING;
+  req->callback = callback;
+  req->data = data;
+
+  pthread_mutex_lock(&at_rt.lock);
+  if (at_rt.queued >= AT_MAX_QUEUED_REQUESTS) {
+    pthread_mutex_unlock(&at_rt.lock);
+    logger(MSG_ERROR, "%s: Too many pending AT commands\n", __func__);
+    free(req);
+    return -EAGAIN;
+  }
+  if (at_rt.tail != NULL)
+    at_rt.tail->next = req;
+  else
+    at_rt.head = req;
+  at_rt.tail = req;
+  at_rt.queued++;
+  metrics_set_gauge(METRICS_GAUGE_AT_QUEUE_DEPTH, at_rt.queued);
+  pthread_mutex_unlock(&at_rt.lock);
+
+  wake_channel_thread();
+  return 0;
+}
+
+struct at_sync_response {
+  bool done;
+  uint8_t status;
+  char *response;
+  size_t response_sz;
+};
+
+static void at_sync_callback(uint8_t status, const char *response, size_t len,
+                             void *data) {
+  struct at_sync_response *sync = (struct at_sync_response *)data;
+  pthread_mutex_lock(&at_rt.lock);
+  if (sync->response != NULL && sync->response_sz > 0) {
+    if (len >= sync->response_sz)
+      len = sync->response_sz - 1;
+    memcpy(sync->response, response, len);
+    sync->response[len] = 0;
+  }
+  sync->status = status;
+  sync->done = true;
+  pthread_cond_broadcast(&at_rt.done_cond);
+  pthread_mutex_unlock(&at_rt.lock);
+}
+
+int at_channel_send(const char *cmd, size_t cmdlen, char *response,
+                    size_t response_sz, uint32_t timeout_ms) {
+  struct at_sync_response sync = {
+      .done = false,
+      .status = AT_STATUS_PENDING,
+      .response = response,
+      .response_sz = response_sz,
+  };
+  int ret;
+
+  /* Callers log the response even if we fail before getting one */
+  if (response != NULL && response_sz > 0)
+    response[0] = 0;
+
+  ret = at_channel_send_async(cmd, cmdlen, timeout_ms, at_sync_callback, &sync);
+  if (ret < 0)
+    return ret;
+
+  pthread_mutex_lock(&at_rt.lock);
+  while (!sync.done)
+    pthread_cond_wait(&at_rt.done_cond, &at_rt.lock);
+  pthread_mutex_unlock(&at_rt.lock);
+
+  switch (sync.status) {
+  case AT_STATUS_OK:
+    return 0;
+  case AT_STATUS_TIMEOUT:
+    return -ETIMEDOUT;
+  case AT_STATUS_IO_ERROR:
+    return -EIO;
+  default:
+    return -EBADMSG;
+  }
+}
+
+int at_channel_register_urc(const char *prefix, at_urc_cb callback,
+                            void *data) {
+  pthread_mutex_lock(&at_rt.lock);
+  if (at_rt.num_urc_handlers >= AT_MAX_URC_HANDLERS) {
+    pthread_mutex_unlock(&at_rt.lock);
+    logger(MSG_ERROR, "%s: Can't register more URC handlers\n", __func__);
+    return -ENOSPC;
+  }
+  snprintf(at_rt.urc_handlers[at_rt.num_urc_handlers].prefix,
+           sizeof(at_rt.urc_handlers[0].prefix), "%s", prefix);
+  at_rt.urc_handlers[at_rt.num_urc_handlers].callback = callback;
+  at_rt.urc_handlers[at_rt.num_urc_handlers].data = data;
+  at_rt.num_urc_handlers++;
+  pthread_mutex_unlock(&at_rt.lock);
+  return 0;
+}
+
+uint32_t at_channel_get_queue_depth(void) {
+  uint32_t depth;
+  pthread_mutex_lock(&at_rt.lock);
+  depth = at_rt.queued;
+  pthread_mutex_unlock(&at_rt.lock);
+  return depth;
+}
@@ -1,15 +1,19 @@
 #include <stdlib.h>
 #include <stdint.h>
+#include <unistd.h>
 #include "logger.h"
 #include "devices.h"
 #include "command.h"
 #include "audio.h"
 #include "helpers.h"
+#include "audio2text.h"
 
 #ifdef USE_POCKETSPHINX
 #include <pocketsphinx.h>
 #endif
 
+/* Give up listening after this many pcm_read() failures in a row */
+#define STT_MAX_READ_ERRORS 10
 
 struct {
     uint8_t is_enabled;
@@ -55,6 +59,8 @@ callaudio_stt_demo(char *filename) {
     /* Initialize configuration from input file. */
     config = ps_config_init(NULL);
     ps_default_search_args(config);
+    /* Keep the models loaded between calls */
+    ps_config_set_bool(config, "model_cache", 1);
     if (ps_config_soundfile(config, fh, filename) < 0) {
         logger(MSG_ERROR,"Unsupported input file %s\n", filename);
         if (config)
@@ -104,16 +110,47 @@ callaudio_stt_demo(char *filename) {
     return 0;
 }
 
+/* Feed one span of speech from the endpointer to the decoder */
+static void stt_process_span(ps_decoder_t *decoder, ps_endpointer_t *ep,
+                             const ps_endpointer_span_t *span)
+{
+    const char *hyp;
+
+    if (span->flags & PS_ENDPOINTER_SPAN_START) {
+        logger(MSG_ERROR, "%s: Speech start at %.2f\n", __func__,
+                span->start);
+        ps_start_utt(decoder);
+    }
+    if (ps_process_raw(decoder, span->pcm, span->nsamp, FALSE, FALSE) < 0)
+        logger(MSG_ERROR,"%s: ps_process_raw() failed\n", __func__);
+    if ((hyp = ps_get_hyp(decoder, NULL)) != NULL) {
+        logger(MSG_ERROR, "%s: PARTIAL RESULT: %s\n", __func__, hyp);
+        parse_command(hyp);
+    }
+    if (span->flags & PS_ENDPOINTER_SPAN_END) {
+        logger(MSG_ERROR, "%s: Speech end at %.2f\n", __func__,
+                span->start
+                + (double)span->nsamp / ps_endpointer_sample_rate(ep));
+        ps_end_utt(decoder);
+        if ((hyp = ps_get_hyp(decoder, NULL)) != NULL) {
+            logger(MSG_INFO, "%s: %s\n", __func__, hyp);
+            parse_command(hyp);
+        }
+    }
+}
+
 /* launched from call thread */
 void *callaudio_stt_continuous()
 {
     ps_decoder_t *decoder;
     ps_config_t *config;
     ps_endpointer_t *ep;
-    short *frame;
-    size_t frame_size;
+    short *pcm;
+    const int16 *speech;
+    size_t nsamp, end_samples;
     struct pcm *incall_pcm_rx;
     size_t bufsize;
+    int read_errors = 0;
     logger(MSG_INFO, "%s: START\n", __func__);
     if (speech_to_text.is_enabled) {
         logger(MSG_ERROR, "%s: Already running\n", __func__);
@@ -151,6 +188,7 @@ void *callaudio_stt_continuous()
 
     config = ps_config_init(NULL);
     ps_default_search_args(config);
+    ps_config_set_bool(config, "model_cache", 1);
     if ((decoder = ps_init(config)) == NULL) {
         logger(MSG_ERROR,"PocketSphinx decoder init failed\n");
         speech_to_text.is_enabled = 0;
@@ -166,59 +204,58 @@ void *callaudio_stt_continuous()
         pcm_close(incall_pcm_rx);
         return NULL;
     }
-//    sox = popen_sox(ps_endpointer_sample_rate(ep));
-    frame_size =  pcm_get_buffer_size(incall_pcm_rx); // ps_endpointer_frame_size(ep);
-    if ((frame = malloc(frame_size * sizeof(frame[0]))) == NULL)
-        logger(MSG_ERROR,"Failed to allocate frame");
+    /* The whole ALSA buffer goes to the endpointer at once, which
+     * classifies every frame in it and hands back the speech as spans
+     * we can decode in place. */
+    bufsize = pcm_get_buffer_size(incall_pcm_rx);
+    nsamp = pcm_bytes_to_frames(incall_pcm_rx, bufsize);
+    if ((pcm = malloc(bufsize)) == NULL) {
+        logger(MSG_ERROR, "%s: Unable to allocate %zu bytes\n", __func__,
+               bufsize);
+        ps_endpointer_free(ep);
+        ps_free(decoder);
+        ps_config_free(config);
+        speech_to_text.is_enabled = 0;
+        speech_to_text.stay_running = 0;
+        pcm_close(incall_pcm_rx);
+        return NULL;
+    }
 
     while (speech_to_text.stay_running) {
-        logger(MSG_INFO, "%s: LOOPING\n", __func__);
-
-        const int16 *speech;
-        int prev_in_speech = ps_endpointer_in_speech(ep);
-        size_t len, end_samples;
-        if (pcm_read(incall_pcm_rx, frame,
-            pcm_bytes_to_frames(incall_pcm_rx,
-                                pcm_get_buffer_size(incall_pcm_rx))) == 0) {
-                speech = ps_endpointer_end_stream(ep, frame,
-                                                  frame_size,
-                                                  &end_samples);
-            logger(MSG_INFO, "%s: Read %u bytes\n", __func__, frame_size);
-        } else {
-            speech = ps_endpointer_process(ep, frame);
-        }
-        if (speech != NULL) {
-            logger(MSG_INFO, "%s: Speech is not null\n", __func__);
-            const char *hyp;
-            if (!prev_in_speech) {
-                logger(MSG_ERROR, "%s: Speech start at %.2f\n", __func__,
-                        ps_endpointer_speech_start(ep));
-                ps_start_utt(decoder);
-            }
-            if (ps_process_raw(decoder, speech, frame_size, FALSE, FALSE) < 0)
-                logger(MSG_ERROR,"%s: ps_process_raw() failed\n", __func__);
-            if ((hyp = ps_get_hyp(decoder, NULL)) != NULL) {
-                logger(MSG_ERROR, "%s: PARTIAL RESULT: %s\n", __func__, hyp);
-                parse_command(hyp);
-            }
-            if (!ps_endpointer_in_speech(ep)) {
-                logger(MSG_ERROR, "%s: Speech end at %.2f\n", __func__,
-                        ps_endpointer_speech_end(ep));
-                ps_end_utt(decoder);
-                if ((hyp = ps_get_hyp(decoder, NULL)) != NULL) {
-                    logger(MSG_INFO, "%s: %s\n", __func__, hyp);
-                    parse_command(hyp);
-
+        const ps_endpointer_span_t *spans;
+        int i, nspans;
 
-                }
+        if (pcm_read(incall_pcm_rx, pcm, nsamp) != 0) {
+            logger(MSG_ERROR, "%s: Error reading RX\n", __func__);
+            if (++read_errors >= STT_MAX_READ_ERRORS) {
+                logger(MSG_ERROR, "%s: RX keeps failing, bailing out\n",
+                       __func__);
+                break;
             }
-        } else {
-            logger(MSG_WARN, "%s: Speech is null!\n", __func__);
+            usleep(100000);
+            continue;
+        }
+        read_errors = 0;
+        spans = ps_endpointer_process_block(ep, pcm, nsamp, &nspans);
+        for (i = 0; i < nspans; i++)
+            stt_process_span(decoder, ep, &spans[i]);
+    }
+
+    /* Finish off whatever was being said when the call ended */
+    speech = ps_endpointer_end_stream(ep, NULL, 0, &end_samples);
+    if (speech != NULL) {
+        const char *hyp;
+        if (ps_process_raw(decoder, speech, end_samples, FALSE, FALSE) < 0)
+            logger(MSG_ERROR,"%s: ps_process_raw() failed\n", __func__);
+        ps_end_utt(decoder);
+        if ((hyp = ps_get_hyp(decoder, NULL)) != NULL) {
+            logger(MSG_INFO, "%s: %s\n", __func__, hyp);
+            parse_command(hyp);
         }
     }
     logger(MSG_INFO, "%s: GETTING OUT\n", __func__);
 
-    free(frame);
+    free(pcm);
 
     ps_endpointer_free(ep);
     ps_free(decoder);
@@ -12,6 +12,7 @@
 #include "ipc.h"
 #include "logger.h"
 #include "nas.h"
+#include "pkt_trace.h"
 #include "proxy.h"
 #include "scheduler.h"
 #include "sms.h"
@@ -131,6 +132,40 @@ void cmd_get_gps_stats() {
   add_message_to_queue(reply, strsz);
 }
 
+void cmd_set_packet_tracing(bool en) {
+  size_t strsz = 0;
+  uint8_t reply[MAX_MESSAGE_SIZE];
+
+  if (en && !pkt_trace_is_enabled())
+    pkt_trace_reset();
+  pkt_trace_set_enabled(en);
+  strsz = snprintf((char *)reply, MAX_MESSAGE_SIZE, "Packet tracing: %s\n",
+                   en ? "enabled" : "disabled");
+  add_message_to_queue(reply, strsz);
+}
+
+void cmd_get_packet_trace() {
+  size_t strsz = 0;
+  uint8_t reply[MAX_MESSAGE_SIZE];
+
+  if (!pkt_trace_is_enabled()) {
+    strsz = snprintf((char *)reply, MAX_MESSAGE_SIZE,
+                     "Packet tracing is disabled, enable it first\n");
+    add_message_to_queue(reply, strsz);
+    return;
+  }
+
+  strsz = pkt_trace_get_summary((char *)reply, MAX_MESSAGE_SIZE);
+  if (pkt_trace_dump() == 0 && strsz < MAX_MESSAGE_SIZE) {
+    strsz += snprintf((char *)reply + strsz, MAX_MESSAGE_SIZE - strsz,
+                      "Full trace in %s%s", get_default_logpath(),
+                      PKT_TRACE_FILE);
+  }
+  if (strsz >= MAX_MESSAGE_SIZE)
+    strsz = MAX_MESSAGE_SIZE - 1;
+  add_message_to_queue(reply, strsz);
+}
+
 void cmd_get_help() {
   /* Help */
   size_t strsz = 0;
@@ -603,12 +638,14 @@ void cmd_dump_signal_report() {
 
 void *cmd_delayed_shutdown() {
   sleep(5);
+  flush_pending_settings();
   reboot(0x4321fedc);
   return NULL;
 }
 
 void *cmd_delayed_reboot() {
   sleep(5);
+  flush_pending_settings();
   reboot(0x01234567);
   return NULL;
 }
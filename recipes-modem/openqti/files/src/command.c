@@ -249,6 +249,15 @@ uint8_t parse_command(uint8_t *command) {
   case CMD_ID_GET_RUNNING_CONFIG:
     cmd_get_running_config();
     break;
+  case CMD_ID_ACTION_ENABLE_PACKET_TRACING:
+    cmd_set_packet_tracing(true);
+    break;
+  case CMD_ID_ACTION_DISABLE_PACKET_TRACING:
+    cmd_set_packet_tracing(false);
+    break;
+  case CMD_ID_GET_PACKET_TRACE:
+    cmd_get_packet_trace();
+    break;
   case CMD_ID_ACTION_ENABLE_CELL_BROADCAST:
     cmd_set_cb_broadcast(true);
     break;
@@ -9,6 +9,7 @@
 #include <linux/netdevice.h>
 #include <linux/reboot.h>
 #include <pthread.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,10 +17,187 @@
 #include <sys/poll.h>
 #include <sys/time.h>
 #include <syscall.h>
+#include <time.h>
 #include <unistd.h>
 
 #define BOOT_FLAG_FILE "/persist/.openqti_boot_done"
-struct config_prototype *settings;
+
+/*
+ * Settings are published as immutable snapshots: readers just load the
+ * current pointer and read from it, writers copy it, modify the copy and
+ * swap the pointer. Replaced snapshots are kept around for a while before
+ * being freed, as some getters hand out pointers to strings inside them.
+ */
+static struct config_prototype *settings;
+
+struct retired_snapshot {
+  struct config_prototype *snapshot;
+  time_t retired_at;
+  struct retired_snapshot *next;
+};
+
+static struct {
+  pthread_mutex_t update_lock;
+  pthread_mutex_t storage_lock;
+  pthread_mutex_t flush_lock;
+  pthread_cond_t flush_cond;
+  pthread_once_t flush_thread_once;
+  bool flush_pending;
+  struct timespec flush_deadline;
+  struct retired_snapshot *retired;
+} config_rt = {
+    .update_lock = PTHREAD_MUTEX_INITIALIZER,
+    .storage_lock = PTHREAD_MUTEX_INITIALIZER,
+    .flush_lock = PTHREAD_MUTEX_INITIALIZER,
+    .flush_cond = PTHREAD_COND_INITIALIZER,
+    .flush_thread_once = PTHREAD_ONCE_INIT,
+    .flush_pending = false,
+    .retired = NULL,
+};
+
+/* Key table: everything that is stored in the config file */
+static const struct config_key config_keys[] = {
+    {"custom_alert_tone", CFG_TYPE_U8,
+     offsetof(struct config_prototype, custom_alert_tone), 0, 1},
+    {"persistent_logging", CFG_TYPE_U8,
+     offsetof(struct config_prototype, persistent_logging), 0, 1},
+    {"user_name", CFG_TYPE_STR, offsetof(struct config_prototype, user_name),
+     0, MAX_NAME_SZ},
+    {"modem_name", CFG_TYPE_STR, offsetof(struct config_prototype, modem_name),
+     0, MAX_NAME_SZ},
+    {"signal_tracking", CFG_TYPE_U8,
+     offsetof(struct config_prototype, signal_tracking), 0, 1},
+    {"signal_tracking_mode", CFG_TYPE_U8,
+     offsetof(struct config_prototype, signal_tracking_mode), 0, 3},
+    {"signal_tracking_notify_downgrade", CFG_TYPE_U8,
+     offsetof(struct config_prototype, signal_tracking_notify_downgrade), 0, 1},
+    {"signal_tracking_notify_cell_change", CFG_TYPE_U8,
+     offsetof(struct config_prototype, signal_tracking_notify_cell_change), 0,
+     2},
+    {"dump_network_tables", CFG_TYPE_U8,
+     offsetof(struct config_prototype, dump_network_tables), 0, 1},
+    {"callwait_autohangup", CFG_TYPE_U8,
+     offsetof(struct config_prototype, callwait_autohangup), 0, 2},
+    {"automatic_call_recording", CFG_TYPE_U8,
+     offsetof(struct config_prototype, automatic_call_recording), 0, 2},
+    {"sms_logging", CFG_TYPE_U8, offsetof(struct config_prototype, sms_logging),
+     0, 1},
+    {"list_all_bypass", CFG_TYPE_U8,
+     offsetof(struct config_prototype, list_all_bypass), 0, 1},
+    {"allow_internal_modem_connectivity", CFG_TYPE_U8,
+     offsetof(struct config_prototype, allow_internal_modem_connectivity), 0,
+     1},
+    {"auth_method", CFG_TYPE_U8,
+     offsetof(struct config_prototype, apn_auth_method), 0, 3},
+    {"apn_addr", CFG_TYPE_STR, offsetof(struct config_prototype, apn_addr), 0,
+     MAX_APN_FIELD_SZ},
+    {"apn_username", CFG_TYPE_STR,
+     offsetof(struct config_prototype, apn_username), 0, MAX_APN_FIELD_SZ},
+    {"apn_password", CFG_TYPE_STR,
+     offsetof(struct config_prototype, apn_password), 0, MAX_APN_FIELD_SZ},
+    {"ims_apn_addr", CFG_TYPE_STR,
+     offsetof(struct config_prototype, ims_apn_addr), 0, MAX_APN_FIELD_SZ},
+    {"ims_apn_username", CFG_TYPE_STR,
+     offsetof(struct config_prototype, ims_apn_username), 0, MAX_APN_FIELD_SZ},
+    {"ims_apn_password", CFG_TYPE_STR,
+     offsetof(struct config_prototype, ims_apn_password), 0, MAX_APN_FIELD_SZ},
+    {"ims_attempt_enable", CFG_TYPE_U8,
+     offsetof(struct config_prototype, ims_attempt_enable), 0, 1},
+    {"ims_vt_support", CFG_TYPE_U8,
+     offsetof(struct config_prototype, ims_vt_support), 0, 1},
+    {"ims_rtp_support", CFG_TYPE_U8,
+     offsetof(struct config_prototype, ims_rtp_support), 0, 1},
+    {"ims_sms_support", CFG_TYPE_U8,
+     offsetof(struct config_prototype, ims_sms_support), 0, 1},
+};
+
+#define CONFIG_NUM_KEYS (sizeof(config_keys) / sizeof(config_keys[0]))
+
+/* Open addressing hash: slot -> index in config_keys + 1, 0 is empty */
+static uint8_t config_key_hash[CONFIG_KEY_HASH_SZ];
+
+static uint32_t hash_config_key(const char *key) {
+  uint32_t hash = 5381;
+  while (*key)
+    hash = ((hash << 5) + hash) ^ (uint8_t)*key++;
+  return hash;
+}
+
+static void build_config_key_hash(void) {
+  uint32_t slot;
+  memset(config_key_hash, 0, sizeof(config_key_hash));
+  for (uint8_t i = 0; i < CONFIG_NUM_KEYS; i++) {
+    slot = hash_config_key(config_keys[i].key) & (CONFIG_KEY_HASH_SZ - 1);
+    while (config_key_hash[slot] != 0)
+      slot = (slot + 1) & (CONFIG_KEY_HASH_SZ - 1);
+    config_key_hash[slot] = i + 1;
+  }
+}
+
+const struct config_key *find_config_key(const char *key) {
+  uint32_t slot = hash_config_key(key) & (CONFIG_KEY_HASH_SZ - 1);
+  while (config_key_hash[slot] != 0) {
+    if (strcmp(config_keys[config_key_hash[slot] - 1].key, key) == 0)
+      return &config_keys[config_key_hash[slot] - 1];
+    slot = (slot + 1) & (CONFIG_KEY_HASH_SZ - 1);
+  }
+  return NULL;
+}
+
+/* Readers: always go through the currently published snapshot */
+static inline struct config_prototype *current_settings(void) {
+  return __atomic_load_n(&settings, __ATOMIC_ACQUIRE);
+}
+
+static time_t get_monotonic_secs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec;
+}
+
+/* Free replaced snapshots once nobody can reasonably be reading them */
+static void reclaim_retired_snapshots(void) {
+  struct retired_snapshot **pos = &config_rt.retired;
+  struct retired_snapshot *tmp;
+  time_t now = get_monotonic_secs();
+  while (*pos != NULL) {
+    if (now - (*pos)->retired_at >= CONFIG_RECLAIM_GRACE_SECS) {
+      tmp = *pos;
+      *pos = tmp->next;
+      free(tmp->snapshot);
+      free(tmp);
+    } else {
+      pos = &(*pos)->next;
+    }
+  }
+}
+
+/*
+ * Writers: config_begin_update() returns a private copy of the current
+ * settings with the update lock held, config_commit_update() publishes it
+ * and, if requested, schedules it to be written to /persist
+ */
+static struct config_prototype *config_begin_update(void) {
+  struct config_prototype *next;
+  pthread_mutex_lock(&config_rt.update_lock);
+  next = malloc(sizeof(struct config_prototype));
+  memcpy(next, settings, sizeof(struct config_prototype));
+  return next;
+}
+
+static void config_commit_update(struct config_prototype *next, bool persist) {
+  struct retired_snapshot *old = calloc(1, sizeof(struct retired_snapshot));
+  old->snapshot = settings;
+  old->retired_at = get_monotonic_secs();
+  __atomic_store_n(&settings, next, __ATOMIC_RELEASE);
+  reclaim_retired_snapshots();
+  old->next = config_rt.retired;
+  config_rt.retired = old;
+  pthread_mutex_unlock(&config_rt.update_lock);
+
+  if (persist)
+    schedule_settings_write();
+}
 
 int set_persistent_partition_rw(void) {
   if (system("mount -o remount,rw /persist") < 0) {
@@ -44,255 +222,238 @@ void do_sync_fs(void) {
 }
 
 int set_initial_config(void) {
-  settings = malloc(sizeof(struct config_prototype));
-  settings->custom_alert_tone = 0;
-  settings->persistent_logging = 0;
-  settings->signal_tracking = 0;
-  settings->signal_tracking_mode = 0;
-  settings->signal_tracking_notify_downgrade = 0;
-  settings->signal_tracking_notify_cell_change = 0;
-  settings->sms_logging = 0;
-  settings->list_all_bypass = 1;
-  settings->callwait_autohangup = 0;
-  settings->automatic_call_recording = 0;
-  settings->allow_internal_modem_connectivity = 0;
-  settings->dump_network_tables = 0;
-  settings->first_boot = false;
-  snprintf(settings->user_name, MAX_NAME_SZ, "Admin");
-  snprintf(settings->modem_name, MAX_NAME_SZ, "Modem");
-  settings->ims_attempt_enable = 0;
-  settings->ims_vt_support = 0;
-  settings->ims_rtp_support = 0;
-  settings->ims_sms_support = 0;
-  snprintf(settings->ims_apn_addr, MAX_APN_FIELD_SZ, "ims");
+  struct config_prototype *defaults;
+  build_config_key_hash();
+  defaults = calloc(1, sizeof(struct config_prototype));
+  defaults->custom_alert_tone = 0;
+  defaults->persistent_logging = 0;
+  defaults->signal_tracking = 0;
+  defaults->signal_tracking_mode = 0;
+  defaults->signal_tracking_notify_downgrade = 0;
+  defaults->signal_tracking_notify_cell_change = 0;
+  defaults->sms_logging = 0;
+  defaults->list_all_bypass = 1;
+  defaults->callwait_autohangup = 0;
+  defaults->automatic_call_recording = 0;
+  defaults->allow_internal_modem_connectivity = 0;
+  defaults->dump_network_tables = 0;
+  defaults->first_boot = false;
+  snprintf(defaults->user_name, MAX_NAME_SZ, "Admin");
+  snprintf(defaults->modem_name, MAX_NAME_SZ, "Modem");
+  defaults->ims_attempt_enable = 0;
+  defaults->ims_vt_support = 0;
+  defaults->ims_rtp_support = 0;
+  defaults->ims_sms_support = 0;
+  snprintf(defaults->ims_apn_addr, MAX_APN_FIELD_SZ, "ims");
+  __atomic_store_n(&settings, defaults, __ATOMIC_RELEASE);
   return 0;
 }
 
-int parse_line(char *buf) {
-  if (settings == NULL || buf == NULL)
-    return 0;
-
-  char setting[64];
-  char value[64];
-  const char *sep = "=\n"; // get also rid of newlines
-  char *token;
-
-  token = strtok(buf, sep);
-
-  strncpy(setting, token, sizeof setting);
-  setting[sizeof(setting) - 1] = 0; // making sure that setting is C-String
-  token = strtok(NULL, sep);
-
-  if (token == NULL) {
-    return 0;
-  }
-
-  strncpy(value, token, sizeof value);
-  value[sizeof(setting) - 1] = 0;
-
-  if (setting[0] == '#') { // Ignore if it's a comment
-    return 1;
-  }
-
-  logger(MSG_DEBUG, "%s: Key %s -> val %s\n", __func__, setting, value);
-  if (strcmp(setting, "custom_alert_tone") == 0) {
-    settings->custom_alert_tone = atoi(value);
-    return 1;
-  }
-  if (strcmp(setting, "persistent_logging") == 0) {
-    settings->persistent_logging = atoi(value);
-    /* As soon as we read this, we remount the partition as rw */
-    if (settings->persistent_logging) {
-      set_persistent_partition_rw();
+/* Validate and store a value into the field described by key */
+static int store_config_value(struct config_prototype *cfg,
+                              const struct config_key *key,
+                              const char *value) {
+  char *end;
+  long val;
+  uint8_t *field = (uint8_t *)cfg + key->offset;
+
+  switch (key->type) {
+  case CFG_TYPE_U8:
+    val = strtol(value, &end, 10);
+    if (end == value || val < key->min || val > key->max) {
+      logger(MSG_WARN, "%s: Invalid value for %s: %s\n", __func__, key->key,
+             value);
+      return 0;
     }
+    *field = (uint8_t)val;
     return 1;
-  }
-  if (strcmp(setting, "signal_tracking") == 0) {
-    settings->signal_tracking = atoi(value);
-    return 1;
-  }
 
-  if (strcmp(setting, "signal_tracking_mode") == 0) {
-    settings->signal_tracking_mode = atoi(value);
+  case CFG_TYPE_STR:
+    snprintf((char *)field, key->max, "%s", value);
     return 1;
   }
 
-  if (strcmp(setting, "signal_tracking_notify_downgrade") == 0) {
-    settings->signal_tracking_notify_downgrade = atoi(value);
-    return 1;
-  }
+  return 0;
+}
 
-  if (strcmp(setting, "signal_tracking_notify_cell_change") == 0) {
-    settings->signal_tracking_notify_cell_change = atoi(value);
-    return 1;
-  }
+/* Parses a line from the config file into cfg */
+static int parse_line(struct config_prototype *cfg, char *buf) {
+  const struct config_key *key;
+  char *setting, *value;
+  const char *sep = "=\n"; // get also rid of newlines
+  char *saveptr = NULL;
 
-  if (strcmp(setting, "dump_network_tables") == 0) {
-    settings->dump_network_tables = atoi(value);
-    return 1;
-  }
+  if (cfg == NULL || buf == NULL)
+    return 0;
 
-  if (strcmp(setting, "callwait_autohangup") == 0) {
-    settings->callwait_autohangup = atoi(value);
-    return 1;
-  }
+  setting = strtok_r(buf, sep, &saveptr);
+  if (setting == NULL)
+    return 0;
 
-  if (strcmp(setting, "sms_logging") == 0) {
-    settings->sms_logging = atoi(value);
+  if (setting[0] == '#') { // Ignore if it's a comment
     return 1;
   }
 
-  if (strcmp(setting, "list_all_bypass") == 0) {
-    settings->list_all_bypass = atoi(value);
-    return 1;
+  value = strtok_r(NULL, sep, &saveptr);
+  if (value == NULL) {
+    return 0;
   }
 
-  if (strcmp(setting, "allow_internal_modem_connectivity") == 0) {
-    settings->allow_internal_modem_connectivity = atoi(value);
-    return 1;
+  logger(MSG_DEBUG, "%s: Key %s -> val %s\n", __func__, setting, value);
+  key = find_config_key(setting);
+  if (key == NULL) {
+    logger(MSG_WARN, "%s: Unknown key %s\n", __func__, setting);
+    return 0;
   }
 
-  if (strcmp(setting, "automatic_call_recording") == 0) {
-    settings->automatic_call_recording = atoi(value);
-    return 1;
-  }
+  return store_config_value(cfg, key, value);
+}
 
-  if (strcmp(setting, "user_name") == 0) {
-    snprintf(settings->user_name, MAX_NAME_SZ, "%s", value);
-    settings->user_name[strlen(settings->user_name)] = 0;
-    return 1;
+static int write_config_file(struct config_prototype *cfg) {
+  FILE *fp;
+  int fd;
+  uint8_t *field;
+  logger(MSG_DEBUG, "%s: Open file\n", __func__);
+  fp = fopen(CONFIG_FILE_PATH_TMP, "w");
+  if (fp == NULL) {
+    logger(MSG_ERROR, "%s: Can't open config file for writing\n", __func__);
+    return -1;
   }
-
-  if (strcmp(setting, "modem_name") == 0) {
-    snprintf(settings->modem_name, MAX_NAME_SZ, "%s", value);
-    settings->modem_name[strlen(settings->modem_name)] = 0;
-    return 1;
+  logger(MSG_INFO, "%s: Store\n", __func__);
+  fprintf(fp, "# OpenQTI Config file\n");
+  fprintf(fp, "# key=value\n");
+  for (uint8_t i = 0; i < CONFIG_NUM_KEYS; i++) {
+    field = (uint8_t *)cfg + config_keys[i].offset;
+    if (config_keys[i].type == CFG_TYPE_U8) {
+      fprintf(fp, "%s=%i\n", config_keys[i].key, *field);
+    } else {
+      fprintf(fp, "%s=%s\n", config_keys[i].key, (char *)field);
+    }
   }
 
-  if (strcmp(setting, "apn_addr") == 0) {
-    snprintf(settings->apn_addr, MAX_APN_FIELD_SZ, "%s", value);
-    settings->apn_addr[strlen(settings->apn_addr)] = 0;
-    return 1;
+  logger(MSG_DEBUG, "%s: Close\n", __func__);
+  if (fflush(fp) != 0 || fsync(fileno(fp)) < 0) {
+    logger(MSG_ERROR, "%s: Failed to flush the config file\n", __func__);
+    fclose(fp);
+    unlink(CONFIG_FILE_PATH_TMP);
+    return -1;
   }
+  fclose(fp);
 
-  if (strcmp(setting, "apn_username") == 0) {
-    snprintf(settings->apn_username, MAX_APN_FIELD_SZ, "%s", value);
-    settings->apn_username[strlen(settings->apn_username)] = 0;
-    return 1;
+  /* Swap it in place: we either get the old or the new file, never half */
+  if (rename(CONFIG_FILE_PATH_TMP, CONFIG_FILE_PATH) < 0) {
+    logger(MSG_ERROR, "%s: Can't replace config file: %s\n", __func__,
+           strerror(errno));
+    unlink(CONFIG_FILE_PATH_TMP);
+    return -1;
   }
 
-  if (strcmp(setting, "apn_password") == 0) {
-    snprintf(settings->apn_password, MAX_APN_FIELD_SZ, "%s", value);
-    settings->apn_password[strlen(settings->apn_password)] = 0;
-    return 1;
-  }
-  
-  if (strcmp(setting, "auth_method") == 0) {
-    settings->apn_auth_method = atoi(value);
-    return 1;
+  fd = open(PERSISTENT_PATH, O_RDONLY | O_DIRECTORY);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
   }
+  return 0;
+}
 
-
-  if (strcmp(setting, "ims_apn_addr") == 0) {
-    snprintf(settings->ims_apn_addr, MAX_APN_FIELD_SZ, "%s", value);
-    settings->ims_apn_addr[strlen(settings->ims_apn_addr)] = 0;
-    return 1;
+int write_settings_to_storage(void) {
+  struct config_prototype *cfg;
+  int ret = 0;
+  pthread_mutex_lock(&config_rt.storage_lock);
+  cfg = current_settings();
+  if (set_persistent_partition_rw() < 0) {
+    logger(MSG_ERROR, "%s: Can't set persist partition in RW mode\n", __func__);
+    pthread_mutex_unlock(&config_rt.storage_lock);
+    return -1;
   }
-
-
-  if (strcmp(setting, "ims_apn_username") == 0) {
-    snprintf(settings->ims_apn_username, MAX_APN_FIELD_SZ, "%s", value);
-    settings->ims_apn_username[strlen(settings->ims_apn_username)] = 0;
-    return 1;
+  if (write_config_file(cfg) < 0) {
+    ret = -1;
   }
-
-
-  if (strcmp(setting, "ims_apn_password") == 0) {
-    snprintf(settings->ims_apn_password, MAX_APN_FIELD_SZ, "%s", value);
-    settings->ims_apn_password[strlen(settings->ims_apn_password)] = 0;
-    return 1;
+  /* Read it again, it might have been enabled while we were writing */
+  if (!current_settings()->persistent_logging) {
+    if (set_persistent_partition_ro() < 0) {
+      logger(MSG_ERROR, "%s: Can't set persist partition in RO mode\n",
+             __func__);
+      ret = -1;
+    }
   }
+  pthread_mutex_unlock(&config_rt.storage_lock);
+  return ret;
+}
 
-  if (strcmp(setting, "ims_attempt_enable") == 0) {
-    settings->ims_attempt_enable = atoi(value);
-    return 1;
+static void get_flush_deadline(struct timespec *ts) {
+  clock_gettime(CLOCK_MONOTONIC, ts);
+  ts->tv_sec += CONFIG_WRITE_DELAY_MS / 1000;
+  ts->tv_nsec += (CONFIG_WRITE_DELAY_MS % 1000) * 1000000L;
+  if (ts->tv_nsec >= 1000000000L) {
+    ts->tv_sec++;
+    ts->tv_nsec -= 1000000000L;
   }
+}
 
-  if (strcmp(setting, "ims_vt_support") == 0) {
-    settings->ims_vt_support = atoi(value);
-    return 1;
-  }
+/*
+ * Waits until settings have been left alone for CONFIG_WRITE_DELAY_MS
+ * and then stores them, so a burst of changes ends up as a single write
+ */
+static void *settings_flush_thread(void *arg) {
+  int ret;
+  pthread_mutex_lock(&config_rt.flush_lock);
+  while (1) {
+    while (!config_rt.flush_pending)
+      pthread_cond_wait(&config_rt.flush_cond, &config_rt.flush_lock);
 
-  if (strcmp(setting, "ims_rtp_support") == 0) {
-    settings->ims_rtp_support = atoi(value);
-    return 1;
-  }
+    ret = pthread_cond_timedwait(&config_rt.flush_cond, &config_rt.flush_lock,
+                                 &config_rt.flush_deadline);
+    if (ret != ETIMEDOUT || !config_rt.flush_pending)
+      continue; // Either flushed by someone else or it changed again
 
-  if (strcmp(setting, "ims_sms_support") == 0) {
-    settings->ims_sms_support = atoi(value);
-    return 1;
+    config_rt.flush_pending = false;
+    pthread_mutex_unlock(&config_rt.flush_lock);
+    logger(MSG_DEBUG, "%s: Storing pending settings\n", __func__);
+    write_settings_to_storage();
+    pthread_mutex_lock(&config_rt.update_lock);
+    reclaim_retired_snapshots();
+    pthread_mutex_unlock(&config_rt.update_lock);
+    pthread_mutex_lock(&config_rt.flush_lock);
+  }
+  pthread_mutex_unlock(&config_rt.flush_lock);
+  return NULL;
+}
+
+static void start_settings_flush_thread(void) {
+  pthread_t flush_thread;
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_destroy(&config_rt.flush_cond);
+  pthread_cond_init(&config_rt.flush_cond, &attr);
+  pthread_condattr_destroy(&attr);
+  if (pthread_create(&flush_thread, NULL, &settings_flush_thread, NULL)) {
+    logger(MSG_ERROR, "%s: Error creating settings flush thread\n", __func__);
+    return;
   }
-
-
-  return 0;
+  pthread_detach(flush_thread);
 }
 
-int write_settings_to_storage() {
-  FILE *fp;
-  if (set_persistent_partition_rw() < 0) {
-    logger(MSG_ERROR, "%s: Can't set persist partition in RW mode\n", __func__);
-    return -1;
-  }
-  logger(MSG_DEBUG, "%s: Open file\n", __func__);
-  fp = fopen(CONFIG_FILE_PATH, "w");
-  if (fp == NULL) {
-    logger(MSG_ERROR, "%s: Can't open config file for writing\n", __func__);
-    return -1;
-  }
-  logger(MSG_INFO, "%s: Store\n", __func__);
-  fprintf(fp, "# OpenQTI Config file\n");
-  fprintf(fp, "# key=value\n");
-  fprintf(fp, "custom_alert_tone=%i\n", settings->custom_alert_tone);
-  fprintf(fp, "persistent_logging=%i\n", settings->persistent_logging);
-  fprintf(fp, "user_name=%s\n", settings->user_name);
-  fprintf(fp, "modem_name=%s\n", settings->modem_name);
-  fprintf(fp, "signal_tracking=%i\n", settings->signal_tracking);
-  fprintf(fp, "signal_tracking_mode=%i\n", settings->signal_tracking_mode);
-  fprintf(fp, "signal_tracking_notify_downgrade=%i\n", settings->signal_tracking_notify_downgrade);
-  fprintf(fp, "signal_tracking_notify_cell_change=%i\n", settings->signal_tracking_notify_cell_change);
-  fprintf(fp, "dump_network_tables=%i\n", settings->dump_network_tables);
-  fprintf(fp, "callwait_autohangup=%i\n", settings->callwait_autohangup);
-  fprintf(fp, "automatic_call_recording=%i\n",
-          settings->automatic_call_recording);
-  fprintf(fp, "sms_logging=%i\n", settings->sms_logging);
-  fprintf(fp, "list_all_bypass=%i\n", settings->list_all_bypass);
-
-  fprintf(fp, "allow_internal_modem_connectivity=%i\n",
-          settings->allow_internal_modem_connectivity);
-  fprintf(fp, "auth_method=%i\n",
-          settings->apn_auth_method);
-  fprintf(fp, "apn_addr=%s\n", settings->apn_addr);
-  fprintf(fp, "apn_username=%s\n", settings->apn_username);
-  fprintf(fp, "apn_password=%s\n", settings->apn_password);
-  fprintf(fp, "ims_apn_addr=%s\n", settings->ims_apn_addr);
-  fprintf(fp, "ims_apn_username=%s\n", settings->ims_apn_username);
-  fprintf(fp, "ims_apn_password=%s\n", settings->ims_apn_password);
-  fprintf(fp, "ims_attempt_enable=%i\n", settings->ims_attempt_enable);
-  fprintf(fp, "ims_vt_support=%i\n", settings->ims_vt_support);
-  fprintf(fp, "ims_rtp_support=%i\n", settings->ims_rtp_support);
-  fprintf(fp, "ims_sms_support=%i\n", settings->ims_sms_support);
+void schedule_settings_write(void) {
+  pthread_once(&config_rt.flush_thread_once, start_settings_flush_thread);
+  pthread_mutex_lock(&config_rt.flush_lock);
+  config_rt.flush_pending = true;
+  get_flush_deadline(&config_rt.flush_deadline);
+  pthread_cond_signal(&config_rt.flush_cond);
+  pthread_mutex_unlock(&config_rt.flush_lock);
+}
 
-  logger(MSG_DEBUG, "%s: Close\n", __func__);
-  fclose(fp);
-  do_sync_fs();
-  if (!settings->persistent_logging) {
-    if (set_persistent_partition_ro() < 0) {
-      logger(MSG_ERROR, "%s: Can't set persist partition in RO mode\n",
-             __func__);
-      return -1;
-    }
+void flush_pending_settings(void) {
+  bool pending;
+  pthread_mutex_lock(&config_rt.flush_lock);
+  pending = config_rt.flush_pending;
+  config_rt.flush_pending = false;
+  pthread_mutex_unlock(&config_rt.flush_lock);
+  if (pending) {
+    logger(MSG_INFO, "%s: Storing pending settings now\n", __func__);
+    write_settings_to_storage();
   }
-  return 0;
 }
 
 int write_boot_counter_file(int failed_boots) {
@@ -334,18 +495,22 @@ int read_settings_from_file(void) {
   int line = 0;
   bool recreate_cfg_required = false;
   int attempted_boots = 0;
+  struct config_prototype *next;
   fp = fopen(CONFIG_FILE_PATH, "r");
   if (fp == NULL) {
     logger(MSG_WARN, "%s: Settings file doesn't exist, creating it\n",
            __func__);
-    settings->first_boot = true;
+    next = config_begin_update();
+    next->first_boot = true;
+    config_commit_update(next, false);
     write_settings_to_storage();
     return 0;
   }
 
+  next = config_begin_update();
   while (fgets(buf, sizeof buf, fp)) {
     line++;
-    if (parse_line(buf) < 1) {
+    if (parse_line(next, buf) < 1) {
       /* There was some error or unknown in the config file
        * To avoid problems, we regenerate the config file
        * with whatever we could retrieve */
@@ -353,190 +518,222 @@ int read_settings_from_file(void) {
     }
   }
   fclose(fp);
+  /* As soon as we read this, we remount the partition as rw */
+  if (next->persistent_logging) {
+    set_persistent_partition_rw();
+  }
   attempted_boots = read_boot_counter_file();
-  if (attempted_boots > 3 && !settings->persistent_logging) {
+  if (attempted_boots > 3 && !next->persistent_logging) {
     logger(MSG_WARN,
            "%s: Enabling persistent logging due to repeated boot failures\n",
            __func__);
-    settings->persistent_logging = 1;
+    next->persistent_logging = 1;
     recreate_cfg_required = true;
   }
+  config_commit_update(next, false);
   if (recreate_cfg_required) {
     write_settings_to_storage();
   }
-  if (!settings->persistent_logging) {
+  if (!current_settings()->persistent_logging) {
     set_persistent_partition_ro();
   }
   return 0;
 }
 
-bool is_first_boot(void) { return settings->first_boot; }
+bool is_first_boot(void) { return current_settings()->first_boot; }
 
-void clear_ifrst_boot_flag(void) { settings->first_boot = false; }
+void clear_ifrst_boot_flag(void) {
+  struct config_prototype *next = config_begin_update();
+  next->first_boot = false;
+  config_commit_update(next, false);
+}
 
-uint8_t use_persistent_logging(void) { return settings->persistent_logging; }
+uint8_t use_persistent_logging(void) {
+  return current_settings()->persistent_logging;
+}
 
 char *get_openqti_logfile(void) {
-  if (settings->persistent_logging)
+  if (current_settings()->persistent_logging)
     return PERSISTENT_LOGPATH;
 
   return VOLATILE_LOGPATH;
 }
 
 char *get_default_logpath(void) {
-  if (settings->persistent_logging)
+  if (current_settings()->persistent_logging)
     return PERSISTENT_PATH;
 
   return VOLATILE_PATH;
 }
-uint8_t use_custom_alert_tone(void) { return settings->custom_alert_tone; }
+uint8_t use_custom_alert_tone(void) {
+  return current_settings()->custom_alert_tone;
+}
 
-uint8_t is_signal_tracking_enabled(void) { return settings->signal_tracking; }
+uint8_t is_signal_tracking_enabled(void) {
+  return current_settings()->signal_tracking;
+}
 
-uint8_t get_signal_tracking_mode(void) { return settings->signal_tracking_mode; }
+uint8_t get_signal_tracking_mode(void) {
+  return current_settings()->signal_tracking_mode;
+}
 
-uint8_t get_dump_network_tables_config(void) { return settings->dump_network_tables; }
+uint8_t get_dump_network_tables_config(void) {
+  return current_settings()->dump_network_tables;
+}
 
-uint8_t is_sms_logging_enabled(void) { return settings->sms_logging; }
+uint8_t is_sms_logging_enabled(void) { return current_settings()->sms_logging; }
 
-uint8_t is_sms_list_all_bypass_enabled(void) { return settings->list_all_bypass; }
+uint8_t is_sms_list_all_bypass_enabled(void) {
+  return current_settings()->list_all_bypass;
+}
 
 uint8_t is_internal_connect_enabled(void) {
-  return settings->allow_internal_modem_connectivity;
+  return current_settings()->allow_internal_modem_connectivity;
 }
 
 uint8_t is_automatic_call_recording_enabled(void) {
-  return settings->automatic_call_recording;
+  return current_settings()->automatic_call_recording;
 }
 
 uint8_t callwait_auto_hangup_operation_mode(void) {
-  return settings->callwait_autohangup;
+  return current_settings()->callwait_autohangup;
 }
 
 uint8_t get_modem_name(char *buff) {
-  snprintf(buff, MAX_NAME_SZ, "%s", settings->modem_name);
+  snprintf(buff, MAX_NAME_SZ, "%s", current_settings()->modem_name);
   return 1;
 }
 
 uint8_t get_user_name(char *buff) {
-  snprintf(buff, MAX_NAME_SZ, "%s", settings->user_name);
+  snprintf(buff, MAX_NAME_SZ, "%s", current_settings()->user_name);
   return 1;
 }
 
-char *get_rt_modem_name(void) { return settings->modem_name; }
+char *get_rt_modem_name(void) { return current_settings()->modem_name; }
 
-char *get_rt_user_name(void) { return settings->user_name; }
+char *get_rt_user_name(void) { return current_settings()->user_name; }
 
 void set_custom_alert_tone(bool en) {
+  struct config_prototype *next = config_begin_update();
   if (en) {
     logger(MSG_WARN, "Enabling Custom alert tone\n");
-    settings->custom_alert_tone = 1;
+    next->custom_alert_tone = 1;
   } else {
     logger(MSG_WARN, "Disabling custom alert tone\n");
-    settings->custom_alert_tone = 0;
+    next->custom_alert_tone = 0;
   }
-  write_settings_to_storage();
+  config_commit_update(next, true);
 }
 
 void set_automatic_call_recording(uint8_t mode) {
+  struct config_prototype *next = config_begin_update();
   if (mode == 2) {
     logger(MSG_WARN,
            "Enabling Automatic Call Recording (record and recycle)\n");
-    settings->automatic_call_recording = 2;
+    next->automatic_call_recording = 2;
   } else if (mode == 1) {
     logger(MSG_WARN, "Enabling Automatic Call Recording\n");
-    settings->automatic_call_recording = 1;
+    next->automatic_call_recording = 1;
   } else {
     logger(MSG_WARN, "Disabling Automatic Call Recording\n");
-    settings->automatic_call_recording = 0;
+    next->automatic_call_recording = 0;
   }
-  write_settings_to_storage();
+  config_commit_update(next, true);
 }
 
 void set_sms_logging(bool en) {
+  struct config_prototype *next = config_begin_update();
   if (en) {
     logger(MSG_WARN, "Enabling SMS logging\n");
-    settings->sms_logging = 1;
+    next->sms_logging = 1;
   } else {
     logger(MSG_WARN, "Disabling SMS logging\n");
-    settings->sms_logging = 0;
+    next->sms_logging = 0;
   }
-  write_settings_to_storage();
+  config_commit_update(next, true);
 }
 
 void set_list_all_bypass(bool en) {
+  struct config_prototype *next = config_begin_update();
   if (en) {
     logger(MSG_WARN, "Enabling SMS List All Bypass for MM\n");
-    settings->list_all_bypass = 1;
+    next->list_all_bypass = 1;
   } else {
     logger(MSG_WARN, "Disabling SMS List All Bypass for MM\n");
-    settings->list_all_bypass = 0;
+    next->list_all_bypass = 0;
   }
-  write_settings_to_storage();
+  config_commit_update(next, true);
 }
 
 void set_internal_connectivity(bool en) {
+  struct config_prototype *next = config_begin_update();
   if (en) {
     logger(MSG_WARN, "Enabling Internal networking support (reboot needed)\n");
-    settings->allow_internal_modem_connectivity = 1;
+    next->allow_internal_modem_connectivity = 1;
   } else {
     logger(MSG_WARN, "Disabling Internal networking support (reboot needed)\n");
-    settings->allow_internal_modem_connectivity = 0;
+    next->allow_internal_modem_connectivity = 0;
   }
-  write_settings_to_storage();
+  config_commit_update(next, true);
 }
 
 void set_persistent_logging(bool en) {
+  struct config_prototype *next = config_begin_update();
   if (en) {
     logger(MSG_WARN, "Enabling Persistent logs\n");
     if (set_persistent_partition_rw() < 0) {
       logger(MSG_WARN, "Failed to set partition as RW\n");
-      settings->persistent_logging = 0;
+      next->persistent_logging = 0;
     } else {
-      settings->persistent_logging = 1;
+      next->persistent_logging = 1;
     }
   } else {
     logger(MSG_WARN, "Disabling Persistent logs\n");
-    settings->persistent_logging = 0;
+    next->persistent_logging = 0;
   }
-  write_settings_to_storage();
+  config_commit_update(next, true);
 }
 
 void set_modem_name(char *name) {
-  memset(settings->modem_name, 0, MAX_NAME_SZ);
-  snprintf(settings->modem_name, MAX_NAME_SZ, "%s", name);
-  write_settings_to_storage();
+  struct config_prototype *next = config_begin_update();
+  memset(next->modem_name, 0, MAX_NAME_SZ);
+  snprintf(next->modem_name, MAX_NAME_SZ, "%s", name);
+  config_commit_update(next, true);
 }
 
 void set_user_name(char *name) {
-  memset(settings->user_name, 0, MAX_NAME_SZ);
-  snprintf(settings->user_name, MAX_NAME_SZ, "%s", name);
-  write_settings_to_storage();
+  struct config_prototype *next = config_begin_update();
+  memset(next->user_name, 0, MAX_NAME_SZ);
+  snprintf(next->user_name, MAX_NAME_SZ, "%s", name);
+  config_commit_update(next, true);
 }
 
 void enable_signal_tracking(bool en) {
+  struct config_prototype *next = config_begin_update();
   if (en) {
     logger(MSG_WARN, "Enabling Signal tracking\n");
-    settings->signal_tracking = 1;
+    next->signal_tracking = 1;
   } else {
     logger(MSG_WARN, "Disabling Signal tracking\n");
-    settings->signal_tracking = 0;
+    next->signal_tracking = 0;
   }
-  write_settings_to_storage();
+  config_commit_update(next, true);
 }
 
 void enable_dump_network_tables(bool en) {
+  struct config_prototype *next = config_begin_update();
   if (en) {
     logger(MSG_WARN, "Enable logging of cell location data as csv\n");
-    settings->dump_network_tables = 1;
+    next->dump_network_tables = 1;
   } else {
     logger(MSG_WARN, "Disabling  logging of cell location data as csv\n");
-    settings->dump_network_tables = 0;
+    next->dump_network_tables = 0;
   }
-  write_settings_to_storage();
+  config_commit_update(next, true);
 }
 
 void set_signal_tracking_mode(uint8_t mode) {
+  struct config_prototype *next;
   if (mode > 3) {
     logger(MSG_ERROR, "%s: Invalid mode: %u\n", __func__, mode);
     return;
@@ -564,29 +761,32 @@ void set_signal_tracking_mode(uint8_t mode) {
            __func__);
     break;
   }
-  settings->signal_tracking_mode = mode;
-  write_settings_to_storage();
+  next = config_begin_update();
+  next->signal_tracking_mode = mode;
+  config_commit_update(next, true);
 }
 
 uint8_t is_signal_tracking_downgrade_notification_enabled(void) {
-  return settings->signal_tracking_notify_downgrade;
+  return current_settings()->signal_tracking_notify_downgrade;
 }
 uint8_t get_signal_tracking_cell_change_notification_mode(void) {
-  return settings->signal_tracking_notify_cell_change;
+  return current_settings()->signal_tracking_notify_cell_change;
 }
 
 void set_signal_tracking_downgrade_notification(uint8_t enable) {
+  struct config_prototype *next = config_begin_update();
   if (enable) {
     logger(MSG_WARN, "Enabling Signal downgrade notification\n");
-    settings->signal_tracking_notify_downgrade = 1;
+    next->signal_tracking_notify_downgrade = 1;
   } else {
     logger(MSG_WARN, "Disabling Signal downgrade notification\n");
-    settings->signal_tracking_notify_downgrade = 0;
+    next->signal_tracking_notify_downgrade = 0;
   }
-  write_settings_to_storage();
+  config_commit_update(next, true);
 }
 
 void set_signal_tracking_cell_change_notification(uint8_t mode) {
+  struct config_prototype *next;
   if (mode > 2) {
     logger(MSG_ERROR, "%s: Invalid mode: %u\n", __func__, mode);
     return;
@@ -609,119 +809,134 @@ void set_signal_tracking_cell_change_notification(uint8_t mode) {
     break;
 
   }
-  settings->signal_tracking_notify_cell_change = mode;
-  write_settings_to_storage();
+  next = config_begin_update();
+  next->signal_tracking_notify_cell_change = mode;
+  config_commit_update(next, true);
 }
 
 void enable_call_waiting_autohangup(uint8_t en) {
+  struct config_prototype *next = config_begin_update();
   if (en == 2) {
     logger(MSG_WARN, "Enabling Automatic hang up of calls in waiting state\n");
-    settings->callwait_autohangup = 2;
+    next->callwait_autohangup = 2;
   } else if (en == 1) {
     logger(MSG_WARN, "Enabling Automatic ignore of calls in waiting state\n");
-    settings->callwait_autohangup = 1;
+    next->callwait_autohangup = 1;
   } else {
     logger(MSG_WARN,
            "Disabling Automatic handling of calls in waiting state\n");
-    settings->callwait_autohangup = 0;
+    next->callwait_autohangup = 0;
   }
-  write_settings_to_storage();
+  config_commit_update(next, true);
 }
 
 char *get_signal_tracking_mode_text(void) {
-  if (settings->signal_tracking_mode == 0) {
+  struct config_prototype *cfg = current_settings();
+  if (cfg->signal_tracking_mode == 0) {
     return "Standalone/Learn";
-  } else if (settings->signal_tracking_mode == 1) {
+  } else if (cfg->signal_tracking_mode == 1) {
     return "Standalone/Strict";
-  } else if (settings->signal_tracking_notify_cell_change == 2) {
+  } else if (cfg->signal_tracking_notify_cell_change == 2) {
     return "OpenCellid/Learn";
-  } else if (settings->signal_tracking_notify_cell_change == 2) {
+  } else if (cfg->signal_tracking_notify_cell_change == 2) {
     return "OpenCellid/Strict";
   }
   return "unknown";
 }
 
 char *get_signal_tracking_cell_change_notification_mode_text(void) {
-  if (settings->signal_tracking_notify_cell_change == 0) {
+  struct config_prototype *cfg = current_settings();
+  if (cfg->signal_tracking_notify_cell_change == 0) {
     return "none";
-  } else if (settings->signal_tracking_notify_cell_change == 1) {
+  } else if (cfg->signal_tracking_notify_cell_change == 1) {
     return "new cells";
-  } else if (settings->signal_tracking_notify_cell_change == 2) {
+  } else if (cfg->signal_tracking_notify_cell_change == 2) {
     return "any";
   }
   return "unknown";
 }
 
 char *get_internal_network_apn_name(void) {
-  return settings->apn_addr;
+  return current_settings()->apn_addr;
 }
 
 char *get_internal_network_username(void) {
-  return settings->apn_username;
+  return current_settings()->apn_username;
 }
 
 char *get_internal_network_pass(void) {
-  return settings->apn_password;
+  return current_settings()->apn_password;
 }
 char *get_internal_network_auth_method_text(void) {
-  if (settings->apn_auth_method == 0) {
+  struct config_prototype *cfg = current_settings();
+  if (cfg->apn_auth_method == 0) {
     return "none";
-  } else if (settings->apn_auth_method == 1) {
+  } else if (cfg->apn_auth_method == 1) {
     return "pap";
-  } else if (settings->apn_auth_method == 2) {
+  } else if (cfg->apn_auth_method == 2) {
     return "chap";
-  } else if (settings->apn_auth_method == 3) {
+  } else if (cfg->apn_auth_method == 3) {
     return "auto";
   }
   return "unknown";
 }
 
 uint8_t get_internal_network_auth_method(void) {
-  return settings->apn_auth_method;
+  return current_settings()->apn_auth_method;
 }
 
 void set_internal_network_apn_name(char *apn) {
+  struct config_prototype *next = config_begin_update();
   size_t len = strlen(apn) > MAX_APN_FIELD_SZ ? (MAX_APN_FIELD_SZ-1) : strlen(apn);
-  memset(settings->apn_addr, 0, MAX_APN_FIELD_SZ);
-  strncpy(settings->apn_addr, apn, len);
-  write_settings_to_storage();
+  memset(next->apn_addr, 0, MAX_APN_FIELD_SZ);
+  strncpy(next->apn_addr, apn, len);
+  config_commit_update(next, true);
 }
 
 void set_internal_network_username(char *username) {
+  struct config_prototype *next = config_begin_update();
   size_t len = strlen(username) > MAX_APN_FIELD_SZ ? (MAX_APN_FIELD_SZ-1) : strlen(username);
-  memset(settings->apn_username, 0, MAX_APN_FIELD_SZ);
-  strncpy(settings->apn_username, username, len);
-  write_settings_to_storage();
+  memset(next->apn_username, 0, MAX_APN_FIELD_SZ);
+  strncpy(next->apn_username, username, len);
+  config_commit_update(next, true);
 }
 
 void set_internal_network_pass(char *pass) {
+  struct config_prototype *next = config_begin_update();
   size_t len = strlen(pass) > MAX_APN_FIELD_SZ ? (MAX_APN_FIELD_SZ-1) : strlen(pass);
-  memset(settings->apn_password, 0, MAX_APN_FIELD_SZ);
-  strncpy(settings->apn_password, pass, len);
-  write_settings_to_storage();
+  memset(next->apn_password, 0, MAX_APN_FIELD_SZ);
+  strncpy(next->apn_password, pass, len);
+  config_commit_update(next, true);
 }
 
 void set_internal_network_auth_method(uint8_t method) {
+  struct config_prototype *next = config_begin_update();
   if (method < 3) {
-    settings->apn_auth_method = method;
+    next->apn_auth_method = method;
   }
-  write_settings_to_storage();
+  config_commit_update(next, true);
 }
 
 /* IMSG Getters */
 char *get_ims_network_apn_name(void) {
-  return settings->ims_apn_addr;
+  return current_settings()->ims_apn_addr;
 }
 
 char *get_ims_network_username(void) {
-  return settings->ims_apn_username;
+  return current_settings()->ims_apn_username;
 }
 
 char *get_ims_network_pass(void) {
-  return settings->ims_apn_password;
+  return current_settings()->ims_apn_password;
 }
 
-uint8_t is_ims_enabled(void) { return settings->ims_attempt_enable; }
-uint8_t is_ims_vt_support_enabled(void) { return settings->ims_vt_support; }
-uint8_t is_ims_rtp_support_enabled(void) { return settings->ims_rtp_support; }
-uint8_t is_ims_sms_support_enabled(void) { return settings->ims_sms_support; }
+uint8_t is_ims_enabled(void) { return current_settings()->ims_attempt_enable; }
+uint8_t is_ims_vt_support_enabled(void) {
+  return current_settings()->ims_vt_support;
+}
+uint8_t is_ims_rtp_support_enabled(void) {
+  return current_settings()->ims_rtp_support;
+}
+uint8_t is_ims_sms_support_enabled(void) {
+  return current_settings()->ims_sms_support;
+}
@@ -2,6 +2,7 @@
 
 #include "helpers.h"
 #include "adspfw.h"
+#include "at_channel.h"
 #include "atfwd.h"
 #include "audio.h"
 #include "devices.h"
@@ -336,6 +337,7 @@ void *power_key_event() {
           logger(MSG_ERROR, "%s: Power GPIO long press detected\n", __func__);
         } else {
           write_boot_counter_file(0);
+          flush_pending_settings();
           do_sync_fs();
           logger(MSG_ERROR, "%s: Poweroff requested!\n", __func__);
           syscall(SYS_reboot, LINUX_REBOOT_MAGIC1, LINUX_REBOOT_MAGIC2,
@@ -384,25 +386,21 @@ int read_adsp_version() {
 }
 
 int wipe_message_storage() {
-  int fd, sz, i;
+  int i, ret = 0;
   char command[128];
 
   logger(MSG_INFO, "%s: Wiping message storage\n", __func__);
-  fd = open(SMD_SEC_AT, O_RDWR);
-  if (fd < 0) {
-    logger(MSG_ERROR, "%s: Cannot open SMD10 entry\n", __func__);
-    return -EINVAL;
-  }
-
+  /* Queue them all, the AT channel sends them back to back */
   for (i = 0; i <= 100; i++) {
-    sz = snprintf(command, 128, "%s%i\r\n", MSG_DELETE_PARTIAL_CMD, i);
-    if (write(fd, command, sz) < 0)
-      logger(MSG_ERROR, "%s: Error writing wipe cmd %i\n", __func__, i);
-    usleep(100000);
+    snprintf(command, 128, "%s%i\r", MSG_DELETE_PARTIAL_CMD, i);
+    if (at_channel_send_async(command, sizeof(command), AT_DEFAULT_TIMEOUT_MS,
+                              NULL, NULL) < 0) {
+      logger(MSG_ERROR, "%s: Error queuing wipe cmd %i\n", __func__, i);
+      ret = -EIO;
+    }
   }
-  close(fd);
-  logger(MSG_INFO, "%s: Message storage cleared\n", __func__);
-  return 0;
+  logger(MSG_INFO, "%s: Message storage wipe queued\n", __func__);
+  return ret;
 }
 
 void add_message_to_queue(uint8_t *message, size_t len) {
@@ -418,54 +416,22 @@ void add_message_to_queue(uint8_t *message, size_t len) {
   }
 }
 
-bool at_if_in_use = false;
+/*
+ * Kept for existing callers: runs through the AT channel now, so it
+ * only blocks the calling thread until the modem answers
+ */
 int send_at_command(char *at_command, size_t cmdlen, char *response,
                     size_t response_sz) {
-  int fd, ret;
-  fd_set readfds;
-  struct timeval tv;
-
-  if (at_if_in_use) {
-    logger(MSG_ERROR, "%s: AT Interface is already in use\n", __func__);
-    return -EAGAIN;
-  }
-
-  at_if_in_use = true;
-  fd = open(SMD_SEC_AT, O_RDWR);
-  if (fd < 0) {
-    logger(MSG_ERROR, "%s: Cannot open %s\n", __func__, SMD_SEC_AT);
-    at_if_in_use = false;
-    return -EINVAL;
-  }
-
+  int ret;
   logger(MSG_DEBUG, "%s: Sending %s\n", __func__, at_command);
-  ret = write(fd, at_command, cmdlen);
-  if (ret < 0) {
-    logger(MSG_ERROR, "%s: Failed to write to %s\n", __func__, SMD_SEC_AT);
-    at_if_in_use = false;
-    return -EIO;
-  }
-  tv.tv_sec = 1;
-  tv.tv_usec = 500000;
-  FD_ZERO(&readfds);
-  FD_SET(fd, &readfds);
-  ret = select(MAX_FD, &readfds, NULL, NULL, &tv);
-  if (FD_ISSET(fd, &readfds)) {
-    ret = read(fd, response, response_sz);
-    if (ret < 0) {
-      logger(MSG_ERROR, "%s: Failed to read from %s\n", __func__, SMD_SEC_AT);
-      at_if_in_use = false;
-      close(fd);
-      return -EIO;
-    }
-  } else {
+  ret = at_channel_send(at_command, cmdlen, response, response_sz,
+                        AT_DEFAULT_TIMEOUT_MS);
+  if (ret == -ETIMEDOUT) {
     logger(MSG_ERROR, "%s: No response in time from %s\n", __func__,
            SMD_SEC_AT);
   }
-  at_if_in_use = false;
   logger(MSG_DEBUG, "%s: Received %s\n", __func__, response);
-  close(fd);
-  return 0;
+  return ret;
 }
 
 void enable_cpufreq_performance_mode(bool enable) {
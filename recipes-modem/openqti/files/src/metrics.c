@@ -0,0 +1,358 @@
+// SPDX-License-Identifier: MIT
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "metrics.h"
+
+struct {
+  struct metrics_shm *shm;
+  /* Slots left behind by threads that exited, one bit each */
+  uint32_t free_slots;
+  pthread_key_t slot_key;
+  pthread_once_t slot_key_once;
+  bool slot_key_ok;
+} metrics_rt = {
+    .shm = NULL,
+    .free_slots = 0,
+    .slot_key_once = PTHREAD_ONCE_INIT,
+    .slot_key_ok = false,
+};
+
+/* Slot owned by the calling thread, -1 until it records something */
+static __thread int metrics_slot_id = -1;
+
+/*
+ * Calls and commands get a new thread every time, so slots are handed back
+ * when their thread exits. The counts stay in the slot and the next thread
+ * taking it keeps adding to them, so the totals don't change
+ */
+static void release_thread_slot(void *data) {
+  int id = (int)(intptr_t)data - 1;
+  struct metrics_shm *shm = __atomic_load_n(&metrics_rt.shm, __ATOMIC_ACQUIRE);
+
+  if (shm == NULL || id < 0 || id >= METRICS_MAX_SLOTS)
+    return;
+
+  __atomic_store_n(&shm->slots[id].tid, 0, __ATOMIC_RELAXED);
+  __atomic_fetch_or(&metrics_rt.free_slots, 1U << id, __ATOMIC_RELEASE);
+}
+
+static void create_slot_key(void) {
+  if (pthread_key_create(&metrics_rt.slot_key, release_thread_slot) == 0)
+    metrics_rt.slot_key_ok = true;
+  else
+    logger(MSG_WARN, "%s: Metrics slots won't be reused\n", __func__);
+}
+
+static int take_free_slot(void) {
+  uint32_t free_slots = __atomic_load_n(&metrics_rt.free_slots, __ATOMIC_ACQUIRE);
+  int id;
+
+  while (free_slots != 0) {
+    id = __builtin_ctz(free_slots);
+    if (__atomic_compare_exchange_n(&metrics_rt.free_slots, &free_slots,
+                                    free_slots & ~(1U << id), false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+      return id;
+  }
+
+  return -1;
+}
+
+static const char *counter_names[METRICS_CTR_LAST] = {
+    [METRICS_CTR_RMNET_ALLOWED] = "rmnet_allowed",
+    [METRICS_CTR_RMNET_BYPASSED] = "rmnet_bypassed",
+    [METRICS_CTR_RMNET_DISCARDED] = "rmnet_discarded",
+    [METRICS_CTR_RMNET_FAILED] = "rmnet_failed",
+    [METRICS_CTR_RMNET_EMPTY] = "rmnet_empty",
+    [METRICS_CTR_RMNET_BYTES] = "rmnet_bytes",
+    [METRICS_CTR_GPS_ALLOWED] = "gps_allowed",
+    [METRICS_CTR_GPS_DISCARDED] = "gps_discarded",
+    [METRICS_CTR_GPS_FAILED] = "gps_failed",
+    [METRICS_CTR_QMI_INTERNAL_TX] = "qmi_internal_tx",
+    [METRICS_CTR_QMI_INTERNAL_RX] = "qmi_internal_rx",
+    [METRICS_CTR_SMS_QUEUED] = "sms_queued",
+    [METRICS_CTR_SMS_DELIVERED] = "sms_delivered",
+    [METRICS_CTR_AUDIO_XRUNS] = "audio_xruns",
+};
+
+static const char *histogram_names[METRICS_HIST_LAST] = {
+    [METRICS_HIST_PKT_FORWARD] = "pkt_forward_us",
+    [METRICS_HIST_QMI_ROUNDTRIP] = "qmi_roundtrip_us",
+    [METRICS_HIST_SMS_DELIVERY] = "sms_delivery_us",
+};
+
+static const char *gauge_names[METRICS_GAUGE_LAST] = {
+    [0] = "thermal_zone0",
+    [1] = "thermal_zone1",
+    [2] = "thermal_zone2",
+    [3] = "thermal_zone3",
+    [4] = "thermal_zone4",
+    [5] = "thermal_zone5",
+    [6] = "thermal_zone6",
+    [METRICS_GAUGE_QMI_CLIENTS] = "qmi_clients",
+    [METRICS_GAUGE_SMS_QUEUE_DEPTH] = "sms_queue_depth",
+    [METRICS_GAUGE_QMI_PENDING] = "qmi_pending",
+    [METRICS_GAUGE_AT_QUEUE_DEPTH] = "at_queue_depth",
+};
+
+const char *metrics_counter_name(uint8_t counter) {
+  if (counter >= METRICS_CTR_LAST)
+    return "unknown";
+  return counter_names[counter];
+}
+
+const char *metrics_histogram_name(uint8_t histogram) {
+  if (histogram >= METRICS_HIST_LAST)
+    return "unknown";
+  return histogram_names[histogram];
+}
+
+const char *metrics_gauge_name(uint8_t gauge) {
+  if (gauge >= METRICS_GAUGE_LAST)
+    return "unknown";
+  return gauge_names[gauge];
+}
+
+uint64_t metrics_get_time_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint64_t metrics_elapsed_us(struct timespec *since) {
+  struct timespec now;
+  int64_t elapsed;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  elapsed = (int64_t)(now.tv_sec - since->tv_sec) * 1000000 +
+            (now.tv_nsec - since->tv_nsec) / 1000;
+  return elapsed > 0 ? (uint64_t)elapsed : 0;
+}
+
+/*
+ * Creates (or truncates) the shared memory file. If this fails openqti
+ * keeps working, every metrics call just becomes a no-op
+ */
+int metrics_init(void) {
+  struct metrics_shm *shm;
+  int fd;
+
+  if (metrics_rt.shm != NULL)
+    return 0;
+
+  fd = open(METRICS_SHM_PATH, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    logger(MSG_ERROR, "%s: Can't open %s: %s\n", __func__, METRICS_SHM_PATH,
+           strerror(errno));
+    return -errno;
+  }
+
+  if (ftruncate(fd, sizeof(struct metrics_shm)) < 0) {
+    logger(MSG_ERROR, "%s: Can't resize %s: %s\n", __func__, METRICS_SHM_PATH,
+           strerror(errno));
+    close(fd);
+    return -errno;
+  }
+
+  shm = mmap(NULL, sizeof(struct metrics_shm), PROT_READ | PROT_WRITE,
+             MAP_SHARED, fd, 0);
+  close(fd);
+  if (shm == MAP_FAILED) {
+    logger(MSG_ERROR, "%s: Can't map %s: %s\n", __func__, METRICS_SHM_PATH,
+           strerror(errno));
+    return -errno;
+  }
+
+  memset(shm, 0, sizeof(struct metrics_shm));
+  shm->version = METRICS_VERSION;
+  shm->size = sizeof(struct metrics_shm);
+  shm->pid = getpid();
+  shm->start_time = metrics_get_time_us() / 1000;
+  /* Readers check the magic last, publish it once everything else is set */
+  __atomic_store_n(&shm->magic, METRICS_MAGIC, __ATOMIC_RELEASE);
+  __atomic_store_n(&metrics_rt.shm, shm, __ATOMIC_RELEASE);
+  logger(MSG_INFO, "%s: Metrics exported to %s\n", __func__,
+         METRICS_SHM_PATH);
+  return 0;
+}
+
+static struct metrics_slot *get_thread_slot(void) {
+  struct metrics_shm *shm = __atomic_load_n(&metrics_rt.shm, __ATOMIC_ACQUIRE);
+  uint32_t id;
+  int free_id;
+
+  if (shm == NULL)
+    return NULL;
+
+  if (metrics_slot_id < 0) {
+    pthread_once(&metrics_rt.slot_key_once, create_slot_key);
+    free_id = take_free_slot();
+    if (free_id >= 0)
+      id = (uint32_t)free_id;
+    else
+      id = __atomic_fetch_add(&shm->num_slots, 1, __ATOMIC_RELAXED);
+    if (id >= METRICS_MAX_SLOTS) {
+      /* Out of slots: this thread won't report anything */
+      logger(MSG_WARN, "%s: No metrics slots left for thread %ld\n", __func__,
+             (long)syscall(SYS_gettid));
+      metrics_slot_id = METRICS_MAX_SLOTS;
+      return NULL;
+    }
+    __atomic_store_n(&shm->slots[id].tid, (int32_t)syscall(SYS_gettid),
+                     __ATOMIC_RELAXED);
+    metrics_slot_id = id;
+    if (metrics_rt.slot_key_ok)
+      pthread_setspecific(metrics_rt.slot_key, (void *)(intptr_t)(id + 1));
+  }
+
+  if (metrics_slot_id >= METRICS_MAX_SLOTS)
+    return NULL;
+
+  return &shm->slots[metrics_slot_id];
+}
+
+/* Only the owning thread writes to a slot, so a plain sequence bump works */
+static inline void slot_write_begin(struct metrics_slot *slot) {
+  __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void slot_write_end(struct metrics_slot *slot) {
+  __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+}
+
+void metrics_add(uint8_t counter, uint64_t val) {
+  struct metrics_slot *slot;
+  if (counter >= METRICS_CTR_LAST)
+    return;
+
+  slot = get_thread_slot();
+  if (slot == NULL)
+    return;
+
+  slot_write_begin(slot);
+  slot->counters[counter] += val;
+  slot_write_end(slot);
+}
+
+void metrics_inc(uint8_t counter) { metrics_add(counter, 1); }
+
+void metrics_set_gauge(uint8_t gauge, int32_t val) {
+  struct metrics_shm *shm = __atomic_load_n(&metrics_rt.shm, __ATOMIC_ACQUIRE);
+  if (shm == NULL || gauge >= METRICS_GAUGE_LAST)
+    return;
+
+  __atomic_store_n(&shm->gauges[gauge], val, __ATOMIC_RELAXED);
+}
+
+static uint8_t get_bucket(uint64_t usecs) {
+  uint8_t bucket = 0;
+  while (usecs > 0 && bucket < METRICS_HIST_BUCKETS - 1) {
+    usecs >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+void metrics_record_latency(uint8_t histogram, uint64_t usecs) {
+  struct metrics_slot *slot;
+  struct metrics_histogram *hist;
+  if (histogram >= METRICS_HIST_LAST)
+    return;
+
+  slot = get_thread_slot();
+  if (slot == NULL)
+    return;
+
+  hist = &slot->histograms[histogram];
+  slot_write_begin(slot);
+  hist->count++;
+  hist->sum_us += usecs;
+  if (usecs > hist->max_us)
+    hist->max_us = usecs;
+  hist->buckets[get_bucket(usecs)]++;
+  slot_write_end(slot);
+}
+
+/*
+ * Reader side
+ *  Adds up every slot into counters[METRICS_CTR_LAST] and
+ *  histograms[METRICS_HIST_LAST]. Slots being written to are retried
+ */
+int metrics_read_snapshot(const struct metrics_shm *shm, uint64_t *counters,
+                          struct metrics_histogram *histograms) {
+  struct metrics_slot copy;
+  uint32_t num_slots, seq_start, seq_end;
+  int retries;
+
+  if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != METRICS_MAGIC ||
+      shm->version != METRICS_VERSION ||
+      shm->size != sizeof(struct metrics_shm))
+    return -EINVAL;
+
+  memset(counters, 0, sizeof(uint64_t) * METRICS_CTR_LAST);
+  memset(histograms, 0, sizeof(struct metrics_histogram) * METRICS_HIST_LAST);
+
+  num_slots = __atomic_load_n(&shm->num_slots, __ATOMIC_ACQUIRE);
+  if (num_slots > METRICS_MAX_SLOTS)
+    num_slots = METRICS_MAX_SLOTS;
+
+  for (uint32_t i = 0; i < num_slots; i++) {
+    for (retries = 0; retries < 1000; retries++) {
+      seq_start = __atomic_load_n(&shm->slots[i].seq, __ATOMIC_ACQUIRE);
+      if (seq_start & 1)
+        continue;
+      memcpy(&copy, &shm->slots[i], sizeof(struct metrics_slot));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      seq_end = __atomic_load_n(&shm->slots[i].seq, __ATOMIC_RELAXED);
+      if (seq_start == seq_end)
+        break;
+    }
+    if (retries == 1000)
+      return -EAGAIN;
+
+    for (uint8_t j = 0; j < METRICS_CTR_LAST; j++)
+      counters[j] += copy.counters[j];
+
+    for (uint8_t j = 0; j < METRICS_HIST_LAST; j++) {
+      histograms[j].count += copy.histograms[j].count;
+      histograms[j].sum_us += copy.histograms[j].sum_us;
+      if (copy.histograms[j].max_us > histograms[j].max_us)
+        histograms[j].max_us = copy.histograms[j].max_us;
+      for (uint8_t k = 0; k < METRICS_HIST_BUCKETS; k++)
+        histograms[j].buckets[k] += copy.histograms[j].buckets[k];
+    }
+  }
+
+  return 0;
+}
+
+/* Upper bound of the bucket where the percentile falls, capped by max */
+uint64_t metrics_histogram_percentile(const struct metrics_histogram *hist,
+                                      uint8_t percentile) {
+  uint64_t target, seen = 0, bound;
+  if (hist->count == 0)
+    return 0;
+
+  target = (hist->count * percentile + 99) / 100;
+  if (target == 0)
+    target = 1;
+
+  for (uint8_t i = 0; i < METRICS_HIST_BUCKETS; i++) {
+    seen += hist->buckets[i];
+    if (seen >= target) {
+      bound = i == 0 ? 0 : ((uint64_t)1 << i) - 1;
+      return bound < hist->max_us ? bound : hist->max_us;
+    }
+  }
+
+  return hist->max_us;
+}
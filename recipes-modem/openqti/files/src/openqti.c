@@ -19,7 +19,9 @@
 #include "helpers.h"
 #include "ipc.h"
 #include "logger.h"
+#include "metrics.h"
 #include "openqti.h"
+#include "pkt_trace.h"
 #include "proxy.h"
 #include "scheduler.h"
 #include "sms.h"
@@ -138,6 +140,12 @@ int main(int argc, char **argv) {
     return -EBUSY;
   }
 
+  /* Export runtime metrics for oqtistat, we keep going if it fails */
+  metrics_init();
+
+  /* SIGUSR1 dumps the packet trace, SIGUSR2 toggles it */
+  pkt_trace_init();
+
   /* Set cpu governor to performance to speed it up a bit */
   enable_cpufreq_performance_mode(true);
 
@@ -0,0 +1,527 @@
+// SPDX-License-Identifier: MIT
+
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "call.h"
+#include "command.h"
+#include "config.h"
+#include "ipc.h"
+#include "logger.h"
+#include "nas.h"
+#include "openqti.h"
+#include "proxy.h"
+#include "qmi.h"
+#include "sms.h"
+#include "tracking.h"
+
+/*
+ * oqtibench
+ *  Replays QMI traffic through the real rmnet_proxy() on a Linux host.
+ *  The USB and SMD nodes are replaced by socketpairs, we push every packet
+ *  from the side it was recorded on, wait until the proxy is done with it
+ *  and time the whole thing.
+ *
+ *  Traces can be openQTI debug logs (openqti -l), every "HOST->SMD :" and
+ *  "HOST<-SMD :" line is replayed, or one of the built in scenarios.
+ *
+ *  Allocations are counted by wrapping malloc, calloc and realloc at link
+ *  time (-Wl,--wrap=...), so only calls made from openQTI itself are seen.
+ *  Anything touching real hardware (mixers, GPIOs, sysfs) will just fail
+ *  quickly here, so handler costs are a lower bound of what the modem does
+ */
+
+#define BENCH_DEFAULT_ITERATIONS 20
+#define BENCH_RESPONSE_TIMEOUT_MS 1000
+#define BENCH_MAX_PACKETS 65536
+
+struct bench_packet {
+  uint8_t source;
+  uint16_t len;
+  uint8_t *data;
+};
+
+struct {
+  bool counting;
+  uint64_t allocations;
+  uint64_t allocated_bytes;
+
+  struct bench_packet *packets;
+  uint32_t num_packets;
+
+  int host_fd; // our end of the fake USB node
+  int dsp_fd;  // our end of the fake SMD node
+  FILE *report;
+
+  uint64_t *latencies;
+  uint64_t forwarded;
+  uint64_t bypassed;
+  uint64_t injected;
+  uint64_t timeouts;
+} bench_rt = {
+    .counting = false,
+    .allocations = 0,
+    .allocated_bytes = 0,
+    .packets = NULL,
+    .num_packets = 0,
+    .host_fd = -1,
+    .dsp_fd = -1,
+    .report = NULL,
+    .latencies = NULL,
+    .forwarded = 0,
+    .bypassed = 0,
+    .injected = 0,
+    .timeouts = 0,
+};
+
+/* Allocation accounting */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static inline void count_allocation(size_t size) {
+  if (__atomic_load_n(&bench_rt.counting, __ATOMIC_RELAXED)) {
+    __atomic_fetch_add(&bench_rt.allocations, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&bench_rt.allocated_bytes, size, __ATOMIC_RELAXED);
+  }
+}
+
+void *__wrap_malloc(size_t size) {
+  count_allocation(size);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+  count_allocation(nmemb * size);
+  return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  count_allocation(size);
+  return __real_realloc(ptr, size);
+}
+
+static uint64_t get_time_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int add_packet(uint8_t source, uint8_t *data, size_t len) {
+  struct bench_packet *pkt;
+  if (bench_rt.num_packets >= BENCH_MAX_PACKETS || len == 0 ||
+      len > MAX_PACKET_SIZE)
+    return -EINVAL;
+
+  if (bench_rt.num_packets % 256 == 0) {
+    pkt = realloc(bench_rt.packets,
+                  (bench_rt.num_packets + 256) * sizeof(struct bench_packet));
+    if (pkt == NULL)
+      return -ENOMEM;
+    bench_rt.packets = pkt;
+  }
+
+  pkt = &bench_rt.packets[bench_rt.num_packets];
+  pkt->data = malloc(len);
+  if (pkt->data == NULL)
+    return -ENOMEM;
+  memcpy(pkt->data, data, len);
+  pkt->len = len;
+  pkt->source = source;
+  bench_rt.num_packets++;
+  return 0;
+}
+
+/*
+ * Parses an openQTI debug log. Packets are dumped by process_packet() as
+ *  HOST->SMD :0x01 0x0c 0x00 ...
+ */
+static int load_trace(const char *path) {
+  uint8_t buf[MAX_PACKET_SIZE];
+  char *line = NULL, *pos, *end;
+  size_t line_sz = 0, len;
+  uint8_t source;
+  unsigned long val;
+  FILE *fp;
+
+  fp = fopen(path, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Can't open %s: %s\n", path, strerror(errno));
+    return -errno;
+  }
+
+  while (getline(&line, &line_sz, fp) > 0) {
+    if ((pos = strstr(line, "HOST->SMD :")) != NULL) {
+      source = FROM_HOST;
+    } else if ((pos = strstr(line, "HOST<-SMD :")) != NULL) {
+      source = FROM_DSP;
+    } else {
+      continue;
+    }
+
+    pos += strlen("HOST->SMD :");
+    len = 0;
+    while (len < MAX_PACKET_SIZE) {
+      val = strtoul(pos, &end, 16);
+      if (end == pos || val > 0xff)
+        break;
+      buf[len++] = val;
+      pos = end;
+    }
+    add_packet(source, buf, len);
+  }
+
+  free(line);
+  fclose(fp);
+  return bench_rt.num_packets > 0 ? 0 : -ENODATA;
+}
+
+/* Builds a QMI service message with a single TLV */
+static size_t build_qmi_packet(uint8_t *buf, uint8_t service, uint8_t ctlid,
+                               uint16_t transaction_id, uint16_t msgid,
+                               const uint8_t *tlvs, uint16_t tlvs_len) {
+  struct encapsulated_qmi_packet *pkt = (struct encapsulated_qmi_packet *)buf;
+  size_t len = sizeof(struct encapsulated_qmi_packet) + tlvs_len;
+
+  pkt->qmux.version = 0x01;
+  pkt->qmux.packet_length = htole16(len - sizeof(uint8_t));
+  pkt->qmux.control = ctlid == 0x00 ? 0x00 : 0x80;
+  pkt->qmux.service = service;
+  pkt->qmux.instance_id = 0x01;
+  pkt->qmi.ctlid = ctlid;
+  pkt->qmi.transaction_id = htole16(transaction_id);
+  pkt->qmi.msgid = htole16(msgid);
+  pkt->qmi.length = htole16(tlvs_len);
+  if (tlvs_len > 0)
+    memcpy(buf + sizeof(struct encapsulated_qmi_packet), tlvs, tlvs_len);
+  return len;
+}
+
+static size_t build_tlv(uint8_t *buf, uint8_t id, const uint8_t *data,
+                        uint16_t len) {
+  buf[0] = id;
+  buf[1] = len & 0xff;
+  buf[2] = len >> 8;
+  memcpy(buf + 3, data, len);
+  return len + 3;
+}
+
+/* Outgoing messages from the host and their responses */
+static void build_wms_scenario(void) {
+  uint8_t buf[MAX_PACKET_SIZE], tlvs[256], payload[160];
+  size_t len, tlvlen;
+
+  memset(payload, 0x41, sizeof(payload));
+  for (uint16_t i = 1; i <= 200; i++) {
+    tlvlen = build_tlv(tlvs, 0x01, payload, sizeof(payload));
+    len = build_qmi_packet(buf, 5, 0x00, i, WMS_RAW_SEND, tlvs, tlvlen);
+    add_packet(FROM_HOST, buf, len);
+
+    tlvlen = build_tlv(tlvs, 0x02, (uint8_t[]){0x00, 0x00, 0x00, 0x00}, 4);
+    len = build_qmi_packet(buf, 5, 0x02, i, WMS_RAW_SEND, tlvs, tlvlen);
+    add_packet(FROM_DSP, buf, len);
+
+    tlvlen = build_tlv(tlvs, 0x10, (uint8_t[]){0x01, 0x00, 0x00, 0x00, 0x00},
+                       5);
+    len = build_qmi_packet(buf, 5, 0x04, 0, WMS_EVENT_REPORT, tlvs, tlvlen);
+    add_packet(FROM_DSP, buf, len);
+  }
+}
+
+/* Cell info bursts, as sent while ModemManager polls the network */
+static void build_nas_scenario(void) {
+  uint8_t buf[MAX_PACKET_SIZE], tlvs[1024], payload[512];
+  size_t len, tlvlen;
+
+  for (size_t i = 0; i < sizeof(payload); i++)
+    payload[i] = i & 0xff;
+
+  for (uint16_t i = 1; i <= 200; i++) {
+    len = build_qmi_packet(buf, 3, 0x00, i, NAS_GET_CELL_LOCATION_INFO, NULL,
+                           0);
+    add_packet(FROM_HOST, buf, len);
+
+    tlvlen = build_tlv(tlvs, 0x02, (uint8_t[]){0x00, 0x00, 0x00, 0x00}, 4);
+    tlvlen += build_tlv(tlvs + tlvlen, 0x13, payload, sizeof(payload));
+    len = build_qmi_packet(buf, 3, 0x02, i, NAS_GET_CELL_LOCATION_INFO, tlvs,
+                           tlvlen);
+    add_packet(FROM_DSP, buf, len);
+
+    tlvlen = build_tlv(tlvs, 0x14, payload, 16);
+    len = build_qmi_packet(buf, 3, 0x04, 0, NAS_GET_SIGNAL_INFO, tlvs, tlvlen);
+    add_packet(FROM_DSP, buf, len);
+  }
+}
+
+/* Dial, get the call status updates and hang up */
+static void build_voice_scenario(void) {
+  uint8_t buf[MAX_PACKET_SIZE], tlvs[256], number[] = "5551234567";
+  uint8_t states[] = {CALL_STATE_ORIGINATING, CALL_STATE_ALERTING,
+                      CALL_STATE_DISCONNECTING, CALL_STATE_HANGUP};
+  uint8_t meta[8], remote[4 + sizeof(number) - 1];
+  size_t len, tlvlen;
+
+  for (uint16_t i = 1; i <= 50; i++) {
+    tlvlen = build_tlv(tlvs, 0x01, number, sizeof(number) - 1);
+    len = build_qmi_packet(buf, 9, 0x00, i, VO_SVC_CALL_REQUEST, tlvs, tlvlen);
+    add_packet(FROM_HOST, buf, len);
+
+    tlvlen = build_tlv(tlvs, 0x02, (uint8_t[]){0x00, 0x00, 0x00, 0x00}, 4);
+    len = build_qmi_packet(buf, 9, 0x02, i, VO_SVC_CALL_REQUEST, tlvs, tlvlen);
+    add_packet(FROM_DSP, buf, len);
+
+    for (uint8_t j = 0; j < sizeof(states); j++) {
+      /* instances, call id, state, type, direction, mode, mpty, als */
+      meta[0] = 1;
+      meta[1] = 1;
+      meta[2] = states[j];
+      meta[3] = 0x00;
+      meta[4] = CALL_DIRECTION_OUTGOING;
+      meta[5] = CALL_MODE_GSM;
+      meta[6] = 0;
+      meta[7] = 0;
+      tlvlen = build_tlv(tlvs, TLV_CALL_INFO, meta, sizeof(meta));
+      /* instances, call id, presentation, number length, number */
+      remote[0] = 1;
+      remote[1] = 1;
+      remote[2] = 0;
+      remote[3] = sizeof(number) - 1;
+      memcpy(remote + 4, number, sizeof(number) - 1);
+      tlvlen += build_tlv(tlvs + tlvlen, TLV_REMOTE_NUMBER, remote,
+                          sizeof(remote));
+      len = build_qmi_packet(buf, 9, 0x04, 0, VO_SVC_CALL_STATUS, tlvs, tlvlen);
+      add_packet(FROM_DSP, buf, len);
+    }
+  }
+}
+
+static int build_scenario(const char *name) {
+  bool all = strcmp(name, "all") == 0;
+  if (all || strcmp(name, "wms") == 0)
+    build_wms_scenario();
+  if (all || strcmp(name, "nas") == 0)
+    build_nas_scenario();
+  if (all || strcmp(name, "voice") == 0)
+    build_voice_scenario();
+  return bench_rt.num_packets > 0 ? 0 : -EINVAL;
+}
+
+static uint64_t get_processed_count(void) {
+  struct pkt_stats stats = get_rmnet_stats();
+  return (uint64_t)stats.allowed + stats.bypassed + stats.discarded +
+         stats.empty;
+}
+
+/* Reads whatever the proxy sent on its own (simulated replies, etc) */
+static void drain_injected(void) {
+  uint8_t buf[MAX_PACKET_SIZE];
+  while (recv(bench_rt.host_fd, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+    bench_rt.injected++;
+  while (recv(bench_rt.dsp_fd, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+    bench_rt.injected++;
+}
+
+/* Waits for the packet to show up on the other side of the proxy */
+static int wait_for_forwarded(struct bench_packet *pkt) {
+  uint8_t buf[MAX_PACKET_SIZE];
+  struct pollfd pfd;
+  ssize_t ret;
+
+  pfd.fd = pkt->source == FROM_HOST ? bench_rt.dsp_fd : bench_rt.host_fd;
+  pfd.events = POLLIN;
+  while (poll(&pfd, 1, BENCH_RESPONSE_TIMEOUT_MS) > 0) {
+    ret = recv(pfd.fd, buf, sizeof(buf), 0);
+    if (ret <= 0)
+      return -EIO;
+    if (ret == pkt->len && memcmp(buf, pkt->data, ret) == 0)
+      return 0;
+    bench_rt.injected++;
+  }
+  return -ETIMEDOUT;
+}
+
+static int replay_packet(struct bench_packet *pkt, uint64_t *latency) {
+  struct pkt_stats before, after;
+  uint64_t processed, start;
+  int fd = pkt->source == FROM_HOST ? bench_rt.host_fd : bench_rt.dsp_fd;
+
+  before = get_rmnet_stats();
+  processed = get_processed_count();
+  start = get_time_ns();
+  if (send(fd, pkt->data, pkt->len, 0) != pkt->len)
+    return -EIO;
+
+  while (get_processed_count() == processed) {
+    if (get_time_ns() - start > BENCH_RESPONSE_TIMEOUT_MS * 1000000ULL) {
+      bench_rt.timeouts++;
+      return -ETIMEDOUT;
+    }
+    sched_yield();
+  }
+
+  after = get_rmnet_stats();
+  if (after.allowed != before.allowed) {
+    if (wait_for_forwarded(pkt) < 0) {
+      bench_rt.timeouts++;
+      return -ETIMEDOUT;
+    }
+    bench_rt.forwarded++;
+  } else {
+    bench_rt.bypassed++;
+  }
+
+  *latency = get_time_ns() - start;
+  return 0;
+}
+
+static int compare_latency(const void *a, const void *b) {
+  uint64_t la = *(const uint64_t *)a, lb = *(const uint64_t *)b;
+  return la < lb ? -1 : la > lb;
+}
+
+static void print_results(uint32_t iterations, uint64_t elapsed_ns,
+                          uint64_t samples) {
+  FILE *fd = bench_rt.report;
+  double secs = elapsed_ns / 1e9;
+
+  qsort(bench_rt.latencies, samples, sizeof(uint64_t), compare_latency);
+  fprintf(fd, "Packets:        %u x %u iterations\n", bench_rt.num_packets,
+          iterations);
+  fprintf(fd, "Elapsed:        %.3f s\n", secs);
+  fprintf(fd, "Throughput:     %.0f packets/s\n",
+          secs > 0 ? samples / secs : 0);
+  if (samples > 0) {
+    fprintf(fd, "Latency p50:    %.1f us\n",
+            bench_rt.latencies[samples / 2] / 1000.0);
+    fprintf(fd, "Latency p99:    %.1f us\n",
+            bench_rt.latencies[(samples * 99) / 100] / 1000.0);
+    fprintf(fd, "Latency max:    %.1f us\n",
+            bench_rt.latencies[samples - 1] / 1000.0);
+    fprintf(fd, "Allocs/packet:  %.2f (%.1f bytes)\n",
+            (double)bench_rt.allocations / samples,
+            (double)bench_rt.allocated_bytes / samples);
+  }
+  fprintf(fd, "Forwarded:      %llu\n", (unsigned long long)bench_rt.forwarded);
+  fprintf(fd, "Bypassed:       %llu\n", (unsigned long long)bench_rt.bypassed);
+  fprintf(fd, "Injected:       %llu\n", (unsigned long long)bench_rt.injected);
+  fprintf(fd, "Timeouts:       %llu\n", (unsigned long long)bench_rt.timeouts);
+}
+
+static void print_usage(void) {
+  fprintf(stdout, "oqtibench: Replay QMI traffic through the openQTI proxy\n");
+  fprintf(stdout, "Arguments: \n");
+  fprintf(stdout, "\t-f [file]: Replay packets from an openqti debug log\n");
+  fprintf(stdout, "\t-s [name]: Built in scenario: wms, nas, voice, all\n");
+  fprintf(stdout, "\t-n [num]: Iterations over the trace (default %i)\n",
+          BENCH_DEFAULT_ITERATIONS);
+  fprintf(stdout, "\t-v: Show openQTI logs\n");
+}
+
+int main(int argc, char **argv) {
+  struct node_pair nodes;
+  pthread_t proxy_thread;
+  int host_pair[2], dsp_pair[2];
+  uint32_t iterations = BENCH_DEFAULT_ITERATIONS;
+  uint64_t start, elapsed, samples = 0, latency;
+  char *trace = NULL, *scenario = "all";
+  bool verbose = false;
+  int ret, stdout_fd;
+
+  while ((ret = getopt(argc, argv, "f:s:n:vh?")) != -1)
+    switch (ret) {
+    case 'f':
+      trace = optarg;
+      break;
+    case 's':
+      scenario = optarg;
+      break;
+    case 'n':
+      iterations = atoi(optarg);
+      break;
+    case 'v':
+      verbose = true;
+      break;
+    case 'h':
+    case '?':
+    default:
+      print_usage();
+      return 0;
+    }
+
+  if (trace != NULL)
+    ret = load_trace(trace);
+  else
+    ret = build_scenario(scenario);
+  if (ret < 0 || iterations == 0) {
+    fprintf(stderr, "Nothing to replay\n");
+    return 1;
+  }
+
+  /* openQTI logs to stdout, keep the report away from it */
+  stdout_fd = dup(STDOUT_FILENO);
+  bench_rt.report = fdopen(stdout_fd, "w");
+  if (!verbose && freopen("/dev/null", "w", stdout) == NULL) {
+    fprintf(stderr, "Can't silence logs: %s\n", strerror(errno));
+    return 1;
+  }
+
+  set_initial_config();
+  reset_logtime();
+  set_log_method(true);
+  set_log_level(verbose ? MSG_DEBUG : MSG_WARN);
+  reset_client_handler();
+  reset_sms_runtime();
+  reset_call_state();
+  set_cmd_runtime_defaults();
+  proxy_rt_reset();
+
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, host_pair) < 0 ||
+      socketpair(AF_UNIX, SOCK_SEQPACKET, 0, dsp_pair) < 0) {
+    fprintf(stderr, "Can't create socketpairs: %s\n", strerror(errno));
+    return 1;
+  }
+  bench_rt.host_fd = host_pair[0];
+  bench_rt.dsp_fd = dsp_pair[0];
+  nodes.node1.fd = host_pair[1]; // RMNET_CTL
+  nodes.node2.fd = dsp_pair[1];  // SMD_CNTL
+  nodes.allow_exit = false;
+
+  if (pthread_create(&proxy_thread, NULL, &rmnet_proxy, (void *)&nodes)) {
+    fprintf(stderr, "Can't start the proxy thread\n");
+    return 1;
+  }
+
+  bench_rt.latencies = calloc((uint64_t)bench_rt.num_packets * iterations,
+                              sizeof(uint64_t));
+  if (bench_rt.latencies == NULL) {
+    fprintf(stderr, "Too many packets to keep track of\n");
+    return 1;
+  }
+
+  __atomic_store_n(&bench_rt.counting, true, __ATOMIC_RELAXED);
+  start = get_time_ns();
+  for (uint32_t i = 0; i < iterations; i++) {
+    for (uint32_t j = 0; j < bench_rt.num_packets; j++) {
+      drain_injected();
+      if (replay_packet(&bench_rt.packets[j], &latency) == 0)
+        bench_rt.latencies[samples++] = latency;
+    }
+  }
+  elapsed = get_time_ns() - start;
+  __atomic_store_n(&bench_rt.counting, false, __ATOMIC_RELAXED);
+
+  print_results(iterations, elapsed, samples);
+  fclose(bench_rt.report);
+  /* The proxy thread never returns, just leave */
+  return 0;
+}
@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: MIT
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "metrics.h"
+
+/*
+ * oqtistat
+ *  Prints the counters, gauges and latency histograms openqti exports
+ *  in METRICS_SHM_PATH
+ */
+
+void logger(uint8_t level, char *format, ...) {}
+
+static void print_usage(void) {
+  fprintf(stdout, "oqtistat: Show openQTI runtime metrics\n");
+  fprintf(stdout, "Arguments: \n");
+  fprintf(stdout, "\t-k: Print as key=value pairs\n");
+  fprintf(stdout, "\t-i [secs]: Repeat every [secs] seconds\n");
+  fprintf(stdout, "\t-h: Show this help\n");
+}
+
+static void print_metrics(const struct metrics_shm *shm, bool keyvalue) {
+  uint64_t counters[METRICS_CTR_LAST];
+  struct metrics_histogram histograms[METRICS_HIST_LAST];
+  uint64_t avg;
+  int ret;
+
+  ret = metrics_read_snapshot(shm, counters, histograms);
+  if (ret < 0) {
+    fprintf(stderr, "Can't read metrics: %s\n", strerror(-ret));
+    return;
+  }
+
+  if (keyvalue) {
+    fprintf(stdout, "pid=%i\n", shm->pid);
+    fprintf(stdout, "uptime_ms=%llu\n",
+            (unsigned long long)(metrics_get_time_us() / 1000 -
+                                 shm->start_time));
+    for (uint8_t i = 0; i < METRICS_CTR_LAST; i++)
+      fprintf(stdout, "%s=%llu\n", metrics_counter_name(i),
+              (unsigned long long)counters[i]);
+    for (uint8_t i = 0; i < METRICS_GAUGE_LAST; i++)
+      fprintf(stdout, "%s=%i\n", metrics_gauge_name(i),
+              __atomic_load_n(&shm->gauges[i], __ATOMIC_RELAXED));
+    for (uint8_t i = 0; i < METRICS_HIST_LAST; i++) {
+      fprintf(stdout, "%s_count=%llu\n", metrics_histogram_name(i),
+              (unsigned long long)histograms[i].count);
+      fprintf(stdout, "%s_p50=%llu\n", metrics_histogram_name(i),
+              (unsigned long long)metrics_histogram_percentile(
+                  &histograms[i], 50));
+      fprintf(stdout, "%s_p99=%llu\n", metrics_histogram_name(i),
+              (unsigned long long)metrics_histogram_percentile(
+                  &histograms[i], 99));
+      fprintf(stdout, "%s_max=%llu\n", metrics_histogram_name(i),
+              (unsigned long long)histograms[i].max_us);
+    }
+    return;
+  }
+
+  fprintf(stdout, "openQTI (pid %i), %u metrics slots used\n", shm->pid,
+          __atomic_load_n(&shm->num_slots, __ATOMIC_RELAXED));
+  fprintf(stdout, "Counters:\n");
+  for (uint8_t i = 0; i < METRICS_CTR_LAST; i++)
+    fprintf(stdout, "  %-20s %llu\n", metrics_counter_name(i),
+            (unsigned long long)counters[i]);
+
+  fprintf(stdout, "Gauges:\n");
+  for (uint8_t i = 0; i < METRICS_GAUGE_LAST; i++)
+    fprintf(stdout, "  %-20s %i\n", metrics_gauge_name(i),
+            __atomic_load_n(&shm->gauges[i], __ATOMIC_RELAXED));
+
+  fprintf(stdout, "Latencies (us):\n");
+  fprintf(stdout, "  %-20s %10s %10s %10s %10s %10s\n", "", "count", "avg",
+          "p50", "p99", "max");
+  for (uint8_t i = 0; i < METRICS_HIST_LAST; i++) {
+    avg = histograms[i].count ? histograms[i].sum_us / histograms[i].count : 0;
+    fprintf(stdout, "  %-20s %10llu %10llu %10llu %10llu %10llu\n",
+            metrics_histogram_name(i), (unsigned long long)histograms[i].count,
+            (unsigned long long)avg,
+            (unsigned long long)metrics_histogram_percentile(&histograms[i],
+                                                             50),
+            (unsigned long long)metrics_histogram_percentile(&histograms[i],
+                                                             99),
+            (unsigned long long)histograms[i].max_us);
+  }
+}
+
+int main(int argc, char **argv) {
+  struct metrics_shm *shm;
+  struct stat st;
+  bool keyvalue = false;
+  int interval = 0;
+  int fd, ret;
+
+  while ((ret = getopt(argc, argv, "ki:h?")) != -1)
+    switch (ret) {
+    case 'k':
+      keyvalue = true;
+      break;
+    case 'i':
+      interval = atoi(optarg);
+      break;
+    case 'h':
+    case '?':
+    default:
+      print_usage();
+      return 0;
+    }
+
+  fd = open(METRICS_SHM_PATH, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Can't open %s: %s. Is openqti running?\n",
+            METRICS_SHM_PATH, strerror(errno));
+    return 1;
+  }
+
+  /* Mapping past the end of a short file would crash us on first read */
+  if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(struct metrics_shm)) {
+    fprintf(stderr, "%s is not a valid metrics file\n", METRICS_SHM_PATH);
+    close(fd);
+    return 1;
+  }
+
+  shm = mmap(NULL, sizeof(struct metrics_shm), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (shm == MAP_FAILED) {
+    fprintf(stderr, "Can't map %s: %s\n", METRICS_SHM_PATH, strerror(errno));
+    return 1;
+  }
+
+  do {
+    print_metrics(shm, keyvalue);
+    if (interval > 0) {
+      fprintf(stdout, "\n");
+      fflush(stdout);
+      sleep(interval);
+    }
+  } while (interval > 0);
+
+  munmap(shm, sizeof(struct metrics_shm));
+  return 0;
+}
@@ -25,6 +25,7 @@
 
 #include "audio.h"
 #include "logger.h"
+#include "metrics.h"
 
 static inline int param_is_mask(int p) {
   return (p >= SNDRV_PCM_HW_PARAM_FIRST_MASK) &&
@@ -300,6 +301,7 @@ static int pcm_write_nmmap(struct pcm *pcm, void *data, unsigned count) {
         /* we failed to make our window -- try to restart */
         logger(MSG_DEBUG, "Buffer Underrun Error\n");
         pcm->underruns++;
+        metrics_inc(METRICS_CTR_AUDIO_XRUNS);
         pcm->running = 0;
         continue;
       }
@@ -369,6 +371,7 @@ int pcm_read(struct pcm *pcm, void *data, uint32_t frames)
                 /* we failed to make our window -- try to restart */
                 logger(MSG_ERROR, "%s: Overrun Error\n", __func__);
                 pcm->underruns++;
+                metrics_inc(METRICS_CTR_AUDIO_XRUNS);
                 pcm->running = 0;
                 continue;
             }
@@ -0,0 +1,352 @@
+// SPDX-License-Identifier: MIT
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "ipc.h"
+#include "logger.h"
+#include "openqti.h"
+#include "pkt_trace.h"
+
+struct {
+  bool enabled;
+  uint32_t dropped; // packets that didn't fit in the table
+  /* Only contended while dumping */
+  pthread_mutex_t lock;
+  struct pkt_trace_entry entries[PKT_TRACE_MAX_ENTRIES];
+} pkt_trace_rt = {
+    .enabled = false,
+    .dropped = 0,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static const char *stage_names[PKT_TRACE_STAGE_LAST] = {
+    [PKT_TRACE_STAGE_READ] = "read",
+    [PKT_TRACE_STAGE_CLASSIFY] = "classify",
+    [PKT_TRACE_STAGE_HANDLER] = "handler",
+    [PKT_TRACE_STAGE_WRITE] = "write",
+};
+
+/* Only thread that ever gets SIGUSR1 / SIGUSR2 */
+static void *pkt_trace_signal_thread(void *arg) {
+  sigset_t *set = (sigset_t *)arg;
+  int signum;
+
+  while (1) {
+    if (sigwait(set, &signum) != 0)
+      continue;
+    if (signum == SIGUSR1)
+      pkt_trace_dump();
+    else if (signum == SIGUSR2)
+      pkt_trace_set_enabled(!pkt_trace_is_enabled());
+  }
+
+  return NULL;
+}
+
+/*
+ * Must run before any other thread is created: they all inherit the mask,
+ * so the signals can't interrupt their select() / read() calls
+ */
+void pkt_trace_init(void) {
+  static sigset_t set;
+  pthread_t thread;
+  int ret;
+
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  sigaddset(&set, SIGUSR2);
+  ret = pthread_sigmask(SIG_BLOCK, &set, NULL);
+  if (ret != 0) {
+    logger(MSG_ERROR, "%s: Can't block trace signals: %s\n", __func__,
+           strerror(ret));
+    return;
+  }
+
+  ret = pthread_create(&thread, NULL, &pkt_trace_signal_thread, &set);
+  if (ret != 0) {
+    logger(MSG_ERROR, "%s: Error creating signal thread: %s\n", __func__,
+           strerror(ret));
+    return;
+  }
+  pthread_detach(thread);
+}
+
+void pkt_trace_set_enabled(bool en) {
+  __atomic_store_n(&pkt_trace_rt.enabled, en, __ATOMIC_RELAXED);
+  logger(MSG_INFO, "%s: Packet tracing %s\n", __func__,
+         en ? "enabled" : "disabled");
+}
+
+bool pkt_trace_is_enabled(void) {
+  return __atomic_load_n(&pkt_trace_rt.enabled, __ATOMIC_RELAXED);
+}
+
+void pkt_trace_reset(void) {
+  pthread_mutex_lock(&pkt_trace_rt.lock);
+  memset(pkt_trace_rt.entries, 0, sizeof(pkt_trace_rt.entries));
+  pkt_trace_rt.dropped = 0;
+  pthread_mutex_unlock(&pkt_trace_rt.lock);
+}
+
+static uint16_t get_bucket(uint64_t usecs) {
+  uint8_t exponent;
+  if (usecs < PKT_TRACE_SUB_BUCKETS)
+    return usecs;
+
+  exponent = 63 - __builtin_clzll(usecs);
+  if (exponent >= PKT_TRACE_MAX_EXPONENT)
+    return PKT_TRACE_BUCKETS - 1;
+
+  return PKT_TRACE_SUB_BUCKETS +
+         (exponent - PKT_TRACE_SUB_BUCKET_BITS) * PKT_TRACE_SUB_BUCKETS +
+         ((usecs >> (exponent - PKT_TRACE_SUB_BUCKET_BITS)) &
+          (PKT_TRACE_SUB_BUCKETS - 1));
+}
+
+/* Highest value that falls in a bucket */
+static uint32_t get_bucket_limit(uint16_t bucket) {
+  uint8_t shift, sub;
+  if (bucket < PKT_TRACE_SUB_BUCKETS)
+    return bucket;
+
+  shift = (bucket - PKT_TRACE_SUB_BUCKETS) / PKT_TRACE_SUB_BUCKETS;
+  sub = (bucket - PKT_TRACE_SUB_BUCKETS) % PKT_TRACE_SUB_BUCKETS;
+  return ((uint32_t)(PKT_TRACE_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+static uint32_t get_percentile(const struct pkt_trace_entry *entry,
+                               uint8_t percentile) {
+  uint64_t target, seen = 0;
+  uint32_t limit;
+  if (entry->count == 0)
+    return 0;
+
+  target = ((uint64_t)entry->count * percentile + 99) / 100;
+  for (uint16_t i = 0; i < PKT_TRACE_BUCKETS; i++) {
+    seen += entry->buckets[i];
+    if (seen >= target) {
+      limit = get_bucket_limit(i);
+      return limit < entry->total_max_us ? limit : entry->total_max_us;
+    }
+  }
+  return entry->total_max_us;
+}
+
+static uint64_t get_elapsed_us(struct timespec *from, struct timespec *to) {
+  int64_t elapsed = (int64_t)(to->tv_sec - from->tv_sec) * 1000000 +
+                    (to->tv_nsec - from->tv_nsec) / 1000;
+  return elapsed > 0 ? (uint64_t)elapsed : 0;
+}
+
+void pkt_trace_begin(struct pkt_trace *trace, uint8_t source) {
+  trace->active = pkt_trace_is_enabled();
+  if (!trace->active)
+    return;
+
+  memset(trace->stages, 0, sizeof(trace->stages));
+  trace->source = source;
+  trace->service = 0;
+  trace->message_id = 0;
+  clock_gettime(CLOCK_MONOTONIC, &trace->stages[PKT_TRACE_STAGE_READ]);
+}
+
+void pkt_trace_classify(struct pkt_trace *trace, uint8_t service,
+                        uint16_t message_id) {
+  if (!trace->active)
+    return;
+
+  trace->service = service;
+  trace->message_id = message_id;
+  clock_gettime(CLOCK_MONOTONIC, &trace->stages[PKT_TRACE_STAGE_CLASSIFY]);
+}
+
+void pkt_trace_mark(struct pkt_trace *trace, uint8_t stage) {
+  if (!trace->active || stage >= PKT_TRACE_STAGE_LAST)
+    return;
+
+  clock_gettime(CLOCK_MONOTONIC, &trace->stages[stage]);
+}
+
+static struct pkt_trace_entry *find_entry(struct pkt_trace *trace) {
+  /* Open addressing over the table, keyed by direction, service and msg */
+  uint32_t key = ((uint32_t)trace->source << 24) |
+                 ((uint32_t)trace->service << 16) | trace->message_id;
+  uint32_t pos = (key * 2654435761u) % PKT_TRACE_MAX_ENTRIES;
+  struct pkt_trace_entry *entry;
+
+  for (uint8_t i = 0; i < PKT_TRACE_MAX_ENTRIES; i++) {
+    entry = &pkt_trace_rt.entries[(pos + i) % PKT_TRACE_MAX_ENTRIES];
+    if (!entry->in_use) {
+      entry->in_use = true;
+      entry->source = trace->source;
+      entry->service = trace->service;
+      entry->message_id = trace->message_id;
+      return entry;
+    }
+    if (entry->source == trace->source && entry->service == trace->service &&
+        entry->message_id == trace->message_id)
+      return entry;
+  }
+  return NULL;
+}
+
+void pkt_trace_end(struct pkt_trace *trace) {
+  struct pkt_trace_entry *entry;
+  struct timespec *prev;
+  uint64_t elapsed, total;
+
+  if (!trace->active)
+    return;
+  trace->active = false;
+
+  /* Packets that never got classified (empty or too small) aren't useful */
+  if (trace->stages[PKT_TRACE_STAGE_CLASSIFY].tv_sec == 0)
+    return;
+
+  clock_gettime(CLOCK_MONOTONIC, &trace->stages[PKT_TRACE_STAGE_WRITE]);
+
+  pthread_mutex_lock(&pkt_trace_rt.lock);
+  entry = find_entry(trace);
+  if (entry == NULL) {
+    pkt_trace_rt.dropped++;
+    pthread_mutex_unlock(&pkt_trace_rt.lock);
+    return;
+  }
+
+  entry->count++;
+  prev = &trace->stages[PKT_TRACE_STAGE_READ];
+  for (uint8_t i = PKT_TRACE_STAGE_CLASSIFY; i < PKT_TRACE_STAGE_LAST; i++) {
+    if (trace->stages[i].tv_sec == 0)
+      continue;
+    elapsed = get_elapsed_us(prev, &trace->stages[i]);
+    entry->stage_sum_us[i] += elapsed;
+    if (elapsed > entry->stage_max_us[i])
+      entry->stage_max_us[i] = elapsed;
+    prev = &trace->stages[i];
+  }
+
+  total = get_elapsed_us(&trace->stages[PKT_TRACE_STAGE_READ],
+                         &trace->stages[PKT_TRACE_STAGE_WRITE]);
+  if (total > entry->total_max_us)
+    entry->total_max_us = total;
+  entry->buckets[get_bucket(total)]++;
+  pthread_mutex_unlock(&pkt_trace_rt.lock);
+}
+
+/*
+ * Copies the used entries out of the table, so the proxy thread isn't
+ * blocked while we write them somewhere
+ */
+static uint8_t get_snapshot(struct pkt_trace_entry *entries,
+                            uint32_t *dropped) {
+  uint8_t num = 0;
+  pthread_mutex_lock(&pkt_trace_rt.lock);
+  for (uint8_t i = 0; i < PKT_TRACE_MAX_ENTRIES; i++) {
+    if (pkt_trace_rt.entries[i].in_use) {
+      memcpy(&entries[num], &pkt_trace_rt.entries[i],
+             sizeof(struct pkt_trace_entry));
+      num++;
+    }
+  }
+  *dropped = pkt_trace_rt.dropped;
+  pthread_mutex_unlock(&pkt_trace_rt.lock);
+  return num;
+}
+
+/* Slowest first */
+static int compare_entries(const void *a, const void *b) {
+  const struct pkt_trace_entry *ea = a, *eb = b;
+  uint32_t pa = get_percentile(ea, 99), pb = get_percentile(eb, 99);
+  if (pa != pb)
+    return pa < pb ? 1 : -1;
+  if (ea->total_max_us != eb->total_max_us)
+    return ea->total_max_us < eb->total_max_us ? 1 : -1;
+  return 0;
+}
+
+int pkt_trace_dump(void) {
+  struct pkt_trace_entry *entries;
+  char path[255];
+  uint32_t dropped;
+  uint8_t num;
+  FILE *fd;
+
+  entries = calloc(PKT_TRACE_MAX_ENTRIES, sizeof(struct pkt_trace_entry));
+  if (entries == NULL)
+    return -ENOMEM;
+
+  num = get_snapshot(entries, &dropped);
+  qsort(entries, num, sizeof(struct pkt_trace_entry), compare_entries);
+
+  snprintf(path, sizeof(path), "%s%s", get_default_logpath(), PKT_TRACE_FILE);
+  fd = fopen(path, "w");
+  if (fd == NULL) {
+    logger(MSG_ERROR, "%s: Can't open %s: %s\n", __func__, path,
+           strerror(errno));
+    free(entries);
+    return -errno;
+  }
+
+  fprintf(fd, "# Packet trace (%s), %u entries, %u packets dropped\n",
+          pkt_trace_is_enabled() ? "enabled" : "disabled", num, dropped);
+  fprintf(fd, "# All times in us. Stage times are averages since the "
+              "previous stage\n");
+  fprintf(fd, "%-6s %-12s %-6s %8s %8s %8s %8s", "dir", "service", "msg",
+          "count", "p50", "p99", "max");
+  for (uint8_t i = PKT_TRACE_STAGE_CLASSIFY; i < PKT_TRACE_STAGE_LAST; i++)
+    fprintf(fd, " %8s %8s", stage_names[i], "max");
+  fprintf(fd, "\n");
+
+  for (uint8_t i = 0; i < num; i++) {
+    fprintf(fd, "%-6s %-12s 0x%.4x %8u %8u %8u %8u",
+            entries[i].source == FROM_HOST ? "host" : "dsp",
+            get_service_name(entries[i].service), entries[i].message_id,
+            entries[i].count, get_percentile(&entries[i], 50),
+            get_percentile(&entries[i], 99), entries[i].total_max_us);
+    for (uint8_t j = PKT_TRACE_STAGE_CLASSIFY; j < PKT_TRACE_STAGE_LAST; j++)
+      fprintf(fd, " %8llu %8u",
+              (unsigned long long)(entries[i].stage_sum_us[j] /
+                                   entries[i].count),
+              entries[i].stage_max_us[j]);
+    fprintf(fd, "\n");
+  }
+
+  fclose(fd);
+  free(entries);
+  logger(MSG_INFO, "%s: Packet trace written to %s\n", __func__, path);
+  return 0;
+}
+
+/* Top entries by p99, short enough to be sent back as a message */
+size_t pkt_trace_get_summary(char *buf, size_t max_len) {
+  struct pkt_trace_entry *entries;
+  uint32_t dropped;
+  size_t len = 0;
+  uint8_t num;
+
+  entries = calloc(PKT_TRACE_MAX_ENTRIES, sizeof(struct pkt_trace_entry));
+  if (entries == NULL)
+    return 0;
+
+  num = get_snapshot(entries, &dropped);
+  qsort(entries, num, sizeof(struct pkt_trace_entry), compare_entries);
+
+  len += snprintf(buf + len, max_len - len, "Slowest packets (p99/max us):\n");
+  for (uint8_t i = 0; i < num && i < 4 && len < max_len; i++) {
+    len += snprintf(buf + len, max_len - len, "%s %.2x:%.4x %u/%u\n",
+                    entries[i].source == FROM_HOST ? ">" : "<",
+                    entries[i].service, entries[i].message_id,
+                    get_percentile(&entries[i], 99), entries[i].total_max_us);
+  }
+  if (num == 0 && len < max_len)
+    len += snprintf(buf + len, max_len - len, "Nothing traced yet\n");
+
+  free(entries);
+  return len < max_len ? len : max_len - 1;
+}
@@ -9,7 +9,9 @@
 #include "helpers.h"
 #include "ipc.h"
 #include "logger.h"
+#include "metrics.h"
 #include "openqti.h"
+#include "pkt_trace.h"
 #include "qmi.h"
 #include "sms.h"
 #include "tracking.h"
@@ -30,6 +32,7 @@ struct {
   uint8_t debug_service_id;
   struct pkt_stats rmnet_packet_stats;
   struct pkt_stats gps_packet_stats;
+  struct pkt_trace trace; // packet currently in rmnet_proxy()
 } proxy_rt;
 
 void proxy_rt_reset() {
@@ -151,7 +154,11 @@ void *gps_proxy() {
 
     tv.tv_sec = 0;
     tv.tv_usec = 500000;
-    select(MAX_FD, &readfds, NULL, NULL, &tv);
+    if (select(MAX_FD, &readfds, NULL, NULL, &tv) < 0) {
+      /* Interrupted: the set is left as it was, don't block reading a
+       * node with nothing in it */
+      FD_ZERO(&readfds);
+    }
     if (FD_ISSET(nodes->node1.fd, &readfds)) {
       ret = read(nodes->node1.fd, &buf, MAX_PACKET_SIZE);
       if (ret > 0) {
@@ -163,14 +170,17 @@ void *gps_proxy() {
                }*/
         if (!get_transceiver_suspend_state() && nodes->node2.fd >= 0) {
           proxy_rt.gps_packet_stats.allowed++;
+          metrics_inc(METRICS_CTR_GPS_ALLOWED);
           ret = write(nodes->node2.fd, buf, ret);
           if (ret == 0) {
             proxy_rt.gps_packet_stats.failed++;
+            metrics_inc(METRICS_CTR_GPS_FAILED);
             logger(MSG_ERROR, "%s: [GPS_TRACK Failed to write to USB\n",
                    __func__);
           }
         } else {
           proxy_rt.gps_packet_stats.discarded++;
+          metrics_inc(METRICS_CTR_GPS_DISCARDED);
         }
       } else {
         proxy_rt.gps_packet_stats.empty++;
@@ -184,10 +194,12 @@ void *gps_proxy() {
       ret = read(nodes->node2.fd, &buf, MAX_PACKET_SIZE);
       if (ret > 0) {
         proxy_rt.gps_packet_stats.allowed++;
+        metrics_inc(METRICS_CTR_GPS_ALLOWED);
         dump_packet("GPS_SMD<--USB", buf, ret);
         ret = write(nodes->node1.fd, buf, ret);
         if (ret == 0) {
           proxy_rt.gps_packet_stats.failed++;
+          metrics_inc(METRICS_CTR_GPS_FAILED);
           logger(MSG_ERROR, "%s: Failed to write to the ADSP\n", __func__);
         }
       } else {
@@ -314,6 +326,14 @@ uint8_t process_packet(uint8_t source, uint8_t *pkt, size_t pkt_size,
                                              : "Baseband --> Host",
                          pkt, pkt_size);
   }
+  if (get_qmux_service_id(pkt, pkt_size) == 0) {
+    pkt_trace_classify(&proxy_rt.trace, 0,
+                       get_control_message_id(pkt, pkt_size));
+  } else {
+    pkt_trace_classify(&proxy_rt.trace, get_qmux_service_id(pkt, pkt_size),
+                       get_qmi_message_id(pkt, pkt_size));
+  }
+
   /* In the future we can use this as a router inside the application.
    * For now we only do some simple tasks depending on service, so no
    * need to do too much
@@ -421,9 +441,11 @@ void *rmnet_proxy(void *node_data) {
   uint8_t sourcefd, targetfd;
   size_t bytes_read, bytes_written;
   int8_t source;
+  uint8_t action;
   fd_set readfds;
   uint8_t buf[MAX_PACKET_SIZE];
   struct timeval tv;
+  struct timespec pkt_time;
 
   logger(MSG_INFO, "%s: Initialize RMNET proxy thread.\n", __func__);
 
@@ -438,7 +460,10 @@ void *rmnet_proxy(void *node_data) {
 
     tv.tv_sec = 0;
     tv.tv_usec = 500000;
-    select(MAX_FD, &readfds, NULL, NULL, &tv);
+    if (select(MAX_FD, &readfds, NULL, NULL, &tv) < 0) {
+      /* Interrupted by a signal, see gps_proxy() */
+      FD_ZERO(&readfds);
+    }
     if (FD_ISSET(nodes->node2.fd, &readfds)) {
       source = FROM_DSP;
       sourcefd = nodes->node2.fd;
@@ -459,25 +484,37 @@ void *rmnet_proxy(void *node_data) {
     /* We've set it all up, now we do the work */
     if (source == FROM_HOST || source == FROM_DSP) {
       bytes_read = read(sourcefd, &buf, MAX_PACKET_SIZE);
-      switch (process_packet(source, buf, bytes_read, nodes->node2.fd,
-                             nodes->node1.fd)) {
+      clock_gettime(CLOCK_MONOTONIC, &pkt_time);
+      pkt_trace_begin(&proxy_rt.trace, source);
+      action = process_packet(source, buf, bytes_read, nodes->node2.fd,
+                              nodes->node1.fd);
+      pkt_trace_mark(&proxy_rt.trace, PKT_TRACE_STAGE_HANDLER);
+      switch (action) {
       case PACKET_EMPTY:
         logger(MSG_WARN, "%s Empty packet on %s, (device closed?)\n", __func__,
                (source == FROM_HOST ? "HOST" : "ADSP"));
         proxy_rt.rmnet_packet_stats.empty++;
+        metrics_inc(METRICS_CTR_RMNET_EMPTY);
         break;
       case PACKET_PASS_TRHU:
         logger(MSG_DEBUG, "%s Pass through\n", __func__); // MSG_DEBUG
         if (!get_transceiver_suspend_state() || source == FROM_HOST) {
           proxy_rt.rmnet_packet_stats.allowed++;
+          metrics_inc(METRICS_CTR_RMNET_ALLOWED);
           bytes_written = write(targetfd, buf, bytes_read);
           if (bytes_written < 1) {
             logger(MSG_WARN, "%s Error writing to %s\n", __func__,
                    (source == FROM_HOST ? "ADSP" : "HOST"));
             proxy_rt.rmnet_packet_stats.failed++;
+            metrics_inc(METRICS_CTR_RMNET_FAILED);
+          } else {
+            metrics_add(METRICS_CTR_RMNET_BYTES, bytes_written);
+            metrics_record_latency(METRICS_HIST_PKT_FORWARD,
+                                   metrics_elapsed_us(&pkt_time));
           }
         } else {
           proxy_rt.rmnet_packet_stats.discarded++;
+          metrics_inc(METRICS_CTR_RMNET_DISCARDED);
           logger(MSG_DEBUG, "%s Data discarded from %s to %s\n", __func__,
                  (source == FROM_HOST ? "HOST" : "ADSP"),
                  (source == FROM_HOST ? "ADSP" : "HOST"));
@@ -486,15 +523,22 @@ void *rmnet_proxy(void *node_data) {
       case PACKET_FORCED_PT:
         logger(MSG_DEBUG, "%s Force pass through\n", __func__); // MSG_DEBUG
         proxy_rt.rmnet_packet_stats.allowed++;
+        metrics_inc(METRICS_CTR_RMNET_ALLOWED);
         bytes_written = write(targetfd, buf, bytes_read);
         if (bytes_written < 1) {
           logger(MSG_WARN, "%s [FPT] Error writing to %s\n", __func__,
                  (source == FROM_HOST ? "ADSP" : "HOST"));
           proxy_rt.rmnet_packet_stats.failed++;
+          metrics_inc(METRICS_CTR_RMNET_FAILED);
+        } else {
+          metrics_add(METRICS_CTR_RMNET_BYTES, bytes_written);
+          metrics_record_latency(METRICS_HIST_PKT_FORWARD,
+                                 metrics_elapsed_us(&pkt_time));
         }
         break;
       case PACKET_BYPASS:
         proxy_rt.rmnet_packet_stats.bypassed++;
+        metrics_inc(METRICS_CTR_RMNET_BYPASSED);
         logger(MSG_DEBUG, "%s Packet bypassed\n", __func__);
         break;
 
@@ -502,6 +546,7 @@ void *rmnet_proxy(void *node_data) {
         logger(MSG_WARN, "%s Default case\n", __func__);
         break;
       }
+      pkt_trace_end(&proxy_rt.trace);
     }
   } // end of infinite loop
 
@@ -5,6 +5,7 @@
 #include "dms.h"
 #include "ipc.h"
 #include "logger.h"
+#include "metrics.h"
 #include "openqti.h"
 #include "sms.h"
 #include "wds.h"
@@ -28,6 +29,8 @@ struct {
   uint8_t has_pending_message;
   int fd;
   struct qmi_service_bindings services[QMI_SERVICES_LAST];
+  /* When the last request was sent to each service, for metrics */
+  struct timespec request_sent[QMI_SERVICES_LAST];
 } internal_qmi_client;
 
 /*
@@ -308,6 +311,15 @@ uint16_t count_tlvs_in_message(uint8_t *bytes, size_t len) {
 
 /* INTERNAL QMI CLIENT */
 
+static void update_pending_message_gauge(void) {
+  int32_t pending = 0;
+  for (uint8_t i = 0; i < QMI_SERVICES_LAST; i++) {
+    if (internal_qmi_client.services[i].has_pending_message)
+      pending++;
+  }
+  metrics_set_gauge(METRICS_GAUGE_QMI_PENDING, pending);
+}
+
 /*
  * Signals to the proxy thread that some internal service has a pending message
  */
@@ -316,6 +328,7 @@ void set_pending_message(uint8_t service) {
          service);
   internal_qmi_client.services[service].has_pending_message = 1;
   internal_qmi_client.has_pending_message = 1;
+  update_pending_message_gauge();
 }
 
 /*
@@ -468,6 +481,10 @@ void clear_message_for_service(uint8_t service) {
     return;
   }
 
+  /* This is only called right after the message is written to the port */
+  clock_gettime(CLOCK_MONOTONIC, &internal_qmi_client.request_sent[service]);
+  metrics_inc(METRICS_CTR_QMI_INTERNAL_TX);
+
   free(internal_qmi_client.services[service].message);
   internal_qmi_client.services[service].message = NULL;
   internal_qmi_client.services[service].message_len = 0;
@@ -619,6 +636,7 @@ int send_pending_internal_qmi_messages() {
     internal_qmi_client.has_pending_message = 0;
     logger(MSG_DEBUG, "%s: Pending flag cleared\n", __func__);
   }
+  update_pending_message_gauge();
   return 0;
 }
 /*
@@ -709,6 +727,16 @@ void dispatch_incoming_qmi_message(uint8_t *buf, size_t buf_len) {
   uint16_t transaction_id = get_transaction_id(buf, buf_len);
 
   set_transaction_id_for_service(service, transaction_id + 1);
+  metrics_inc(METRICS_CTR_QMI_INTERNAL_RX);
+  /* Only the first message after a request counts as its response */
+  if (service < QMI_SERVICES_LAST &&
+      internal_qmi_client.request_sent[service].tv_sec != 0) {
+    metrics_record_latency(
+        METRICS_HIST_QMI_ROUNDTRIP,
+        metrics_elapsed_us(&internal_qmi_client.request_sent[service]));
+    internal_qmi_client.request_sent[service].tv_sec = 0;
+    internal_qmi_client.request_sent[service].tv_nsec = 0;
+  }
   switch (service) {
   case QMI_SERVICE_CONTROL:
     break;
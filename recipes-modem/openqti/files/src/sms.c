@@ -14,6 +14,7 @@
 #include "helpers.h"
 #include "ipc.h"
 #include "logger.h"
+#include "metrics.h"
 #include "proxy.h"
 #include "qmi.h"
 #include "sms.h"
@@ -53,6 +54,7 @@ struct message {
   uint8_t state; // message sending status
   uint8_t retries;
   struct timespec timestamp; // to know when to give up
+  struct timespec queued_at; // for delivery latency metrics
 };
 
 struct message_queue {
@@ -1237,6 +1239,10 @@ int handle_message_state(int fd, uint32_t message_id) {
     memset(sms_runtime.queue.msg[message_id].pkt, 0, MAX_MESSAGE_SIZE);
     sms_runtime.queue.msg[message_id].len = 0;
     sms_runtime.current_message_id++;
+    metrics_inc(METRICS_CTR_SMS_DELIVERED);
+    metrics_record_latency(
+        METRICS_HIST_SMS_DELIVERY,
+        metrics_elapsed_us(&sms_runtime.queue.msg[message_id].queued_at));
     break;
   default:
     logger(MSG_WARN, "%s: Unknown task for message ID: %i (%i) \n", __func__,
@@ -1255,6 +1261,7 @@ void wipe_queue() {
   set_pending_notification_source(MSG_NONE);
   sms_runtime.queue.queue_pos = -1;
   sms_runtime.current_message_id = 0;
+  metrics_set_gauge(METRICS_GAUGE_SMS_QUEUE_DEPTH, 0);
 }
 
 /*
@@ -1433,6 +1440,11 @@ void add_sms_to_queue(uint8_t *message, size_t len) {
     sms_runtime.queue.msg[sms_runtime.queue.queue_pos].tp_dcs = 0x00;
     sms_runtime.queue.msg[sms_runtime.queue.queue_pos].is_raw = 0;
     sms_runtime.queue.msg[sms_runtime.queue.queue_pos].is_cb = 0;
+    clock_gettime(CLOCK_MONOTONIC,
+                  &sms_runtime.queue.msg[sms_runtime.queue.queue_pos].queued_at);
+    metrics_inc(METRICS_CTR_SMS_QUEUED);
+    metrics_set_gauge(METRICS_GAUGE_SMS_QUEUE_DEPTH,
+                      sms_runtime.queue.queue_pos + 1);
 
   } else {
     logger(MSG_ERROR, "%s: Size of message is 0\n", __func__);
@@ -1461,6 +1473,11 @@ void add_raw_sms_to_queue(uint8_t *message, size_t len, uint8_t tp_dcs,
     if (is_cb) {
       sms_runtime.queue.msg[sms_runtime.queue.queue_pos].is_cb = 1;
     }
+    clock_gettime(CLOCK_MONOTONIC,
+                  &sms_runtime.queue.msg[sms_runtime.queue.queue_pos].queued_at);
+    metrics_inc(METRICS_CTR_SMS_QUEUED);
+    metrics_set_gauge(METRICS_GAUGE_SMS_QUEUE_DEPTH,
+                      sms_runtime.queue.queue_pos + 1);
   } else {
     logger(MSG_ERROR, "%s: Size of message is 0\n", __func__);
   }
@@ -4,6 +4,7 @@
 #include "config.h"
 #include "helpers.h"
 #include "logger.h"
+#include "metrics.h"
 #include "openqti.h"
 #include "qmi.h"
 #include "scheduler.h"
@@ -54,6 +55,7 @@ void *thermal_monitoring_thread() {
                THRM_ZONE_TRAIL);
       prev_sensor_reading[i] = sensors[i];
       sensors[i] = get_temperature(sensor_path);
+      metrics_set_gauge(METRICS_GAUGE_THERMAL_ZONE0 + i, sensors[i]);
     }
     if (round % 2 == 0) {
       log_thermal_status(MSG_INFO, "Zones 0-6: %iC %iC %iC %iC %iC %iC %iC \n",
@@ -58,9 +58,9 @@ void *time_sync() {
     // Set CTZU first
     logger(MSG_DEBUG, "%s: Send CTZU\n", __func__);
     cmd_ret = send_at_command(SET_CTZU, sizeof(SET_CTZU), response, 128);
-    sleep(1);
     // Now attempt to sync from network
     logger(MSG_DEBUG, "%s: Send QLTS\n", __func__);
+    memset(response, 0, 128);
     cmd_ret = send_at_command(GET_QLTS, sizeof(GET_QLTS), response, 128);
     if (cmd_ret == 0 && strstr(response, "+QLTS: ") != NULL) { // Sync was ok
       begin = strchr(response, '"');
@@ -95,7 +95,7 @@ void *time_sync() {
 
     if (!sync_completed) {
       logger(MSG_DEBUG, "%s: Send CCLK\n", __func__);
-      sleep(1);
+      memset(response, 0, 128);
       cmd_ret = send_at_command(GET_CCLK, sizeof(GET_CCLK), response, 128);
       if (strstr(response, "+CCLK: ") != NULL) {
         begin = strchr(response, '"');
@@ -12,6 +12,7 @@
 #include "helpers.h"
 #include "ipc.h"
 #include "logger.h"
+#include "metrics.h"
 #include "tracking.h"
 
 struct {
@@ -24,6 +25,7 @@ struct {
 
 void reset_client_handler() {
   client_tracking.last_active = 0;
+  metrics_set_gauge(METRICS_GAUGE_QMI_CLIENTS, 0);
   client_tracking.regtime = 0;
   client_tracking.host_side_managing_app = 0;
   for (int i = 0; i < 32; i++) {
@@ -59,6 +61,7 @@ int add_client(uint8_t service, uint8_t instance) {
   client_tracking.services[client_tracking.last_active].service = service;
   client_tracking.services[client_tracking.last_active].instance = instance;
   client_tracking.last_active++;
+  metrics_set_gauge(METRICS_GAUGE_QMI_CLIENTS, client_tracking.last_active);
   client_tracking.regtime = get_curr_timestamp();
   if (client_tracking.last_active > MAX_ACTIVE_CLIENTS) {
     return -ENOSPC;
@@ -74,6 +77,7 @@ int remove_client(uint8_t service, uint8_t instance) {
       client_tracking.services[i].service = 0;
       client_tracking.services[i].instance = 0;
       client_tracking.last_active--;
+      metrics_set_gauge(METRICS_GAUGE_QMI_CLIENTS, client_tracking.last_active);
       if (client_tracking.last_active <= 0) {
         logger(MSG_INFO, "%s: All QMI Clients have been freed from the host\n",
                __func__);
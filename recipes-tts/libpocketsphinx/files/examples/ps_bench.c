@@ -0,0 +1,382 @@
+/* Decoding benchmark for PocketSphinx.
+ *
+ * MIT license (c) 2024, see LICENSE for more information.
+ */
+/**
+ * @example ps_bench.c
+ * @brief Measure decoding speed and memory use over a set of files.
+ *
+ * This decodes every WAV file given on the command line, or found in
+ * directories given on the command line, feeding the audio in small
+ * blocks as a live application would.  It reports the real-time
+ * factor, the median and 99th percentile time taken to process each
+ * block, the peak resident set size, and the time and allocations
+ * spent in each stage of decoding (see ps_get_stage_time()).
+ *
+ * Any option other than the ones below is passed to the decoder, so
+ * you can use it with other models:
+ *
+ *     ps_bench -hmm MODEL -lm LM -dict DICT -json results.jsonl wavs/
+ *
+ * Options:
+ *
+ *  - `-blk MS`: Block size in milliseconds (default 10, one frame).
+ *  - `-json FILE`: Write one JSON object per file plus a final one
+ *    with the totals to FILE (`-` for standard output), to keep
+ *    track of regressions.
+ *
+ * This uses POSIX functions to list directories and read the clock,
+ * so it won't build on Windows.
+ */
+#include <pocketsphinx.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+static const char *stage_names[PS_N_STAGE] = {
+    "fe", "feat", "gmm", "search", "lattice"
+};
+
+typedef struct bench_s {
+    ps_config_t *config;
+    ps_decoder_t *decoder;
+    FILE *json;
+    int blk_ms;
+    long samprate;
+    /* Time taken by each call to ps_process_raw(), in seconds. */
+    double *lat;
+    size_t n_lat, n_lat_alloc;
+    /* Totals. */
+    int n_files;
+    double audio, wall, cpu;
+    double stage_cpu[PS_N_STAGE], stage_wall[PS_N_STAGE];
+    int64 stage_alloc[PS_N_STAGE];
+} bench_t;
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long
+peak_rss_kb(void)
+{
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) < 0)
+        return -1;
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024;
+#else
+    return ru.ru_maxrss;
+#endif
+}
+
+static void
+json_string(FILE *fh, const char *str)
+{
+    fputc('"', fh);
+    for (; str && *str; ++str) {
+        if (*str == '"' || *str == '\\')
+            fprintf(fh, "\\%c", *str);
+        else if ((unsigned char)*str < 0x20)
+            fprintf(fh, "\\u%04x", *str);
+        else
+            fputc(*str, fh);
+    }
+    fputc('"', fh);
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int
+cmp_str(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static double
+percentile(double *sorted, size_t n, double p)
+{
+    if (n == 0)
+        return 0.0;
+    return sorted[(size_t)(p * (n - 1) + 0.5)];
+}
+
+static void
+add_latency(bench_t *b, double t)
+{
+    if (b->n_lat == b->n_lat_alloc) {
+        b->n_lat_alloc = b->n_lat_alloc ? b->n_lat_alloc * 2 : 4096;
+        if ((b->lat = realloc(b->lat,
+                              b->n_lat_alloc * sizeof(*b->lat))) == NULL)
+            E_FATAL_SYSTEM("Failed to allocate latency array");
+    }
+    b->lat[b->n_lat++] = t;
+}
+
+static int16 *
+read_audio(bench_t *b, const char *path, size_t *out_nsamp)
+{
+    FILE *fh;
+    int16 *buf;
+    long start, end;
+
+    if ((fh = fopen(path, "rb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open %s", path);
+        return NULL;
+    }
+    if (ps_config_soundfile(b->config, fh, path) < 0) {
+        E_ERROR("Unsupported input file %s\n", path);
+        fclose(fh);
+        return NULL;
+    }
+    if (b->samprate == 0)
+        b->samprate = ps_config_int(b->config, "samprate");
+    else if (ps_config_int(b->config, "samprate") != b->samprate) {
+        E_ERROR("%s has sampling rate %ld, expected %ld, skipping\n",
+                path, ps_config_int(b->config, "samprate"), b->samprate);
+        fclose(fh);
+        return NULL;
+    }
+    start = ftell(fh);
+    fseek(fh, 0, SEEK_END);
+    end = ftell(fh);
+    fseek(fh, start, SEEK_SET);
+    if ((buf = malloc(end - start + sizeof(*buf))) == NULL)
+        E_FATAL_SYSTEM("Failed to allocate %ld bytes", end - start);
+    *out_nsamp = fread(buf, sizeof(*buf), (end - start) / sizeof(*buf), fh);
+    fclose(fh);
+
+    return buf;
+}
+
+static void
+bench_file(bench_t *b, const char *path)
+{
+    int16 *buf;
+    size_t nsamp, blk, pos;
+    double t, wall, audio, ncpu, nwall;
+    const char *hyp;
+    int32 score;
+    int i;
+
+    if ((buf = read_audio(b, path, &nsamp)) == NULL)
+        return;
+    score = 0;
+    if (b->decoder == NULL
+        && (b->decoder = ps_init(b->config)) == NULL)
+        E_FATAL("PocketSphinx decoder init failed\n");
+    blk = b->samprate * b->blk_ms / 1000;
+    if (blk == 0)
+        blk = 1;
+
+    wall = 0;
+    if (ps_start_utt(b->decoder) < 0)
+        E_FATAL("Failed to start processing\n");
+    for (pos = 0; pos < nsamp; pos += blk) {
+        size_t n = (nsamp - pos < blk) ? nsamp - pos : blk;
+
+        t = now();
+        if (ps_process_raw(b->decoder, buf + pos, n, FALSE, FALSE) < 0)
+            E_FATAL("ps_process_raw() failed on %s\n", path);
+        t = now() - t;
+        add_latency(b, t);
+        wall += t;
+    }
+    t = now();
+    if (ps_end_utt(b->decoder) < 0)
+        E_FATAL("Failed to end processing on %s\n", path);
+    hyp = ps_get_hyp(b->decoder, &score);
+    wall += now() - t;
+    free(buf);
+
+    audio = (double)nsamp / b->samprate;
+    ps_get_utt_time(b->decoder, &t, &ncpu, &nwall);
+    b->n_files++;
+    b->audio += audio;
+    b->wall += wall;
+    b->cpu += ncpu;
+    printf("%s: %.2fs audio, RTF %.3f: %s\n",
+           path, audio, audio > 0 ? wall / audio : 0.0, hyp ? hyp : "");
+
+    if (b->json) {
+        fprintf(b->json, "{\"file\": ");
+        json_string(b->json, path);
+        fprintf(b->json, ", \"audio\": %.3f, \"wall\": %.6f, \"cpu\": %.6f"
+                ", \"rtf\": %.6f, \"score\": %d, \"hyp\": ",
+                audio, wall, ncpu, audio > 0 ? wall / audio : 0.0, score);
+        json_string(b->json, hyp);
+        fprintf(b->json, ", \"stages\": {");
+    }
+    for (i = 0; i < PS_N_STAGE; ++i) {
+        double scpu, swall;
+        int64 salloc;
+
+        if (ps_get_stage_time(b->decoder, i, &scpu, &swall, &salloc) < 0)
+            continue;
+        b->stage_cpu[i] += scpu;
+        b->stage_wall[i] += swall;
+        b->stage_alloc[i] += salloc;
+        if (b->json)
+            fprintf(b->json, "%s\"%s\": {\"cpu\": %.6f, \"wall\": %.6f"
+                    ", \"alloc\": %lld}", i ? ", " : "", stage_names[i],
+                    scpu, swall, (long long)salloc);
+    }
+    if (b->json)
+        fprintf(b->json, "}}\n");
+}
+
+static void
+bench_path(bench_t *b, const char *path)
+{
+    struct stat st;
+    DIR *dir;
+    struct dirent *ent;
+    char **names = NULL;
+    size_t i, n = 0, n_alloc = 0;
+
+    if (stat(path, &st) < 0) {
+        E_ERROR_SYSTEM("Failed to stat %s", path);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        bench_file(b, path);
+        return;
+    }
+    if ((dir = opendir(path)) == NULL) {
+        E_ERROR_SYSTEM("Failed to open directory %s", path);
+        return;
+    }
+    /* Sort them so that runs are comparable. */
+    while ((ent = readdir(dir)) != NULL) {
+        size_t len = strlen(ent->d_name);
+        if (len < 4 || strcasecmp(ent->d_name + len - 4, ".wav") != 0)
+            continue;
+        if (n == n_alloc) {
+            n_alloc = n_alloc ? n_alloc * 2 : 64;
+            if ((names = realloc(names, n_alloc * sizeof(*names))) == NULL)
+                E_FATAL_SYSTEM("Failed to allocate file list");
+        }
+        if ((names[n] = malloc(strlen(path) + len + 2)) == NULL)
+            E_FATAL_SYSTEM("Failed to allocate file name");
+        sprintf(names[n++], "%s/%s", path, ent->d_name);
+    }
+    closedir(dir);
+    qsort(names, n, sizeof(*names), cmp_str);
+    for (i = 0; i < n; ++i) {
+        bench_file(b, names[i]);
+        free(names[i]);
+    }
+    free(names);
+}
+
+static void
+report(bench_t *b)
+{
+    double p50, p99, rtf;
+    long rss;
+    int i;
+
+    qsort(b->lat, b->n_lat, sizeof(*b->lat), cmp_double);
+    p50 = percentile(b->lat, b->n_lat, 0.50) * 1000;
+    p99 = percentile(b->lat, b->n_lat, 0.99) * 1000;
+    rtf = b->audio > 0 ? b->wall / b->audio : 0.0;
+    rss = peak_rss_kb();
+
+    printf("\n%d files, %.2fs audio, %.2fs wall, %.2fs CPU\n",
+           b->n_files, b->audio, b->wall, b->cpu);
+    printf("RTF %.4f, %d ms block latency p50 %.3f ms p99 %.3f ms\n",
+           rtf, b->blk_ms, p50, p99);
+    printf("Peak RSS %ld KiB\n", rss);
+    printf("%-8s %10s %10s %10s\n", "stage", "cpu (s)", "wall (s)", "allocs");
+    for (i = 0; i < PS_N_STAGE; ++i)
+        printf("%-8s %10.3f %10.3f %10lld\n", stage_names[i],
+               b->stage_cpu[i], b->stage_wall[i],
+               (long long)b->stage_alloc[i]);
+
+    if (b->json) {
+        fprintf(b->json, "{\"total\": {\"files\": %d, \"audio\": %.3f"
+                ", \"wall\": %.6f, \"cpu\": %.6f, \"rtf\": %.6f"
+                ", \"blk_ms\": %d, \"lat_p50_ms\": %.6f"
+                ", \"lat_p99_ms\": %.6f, \"peak_rss_kb\": %ld"
+                ", \"stages\": {",
+                b->n_files, b->audio, b->wall, b->cpu, rtf,
+                b->blk_ms, p50, p99, rss);
+        for (i = 0; i < PS_N_STAGE; ++i)
+            fprintf(b->json, "%s\"%s\": {\"cpu\": %.6f, \"wall\": %.6f"
+                    ", \"alloc\": %lld}", i ? ", " : "", stage_names[i],
+                    b->stage_cpu[i], b->stage_wall[i],
+                    (long long)b->stage_alloc[i]);
+        fprintf(b->json, "}}}\n");
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    bench_t b;
+    int i, n_paths;
+
+    memset(&b, 0, sizeof(b));
+    b.blk_ms = 10;
+    b.config = ps_config_init(NULL);
+    ps_config_set_bool(b.config, "stagetime", TRUE);
+
+    /* Our options, then decoder options, then files. */
+    n_paths = 0;
+    for (i = 1; i < argc; ++i) {
+        if (argv[i][0] != '-' || argv[i][1] == '\0') {
+            argv[++n_paths] = argv[i];
+            continue;
+        }
+        if (i + 1 == argc)
+            E_FATAL("Option %s needs a value\n", argv[i]);
+        if (0 == strcmp(argv[i], "-blk")) {
+            if ((b.blk_ms = atoi(argv[++i])) <= 0)
+                E_FATAL("Invalid block size %s\n", argv[i]);
+        }
+        else if (0 == strcmp(argv[i], "-json")) {
+            ++i;
+            if (0 == strcmp(argv[i], "-"))
+                b.json = stdout;
+            else if ((b.json = fopen(argv[i], "w")) == NULL)
+                E_FATAL_SYSTEM("Failed to open %s", argv[i]);
+        }
+        else {
+            if (ps_config_set_str(b.config, argv[i] + 1, argv[i + 1]) == NULL)
+                E_FATAL("Unknown option %s\n", argv[i]);
+            ++i;
+        }
+    }
+    if (n_paths == 0)
+        E_FATAL("Usage: %s [-blk MS] [-json FILE] [DECODER OPTIONS] "
+                "WAV_OR_DIR...\n", argv[0]);
+    /* Fill in whatever models weren't given. */
+    ps_default_search_args(b.config);
+
+    for (i = 1; i <= n_paths; ++i)
+        bench_path(&b, argv[i]);
+    report(&b);
+
+    if (b.json && b.json != stdout)
+        fclose(b.json);
+    free(b.lat);
+    ps_free(b.decoder);
+    ps_config_free(b.config);
+
+    return 0;
+}
@@ -0,0 +1,409 @@
+/* Accuracy check for quantized Gaussians.
+ *
+ * MIT license (c) 2024, see LICENSE for more information.
+ */
+/**
+ * @example quant_wer.c
+ * @brief Compare word error rates with and without `-gauquant`.
+ *
+ * This decodes every WAV file given on the command line, or found in
+ * directories given on the command line, twice: once with the usual
+ * floating-point Gaussians and once with `-gauquant yes`.  It prints
+ * the word errors of both for each file, the totals, and the time
+ * spent in acoustic scoring by each.
+ *
+ * Any option other than the ones below is passed to both decoders:
+ *
+ *     quant_wer -hmm MODEL -lm LM -dict DICT -ref refs.txt -maxdelta 1 wavs/
+ *
+ * Options:
+ *
+ *  - `-ref FILE`: Reference transcripts, one per line, each starting
+ *    with the name of its WAV file without the directory or the
+ *    `.wav` extension.  Without this, the floating-point hypotheses
+ *    are the reference, so the quantized WER is how often the two
+ *    disagree.
+ *  - `-maxdelta PCT`: Exit with status 1 if the quantized WER is
+ *    more than PCT percentage points worse than the floating-point
+ *    one, to use this as a test.
+ *
+ * This uses POSIX functions to list directories, so it won't build on
+ * Windows.
+ */
+#include <pocketsphinx.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define MAX_WORDS 4096
+
+typedef struct ref_s {
+    char *name;
+    char *text;
+} ref_t;
+
+typedef struct check_s {
+    ps_config_t *config[2];
+    ps_decoder_t *decoder[2];
+    ref_t *refs;
+    size_t n_refs;
+    long samprate;
+    /* Totals. */
+    int n_files, n_words;
+    int errors[2];
+    double gmm[2];
+} check_t;
+
+static const char *mode_names[2] = { "float", "quant" };
+
+static int
+cmp_str(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* Splits str in place into at most max words. */
+static int
+split_words(char *str, char **words, int max)
+{
+    int n = 0;
+    char *w;
+
+    for (w = strtok(str, " \t\r\n"); w && n < max;
+         w = strtok(NULL, " \t\r\n"))
+        words[n++] = w;
+    return n;
+}
+
+/* Word-level Levenshtein distance. */
+static int
+word_errors(char **ref, int n_ref, char **hyp, int n_hyp)
+{
+    int *d, i, j, prev, rv;
+
+    if ((d = malloc((n_hyp + 1) * sizeof(*d))) == NULL)
+        E_FATAL_SYSTEM("Failed to allocate edit distance row");
+    for (j = 0; j <= n_hyp; ++j)
+        d[j] = j;
+    for (i = 1; i <= n_ref; ++i) {
+        prev = d[0];
+        d[0] = i;
+        for (j = 1; j <= n_hyp; ++j) {
+            int sub = prev + (strcasecmp(ref[i - 1], hyp[j - 1]) != 0);
+            prev = d[j];
+            d[j] = sub;
+            if (d[j - 1] + 1 < d[j])
+                d[j] = d[j - 1] + 1;
+            if (prev + 1 < d[j])
+                d[j] = prev + 1;
+        }
+    }
+    rv = d[n_hyp];
+    free(d);
+
+    return rv;
+}
+
+static void
+read_refs(check_t *c, const char *path)
+{
+    FILE *fh;
+    char line[8192];
+    size_t n_alloc = 0;
+
+    if ((fh = fopen(path, "r")) == NULL)
+        E_FATAL_SYSTEM("Failed to open %s", path);
+    while (fgets(line, sizeof(line), fh)) {
+        char *name, *text;
+
+        if ((name = strtok(line, " \t\r\n")) == NULL)
+            continue;
+        if ((text = strtok(NULL, "\r\n")) == NULL)
+            text = "";
+        if (c->n_refs == n_alloc) {
+            n_alloc = n_alloc ? n_alloc * 2 : 64;
+            if ((c->refs = realloc(c->refs,
+                                   n_alloc * sizeof(*c->refs))) == NULL)
+                E_FATAL_SYSTEM("Failed to allocate references");
+        }
+        c->refs[c->n_refs].name = strdup(name);
+        c->refs[c->n_refs].text = strdup(text);
+        if (c->refs[c->n_refs].name == NULL
+            || c->refs[c->n_refs].text == NULL)
+            E_FATAL_SYSTEM("Failed to allocate references");
+        ++c->n_refs;
+    }
+    fclose(fh);
+}
+
+static const char *
+find_ref(check_t *c, const char *path)
+{
+    const char *base;
+    size_t i, len;
+
+    if ((base = strrchr(path, '/')) != NULL)
+        ++base;
+    else
+        base = path;
+    len = strlen(base);
+    if (len >= 4 && strcasecmp(base + len - 4, ".wav") == 0)
+        len -= 4;
+    for (i = 0; i < c->n_refs; ++i) {
+        if (strlen(c->refs[i].name) == len
+            && strncmp(c->refs[i].name, base, len) == 0)
+            return c->refs[i].text;
+    }
+
+    return NULL;
+}
+
+static int16 *
+read_audio(check_t *c, const char *path, size_t *out_nsamp)
+{
+    ps_config_t *config = c->config[0];
+    FILE *fh;
+    int16 *buf;
+    long start, end;
+
+    if ((fh = fopen(path, "rb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open %s", path);
+        return NULL;
+    }
+    if (ps_config_soundfile(config, fh, path) < 0) {
+        E_ERROR("Unsupported input file %s\n", path);
+        fclose(fh);
+        return NULL;
+    }
+    if (c->samprate == 0)
+        c->samprate = ps_config_int(config, "samprate");
+    else if (ps_config_int(config, "samprate") != c->samprate) {
+        E_ERROR("%s has sampling rate %ld, expected %ld, skipping\n",
+                path, ps_config_int(config, "samprate"), c->samprate);
+        fclose(fh);
+        return NULL;
+    }
+    start = ftell(fh);
+    fseek(fh, 0, SEEK_END);
+    end = ftell(fh);
+    fseek(fh, start, SEEK_SET);
+    if ((buf = malloc(end - start + sizeof(*buf))) == NULL)
+        E_FATAL_SYSTEM("Failed to allocate %ld bytes", end - start);
+    *out_nsamp = fread(buf, sizeof(*buf), (end - start) / sizeof(*buf), fh);
+    fclose(fh);
+
+    return buf;
+}
+
+/* Decodes buf and returns a copy of the hypothesis. */
+static char *
+decode(check_t *c, int mode, const int16 *buf, size_t nsamp)
+{
+    ps_decoder_t *decoder = c->decoder[mode];
+    const char *hyp;
+    char *rv;
+    double cpu, wall;
+    int64 alloc;
+
+    if (ps_start_utt(decoder) < 0)
+        E_FATAL("Failed to start processing\n");
+    if (ps_process_raw(decoder, buf, nsamp, FALSE, TRUE) < 0)
+        E_FATAL("ps_process_raw() failed\n");
+    if (ps_end_utt(decoder) < 0)
+        E_FATAL("Failed to end processing\n");
+    hyp = ps_get_hyp(decoder, NULL);
+    if (ps_get_stage_time(decoder, PS_STAGE_GMM, &cpu, &wall, &alloc) == 0)
+        c->gmm[mode] += cpu;
+    if ((rv = strdup(hyp ? hyp : "")) == NULL)
+        E_FATAL_SYSTEM("Failed to copy hypothesis");
+
+    return rv;
+}
+
+static void
+check_file(check_t *c, const char *path)
+{
+    static char *ref_words[MAX_WORDS], *hyp_words[MAX_WORDS];
+    int16 *buf;
+    size_t nsamp;
+    char *hyp[2], *ref_text;
+    const char *ref;
+    int n_ref, n_hyp, errors[2], i;
+
+    if ((buf = read_audio(c, path, &nsamp)) == NULL)
+        return;
+    /* Now that we know the sampling rate. */
+    for (i = 0; i < 2; ++i) {
+        if (c->decoder[i])
+            continue;
+        ps_config_set_int(c->config[i], "samprate", c->samprate);
+        if ((c->decoder[i] = ps_init(c->config[i])) == NULL)
+            E_FATAL("PocketSphinx decoder init failed\n");
+    }
+    for (i = 0; i < 2; ++i)
+        hyp[i] = decode(c, i, buf, nsamp);
+    free(buf);
+
+    if (c->refs) {
+        if ((ref = find_ref(c, path)) == NULL) {
+            E_ERROR("No reference for %s, skipping\n", path);
+            free(hyp[0]);
+            free(hyp[1]);
+            return;
+        }
+    }
+    else
+        ref = hyp[0];
+    if ((ref_text = strdup(ref)) == NULL)
+        E_FATAL_SYSTEM("Failed to copy reference");
+    n_ref = split_words(ref_text, ref_words, MAX_WORDS);
+    for (i = 0; i < 2; ++i) {
+        char *hyp_text;
+
+        if ((hyp_text = strdup(hyp[i])) == NULL)
+            E_FATAL_SYSTEM("Failed to copy hypothesis");
+        n_hyp = split_words(hyp_text, hyp_words, MAX_WORDS);
+        errors[i] = word_errors(ref_words, n_ref, hyp_words, n_hyp);
+        c->errors[i] += errors[i];
+        free(hyp_text);
+    }
+    free(ref_text);
+    c->n_files++;
+    c->n_words += n_ref;
+
+    printf("%s: %d words, %d float errors, %d quant errors\n",
+           path, n_ref, errors[0], errors[1]);
+    if (errors[0] != errors[1] || strcmp(hyp[0], hyp[1]) != 0) {
+        printf("  float: %s\n", hyp[0]);
+        printf("  quant: %s\n", hyp[1]);
+    }
+    free(hyp[0]);
+    free(hyp[1]);
+}
+
+static void
+check_path(check_t *c, const char *path)
+{
+    struct stat st;
+    DIR *dir;
+    struct dirent *ent;
+    char **names = NULL;
+    size_t i, n = 0, n_alloc = 0;
+
+    if (stat(path, &st) < 0) {
+        E_ERROR_SYSTEM("Failed to stat %s", path);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        check_file(c, path);
+        return;
+    }
+    if ((dir = opendir(path)) == NULL) {
+        E_ERROR_SYSTEM("Failed to open directory %s", path);
+        return;
+    }
+    while ((ent = readdir(dir)) != NULL) {
+        size_t len = strlen(ent->d_name);
+        if (len < 4 || strcasecmp(ent->d_name + len - 4, ".wav") != 0)
+            continue;
+        if (n == n_alloc) {
+            n_alloc = n_alloc ? n_alloc * 2 : 64;
+            if ((names = realloc(names, n_alloc * sizeof(*names))) == NULL)
+                E_FATAL_SYSTEM("Failed to allocate file list");
+        }
+        if ((names[n] = malloc(strlen(path) + len + 2)) == NULL)
+            E_FATAL_SYSTEM("Failed to allocate file name");
+        sprintf(names[n++], "%s/%s", path, ent->d_name);
+    }
+    closedir(dir);
+    qsort(names, n, sizeof(*names), cmp_str);
+    for (i = 0; i < n; ++i) {
+        check_file(c, names[i]);
+        free(names[i]);
+    }
+    free(names);
+}
+
+int
+main(int argc, char *argv[])
+{
+    check_t c;
+    const char *ref_path = NULL;
+    double max_delta = -1, wer[2];
+    int i, j, n_paths, rv;
+
+    memset(&c, 0, sizeof(c));
+    for (j = 0; j < 2; ++j) {
+        c.config[j] = ps_config_init(NULL);
+        ps_config_set_bool(c.config[j], "stagetime", TRUE);
+    }
+
+    /* Our options, then decoder options, then files. */
+    n_paths = 0;
+    for (i = 1; i < argc; ++i) {
+        if (argv[i][0] != '-' || argv[i][1] == '\0') {
+            argv[++n_paths] = argv[i];
+            continue;
+        }
+        if (i + 1 == argc)
+            E_FATAL("Option %s needs a value\n", argv[i]);
+        if (0 == strcmp(argv[i], "-ref"))
+            ref_path = argv[++i];
+        else if (0 == strcmp(argv[i], "-maxdelta")) {
+            if ((max_delta = atof(argv[++i])) < 0)
+                E_FATAL("Invalid WER delta %s\n", argv[i]);
+        }
+        else {
+            for (j = 0; j < 2; ++j) {
+                if (ps_config_set_str(c.config[j], argv[i] + 1,
+                                      argv[i + 1]) == NULL)
+                    E_FATAL("Unknown option %s\n", argv[i]);
+            }
+            ++i;
+        }
+    }
+    if (n_paths == 0)
+        E_FATAL("Usage: %s [-ref FILE] [-maxdelta PCT] [DECODER OPTIONS] "
+                "WAV_OR_DIR...\n", argv[0]);
+    if (ref_path)
+        read_refs(&c, ref_path);
+    ps_config_set_bool(c.config[0], "gauquant", FALSE);
+    ps_config_set_bool(c.config[1], "gauquant", TRUE);
+    /* Fill in whatever models weren't given. */
+    for (j = 0; j < 2; ++j)
+        ps_default_search_args(c.config[j]);
+
+    for (i = 1; i <= n_paths; ++i)
+        check_path(&c, argv[i]);
+
+    printf("\n%d files, %d reference words (%s)\n", c.n_files, c.n_words,
+           ref_path ? ref_path : "float hypotheses");
+    for (j = 0; j < 2; ++j) {
+        wer[j] = c.n_words ? c.errors[j] * 100.0 / c.n_words : 0.0;
+        printf("%s: %d errors, WER %.2f%%, GMM %.3fs CPU\n",
+               mode_names[j], c.errors[j], wer[j], c.gmm[j]);
+    }
+    printf("WER delta %+.2f points\n", wer[1] - wer[0]);
+    rv = 0;
+    if (max_delta >= 0 && wer[1] - wer[0] > max_delta) {
+        E_ERROR("Quantized WER is %.2f points worse than float, "
+                "more than %.2f\n", wer[1] - wer[0], max_delta);
+        rv = 1;
+    }
+
+    for (j = 0; j < 2; ++j) {
+        ps_free(c.decoder[j]);
+        ps_config_free(c.config[j]);
+    }
+    for (i = 0; i < (int)c.n_refs; ++i) {
+        free(c.refs[i].name);
+        free(c.refs[i].text);
+    }
+    free(c.refs);
+
+    return rv;
+}
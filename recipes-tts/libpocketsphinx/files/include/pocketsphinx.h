@@ -50,6 +50,7 @@
  * There are also a few other structures you should be aware of, which
  * can be useful in writing speech applications:
  *
+ * - \ref ps_batch_t
  * - \ref ps_endpointer_t
  * - \ref ps_vad_t
  * - \ref jsgf_t
@@ -80,6 +81,7 @@
 #include <pocketsphinx/lattice.h>
 #include <pocketsphinx/alignment.h>
 #include <pocketsphinx/mllr.h>
+#include <pocketsphinx/batch.h>
 
 /* Namum manglium ii domum */
 #ifdef __cplusplus
@@ -624,6 +626,22 @@ ps_decoder_t *ps_retain(ps_decoder_t *ps);
 POCKETSPHINX_EXPORT
 int ps_free(ps_decoder_t *ps);
 
+/**
+ * Release the models kept by the shared model cache.
+ *
+ * Decoders created with `-model_cache yes` share their model
+ * definition, transition matrices, dictionary and triphone mappings
+ * with other decoders using the same files, and these stay loaded
+ * after the last such decoder is freed so the next one can start
+ * quickly.  This drops the cache's references; models still used by a
+ * decoder are freed along with it.
+ *
+ * Reference counts on shared models are not atomic, so decoders
+ * sharing them must not be created or freed concurrently.
+ */
+POCKETSPHINX_EXPORT
+void ps_model_cache_clear(void);
+
 /**
  * Get the configuration object for this decoder.
  *
@@ -953,6 +971,36 @@ ps_seg_t *ps_seg_iter(ps_decoder_t *ps);
 POCKETSPHINX_EXPORT
 ps_seg_t *ps_seg_next(ps_seg_t *seg);
 
+/**
+ * Get an iterator over the words that have become final.
+ *
+ * While an utterance is being decoded, words at the start of the
+ * partial hypothesis stop changing once every path still being
+ * searched goes through them.  This returns the ones that have done
+ * so since the last call, so that a caller processing audio in blocks
+ * can act on them without waiting for the end of the utterance.
+ * Each word is returned only once.  After ps_end_utt(), it returns
+ * whatever is left of the final hypothesis, then NULL.
+ *
+ * Stable words come from the first pass of the search.  Without the
+ * second pass or bestpath search, all of them put together are
+ * exactly what ps_seg_iter() gives at the end.  With either of them
+ * enabled, the final hypothesis may segment the audio differently
+ * (it has `<s>` and no null transitions, for instance) or choose
+ * other words, so the guarantee is only by time: after ps_end_utt(),
+ * this returns the segments of the final hypothesis that end after
+ * the last stable word.  Only N-Gram and grammar searches track
+ * stable words, others always return NULL.
+ *
+ * @memberof ps_decoder_t
+ * @param ps Decoder.
+ * @return Iterator over newly stable words, or NULL if there are
+ *         none.  Use ps_seg_next() and ps_seg_free() as for
+ *         ps_seg_iter().
+ */
+POCKETSPHINX_EXPORT
+ps_seg_t *ps_stable_seg_iter(ps_decoder_t *ps);
+
 /**
  * Get word string from a segmentation iterator.
  *
@@ -1092,6 +1140,41 @@ POCKETSPHINX_EXPORT
 void ps_get_all_time(ps_decoder_t *ps, double *out_nspeech,
                      double *out_ncpu, double *out_nwall);
 
+/**
+ * Stages of decoding, for ps_get_stage_time().
+ */
+typedef enum ps_stage_e {
+    PS_STAGE_FE,      /**< Front end, from audio to cepstra. */
+    PS_STAGE_FEAT,    /**< Dynamic features and normalization. */
+    PS_STAGE_GMM,     /**< Acoustic (senone) scoring. */
+    PS_STAGE_SEARCH,  /**< Search, not counting acoustic scoring. */
+    PS_STAGE_LATTICE, /**< Hypotheses, segmentations, lattices and N-best lists. */
+    PS_N_STAGE
+} ps_stage_t;
+
+/**
+ * Get performance information for one stage of the current utterance.
+ *
+ * This is only collected if the `stagetime` option is set, since it
+ * reads the clock a few times per frame.  Time spent in a stage
+ * called from another one (such as acoustic scoring from the search)
+ * is only counted in the inner one.
+ *
+ * @memberof ps_decoder_t
+ * @param ps Decoder.
+ * @param stage Stage to get information for.
+ * @param out_ncpu    Output: Number of seconds of CPU time used.
+ * @param out_nwall   Output: Number of seconds of wall time used.
+ * @param out_nalloc  Output: Number of memory allocations made by the
+ *                    calling thread (not counting scoring threads
+ *                    started with `nthreads`).
+ * @return 0, or -1 if `stagetime` is not set or stage is invalid.
+ */
+POCKETSPHINX_EXPORT
+int ps_get_stage_time(ps_decoder_t *ps, ps_stage_t stage,
+                      double *out_ncpu, double *out_nwall,
+                      int64 *out_nalloc);
+
 /**
  * @mainpage PocketSphinx API Documentation
  * @author David Huggins-Daines <dhdaines@gmail.com>
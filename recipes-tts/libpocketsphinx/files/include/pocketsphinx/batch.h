@@ -0,0 +1,153 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/**
+ * @file batch.h
+ * @brief Decoding several streams at once
+ *
+ * A batch is a set of decoders created from the same configuration,
+ * one per input stream, which are advanced in lockstep.  For each
+ * frame, the Gaussians of all the streams are evaluated together in a
+ * single pass over the acoustic model, instead of each stream pulling
+ * the whole model through the cache on its own.  This raises
+ * throughput when decoding many recordings at once.
+ *
+ * Only phonetically-tied (PTM) acoustic models are evaluated together
+ * for now, other models work but are scored stream by stream.  Results
+ * are the same as decoding each stream with its own decoder.
+ */
+
+#ifndef __PS_BATCH_H__
+#define __PS_BATCH_H__
+
+#include <stddef.h>
+
+#include <pocketsphinx/prim_type.h>
+#include <pocketsphinx/export.h>
+#include <pocketsphinx/model.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/**
+ * @struct ps_batch_t pocketsphinx/batch.h
+ * @brief Decoders for several streams sharing acoustic scoring.
+ */
+typedef struct ps_batch_s ps_batch_t;
+
+/* Forward-declare this because header files are an atrocity. */
+typedef struct ps_decoder_s ps_decoder_t;
+
+/**
+ * Create decoders for a batch of streams.
+ *
+ * Setting `-model_cache yes` in the configuration also lets them
+ * share the dictionary and other read-only models.
+ *
+ * @memberof ps_batch_t
+ * @param config Configuration for all the decoders.
+ * @param n_streams Number of streams.
+ * @return Batch, or NULL on failure.
+ */
+POCKETSPHINX_EXPORT
+ps_batch_t *ps_batch_init(ps_config_t *config, int n_streams);
+
+/**
+ * Retain a pointer to a batch.
+ *
+ * @memberof ps_batch_t
+ * @return Batch with incremented reference count.
+ */
+POCKETSPHINX_EXPORT
+ps_batch_t *ps_batch_retain(ps_batch_t *batch);
+
+/**
+ * Release a pointer to a batch.
+ *
+ * @memberof ps_batch_t
+ * @return New reference count (0 if freed).
+ */
+POCKETSPHINX_EXPORT
+int ps_batch_free(ps_batch_t *batch);
+
+/**
+ * Get the number of streams in a batch.
+ *
+ * @memberof ps_batch_t
+ */
+POCKETSPHINX_EXPORT
+int ps_batch_size(ps_batch_t *batch);
+
+/**
+ * Get the decoder for one stream.
+ *
+ * Use it to start and end utterances and get results as usual.  Do
+ * not pass audio to it directly while other streams are being
+ * processed, and do not change its acoustic model (MLLR transforms
+ * are allowed, but that stream is then scored on its own).
+ *
+ * @memberof ps_batch_t
+ * @param stream Index of the stream.
+ * @return Decoder, owned by the batch, or NULL if stream is invalid.
+ */
+POCKETSPHINX_EXPORT
+ps_decoder_t *ps_batch_decoder(ps_batch_t *batch, int stream);
+
+/**
+ * Decode raw audio data for all streams in lockstep.
+ *
+ * Like ps_process_raw() for each stream.  Streams may have different
+ * amounts of audio, or none at all (data may be NULL if n_samples is
+ * 0).  Utterances must have been started with ps_start_utt() on the
+ * streams that have data.
+ *
+ * @memberof ps_batch_t
+ * @param data Audio data for each stream.
+ * @param n_samples Number of samples for each stream.
+ * @param full_utt If non-zero, this block of data is a full
+ *                 utterance for every stream with data.
+ * @return Number of frames of data searched in all streams, or
+ *         <0 for error.
+ */
+POCKETSPHINX_EXPORT
+int ps_batch_process_raw(ps_batch_t *batch,
+                         int16 const **data,
+                         size_t const *n_samples,
+                         int full_utt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PS_BATCH_H__ */
@@ -68,6 +68,27 @@ typedef struct ps_endpointer_s ps_endpointer_t;
  */
 #define PS_ENDPOINTER_DEFAULT_RATIO 0.9
 
+/**
+ * @struct ps_endpointer_span_t pocketsphinx/endpointer.h
+ * @brief Speech found by ps_endpointer_process_block()
+ */
+typedef struct ps_endpointer_span_s {
+    const int16 *pcm;   /**< Speech samples. */
+    size_t nsamp;       /**< Number of samples in pcm. */
+    double start;       /**< Time of the first sample, in seconds. */
+    int flags;          /**< PS_ENDPOINTER_SPAN_START and/or
+                           PS_ENDPOINTER_SPAN_END. */
+} ps_endpointer_span_t;
+
+/**
+ * Flag for a span that begins a speech segment.
+ */
+#define PS_ENDPOINTER_SPAN_START 1
+/**
+ * Flag for a span that ends a speech segment.
+ */
+#define PS_ENDPOINTER_SPAN_END 2
+
 /**
  * Initialize endpointing.
  *
@@ -167,6 +188,42 @@ POCKETSPHINX_EXPORT
 const int16 *ps_endpointer_process(ps_endpointer_t *ep,
                                    const int16 *frame);
 
+/**
+ * Process a block of audio of any length, returning speech in it.
+ *
+ * This classifies every complete frame in pcm and returns the same
+ * audio as calling ps_endpointer_process() on each of them would,
+ * except that instead of one copied frame at a time it comes back as
+ * spans of consecutive samples.  Those lie in pcm itself as far as
+ * possible; only the frames that were held back (up to the window
+ * passed to ps_endpointer_init()) from earlier calls, and a frame
+ * that straddled the previous block, are in storage owned by the
+ * endpointer.  A span never crosses the start or end of a speech
+ * segment, which are marked in its flags.
+ *
+ * Samples that do not make up a whole frame are kept until the next
+ * call, or until ps_endpointer_end_stream() is called with a NULL
+ * frame.  Do not mix this with ps_endpointer_process() while any are
+ * pending.
+ *
+ * @memberof ps_endpointer_t
+ * @param ep Endpointer.
+ * @param pcm Audio data.  The returned spans point into it, so it
+ *            must stay valid and unmodified for as long as they are
+ *            used.
+ * @param nsamp Number of samples in pcm.
+ * @param out_nspans Output, number of spans returned.
+ * @return NULL if no speech available, or array of spans, owned by
+ *         the endpointer.  The array and everything it points to
+ *         (including pcm) are only valid until the next call to an
+ *         endpointer function.
+ */
+POCKETSPHINX_EXPORT
+const ps_endpointer_span_t *
+ps_endpointer_process_block(ps_endpointer_t *ep,
+                            const int16 *pcm, size_t nsamp,
+                            int *out_nspans);
+
 /**
  * Process remaining samples at end of stream.
  *
@@ -176,7 +233,8 @@ const int16 *ps_endpointer_process(ps_endpointer_t *ep,
  * @memberof ps_endpointer_t
  * @param ep Endpointer.
  * @param frame Frame of data, must contain ps_endpointer_frame_size()
- *              samples or less.
+ *              samples or less, or NULL to use the samples left over
+ *              from ps_endpointer_process_block().
  * @param nsamp: Number of samples in frame.
  * @param out_nsamp: Output, number of samples available.
  * @return Pointer to available samples, or NULL if none available.
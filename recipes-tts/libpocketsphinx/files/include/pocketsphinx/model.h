@@ -273,6 +273,10 @@ int fsg_model_free(fsg_model_t *fsg);
  * FSG_BEGIN and FSG_END): any line with a # character in col 1 is treated
  * as a comment line.
  * 
+ * A compiled FSG written by fsg_model_writefile_bin() can also be
+ * given here (and so to the -fsg option), in which case it is mapped
+ * into memory rather than parsed.
+ *
  * Return value: a new fsg_model_t structure if the file is successfully
  * read, NULL otherwise.
  * @memberof fsg_model_t
@@ -311,6 +315,24 @@ void fsg_model_write(fsg_model_t *fsg, FILE *fp);
 POCKETSPHINX_EXPORT
 void fsg_model_writefile(fsg_model_t *fsg, char const *file);
 
+/**
+ * Write FSG to a file in compiled binary form.
+ *
+ * This saves the FSG as it is in memory, including the transitive
+ * closure of its null transitions, and any silence and alternate
+ * pronunciation transitions added by the decoder (for instance, to
+ * one obtained from ps_get_fsg()).  Reading it back with
+ * fsg_model_readfile() skips parsing the grammar and computing the
+ * closure, which can take a long time for grammars with many
+ * optional words.  The file is only meant to be read on machines
+ * with the same byte order.
+ *
+ * @memberof fsg_model_t
+ * @return 0 for success, <0 on error.
+ */
+POCKETSPHINX_EXPORT
+int fsg_model_writefile_bin(fsg_model_t *fsg, char const *file);
+
 /**
  * Write FSG to a file in AT&T FSM format.
  * @memberof fsg_model_t
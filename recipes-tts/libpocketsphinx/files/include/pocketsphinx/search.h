@@ -243,7 +243,10 @@ int ps_add_fsg(ps_decoder_t *ps, const char *name, fsg_model_t *fsg);
 /**
  * Adds new search using JSGF model.
  *
- * Convenient method to load JSGF model and create a search.
+ * Convenient method to load JSGF model and create a search.  If the
+ * -fsgcache option names a directory, the grammar is compiled there
+ * the first time it is loaded, and loaded from there afterwards,
+ * which is much faster.
  *
  * @memberof ps_decoder_t
  * @see ps_add_fsg
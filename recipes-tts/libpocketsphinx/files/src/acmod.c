@@ -55,8 +55,46 @@
 #include "s2_semi_mgau.h"
 #include "ptm_mgau.h"
 #include "ms_mgau.h"
+#include "model_cache.h"
 
-static int32 acmod_process_mfcbuf(acmod_t *acmod);
+static int acmod_log_mfc(acmod_t *acmod, mfcc_t **cep, int n_frames);
+
+static bin_mdef_t *
+acmod_read_mdef(acmod_t *acmod, char const *mdeffn)
+{
+    bin_mdef_t *mdef;
+
+    if (!ps_config_bool(acmod->config, "model_cache"))
+        return bin_mdef_read(acmod->config, mdeffn);
+    if ((mdef = model_cache_get(MODEL_CACHE_MDEF, mdeffn)) != NULL) {
+        E_INFO("Using cached model definition from %s\n", mdeffn);
+        return mdef;
+    }
+    if ((mdef = bin_mdef_read(acmod->config, mdeffn)) == NULL)
+        return NULL;
+    return model_cache_put(MODEL_CACHE_MDEF, mdeffn, mdef);
+}
+
+static tmat_t *
+acmod_read_tmat(acmod_t *acmod, char const *tmatfn)
+{
+    float64 tpfloor = ps_config_float(acmod->config, "tmatfloor");
+    tmat_t *tmat;
+    char *key;
+
+    if (!ps_config_bool(acmod->config, "model_cache"))
+        return tmat_init(tmatfn, acmod->lmath, tpfloor, TRUE);
+    /* Probabilities are stored in the log domain. */
+    key = model_cache_key("%s|%.17g|%.17g", tmatfn, tpfloor,
+                          logmath_get_base(acmod->lmath));
+    if ((tmat = model_cache_get(MODEL_CACHE_TMAT, key)) != NULL)
+        E_INFO("Using cached transition matrices from %s\n", tmatfn);
+    else
+        tmat = model_cache_put(MODEL_CACHE_TMAT, key,
+                               tmat_init(tmatfn, acmod->lmath, tpfloor, TRUE));
+    ckd_free(key);
+    return tmat;
+}
 
 static int
 acmod_init_am(acmod_t *acmod)
@@ -75,7 +113,7 @@ acmod_init_am(acmod_t *acmod)
         return -1;
     }
 
-    if ((acmod->mdef = bin_mdef_read(acmod->config, mdeffn)) == NULL) {
+    if ((acmod->mdef = acmod_read_mdef(acmod, mdeffn)) == NULL) {
         E_ERROR("Failed to read acoustic model definition from %s\n", mdeffn);
         return -1;
     }
@@ -85,9 +123,7 @@ acmod_init_am(acmod_t *acmod)
         E_ERROR("No tmat file specified\n");
         return -1;
     }
-    acmod->tmat = tmat_init(tmatfn, acmod->lmath,
-                            ps_config_float(acmod->config, "tmatfloor"),
-                            TRUE);
+    acmod->tmat = acmod_read_tmat(acmod, tmatfn);
 
     /* Read the acoustic models. */
     if ((ps_config_str(acmod->config, "mean") == NULL)
@@ -118,6 +154,9 @@ acmod_init_am(acmod_t *acmod)
         }
     }
 
+    /* Worker threads for frame evaluation, if any. */
+    acmod->mgau->pool = mgau_pool_init(ps_config_int(acmod->config, "nthreads"));
+
     /* If there is an MLLR transform, apply it. */
     if ((mllrfn = ps_config_str(acmod->config, "mllr"))) {
         ps_mllr_t *mllr = ps_mllr_read(mllrfn);
@@ -197,20 +236,24 @@ acmod_reinit_feat(acmod_t *acmod, fe_t *fe, feat_t *fcb)
         feat_free(acmod->fcb);
     acmod->fcb = fcb;
 
-    /* The MFCC buffer needs to be at least as large as the dynamic
-     * feature window.  */
-    acmod->n_mfc_alloc = acmod->fcb->window_size * 2 + 1;
+    /* Cepstra go straight into the live feature buffer, so mfc_buf
+     * is only allocated for whole utterances. */
     if (acmod->mfc_buf)
         ckd_free_2d(acmod->mfc_buf);
-    acmod->mfc_buf = (mfcc_t **)
-        ckd_calloc_2d(acmod->n_mfc_alloc, acmod->fcb->cepsize,
-                      sizeof(**acmod->mfc_buf));
+    acmod->mfc_buf = NULL;
+    acmod->n_mfc_alloc = 0;
 
-    /* Feature buffer has to be at least as large as MFCC buffer. */
-    acmod->n_feat_alloc = acmod->n_mfc_alloc + ps_config_int(acmod->config, "pl_window");
+    /* Feature buffer has to be at least as large as the dynamic
+     * feature window. */
+    acmod->n_feat_alloc = acmod->fcb->window_size * 2 + 1
+        + ps_config_int(acmod->config, "pl_window");
     if (acmod->feat_buf)
         feat_array_free(acmod->feat_buf);
     acmod->feat_buf = feat_array_alloc(acmod->fcb, acmod->n_feat_alloc);
+    if (acmod->feat_tail)
+        feat_array_free(acmod->feat_tail);
+    acmod->feat_tail = feat_array_alloc(acmod->fcb,
+                                        acmod->fcb->window_size * 2 + 1);
     if (acmod->framepos)
         ckd_free(acmod->framepos);
     acmod->framepos = ckd_calloc(acmod->n_feat_alloc, sizeof(*acmod->framepos));
@@ -273,6 +316,19 @@ acmod_init(ps_config_t *config, logmath_t *lmath, fe_t *fe, feat_t *fcb)
                                                      sizeof(*acmod->senone_active));
     acmod->log_zero = logmath_get_zero(acmod->lmath);
     acmod->compallsen = ps_config_bool(config, "compallsen");
+    acmod->stage_time = ps_config_bool(config, "stagetime");
+    acmod->stage = -1;
+    if (acmod->stage_time) {
+        static const char *names[PS_N_STAGE] = {
+            "fe", "feat", "gmm", "search", "lattice"
+        };
+        int i;
+        ckd_alloc_count_enable(TRUE);
+        for (i = 0; i < PS_N_STAGE; ++i) {
+            acmod->stage_perf[i].name = names[i];
+            ptmr_init(&acmod->stage_perf[i]);
+        }
+    }
     return acmod;
 
 error_out:
@@ -286,6 +342,8 @@ acmod_free(acmod_t *acmod)
     if (acmod == NULL)
         return;
 
+    if (acmod->stage_time)
+        ckd_alloc_count_enable(FALSE);
     feat_free(acmod->fcb);
     fe_free(acmod->fe);
     ps_config_free(acmod->config);
@@ -294,6 +352,8 @@ acmod_free(acmod_t *acmod)
         ckd_free_2d((void **)acmod->mfc_buf);
     if (acmod->feat_buf)
         feat_array_free(acmod->feat_buf);
+    if (acmod->feat_tail)
+        feat_array_free(acmod->feat_tail);
 
     if (acmod->mfcfh)
         fclose(acmod->mfcfh);
@@ -311,8 +371,10 @@ acmod_free(acmod_t *acmod)
         bin_mdef_free(acmod->mdef);
     if (acmod->tmat)
         tmat_free(acmod->tmat);
-    if (acmod->mgau)
+    if (acmod->mgau) {
+        mgau_pool_free(acmod->mgau->pool);
         ps_mgau_free(acmod->mgau);
+    }
     if (acmod->mllr)
         ps_mllr_free(acmod->mllr);
     logmath_free(acmod->lmath);
@@ -409,35 +471,68 @@ acmod_start_utt(acmod_t *acmod)
 {
     fe_start_utt(acmod->fe);
     acmod->state = ACMOD_STARTED;
-    acmod->n_mfc_frame = 0;
     acmod->n_feat_frame = 0;
-    acmod->mfc_outidx = 0;
     acmod->feat_outidx = 0;
     acmod->output_frame = 0;
     acmod->senscr_frame = -1;
     acmod->n_senone_active = 0;
     acmod->mgau->frame_idx = 0;
+    if (acmod->stage_time) {
+        int i;
+        for (i = 0; i < PS_N_STAGE; ++i) {
+            ptmr_reset(&acmod->stage_perf[i]);
+            acmod->stage_alloc[i] = 0;
+        }
+    }
     return 0;
 }
 
+int
+acmod_switch_stage(acmod_t *acmod, int stage)
+{
+    int prev = acmod->stage;
+    int64 n_alloc;
+
+    if (stage == prev)
+        return prev;
+    n_alloc = ckd_alloc_count();
+    if (prev >= 0) {
+        ptmr_stop(&acmod->stage_perf[prev]);
+        acmod->stage_alloc[prev] += n_alloc - acmod->stage_mark;
+    }
+    if (stage >= 0)
+        ptmr_start(&acmod->stage_perf[stage]);
+    acmod->stage_mark = n_alloc;
+    acmod->stage = stage;
+    return prev;
+}
+
 int
 acmod_end_utt(acmod_t *acmod)
 {
-    int32 nfr = 0;
+    mfcc_t **cep;
+    int32 nfr = 0, nfeat, i;
+    int prev_stage;
 
     acmod->state = ACMOD_ENDED;
-    if (acmod->n_mfc_frame < acmod->n_mfc_alloc) {
-        int inptr;
-        /* Where to start writing them (circular buffer) */
-        inptr = (acmod->mfc_outidx + acmod->n_mfc_frame) % acmod->n_mfc_alloc;
-        /* nfr is always either zero or one. */
-        fe_end_utt(acmod->fe, acmod->mfc_buf[inptr], &nfr);
-        acmod->n_mfc_frame += nfr;
-        /* Process whatever's left, and any leadout. */
-        if (nfr)
-            nfr = acmod_process_mfcbuf(acmod);
-        else /* Make sure to update CMN! */
-            feat_update_stats(acmod->fcb);
+    /* nfr is always either zero or one. */
+    if (feat_live_inbuf(acmod->fcb, FALSE, 1, &cep) > 0)
+        fe_end_utt(acmod->fe, cep[0], &nfr);
+    if (nfr) {
+        if (acmod->mfcfh)
+            acmod_log_mfc(acmod, cep, nfr);
+        /* Process whatever's left, and any leadout.  This can wrap
+         * around feat_buf, so it goes through feat_tail. */
+        prev_stage = acmod_enter_stage(acmod, PS_STAGE_FEAT);
+        nfeat = feat_live_process(acmod->fcb, nfr, FALSE, TRUE,
+                                  acmod->feat_tail);
+        /* We have to grow it at the end of an utterance because we
+         * can't return a short read there. */
+        if (nfeat > acmod->n_feat_alloc - acmod->n_feat_frame)
+            acmod_grow_feat_buf(acmod, acmod->n_feat_alloc + nfeat);
+        for (i = 0; i < nfeat; ++i)
+            acmod_process_feat(acmod, acmod->feat_tail[i]);
+        acmod_enter_stage(acmod, prev_stage);
     }
     else /* Make sure to update CMN! */
         feat_update_stats(acmod->fcb);
@@ -499,11 +594,13 @@ acmod_process_full_cep(acmod_t *acmod,
                        int *inout_n_frames)
 {
     int32 nfr;
+    int prev_stage;
 
     /* Write to log file. */
     if (acmod->mfcfh)
         acmod_log_mfc(acmod, *inout_cep, *inout_n_frames);
 
+    prev_stage = acmod_enter_stage(acmod, PS_STAGE_FEAT);
     /* Resize feat_buf to fit. */
     if (acmod->n_feat_alloc < *inout_n_frames) {
 
@@ -524,6 +621,7 @@ acmod_process_full_cep(acmod_t *acmod,
     assert(acmod->n_feat_frame <= acmod->n_feat_alloc);
     *inout_cep += *inout_n_frames;
     *inout_n_frames = 0;
+    acmod_enter_stage(acmod, prev_stage);
     return nfr;
 }
 
@@ -547,8 +645,6 @@ acmod_process_full_raw(acmod_t *acmod,
                                        sizeof(**acmod->mfc_buf));
         acmod->n_mfc_alloc = nfr + 1;
     }
-    acmod->n_mfc_frame = 0;
-    acmod->mfc_outidx = 0;
     fe_start_utt(acmod->fe);
     if (fe_process_frames(acmod->fe, inout_raw, inout_n_samps,
                           acmod->mfc_buf, &nfr) < 0)
@@ -558,113 +654,80 @@ acmod_process_full_raw(acmod_t *acmod,
 
     cepptr = acmod->mfc_buf;
     nfr = acmod_process_full_cep(acmod, &cepptr, &nfr);
-    acmod->n_mfc_frame = 0;
     return nfr;
 }
 
-/**
- * Process MFCCs that are in the internal buffer into features.
- */
-static int32
-acmod_process_mfcbuf(acmod_t *acmod)
-{
-    mfcc_t **mfcptr;
-    int32 ncep;
-
-    ncep = acmod->n_mfc_frame;
-    /* Also do this in two parts because of the circular mfc_buf. */
-    if (acmod->mfc_outidx + ncep > acmod->n_mfc_alloc) {
-        int32 ncep1 = acmod->n_mfc_alloc - acmod->mfc_outidx;
-        int saved_state = acmod->state;
-
-        /* Make sure we don't end the utterance here. */
-        if (acmod->state == ACMOD_ENDED)
-            acmod->state = ACMOD_PROCESSING;
-        mfcptr = acmod->mfc_buf + acmod->mfc_outidx;
-        ncep1 = acmod_process_cep(acmod, &mfcptr, &ncep1, FALSE);
-        /* It's possible that not all available frames were filled. */
-        ncep -= ncep1;
-        acmod->n_mfc_frame -= ncep1;
-        acmod->mfc_outidx += ncep1;
-        acmod->mfc_outidx %= acmod->n_mfc_alloc;
-        /* Restore original state (could this really be the end) */
-        acmod->state = saved_state;
-    }
-    mfcptr = acmod->mfc_buf + acmod->mfc_outidx;
-    ncep = acmod_process_cep(acmod, &mfcptr, &ncep, FALSE);
-    acmod->n_mfc_frame -= ncep;
-    acmod->mfc_outidx += ncep;
-    acmod->mfc_outidx %= acmod->n_mfc_alloc;
-    return ncep;
-}
-
 int
 acmod_process_raw(acmod_t *acmod,
                   int16 const **inout_raw,
                   size_t *inout_n_samps,
                   int full_utt)
 {
-    int32 ncep;
+    int32 total = 0;
 
     /* If this is a full utterance, process it all at once. */
     if (full_utt)
         return acmod_process_full_raw(acmod, inout_raw, inout_n_samps);
 
-    /* Append MFCCs to the end of any that are previously in there
-     * (in practice, there will probably be none) */
-    if (inout_n_samps && *inout_n_samps) {
+    /* The front end writes into the live buffer in the feature
+     * computation, where the cepstra are normalized and turned into
+     * dynamic features in place.  Both the input and feat_buf are
+     * circular, so this may take a few rounds. */
+    while (inout_n_samps && *inout_n_samps) {
         int16 const *prev_audio_inptr = *inout_raw;
-        int inptr;
-
-        /* Total number of frames available. */
-        ncep = acmod->n_mfc_alloc - acmod->n_mfc_frame;
-        /* Where to start writing them (circular buffer) */
-        inptr = (acmod->mfc_outidx + acmod->n_mfc_frame) % acmod->n_mfc_alloc;
-
-        /* Write them in two (or more) parts if there is wraparound. */
-        while (inptr + ncep > acmod->n_mfc_alloc) {
-            int32 ncep1 = acmod->n_mfc_alloc - inptr;
-            if (fe_process_frames(acmod->fe, inout_raw, inout_n_samps,
-                                  acmod->mfc_buf + inptr, &ncep1) < 0)
-                return -1;
-            /* Write to logging file if any. */
-            if (acmod->rawfh) {
-                fwrite(prev_audio_inptr, 2,
-                       *inout_raw - prev_audio_inptr,
-                       acmod->rawfh);
-                prev_audio_inptr = *inout_raw;
-            }
-            /* ncep1 now contains the number of frames actually
-             * processed.  This is a good thing, but it means we
-             * actually still might have some room left at the end of
-             * the buffer, hence the while loop.  Unfortunately it
-             * also means that in the case where we are really
-             * actually done, we need to get out totally, hence the
-             * goto. */
-            acmod->n_mfc_frame += ncep1;
-            ncep -= ncep1;
-            inptr += ncep1;
-            inptr %= acmod->n_mfc_alloc;
-            if (ncep1 == 0)
-        	goto alldone;
+        int beginutt = (acmod->state == ACMOD_STARTED);
+        mfcc_t **cep;
+        int32 ncep, nfeat, maxfeat, inptr;
+        int prev_stage;
+
+        /* Where to start writing features, and how many fit there
+         * without wraparound. */
+        if (acmod->grow_feat) {
+            /* Grow to avoid wraparound if grow_feat == TRUE. */
+            fe_process_frames(acmod->fe, inout_raw, inout_n_samps,
+                              NULL, &ncep);
+            inptr = acmod->feat_outidx + acmod->n_feat_frame;
+            while (inptr + ncep >= acmod->n_feat_alloc)
+                acmod_grow_feat_buf(acmod, acmod->n_feat_alloc * 2);
+            maxfeat = acmod->n_feat_alloc - inptr - 1;
         }
-        assert(inptr + ncep <= acmod->n_mfc_alloc);
+        else {
+            inptr = (acmod->feat_outidx + acmod->n_feat_frame)
+                % acmod->n_feat_alloc;
+            /* The rest of feat_buf holds frames that the search may
+             * still look back at (see acmod_reinit_feat()). */
+            maxfeat = acmod->fcb->window_size * 2 + 1 - acmod->n_feat_frame;
+            if (maxfeat > acmod->n_feat_alloc - inptr)
+                maxfeat = acmod->n_feat_alloc - inptr;
+        }
+
+        ncep = feat_live_inbuf(acmod->fcb, beginutt, maxfeat, &cep);
+        if (ncep == 0)
+            break;
         if (fe_process_frames(acmod->fe, inout_raw, inout_n_samps,
-                              acmod->mfc_buf + inptr, &ncep) < 0)
+                              cep, &ncep) < 0)
             return -1;
         /* Write to logging file if any. */
-        if (acmod->rawfh) {
+        if (acmod->rawfh)
             fwrite(prev_audio_inptr, 2,
                    *inout_raw - prev_audio_inptr, acmod->rawfh);
-            prev_audio_inptr = *inout_raw;
-        }
-        acmod->n_mfc_frame += ncep;
-    alldone:
-        ;
+        if (ncep == 0)
+            break;
+        if (acmod->mfcfh)
+            acmod_log_mfc(acmod, cep, ncep);
+
+        prev_stage = acmod_enter_stage(acmod, PS_STAGE_FEAT);
+        nfeat = feat_live_process(acmod->fcb, ncep, beginutt, FALSE,
+                                  acmod->feat_buf + inptr);
+        acmod_enter_stage(acmod, prev_stage);
+        acmod->n_feat_frame += nfeat;
+        assert(acmod->n_feat_frame <= acmod->n_feat_alloc);
+        if (acmod->state == ACMOD_STARTED)
+            acmod->state = ACMOD_PROCESSING;
+        total += ncep;
     }
 
-    /* Hand things off to acmod_process_cep. */
-    return acmod_process_mfcbuf(acmod);
+    return total;
 }
 
 int
@@ -757,7 +820,9 @@ acmod_process_cep(acmod_t *acmod,
     /* Move the input feature pointers forward. */
     *inout_n_frames -= ncep;
     *inout_cep += ncep;
-    if (acmod->state == ACMOD_STARTED)
+    /* Stay at the start of the utterance until some input actually
+     * arrives, otherwise the first frame will not get replicated. */
+    if (acmod->state == ACMOD_STARTED && orig_n_frames > *inout_n_frames)
         acmod->state = ACMOD_PROCESSING;
     return orig_n_frames - *inout_n_frames;
 }
@@ -1101,6 +1166,8 @@ acmod_score(acmod_t *acmod, int *inout_frame_idx)
             return NULL;
     }
     else {
+        int prev_stage = acmod_enter_stage(acmod, PS_STAGE_GMM);
+
         /* Build active senone list. */
         acmod_flags2list(acmod);
 
@@ -1112,6 +1179,7 @@ acmod_score(acmod_t *acmod, int *inout_frame_idx)
                            acmod->feat_buf[feat_idx],
                            frame_idx,
                            acmod->compallsen);
+        acmod_enter_stage(acmod, prev_stage);
     }
 
     if (inout_frame_idx)
@@ -1132,6 +1200,47 @@ acmod_score(acmod_t *acmod, int *inout_frame_idx)
     return acmod->senone_scores;
 }
 
+int
+acmod_batch_eval(acmod_t **acmods, int n)
+{
+    ps_mgau_t **mgau;
+    mfcc_t ***feat;
+    int32 *frame;
+    int i, n_batch, rv;
+
+    mgau = ckd_calloc(n, sizeof(*mgau));
+    feat = ckd_calloc(n, sizeof(*feat));
+    frame = ckd_calloc(n, sizeof(*frame));
+    for (n_batch = i = 0; i < n; ++i) {
+        acmod_t *acmod = acmods[i];
+        int feat_idx;
+
+        if (acmod->insenfh || acmod->mllr
+            || acmod->n_feat_frame == 0
+            || acmod->senscr_frame == acmod->output_frame
+            || acmod->mgau->vt->batch_eval == NULL)
+            continue;
+        if (n_batch > 0 && acmod->mgau->vt != mgau[0]->vt)
+            continue;
+        if ((feat_idx = calc_feat_idx(acmod, acmod->output_frame)) < 0)
+            continue;
+        mgau[n_batch] = acmod->mgau;
+        feat[n_batch] = acmod->feat_buf[feat_idx];
+        frame[n_batch] = acmod->output_frame;
+        ++n_batch;
+    }
+
+    /* Evaluating every codebook for a single model is just extra work. */
+    rv = 0;
+    if (n_batch > 1)
+        rv = ps_mgau_batch_eval(mgau, feat, frame, n_batch);
+    ckd_free(mgau);
+    ckd_free(feat);
+    ckd_free(frame);
+
+    return rv;
+}
+
 int
 acmod_best_score(acmod_t *acmod, int *out_best_senid)
 {
@@ -50,9 +50,11 @@
 #include "fe/fe.h"
 #include "feat/feat.h"
 #include "util/bitvec.h"
+#include "util/profile.h"
 #include "bin_mdef.h"
 #include "tmat.h"
 #include "hmm.h"
+#include "mgau_pool.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -108,11 +110,20 @@ typedef struct ps_mgaufuncs_s {
     int (*transform)(ps_mgau_t *mgau,
                      ps_mllr_t *mllr);
     void (*free)(ps_mgau_t *mgau);
+    /* Evaluate Gaussians for the newest frame of n models with the
+     * same parameters as mgau[0], in one pass over them.  The next
+     * frame_eval() for each frame then only computes senone scores.
+     * NULL if not supported. */
+    int (*batch_eval)(ps_mgau_t **mgau,
+                      mfcc_t ***feat,
+                      int32 const *frame,
+                      int32 n);
 } ps_mgaufuncs_t;    
 
 struct ps_mgau_s {
     ps_mgaufuncs_t *vt;  /**< vtable of mgau functions. */
     int frame_idx;       /**< frame counter. */
+    mgau_pool_t *pool;   /**< Worker threads, NULL for single-threaded. */
 };
 
 #define ps_mgau_base(mg) ((ps_mgau_t *)(mg))
@@ -123,6 +134,8 @@ struct ps_mgau_s {
     (*ps_mgau_base(mg)->vt->transform)(mg, mllr)
 #define ps_mgau_free(mg)                                  \
     (*ps_mgau_base(mg)->vt->free)(mg)
+#define ps_mgau_batch_eval(mg, feat, frame, n)                       \
+    (*ps_mgau_base((mg)[0])->vt->batch_eval)(mg, feat, frame, n)
 
 /**
  * Acoustic model structure.
@@ -170,8 +183,9 @@ struct acmod_s {
     int log_zero;              /**< Zero log-probability value. */
 
     /* Utterance processing: */
-    mfcc_t **mfc_buf;   /**< Temporary buffer of acoustic features. */
+    mfcc_t **mfc_buf;   /**< Acoustic features for a whole utterance. */
     mfcc_t ***feat_buf; /**< Temporary buffer of dynamic features. */
+    mfcc_t ***feat_tail; /**< Dynamic features from the end of utterance. */
     FILE *rawfh;        /**< File for writing raw audio data. */
     FILE *mfcfh;        /**< File for writing acoustic feature data. */
     FILE *senfh;        /**< File for writing senone score data. */
@@ -186,11 +200,16 @@ struct acmod_s {
 
     frame_idx_t output_frame; /**< Index of next frame of dynamic features. */
     frame_idx_t n_mfc_alloc;  /**< Number of frames allocated in mfc_buf */
-    frame_idx_t n_mfc_frame;  /**< Number of frames active in mfc_buf */
-    frame_idx_t mfc_outidx;   /**< Start of active frames in mfc_buf */
     frame_idx_t n_feat_alloc; /**< Number of frames allocated in feat_buf */
     frame_idx_t n_feat_frame; /**< Number of frames active in feat_buf */
     frame_idx_t feat_outidx;  /**< Start of active frames in feat_buf */
+
+    /* Profiling, see ps_get_stage_time(): */
+    uint8 stage_time;         /**< Are stages being timed? */
+    int8 stage;               /**< Stage being timed, or -1 for none. */
+    int64 stage_mark;         /**< ckd_alloc_count() when it started. */
+    ptmr_t stage_perf[PS_N_STAGE]; /**< Time spent in each stage. */
+    int64 stage_alloc[PS_N_STAGE]; /**< Allocations made in each stage. */
 };
 typedef struct acmod_s acmod_t;
 
@@ -280,6 +299,16 @@ int acmod_set_rawfh(acmod_t *acmod, FILE *logfh);
  */
 void acmod_free(acmod_t *acmod);
 
+/**
+ * Charge time and allocations to a different stage when profiling.
+ *
+ * @param stage New stage, or -1 for none.
+ * @return Previous stage, to switch back to when done.
+ */
+#define acmod_enter_stage(acmod, st)                                    \
+    ((acmod)->stage_time ? acmod_switch_stage((acmod), (st)) : -1)
+int acmod_switch_stage(acmod_t *acmod, int stage);
+
 /**
  * Mark the start of an utterance.
  */
@@ -423,6 +452,20 @@ mfcc_t **acmod_get_frame(acmod_t *acmod, int *inout_frame_idx);
 int16 const *acmod_score(acmod_t *acmod,
                          int *inout_frame_idx);
 
+/**
+ * Evaluate the Gaussians for the next frame of several acoustic
+ * models at once.
+ *
+ * Models must have been loaded from the same files.  Their Gaussians
+ * are evaluated in one pass over the parameters of the first one, and
+ * the following acmod_score() for each only has to do the rest.  The
+ * scores are the same as without this.  Models with MLLR transforms,
+ * senone score input files or no frame ready are left out.
+ *
+ * @return 0 for success, <0 for failure.
+ */
+int acmod_batch_eval(acmod_t **acmods, int n);
+
 /**
  * Write senone dump file header.
  */
@@ -139,6 +139,7 @@ static ps_searchfuncs_t allphone_funcs = {
     /* hyp: */ allphone_search_hyp,
     /* prob: */ allphone_search_prob,
     /* seg_iter: */ allphone_search_seg_iter,
+    /* stable_seg_iter: */ NULL,
 };
 
 /**
@@ -57,6 +57,7 @@
 #include "util/case.h"
 #include "mdef.h"
 #include "bin_mdef.h"
+#include "model_cache.h"
 
 bin_mdef_t *
 bin_mdef_read_text(ps_config_t *config, const char *filename)
@@ -264,17 +265,19 @@ bin_mdef_read_text(ps_config_t *config, const char *filename)
 bin_mdef_t *
 bin_mdef_retain(bin_mdef_t *m)
 {
-    ++m->refcnt;
+    model_cache_ref(m->refcnt);
     return m;
 }
 
 int
 bin_mdef_free(bin_mdef_t * m)
 {
+    int rc;
+
     if (m == NULL)
         return 0;
-    if (--m->refcnt > 0)
-        return m->refcnt;
+    if ((rc = model_cache_unref(m->refcnt)) > 0)
+        return rc;
 
     switch (m->alloc_mode) {
     case BIN_MDEF_FROM_TEXT:
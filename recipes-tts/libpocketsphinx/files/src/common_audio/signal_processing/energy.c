@@ -17,18 +17,68 @@
 
 #include "common_audio/signal_processing/include/signal_processing_library.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SPL_ENERGY_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define SPL_ENERGY_SSE2
+#include <emmintrin.h>
+#endif
+
 int32_t WebRtcSpl_Energy(int16_t* vector,
                          size_t vector_length,
                          int* scale_factor)
 {
     int32_t en = 0;
-    size_t i;
+    size_t i = 0;
     int scaling =
         WebRtcSpl_GetScalingSquare(vector, vector_length, vector_length);
     size_t looptimes = vector_length;
     int16_t *vectorptr = vector;
 
-    for (i = 0; i < looptimes; i++)
+    // Each square is shifted before it is added, exactly like the loop
+    // below, so 8 at a time gives the same (wrapping) sum.
+#if defined(SPL_ENERGY_NEON)
+    {
+        int32x4_t acc = vdupq_n_s32(0);
+        const int32x4_t shift = vdupq_n_s32(-scaling);
+        int32x2_t sum;
+
+        for (; i + 8 <= looptimes; i += 8)
+        {
+            int16x8_t x = vld1q_s16(vectorptr);
+            int16x4_t x_lo = vget_low_s16(x);
+            int16x4_t x_hi = vget_high_s16(x);
+            acc = vaddq_s32(acc, vshlq_s32(vmull_s16(x_lo, x_lo), shift));
+            acc = vaddq_s32(acc, vshlq_s32(vmull_s16(x_hi, x_hi), shift));
+            vectorptr += 8;
+        }
+        sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+        en = vget_lane_s32(vpadd_s32(sum, sum), 0);
+    }
+#elif defined(SPL_ENERGY_SSE2)
+    {
+        __m128i acc = _mm_setzero_si128();
+        const __m128i shift = _mm_cvtsi32_si128(scaling);
+
+        for (; i + 8 <= looptimes; i += 8)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)vectorptr);
+            __m128i lo = _mm_mullo_epi16(x, x);
+            __m128i hi = _mm_mulhi_epi16(x, x);
+            acc = _mm_add_epi32(acc,
+                                _mm_sra_epi32(_mm_unpacklo_epi16(lo, hi), shift));
+            acc = _mm_add_epi32(acc,
+                                _mm_sra_epi32(_mm_unpackhi_epi16(lo, hi), shift));
+            vectorptr += 8;
+        }
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        en = _mm_cvtsi128_si32(acc);
+    }
+#endif
+
+    for (; i < looptimes; i++)
     {
       en += (*vectorptr * *vectorptr) >> scaling;
       vectorptr++;
@@ -17,6 +17,14 @@
 
 #include "common_audio/signal_processing/include/signal_processing_library.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SPL_SCALING_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define SPL_SCALING_SSE2
+#include <emmintrin.h>
+#endif
+
 int16_t WebRtcSpl_GetScalingSquare(int16_t* in_vector,
                                    size_t in_vector_length,
                                    size_t times)
@@ -29,6 +37,41 @@ int16_t WebRtcSpl_GetScalingSquare(int16_t* in_vector,
     int16_t t;
     size_t looptimes = in_vector_length;
 
+    // The absolute value wraps around to -32768 for -32768 here just as it
+    // does below, so that is ignored the same way.
+#if defined(SPL_SCALING_NEON)
+    {
+        int16x8_t vmax = vdupq_n_s16(-1);
+        int16x4_t m;
+
+        for (; looptimes >= 8; looptimes -= 8)
+        {
+            vmax = vmaxq_s16(vmax, vabsq_s16(vld1q_s16(sptr)));
+            sptr += 8;
+        }
+        m = vmax_s16(vget_low_s16(vmax), vget_high_s16(vmax));
+        m = vpmax_s16(m, m);
+        m = vpmax_s16(m, m);
+        smax = vget_lane_s16(m, 0);
+    }
+#elif defined(SPL_SCALING_SSE2)
+    {
+        __m128i vmax = _mm_set1_epi16(-1);
+
+        for (; looptimes >= 8; looptimes -= 8)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)sptr);
+            __m128i nx = _mm_sub_epi16(_mm_setzero_si128(), x);
+            vmax = _mm_max_epi16(vmax, _mm_max_epi16(x, nx));
+            sptr += 8;
+        }
+        vmax = _mm_max_epi16(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+        vmax = _mm_max_epi16(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+        vmax = _mm_max_epi16(vmax, _mm_shufflelo_epi16(vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+        smax = (int16_t)_mm_cvtsi128_si32(vmax);
+    }
+#endif
+
     for (i = looptimes; i > 0; i--)
     {
         sabs = (*sptr > 0 ? *sptr++ : -*sptr++);
@@ -69,44 +69,22 @@ static void HighPassFilter(const int16_t* data_in, size_t data_length,
   }
 }
 
-// All pass filtering of `data_in`, used before splitting the signal into two
-// frequency bands (low pass vs high pass).
-// Note that `data_in` and `data_out` can NOT correspond to the same address.
-//
-// - data_in            [i]   : Input audio signal given in Q0.
-// - data_length        [i]   : Length of input and output data.
-// - filter_coefficient [i]   : Given in Q15.
-// - filter_state       [i/o] : State of the filter given in Q(-1).
-// - data_out           [o]   : Output audio signal given in Q(-1).
-static void AllPassFilter(const int16_t* data_in, size_t data_length,
-                          int16_t filter_coefficient, int16_t* filter_state,
-                          int16_t* data_out) {
-  // The filter can only cause overflow (in the w16 output variable)
-  // if more than 4 consecutive input numbers are of maximum value and
-  // has the the same sign as the impulse responses first taps.
-  // First 6 taps of the impulse response:
-  // 0.6399 0.5905 -0.3779 0.2418 -0.1547 0.0990
-
-  size_t i;
-  int16_t tmp16 = 0;
-  int32_t tmp32 = 0;
-  int32_t state32 = ((int32_t) (*filter_state) * (1 << 16));  // Q15
-
-  for (i = 0; i < data_length; i++) {
-    tmp32 = state32 + filter_coefficient * *data_in;
-    tmp16 = (int16_t) (tmp32 >> 16);  // Q(-1)
-    *data_out++ = tmp16;
-    state32 = (*data_in * (1 << 14)) - filter_coefficient * tmp16;  // Q14
-    state32 *= 2;  // Q15.
-    data_in += 2;
-  }
-
-  *filter_state = (int16_t) (state32 >> 16);  // Q(-1)
-}
-
 // Splits `data_in` into `hp_data_out` and `lp_data_out` corresponding to
 // an upper (high pass) part and a lower (low pass) part respectively.
 //
+// Even samples go through the upper all-pass filter and odd ones through the
+// lower, each a first order recursion that truncates to Q(-1) at every step,
+// so neither can be computed several samples at a time without changing the
+// result. They are independent of each other though, so they are run side by
+// side in one loop, together with making the LP and HP signals, which lets the
+// two dependency chains overlap instead of running one after the other.
+//
+// The filters can only cause overflow (in the 16 bit outputs) if more than 4
+// consecutive input numbers are of maximum value and have the same sign as
+// the impulse response's first taps.
+// First 6 taps of the impulse response:
+// 0.6399 0.5905 -0.3779 0.2418 -0.1547 0.0990
+//
 // - data_in      [i]   : Input audio data to be split into two frequency bands.
 // - data_length  [i]   : Length of `data_in`.
 // - upper_state  [i/o] : State of the upper filter, given in Q(-1).
@@ -120,22 +98,30 @@ static void SplitFilter(const int16_t* data_in, size_t data_length,
                         int16_t* hp_data_out, int16_t* lp_data_out) {
   size_t i;
   size_t half_length = data_length >> 1;  // Downsampling by 2.
-  int16_t tmp_out;
-
-  // All-pass filtering upper branch.
-  AllPassFilter(&data_in[0], half_length, kAllPassCoefsQ15[0], upper_state,
-                hp_data_out);
+  const int16_t upper_coef = kAllPassCoefsQ15[0];
+  const int16_t lower_coef = kAllPassCoefsQ15[1];
+  int32_t upper32 = ((int32_t) (*upper_state) * (1 << 16));  // Q15
+  int32_t lower32 = ((int32_t) (*lower_state) * (1 << 16));  // Q15
+  int16_t upper16, lower16;
 
-  // All-pass filtering lower branch.
-  AllPassFilter(&data_in[1], half_length, kAllPassCoefsQ15[1], lower_state,
-                lp_data_out);
-
-  // Make LP and HP signals.
   for (i = 0; i < half_length; i++) {
-    tmp_out = *hp_data_out;
-    *hp_data_out++ -= *lp_data_out;
-    *lp_data_out++ += tmp_out;
+    const int16_t upper_in = data_in[0];
+    const int16_t lower_in = data_in[1];
+
+    // All-pass filtering upper and lower branch.
+    upper16 = (int16_t) ((upper32 + upper_coef * upper_in) >> 16);  // Q(-1)
+    lower16 = (int16_t) ((lower32 + lower_coef * lower_in) >> 16);  // Q(-1)
+    upper32 = ((upper_in * (1 << 14)) - upper_coef * upper16) * 2;  // Q15
+    lower32 = ((lower_in * (1 << 14)) - lower_coef * lower16) * 2;  // Q15
+    data_in += 2;
+
+    // Make LP and HP signals.
+    *hp_data_out++ = upper16 - lower16;
+    *lp_data_out++ = lower16 + upper16;
   }
+
+  *upper_state = (int16_t) (upper32 >> 16);  // Q(-1)
+  *lower_state = (int16_t) (lower32 >> 16);  // Q(-1)
 }
 
 // Calculates the energy of `data_in` in dB, and also updates an overall
@@ -33,19 +33,23 @@ void WebRtcVad_Downsampling(const int16_t* signal_in,
   // Downsampling by 2 gives half length.
   size_t half_length = (in_length >> 1);
 
-  // Filter coefficients in Q13, filter state in Q0.
+  // Filter coefficients in Q13, filter state in Q0. Both inputs are loaded
+  // before the output is stored, as the two may alias, which lets the two
+  // branches overlap rather than wait for each other.
   for (n = 0; n < half_length; n++) {
+    const int16_t in_1 = signal_in[0];
+    const int16_t in_2 = signal_in[1];
+    signal_in += 2;
+
     // All-pass filtering upper branch.
-    tmp16_1 = (int16_t) ((tmp32_1 >> 1) +
-        ((kAllPassCoefsQ13[0] * *signal_in) >> 14));
-    *signal_out = tmp16_1;
-    tmp32_1 = (int32_t)(*signal_in++) - ((kAllPassCoefsQ13[0] * tmp16_1) >> 12);
+    tmp16_1 = (int16_t) ((tmp32_1 >> 1) + ((kAllPassCoefsQ13[0] * in_1) >> 14));
+    tmp32_1 = (int32_t)in_1 - ((kAllPassCoefsQ13[0] * tmp16_1) >> 12);
 
     // All-pass filtering lower branch.
-    tmp16_2 = (int16_t) ((tmp32_2 >> 1) +
-        ((kAllPassCoefsQ13[1] * *signal_in) >> 14));
-    *signal_out++ += tmp16_2;
-    tmp32_2 = (int32_t)(*signal_in++) - ((kAllPassCoefsQ13[1] * tmp16_2) >> 12);
+    tmp16_2 = (int16_t) ((tmp32_2 >> 1) + ((kAllPassCoefsQ13[1] * in_2) >> 14));
+    tmp32_2 = (int32_t)in_2 - ((kAllPassCoefsQ13[1] * tmp16_2) >> 12);
+
+    *signal_out++ = tmp16_1 + tmp16_2;
   }
   // Store the filter states.
   filter_state[0] = tmp32_1;
@@ -166,6 +166,10 @@
       ARG_BOOLEAN,                                                                              \
       "no",                                                                                     \
       "Print results and backtraces to log." },                                                 \
+{ "stagetime",                                                                                 \
+      ARG_BOOLEAN,                                                                              \
+      "no",                                                                                     \
+      "Collect time and allocation counts for each stage of decoding" },                        \
 { "latsize",                                                                                   \
       ARG_INTEGER,                                                                                \
       "5000",                                                                                   \
@@ -228,6 +232,10 @@
         ARG_STRING,                                             \
         NULL,                                                   \
         "Start rule for JSGF (first public rule is default)" }, \
+{ "fsgcache",                                                  \
+        ARG_STRING,                                             \
+        NULL,                                                   \
+        "Directory for compiled JSGF grammars, reused when the same grammar is loaded again" }, \
 { "fsgusealtpron",                                             \
         ARG_BOOLEAN,                                            \
         "yes",                                                  \
@@ -313,7 +321,11 @@
     { "dictcase",						\
       ARG_BOOLEAN,						\
       "no",							\
-      "Dictionary is case sensitive (NOTE: case insensitivity applies to ASCII characters only)" }	\
+      "Dictionary is case sensitive (NOTE: case insensitivity applies to ASCII characters only)" },	\
+    { "dictcache",						\
+      ARG_STRING,						\
+      NULL,							\
+      "Compiled dictionary file, rebuilt from -dict and -fdict when out of date" }	\
 
 /** Command-line options for acoustic modeling */
 #define POCKETSPHINX_ACMOD_OPTIONS \
@@ -377,18 +389,38 @@
       ARG_BOOLEAN,                                                              \
       "yes",                                                                    \
       "Use memory-mapped I/O (if possible) for model files" },                  \
+{ "model_cache",                                                               \
+      ARG_BOOLEAN,                                                              \
+      "no",                                                                     \
+      "Share read-only models with other decoders and keep them loaded" },      \
 { "ds",                                                                        \
       ARG_INTEGER,                                                                \
       "1",                                                                      \
       "Frame GMM computation downsampling ratio" },                             \
+{ "dsthresh",                                                                  \
+      ARG_FLOATING,                                                             \
+      "0",                                                                      \
+      "Reuse GMM scores while the cepstrum stays within this distance of the last frame computed in full (0 to disable)" }, \
+{ "dsmax",                                                                     \
+      ARG_INTEGER,                                                              \
+      "3",                                                                      \
+      "Maximum number of frames in a row to reuse GMM scores for with -dsthresh" }, \
 { "topn",                                                                      \
       ARG_INTEGER,                                                                \
       "4",                                                                      \
       "Maximum number of top Gaussians to use in scoring." },                   \
+{ "gauquant",                                                                  \
+      ARG_BOOLEAN,                                                              \
+      "no",                                                                     \
+      "Use 8-bit quantized Gaussian means and variances (PTM models only)" },   \
 { "topn_beam",                                                                 \
       ARG_STRING,                                                               \
       "0",                                                                     \
       "Beam width used to determine top-N Gaussians (or a list, per-feature)" },\
+{ "nthreads",                                                                  \
+      ARG_INTEGER,                                                              \
+      "1",                                                                      \
+      "Number of threads used to compute acoustic scores and load ARPA models" },\
 { "logbase",                                                                   \
       ARG_FLOATING,                                                              \
       "1.0001",                                                                 \
@@ -41,6 +41,8 @@
 #include "util/ckd_alloc.h"
 #include "util/strfuncs.h"
 #include "dict.h"
+#include "dict_cache.h"
+#include "model_cache.h"
 
 
 #define DELIM	" \t\n"         /* Set of field separator characters */
@@ -100,7 +102,7 @@ dict_add_word(dict_t * d, char const *word, s3cipid_t const * p, int32 np)
         int32 w;
 
         /* Truncated to a baseword string; find its ID */
-        if (hash_table_lookup_int32(d->ht, wword, &w) < 0) {
+        if ((w = dict_wordid(d, wword)) == BAD_S3WID) {
             E_ERROR("Missing base word for: %s\n", word);
             ckd_free(wword);
             ckd_free(wordp->word);
@@ -119,7 +121,8 @@ dict_add_word(dict_t * d, char const *word, s3cipid_t const * p, int32 np)
     ckd_free(wword);
 
     /* Associate word string with d->n_word in hash table */
-    if (hash_table_enter_int32(d->ht, wordp->word, d->n_word) != d->n_word) {
+    if (dict_cache_wordid(d, wordp->word) != BAD_S3WID
+        || hash_table_enter_int32(d->ht, wordp->word, d->n_word) != d->n_word) {
         ckd_free(wordp->word);
         wordp->word = NULL;
         return BAD_S3WID;
@@ -401,6 +404,8 @@ dict_wordid(dict_t *d, const char *word)
     assert(d);
     assert(word);
 
+    if ((w = dict_cache_wordid(d, word)) != BAD_S3WID)
+        return w;
     if (hash_table_lookup_int32(d->ht, word, &w) < 0)
         return (BAD_S3WID);
     return w;
@@ -458,7 +463,7 @@ dict_word2basestr(char *word)
 dict_t *
 dict_retain(dict_t *d)
 {
-    ++d->refcnt;
+    model_cache_ref(d->refcnt);
     return d;
 }
 
@@ -466,15 +471,17 @@ int
 dict_free(dict_t * d)
 {
     int i;
+    int rc;
     dictword_t *word;
 
     if (d == NULL)
         return 0;
-    if (--d->refcnt > 0)
-        return d->refcnt;
+    if ((rc = model_cache_unref(d->refcnt)) > 0)
+        return rc;
 
-    /* First Step, free all memory allocated for each word */
-    for (i = 0; i < d->n_word; i++) {
+    /* First Step, free all memory allocated for each word (those
+     * from a compiled dictionary are in its file map) */
+    for (i = d->n_mapped; i < d->n_word; i++) {
         word = (dictword_t *) & (d->word[i]);
         if (word->word)
             ckd_free((void *) word->word);
@@ -486,6 +493,8 @@ dict_free(dict_t * d)
         ckd_free((void *) d->word);
     if (d->ht)
         hash_table_free(d->ht);
+    if (d->filemap)
+        mmio_file_unmap(d->filemap);
     if (d->mdef)
         bin_mdef_free(d->mdef);
     ckd_free((void *) d);
@@ -47,6 +47,7 @@
 #include "s3types.h"
 #include "bin_mdef.h"
 #include "util/hash_table.h"
+#include "util/mmio.h"
 #include "pocketsphinx/export.h"
 
 #define S3DICT_INC_SZ 4096
@@ -88,6 +89,10 @@ typedef struct dict_s {
     s3wid_t finishwid;	/**< FOR INTERNAL-USE ONLY */
     s3wid_t silwid;	/**< FOR INTERNAL-USE ONLY */
     int nocase;
+    mmio_file_t *filemap; /**< Compiled dictionary (see dict_cache.h), or NULL */
+    int32 n_mapped;	/**< Words whose strings and phones are in filemap */
+    int32 const *index;	/**< Word IDs of those by hash, not in ht */
+    uint32 index_mask;	/**< Size of index minus one */
 } dict_t;
 
 
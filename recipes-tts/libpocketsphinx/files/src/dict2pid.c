@@ -42,6 +42,7 @@
 #include "s3types.h"
 #include "dict2pid.h"
 #include "hmm.h"
+#include "model_cache.h"
 
 
 /**
@@ -501,17 +502,19 @@ dict2pid_build(bin_mdef_t * mdef, dict_t * dict)
 dict2pid_t *
 dict2pid_retain(dict2pid_t *d2p)
 {
-    ++d2p->refcount;
+    model_cache_ref(d2p->refcount);
     return d2p;
 }
 
 int
 dict2pid_free(dict2pid_t * d2p)
 {
+    int rc;
+
     if (d2p == NULL)
         return 0;
-    if (--d2p->refcount > 0)
-        return d2p->refcount;
+    if ((rc = model_cache_unref(d2p->refcount)) > 0)
+        return rc;
 
     if (d2p->ldiph_lc)
         ckd_free_3d((void ***) d2p->ldiph_lc);
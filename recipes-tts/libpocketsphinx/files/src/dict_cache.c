@@ -0,0 +1,652 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/**
+ * @file dict_cache.c
+ * @brief Compiled dictionary and dict2pid tables.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <pocketsphinx.h>
+
+#include "util/ckd_alloc.h"
+#include "util/case.h"
+#include "util/mmio.h"
+#include "util/strfuncs.h"
+#include "dict_cache.h"
+
+#define DICT_CACHE_MAGIC "PSDICTC"
+#define DICT_CACHE_VERSION 1
+#define DICT_CACHE_BYTEORDER 0x11223344
+/** Sections start on multiples of this. */
+#define DICT_CACHE_ALIGN 8
+/** Empty slot in the word index. */
+#define DICT_CACHE_EMPTY (-1)
+
+#define FNV_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+/* Everything is in host byte order; the file is only meant to be
+ * read on the machine that wrote it. */
+typedef struct dict_cache_hdr_s {
+    char magic[8];
+    uint32 version;
+    uint32 byteorder;
+    uint32 mdef_hash;   /**< Hash of the model definition */
+    uint32 src_hash;    /**< Hash of the text dictionaries' path, size, time */
+    uint32 file_size;
+    int32 n_ciphone;
+    int32 n_word;
+    int32 filler_start;
+    int32 filler_end;
+    int32 startwid;
+    int32 finishwid;
+    int32 silwid;
+    uint32 n_index;     /**< Slots in the word index, a power of two */
+    uint32 n_pron;      /**< Phones in all pronunciations */
+    uint32 n_str;       /**< Bytes in all word strings */
+    uint32 n_xwd;       /**< Non-empty cross-word entries (rssid and lrssid) */
+    uint32 n_xwd_ssid;  /**< Senone sequences in them */
+} dict_cache_hdr_t;
+
+typedef struct dict_cache_word_s {
+    uint32 str;         /**< Offset of the word string */
+    uint32 pron;        /**< Index of the first phone */
+    int32 pronlen;
+    int32 alt;
+    int32 basewid;
+} dict_cache_word_t;
+
+enum dict_cache_section_e {
+    SEC_WORD,           /**< dict_cache_word_t[n_word] */
+    SEC_INDEX,          /**< int32[n_index], word IDs by hash */
+    SEC_LDIPH,          /**< s3ssid_t[n_ci][n_ci][n_ci], ldiph_lc */
+    SEC_LRDIPH,         /**< s3ssid_t[n_ci][n_ci][n_ci], lrdiph_rc */
+    SEC_XWD_N,          /**< int32[2][n_ci][n_ci], n_ssid of rssid and lrssid */
+    SEC_XWD_SSID,       /**< s3ssid_t[n_xwd_ssid], their ssid lists */
+    SEC_XWD_CIMAP,      /**< s3cipid_t[n_xwd][n_ci], their cimaps */
+    SEC_PRON,           /**< s3cipid_t[n_pron] */
+    SEC_STR,            /**< char[n_str] */
+    SEC_END
+};
+
+/* Work out where each section goes, returns the total size. */
+static size_t
+dict_cache_layout(dict_cache_hdr_t const *hdr, size_t *off)
+{
+    size_t n_ci = hdr->n_ciphone;
+    size_t size[SEC_END];
+    size_t pos;
+    int i;
+
+    size[SEC_WORD] = hdr->n_word * sizeof(dict_cache_word_t);
+    size[SEC_INDEX] = hdr->n_index * sizeof(int32);
+    size[SEC_LDIPH] = n_ci * n_ci * n_ci * sizeof(s3ssid_t);
+    size[SEC_LRDIPH] = size[SEC_LDIPH];
+    size[SEC_XWD_N] = 2 * n_ci * n_ci * sizeof(int32);
+    size[SEC_XWD_SSID] = hdr->n_xwd_ssid * sizeof(s3ssid_t);
+    size[SEC_XWD_CIMAP] = hdr->n_xwd * n_ci * sizeof(s3cipid_t);
+    size[SEC_PRON] = hdr->n_pron * sizeof(s3cipid_t);
+    size[SEC_STR] = hdr->n_str;
+
+    pos = sizeof(*hdr);
+    for (i = 0; i < SEC_END; ++i) {
+        pos = (pos + DICT_CACHE_ALIGN - 1) & ~(size_t)(DICT_CACHE_ALIGN - 1);
+        off[i] = pos;
+        pos += size[i];
+    }
+    off[SEC_END] = pos;
+    return pos;
+}
+
+static uint32
+dict_cache_fnv(uint32 h, void const *data, size_t len)
+{
+    uint8 const *p = data;
+
+    /* A word at a time, the mdef tables are fairly large. */
+    for (; len >= 4; p += 4, len -= 4) {
+        uint32 w;
+        memcpy(&w, p, 4);
+        h = (h ^ w) * FNV_PRIME;
+    }
+    for (; len > 0; ++p, --len)
+        h = (h ^ *p) * FNV_PRIME;
+    return h;
+}
+
+static uint32
+dict_cache_fnv_str(uint32 h, char const *str)
+{
+    if (str == NULL)
+        str = "";
+    return dict_cache_fnv(h, str, strlen(str) + 1);
+}
+
+/* Everything dict_init() and dict2pid_build() look at in the mdef. */
+static uint32
+dict_cache_mdef_hash(bin_mdef_t *mdef)
+{
+    uint32 h = FNV_BASIS;
+    size_t n_sseq_sen;
+    int32 i;
+
+    h = dict_cache_fnv(h, &mdef->n_ciphone, sizeof(mdef->n_ciphone));
+    h = dict_cache_fnv(h, &mdef->n_phone, sizeof(mdef->n_phone));
+    h = dict_cache_fnv(h, &mdef->n_emit_state, sizeof(mdef->n_emit_state));
+    h = dict_cache_fnv(h, &mdef->n_sseq, sizeof(mdef->n_sseq));
+    h = dict_cache_fnv(h, &mdef->n_cd_tree, sizeof(mdef->n_cd_tree));
+    h = dict_cache_fnv(h, &mdef->sil, sizeof(mdef->sil));
+    for (i = 0; i < mdef->n_ciphone; ++i)
+        h = dict_cache_fnv_str(h, mdef->ciname[i]);
+    h = dict_cache_fnv(h, mdef->phone, mdef->n_phone * sizeof(*mdef->phone));
+    h = dict_cache_fnv(h, mdef->cd_tree,
+                       mdef->n_cd_tree * sizeof(*mdef->cd_tree));
+    if (mdef->n_emit_state)
+        n_sseq_sen = (size_t)mdef->n_sseq * mdef->n_emit_state;
+    else {
+        h = dict_cache_fnv(h, mdef->sseq_len, mdef->n_sseq);
+        for (n_sseq_sen = i = 0; i < mdef->n_sseq; ++i)
+            n_sseq_sen += mdef->sseq_len[i];
+    }
+    if (mdef->n_sseq)
+        h = dict_cache_fnv(h, mdef->sseq[0], n_sseq_sen * sizeof(uint16));
+    return h;
+}
+
+/* Path, size and modification time of the text dictionaries. */
+static uint32
+dict_cache_src_hash(ps_config_t *config)
+{
+    char const *name[2] = { "dict", "fdict" };
+    uint32 h = FNV_BASIS;
+    int i;
+
+    for (i = 0; i < 2; ++i) {
+        char const *path = ps_config_str(config, name[i]);
+        struct stat st;
+        int64 val[2];
+
+        h = dict_cache_fnv_str(h, path);
+        if (path == NULL)
+            continue;
+        if (stat(path, &st) < 0) {
+            val[0] = val[1] = -1;
+        }
+        else {
+            val[0] = st.st_size;
+            val[1] = st.st_mtime;
+        }
+        h = dict_cache_fnv(h, val, sizeof(val));
+    }
+    i = ps_config_bool(config, "dictcase");
+    h = dict_cache_fnv(h, &i, sizeof(i));
+    return h;
+}
+
+static uint32
+dict_cache_word_hash(char const *word, int nocase)
+{
+    uint32 h = FNV_BASIS;
+
+    for (; *word; ++word) {
+        unsigned char c = *word;
+        if (nocase)
+            c = UPPER_CASE(c);
+        h = (h ^ c) * FNV_PRIME;
+    }
+    return h;
+}
+
+s3wid_t
+dict_cache_wordid(dict_t *d, char const *word)
+{
+    uint32 i;
+    int32 w;
+
+    if (d->index == NULL)
+        return BAD_S3WID;
+    for (i = dict_cache_word_hash(word, d->nocase) & d->index_mask;
+         (w = d->index[i]) != DICT_CACHE_EMPTY;
+         i = (i + 1) & d->index_mask) {
+        if ((d->nocase ? strcmp_nocase(d->word[w].word, word)
+             : strcmp(d->word[w].word, word)) == 0)
+            return w;
+    }
+    return BAD_S3WID;
+}
+
+/* Range checks, so a damaged file can't make us read outside it. */
+static int
+dict_cache_check(dict_cache_hdr_t const *hdr, char const *base,
+                 size_t const *off, bin_mdef_t *mdef)
+{
+    dict_cache_word_t const *cw;
+    s3cipid_t const *ci;
+    s3ssid_t const *ss;
+    int32 const *n;
+    size_t i, n_ci3, n_empty;
+    uint32 n_xwd, n_xwd_ssid;
+    int32 n_ci = hdr->n_ciphone;
+
+    if (hdr->n_word <= 0 || hdr->n_word >= MAX_S3WID
+        || hdr->filler_start < 0 || hdr->filler_start > hdr->filler_end
+        || hdr->filler_end >= hdr->n_word
+        || hdr->startwid < 0 || hdr->startwid >= hdr->n_word
+        || hdr->finishwid < 0 || hdr->finishwid >= hdr->n_word
+        || hdr->silwid < 0 || hdr->silwid >= hdr->n_word
+        || hdr->n_index == 0 || (hdr->n_index & (hdr->n_index - 1))
+        || hdr->n_str == 0 || base[off[SEC_STR] + hdr->n_str - 1] != '\0')
+        return -1;
+
+    cw = (dict_cache_word_t const *)(base + off[SEC_WORD]);
+    for (i = 0; i < (size_t)hdr->n_word; ++i) {
+        if (cw[i].str >= hdr->n_str
+            || cw[i].pronlen < 0 || cw[i].pron > hdr->n_pron
+            || (uint32)cw[i].pronlen > hdr->n_pron - cw[i].pron
+            || (cw[i].alt != BAD_S3WID
+                && (cw[i].alt < 0 || cw[i].alt >= hdr->n_word))
+            || cw[i].basewid < 0 || cw[i].basewid >= hdr->n_word)
+            return -1;
+    }
+    n = (int32 const *)(base + off[SEC_INDEX]);
+    for (n_empty = i = 0; i < hdr->n_index; ++i) {
+        if (n[i] == DICT_CACHE_EMPTY)
+            ++n_empty;
+        else if (n[i] < 0 || n[i] >= hdr->n_word)
+            return -1;
+    }
+    /* Or lookups of unknown words would never end. */
+    if (n_empty == 0)
+        return -1;
+    ci = (s3cipid_t const *)(base + off[SEC_PRON]);
+    for (i = 0; i < hdr->n_pron; ++i)
+        if (ci[i] < 0 || ci[i] >= n_ci)
+            return -1;
+
+    n_ci3 = (size_t)n_ci * n_ci * n_ci;
+    ss = (s3ssid_t const *)(base + off[SEC_LDIPH]);
+    for (i = 0; i < 2 * n_ci3; ++i)     /* LRDIPH follows directly */
+        if (ss[i] != BAD_S3SSID && ss[i] >= mdef->n_sseq)
+            return -1;
+    n = (int32 const *)(base + off[SEC_XWD_N]);
+    for (n_xwd = n_xwd_ssid = 0, i = 0; i < 2 * (size_t)n_ci * n_ci; ++i) {
+        if (n[i] < 0 || n[i] > n_ci)
+            return -1;
+        if (n[i]) {
+            ++n_xwd;
+            n_xwd_ssid += n[i];
+        }
+    }
+    if (n_xwd != hdr->n_xwd || n_xwd_ssid != hdr->n_xwd_ssid)
+        return -1;
+    ss = (s3ssid_t const *)(base + off[SEC_XWD_SSID]);
+    for (i = 0; i < hdr->n_xwd_ssid; ++i)
+        if (ss[i] != BAD_S3SSID && ss[i] >= mdef->n_sseq)
+            return -1;
+    /* Each cimap indexes its own ssid list. */
+    ci = (s3cipid_t const *)(base + off[SEC_XWD_CIMAP]);
+    for (i = 0; i < 2 * (size_t)n_ci * n_ci; ++i) {
+        int32 r;
+        if (n[i] == 0)
+            continue;
+        for (r = 0; r < n_ci; ++r, ++ci)
+            if (*ci < 0 || *ci >= n[i])
+                return -1;
+    }
+    return 0;
+}
+
+static xwdssid_t **
+dict_cache_read_xwd(int32 n_ci, int32 const **n, s3ssid_t const **ssid,
+                    s3cipid_t const **cimap)
+{
+    xwdssid_t **tree;
+    int32 b, l;
+
+    tree = ckd_calloc(n_ci, sizeof(*tree));
+    for (b = 0; b < n_ci; ++b) {
+        tree[b] = ckd_calloc(n_ci, sizeof(**tree));
+        for (l = 0; l < n_ci; ++l) {
+            xwdssid_t *x = &tree[b][l];
+            if ((x->n_ssid = *(*n)++) == 0)
+                continue;
+            x->ssid = ckd_calloc(x->n_ssid, sizeof(*x->ssid));
+            memcpy(x->ssid, *ssid, x->n_ssid * sizeof(*x->ssid));
+            *ssid += x->n_ssid;
+            x->cimap = ckd_calloc(n_ci, sizeof(*x->cimap));
+            memcpy(x->cimap, *cimap, n_ci * sizeof(*x->cimap));
+            *cimap += n_ci;
+        }
+    }
+    return tree;
+}
+
+static int
+dict_cache_read(char const *path, ps_config_t *config, bin_mdef_t *mdef,
+                dict_t **out_dict, dict2pid_t **out_d2p)
+{
+    dict_cache_hdr_t hdr;
+    size_t off[SEC_END + 1];
+    mmio_file_t *mf;
+    struct stat st;
+    char const *base;
+    dict_cache_word_t const *cw;
+    s3cipid_t const *pron, *cimap;
+    s3ssid_t const *ssid;
+    int32 const *xwd_n;
+    size_t n_ci3;
+    dict2pid_t *d2p;
+    dict_t *d;
+    int32 i, n_ci;
+
+    if (stat(path, &st) < 0)
+        return -1;
+    if ((size_t)st.st_size < sizeof(hdr)) {
+        E_INFO("Compiled dictionary %s is truncated\n", path);
+        return -1;
+    }
+    if ((mf = mmio_file_read(path)) == NULL)
+        return -1;
+    base = mmio_file_ptr(mf);
+    memcpy(&hdr, base, sizeof(hdr));
+    if (memcmp(hdr.magic, DICT_CACHE_MAGIC, sizeof(hdr.magic)) != 0
+        || hdr.version != DICT_CACHE_VERSION
+        || hdr.byteorder != DICT_CACHE_BYTEORDER) {
+        E_INFO("%s is not a compiled dictionary for this version\n", path);
+        goto error_out;
+    }
+    if (hdr.mdef_hash != dict_cache_mdef_hash(mdef)
+        || hdr.n_ciphone != bin_mdef_n_ciphone(mdef)) {
+        E_INFO("Compiled dictionary %s is for a different acoustic model\n",
+               path);
+        goto error_out;
+    }
+    if (hdr.src_hash != dict_cache_src_hash(config)) {
+        E_INFO("Compiled dictionary %s is out of date\n", path);
+        goto error_out;
+    }
+    if (hdr.file_size != (size_t)st.st_size
+        || dict_cache_layout(&hdr, off) != (size_t)st.st_size
+        || dict_cache_check(&hdr, base, off, mdef) < 0) {
+        E_ERROR("Compiled dictionary %s is corrupted\n", path);
+        goto error_out;
+    }
+
+    d = ckd_calloc(1, sizeof(*d));
+    d->refcnt = 1;
+    d->mdef = bin_mdef_retain(mdef);
+    d->nocase = ps_config_bool(config, "dictcase");
+    d->max_words = (hdr.n_word + S3DICT_INC_SZ < MAX_S3WID)
+        ? hdr.n_word + S3DICT_INC_SZ : MAX_S3WID;
+    d->word = ckd_calloc(d->max_words, sizeof(*d->word));
+    /* Only for words added later. */
+    d->ht = hash_table_new(S3DICT_INC_SZ, d->nocase);
+    d->filemap = mf;
+    d->n_mapped = hdr.n_word;
+    d->index = (int32 const *)(base + off[SEC_INDEX]);
+    d->index_mask = hdr.n_index - 1;
+    cw = (dict_cache_word_t const *)(base + off[SEC_WORD]);
+    pron = (s3cipid_t const *)(base + off[SEC_PRON]);
+    for (i = 0; i < hdr.n_word; ++i) {
+        d->word[i].word = (char *)base + off[SEC_STR] + cw[i].str;
+        d->word[i].ciphone = cw[i].pronlen
+            ? (s3cipid_t *)pron + cw[i].pron : NULL;
+        d->word[i].pronlen = cw[i].pronlen;
+        d->word[i].alt = cw[i].alt;
+        d->word[i].basewid = cw[i].basewid;
+    }
+    d->n_word = hdr.n_word;
+    d->filler_start = hdr.filler_start;
+    d->filler_end = hdr.filler_end;
+    d->startwid = hdr.startwid;
+    d->finishwid = hdr.finishwid;
+    d->silwid = hdr.silwid;
+
+    n_ci = hdr.n_ciphone;
+    n_ci3 = (size_t)n_ci * n_ci * n_ci * sizeof(s3ssid_t);
+    d2p = ckd_calloc(1, sizeof(*d2p));
+    d2p->refcount = 1;
+    d2p->mdef = bin_mdef_retain(mdef);
+    d2p->dict = dict_retain(d);
+    d2p->ldiph_lc = (s3ssid_t ***)ckd_calloc_3d(n_ci, n_ci, n_ci,
+                                                sizeof(s3ssid_t));
+    memcpy(d2p->ldiph_lc[0][0], base + off[SEC_LDIPH], n_ci3);
+    d2p->lrdiph_rc = (s3ssid_t ***)ckd_calloc_3d(n_ci, n_ci, n_ci,
+                                                 sizeof(s3ssid_t));
+    memcpy(d2p->lrdiph_rc[0][0], base + off[SEC_LRDIPH], n_ci3);
+    xwd_n = (int32 const *)(base + off[SEC_XWD_N]);
+    ssid = (s3ssid_t const *)(base + off[SEC_XWD_SSID]);
+    cimap = (s3cipid_t const *)(base + off[SEC_XWD_CIMAP]);
+    d2p->rssid = dict_cache_read_xwd(n_ci, &xwd_n, &ssid, &cimap);
+    d2p->lrssid = dict_cache_read_xwd(n_ci, &xwd_n, &ssid, &cimap);
+
+    E_INFO("Loaded compiled dictionary %s: %d words\n", path, d->n_word);
+    *out_dict = d;
+    *out_d2p = d2p;
+    return 0;
+
+error_out:
+    mmio_file_unmap(mf);
+    return -1;
+}
+
+static void
+dict_cache_count_xwd(xwdssid_t **tree, int32 n_ci, dict_cache_hdr_t *hdr)
+{
+    int32 b, l;
+
+    for (b = 0; b < n_ci; ++b) {
+        for (l = 0; l < n_ci; ++l) {
+            if (tree[b][l].n_ssid) {
+                ++hdr->n_xwd;
+                hdr->n_xwd_ssid += tree[b][l].n_ssid;
+            }
+        }
+    }
+}
+
+static void
+dict_cache_fill_xwd(xwdssid_t **tree, int32 n_ci, int32 **n,
+                    s3ssid_t **ssid, s3cipid_t **cimap)
+{
+    int32 b, l;
+
+    for (b = 0; b < n_ci; ++b) {
+        for (l = 0; l < n_ci; ++l) {
+            xwdssid_t *x = &tree[b][l];
+            *(*n)++ = x->n_ssid;
+            if (x->n_ssid == 0)
+                continue;
+            memcpy(*ssid, x->ssid, x->n_ssid * sizeof(*x->ssid));
+            *ssid += x->n_ssid;
+            memcpy(*cimap, x->cimap, n_ci * sizeof(*x->cimap));
+            *cimap += n_ci;
+        }
+    }
+}
+
+int
+dict_cache_write(char const *path, ps_config_t *config,
+                 dict_t *dict, dict2pid_t *d2p)
+{
+    dict_cache_hdr_t hdr;
+    size_t off[SEC_END + 1];
+    size_t total, n_ci3;
+    char *buf, *tmppath;
+    dict_cache_word_t *cw;
+    s3cipid_t *pron, *cimap;
+    s3ssid_t *ssid;
+    int32 *index, *xwd_n;
+    uint32 pos;
+    char *str;
+    FILE *fh;
+    int32 i, n_ci;
+
+    n_ci = bin_mdef_n_ciphone(d2p->mdef);
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, DICT_CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version = DICT_CACHE_VERSION;
+    hdr.byteorder = DICT_CACHE_BYTEORDER;
+    hdr.mdef_hash = dict_cache_mdef_hash(d2p->mdef);
+    hdr.src_hash = dict_cache_src_hash(config);
+    hdr.n_ciphone = n_ci;
+    hdr.n_word = dict_size(dict);
+    hdr.filler_start = dict_filler_start(dict);
+    hdr.filler_end = dict_filler_end(dict);
+    hdr.startwid = dict_startwid(dict);
+    hdr.finishwid = dict_finishwid(dict);
+    hdr.silwid = dict_silwid(dict);
+    /* At most 3/4 full. */
+    for (hdr.n_index = 1; hdr.n_index < (uint32)hdr.n_word / 3 * 4 + 2;
+         hdr.n_index <<= 1)
+        ;
+    for (i = 0; i < hdr.n_word; ++i) {
+        hdr.n_pron += dict_pronlen(dict, i);
+        hdr.n_str += strlen(dict->word[i].word) + 1;
+    }
+    dict_cache_count_xwd(d2p->rssid, n_ci, &hdr);
+    dict_cache_count_xwd(d2p->lrssid, n_ci, &hdr);
+    total = dict_cache_layout(&hdr, off);
+    if (total > 0xffffffffUL) {
+        E_ERROR("Dictionary is too large to compile\n");
+        return -1;
+    }
+    hdr.file_size = total;
+
+    /* It's no bigger than the tables we already have in memory. */
+    buf = ckd_calloc(1, total);
+    memcpy(buf, &hdr, sizeof(hdr));
+    cw = (dict_cache_word_t *)(buf + off[SEC_WORD]);
+    pron = (s3cipid_t *)(buf + off[SEC_PRON]);
+    str = buf + off[SEC_STR];
+    index = (int32 *)(buf + off[SEC_INDEX]);
+    for (i = 0; i < (int32)hdr.n_index; ++i)
+        index[i] = DICT_CACHE_EMPTY;
+    for (pos = 0, i = 0; i < hdr.n_word; ++i) {
+        char const *word = dict->word[i].word;
+        size_t len = strlen(word) + 1;
+        uint32 h;
+
+        cw[i].str = str - (buf + off[SEC_STR]);
+        memcpy(str, word, len);
+        str += len;
+        cw[i].pron = pos;
+        cw[i].pronlen = dict_pronlen(dict, i);
+        if (cw[i].pronlen)
+            memcpy(pron + pos, dict->word[i].ciphone,
+                   cw[i].pronlen * sizeof(*pron));
+        pos += cw[i].pronlen;
+        cw[i].alt = dict_nextalt(dict, i);
+        cw[i].basewid = dict_basewid(dict, i);
+
+        for (h = dict_cache_word_hash(word, dict->nocase) & (hdr.n_index - 1);
+             index[h] != DICT_CACHE_EMPTY; h = (h + 1) & (hdr.n_index - 1))
+            ;
+        index[h] = i;
+    }
+    n_ci3 = (size_t)n_ci * n_ci * n_ci * sizeof(s3ssid_t);
+    memcpy(buf + off[SEC_LDIPH], d2p->ldiph_lc[0][0], n_ci3);
+    memcpy(buf + off[SEC_LRDIPH], d2p->lrdiph_rc[0][0], n_ci3);
+    xwd_n = (int32 *)(buf + off[SEC_XWD_N]);
+    ssid = (s3ssid_t *)(buf + off[SEC_XWD_SSID]);
+    cimap = (s3cipid_t *)(buf + off[SEC_XWD_CIMAP]);
+    dict_cache_fill_xwd(d2p->rssid, n_ci, &xwd_n, &ssid, &cimap);
+    dict_cache_fill_xwd(d2p->lrssid, n_ci, &xwd_n, &ssid, &cimap);
+
+    /* Write it next to the real one and rename it, so other decoders
+     * never see a partial file. */
+    tmppath = string_join(path, ".tmp", NULL);
+    if ((fh = fopen(tmppath, "wb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open %s for writing", tmppath);
+        goto error_out;
+    }
+    if (fwrite(buf, 1, total, fh) != total) {
+        E_ERROR_SYSTEM("Failed to write %s", tmppath);
+        fclose(fh);
+        remove(tmppath);
+        goto error_out;
+    }
+    if (fclose(fh) != 0) {
+        E_ERROR_SYSTEM("Failed to write %s", tmppath);
+        remove(tmppath);
+        goto error_out;
+    }
+#ifdef _WIN32
+    remove(path);
+#endif
+    if (rename(tmppath, path) < 0) {
+        E_ERROR_SYSTEM("Failed to rename %s to %s", tmppath, path);
+        remove(tmppath);
+        goto error_out;
+    }
+    E_INFO("Wrote compiled dictionary to %s (%d KiB)\n",
+           path, (int)(total / 1024));
+    ckd_free(tmppath);
+    ckd_free(buf);
+    return 0;
+
+error_out:
+    ckd_free(tmppath);
+    ckd_free(buf);
+    return -1;
+}
+
+int
+dict_cache_load(ps_config_t *config, bin_mdef_t *mdef,
+                dict_t **out_dict, dict2pid_t **out_d2p)
+{
+    char const *path;
+
+    *out_dict = NULL;
+    *out_d2p = NULL;
+    path = ps_config_str(config, "dictcache");
+    /* It can only be used in place. */
+    if (path && !ps_config_bool(config, "mmap"))
+        path = NULL;
+    if (path && mdef
+        && dict_cache_read(path, config, mdef, out_dict, out_d2p) == 0)
+        return 0;
+
+    if ((*out_dict = dict_init(config, mdef)) == NULL)
+        return -1;
+    if ((*out_d2p = dict2pid_build(mdef, *out_dict)) == NULL) {
+        dict_free(*out_dict);
+        *out_dict = NULL;
+        return -1;
+    }
+    if (path && mdef)
+        dict_cache_write(path, config, *out_dict, *out_d2p);
+    return 0;
+}
@@ -0,0 +1,96 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/**
+ * @file dict_cache.h
+ * @brief Compiled dictionary and dict2pid tables.
+ *
+ * Parsing a large text dictionary and building the cross-word
+ * triphone tables for it takes most of the time spent creating a
+ * decoder.  When the "dictcache" option names a file, the result of
+ * doing that is saved there, and later decoders map it instead.
+ *
+ * The file holds the word strings and pronunciations, a hash index
+ * for dict_wordid(), and the dict2pid tables.  It is tied to the
+ * byte order and to the phone set, senone sequences and context tree
+ * of the model definition by a hash, and to the path, size and
+ * modification time of the text dictionaries it was built from.  If
+ * any of those don't match it is rebuilt from the text ones, which
+ * remain the authoritative source.
+ *
+ * Word strings and pronunciations are used in place; the dict2pid
+ * tables are copied since dict2pid_add_word() updates them.
+ */
+
+#ifndef __DICT_CACHE_H__
+#define __DICT_CACHE_H__
+
+#include <pocketsphinx.h>
+
+#include "bin_mdef.h"
+#include "dict.h"
+#include "dict2pid.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/**
+ * Load the dictionary and dict2pid tables for a configuration.
+ *
+ * Uses the compiled file in -dictcache if it is current, otherwise
+ * reads -dict and -fdict and (if -dictcache is set) writes a new one.
+ *
+ * @return 0, or -1 if the text dictionaries could not be loaded.
+ */
+int dict_cache_load(ps_config_t *config, bin_mdef_t *mdef,
+                    dict_t **out_dict, dict2pid_t **out_d2p);
+
+/**
+ * Write a compiled dictionary file.
+ * @return 0, or -1 on failure (in which case nothing is written).
+ */
+int dict_cache_write(char const *path, ps_config_t *config,
+                     dict_t *dict, dict2pid_t *d2p);
+
+/**
+ * Look up a word among those loaded from a compiled dictionary.
+ * @return Word ID, or BAD_S3WID if it isn't one of them.
+ */
+s3wid_t dict_cache_wordid(dict_t *d, char const *word);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DICT_CACHE_H__ */
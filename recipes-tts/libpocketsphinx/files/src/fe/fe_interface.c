@@ -288,8 +288,9 @@ fe_init_auto_r(cmd_ln_t *config)
     fe->mfspec = ckd_calloc(fe->mel_fb->num_filters, sizeof(*fe->mfspec));
 
     /* create twiddle factors */
-    fe->ccc = ckd_calloc(fe->fft_size / 4, sizeof(*fe->ccc));
-    fe->sss = ckd_calloc(fe->fft_size / 4, sizeof(*fe->sss));
+    fe->ccc = ckd_calloc(fe->fft_size / 2, sizeof(*fe->ccc));
+    fe->sss = ckd_calloc(fe->fft_size / 2, sizeof(*fe->sss));
+    fe->fft_bitrev = ckd_calloc(fe->fft_size, sizeof(*fe->fft_bitrev));
     fe_create_twiddle(fe);
 
     if (ps_config_bool(config, "verbose")) {
@@ -575,6 +576,7 @@ fe_free(fe_t * fe)
     ckd_free(fe->frame);
     ckd_free(fe->ccc);
     ckd_free(fe->sss);
+    ckd_free(fe->fft_bitrev);
     ckd_free(fe->spec);
     ckd_free(fe->mfspec);
     ckd_free(fe->overflow_samps);
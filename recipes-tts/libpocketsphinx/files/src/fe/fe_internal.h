@@ -131,8 +131,11 @@ struct fe_s {
     float32 pre_emphasis_alpha;
     int32 dither_seed;
 
-    /* Twiddle factors for FFT. */
+    /* Twiddle factors for FFT, fft_size/2 of them.  Those for stage k
+     * are stored contiguously starting at 1 << (k-1). */
     frame_t *ccc, *sss;
+    /* Bit-reversal permutation for FFT input. */
+    int16 *fft_bitrev;
     /* Mel filter parameters. */
     melfb_t *mel_fb;
     /* Half of a Hamming Window. */
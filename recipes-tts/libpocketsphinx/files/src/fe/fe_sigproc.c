@@ -76,6 +76,19 @@
 #define COSMUL(x,y) ((x)*(y))
 #endif
 
+/* The floating-point front end works in double precision, so it can
+ * use two-lane vectors on x86-64 and AArch64.  32-bit ARM NEON has no
+ * doubles and keeps the scalar loops. */
+#ifndef FIXED_POINT
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FE_SIMD_SSE2
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define FE_SIMD_NEON
+#endif
+#endif
+
 #ifdef FIXED_POINT
 
 /* Internal log-addition table for natural log with radix point at 8
@@ -915,20 +928,62 @@ fe_shift_frame(fe_t * fe, int16 const *in, int32 len)
 void
 fe_create_twiddle(fe_t * fe)
 {
-    int i;
+    int i, j, k, m, n;
+
+    m = fe->fft_order;
+    n = fe->fft_size;
 
-    for (i = 0; i < fe->fft_size / 4; ++i) {
-        float64 a = 2 * M_PI * i / fe->fft_size;
+    /* Stage k of the FFT uses every (1 << (m-k-1))th twiddle factor,
+     * so lay them out one stage after another to make those reads
+     * sequential.  Nothing is stored for stage 0 and 1, which only
+     * have real twiddle factors. */
+    for (k = 2; k < m; ++k) {
+        for (j = 1; j < (1 << (k - 1)); ++j) {
+            float64 a = 2 * M_PI * (j << (m - k - 1)) / n;
+            i = (1 << (k - 1)) + j;
 #ifdef FIXED16
-        fe->ccc[i] = (int16)(cos(a) * 0x8000);
-        fe->sss[i] = (int16)(sin(a) * 0x8000);
+            fe->ccc[i] = (int16)(cos(a) * 0x8000);
+            fe->sss[i] = (int16)(sin(a) * 0x8000);
 #elif defined(FIXED_POINT)
-        fe->ccc[i] = FLOAT2COS(cos(a));
-        fe->sss[i] = FLOAT2COS(sin(a));
+            fe->ccc[i] = FLOAT2COS(cos(a));
+            fe->sss[i] = FLOAT2COS(sin(a));
 #else
-        fe->ccc[i] = cos(a);
-        fe->sss[i] = sin(a);
+            fe->ccc[i] = cos(a);
+            fe->sss[i] = sin(a);
 #endif
+        }
+    }
+
+    /* Bit-reversal permutation, so it doesn't get recomputed for
+     * every frame. */
+    j = 0;
+    for (i = 0; i < n - 1; ++i) {
+        fe->fft_bitrev[i] = j;
+        k = n / 2;
+        while (k <= j) {
+            j -= k;
+            k /= 2;
+        }
+        j += k;
+    }
+    fe->fft_bitrev[n - 1] = n - 1;
+}
+
+/* Swap the input into bit-reversed order. */
+static void
+fe_fft_bitrev(fe_t *fe)
+{
+    frame_t *x, xt;
+    int i, j;
+
+    x = fe->frame;
+    for (i = 0; i < fe->fft_size; ++i) {
+        j = fe->fft_bitrev[i];
+        if (i < j) {
+            xt = x[j];
+            x[j] = x[i];
+            x[i] = xt;
+        }
     }
 }
 
@@ -950,20 +1005,7 @@ fe_fft_real(fe_t *fe)
     n = fe->fft_size;
 
     /* Bit-reverse the input. */
-    j = 0;
-    for (i = 0; i < n - 1; ++i) {
-        if (i < j) {
-            xt = x[j];
-            x[j] = x[i];
-            x[i] = xt;
-        }
-        k = n / 2;
-        while (k <= j) {
-            j -= k;
-            k /= 2;
-        }
-        j += k;
-    }
+    fe_fft_bitrev(fe);
     /* Determine how many bits of dynamic range are in the input. */
     max = 0;
     for (i = 0; i < n; ++i)
@@ -1034,8 +1076,8 @@ fe_fft_real(fe_t *fe)
                  * cc = real(W[j * n / (1<<(k+1))])
                  * ss = imag(W[j * n / (1<<(k+1))])
                  */
-                cc = fe->ccc[j << (m - n1)];
-                ss = fe->sss[j << (m - n1)];
+                cc = fe->ccc[(1 << n4) + j];
+                ss = fe->sss[(1 << n4) + j];
 
                 /* There are some symmetry properties which allow us
                  * to get away with only four multiplications here. */
@@ -1059,6 +1101,116 @@ fe_fft_real(fe_t *fe)
     return lz;
 }
 #else /* !FIXED16 */
+/*
+ * Complex butterflies for one group of stage n2, from the jth one on.
+ */
+static void
+fe_fft_butterflies(frame_t *x, int i, int n2, int n4,
+                   frame_t const *ccc, frame_t const *sss, int j)
+{
+    for (; j < (1 << n4); ++j) {
+        frame_t cc, ss, t1, t2;
+        int i1, i2, i3, i4;
+
+        i1 = i + j;
+        i2 = i + (1 << n2) - j;
+        i3 = i + (1 << n2) + j;
+        i4 = i + (1 << n2) + (1 << n2) - j;
+
+        /*
+         * cc = real(W[j * n / (1<<(k+1))])
+         * ss = imag(W[j * n / (1<<(k+1))])
+         */
+        cc = ccc[(1 << n4) + j];
+        ss = sss[(1 << n4) + j];
+
+        /* There are some symmetry properties which allow us
+         * to get away with only four multiplications here. */
+        t1 = COSMUL(x[i3], cc) + COSMUL(x[i4], ss);
+        t2 = COSMUL(x[i3], ss) - COSMUL(x[i4], cc);
+
+        x[i4] = (x[i2] - t2);
+        x[i3] = (-x[i2] - t2);
+        x[i2] = (x[i1] - t1);
+        x[i1] = (x[i1] + t1);
+    }
+}
+
+#if defined(FE_SIMD_SSE2) || defined(FE_SIMD_NEON)
+/*
+ * Complex butterflies for one group of stage n2, two at a time.  The
+ * points at i1 and i3 go forwards while those at i2 and i4 go
+ * backwards, so the latter have their lanes swapped on the way in and
+ * out.  This does the same arithmetic as fe_fft_butterflies().
+ * Returns the first butterfly left over for it.
+ */
+static int
+fe_fft_butterflies_x2(frame_t *x, int i, int n2, int n4,
+                      frame_t const *ccc, frame_t const *sss)
+{
+    int j;
+
+    for (j = 1; j + 1 < (1 << n4); j += 2) {
+        int i1, i2, i3, i4;
+
+        /* Lowest address of each pair. */
+        i1 = i + j;
+        i2 = i + (1 << n2) - j - 1;
+        i3 = i + (1 << n2) + j;
+        i4 = i + (1 << n2) + (1 << n2) - j - 1;
+#ifdef FE_SIMD_SSE2
+        {
+            __m128d x1, x2, x3, x4, cc, ss, t1, t2, y;
+
+            x1 = _mm_loadu_pd(x + i1);
+            x2 = _mm_loadu_pd(x + i2);
+            x2 = _mm_shuffle_pd(x2, x2, 1);
+            x3 = _mm_loadu_pd(x + i3);
+            x4 = _mm_loadu_pd(x + i4);
+            x4 = _mm_shuffle_pd(x4, x4, 1);
+            cc = _mm_loadu_pd(ccc + (1 << n4) + j);
+            ss = _mm_loadu_pd(sss + (1 << n4) + j);
+
+            t1 = _mm_add_pd(_mm_mul_pd(x3, cc), _mm_mul_pd(x4, ss));
+            t2 = _mm_sub_pd(_mm_mul_pd(x3, ss), _mm_mul_pd(x4, cc));
+
+            y = _mm_sub_pd(x2, t2);
+            _mm_storeu_pd(x + i4, _mm_shuffle_pd(y, y, 1));
+            y = _mm_sub_pd(_mm_xor_pd(x2, _mm_set1_pd(-0.0)), t2);
+            _mm_storeu_pd(x + i3, y);
+            y = _mm_sub_pd(x1, t1);
+            _mm_storeu_pd(x + i2, _mm_shuffle_pd(y, y, 1));
+            _mm_storeu_pd(x + i1, _mm_add_pd(x1, t1));
+        }
+#else /* FE_SIMD_NEON */
+        {
+            float64x2_t x1, x2, x3, x4, cc, ss, t1, t2, y;
+
+            x1 = vld1q_f64(x + i1);
+            x2 = vld1q_f64(x + i2);
+            x2 = vextq_f64(x2, x2, 1);
+            x3 = vld1q_f64(x + i3);
+            x4 = vld1q_f64(x + i4);
+            x4 = vextq_f64(x4, x4, 1);
+            cc = vld1q_f64(ccc + (1 << n4) + j);
+            ss = vld1q_f64(sss + (1 << n4) + j);
+
+            t1 = vaddq_f64(vmulq_f64(x3, cc), vmulq_f64(x4, ss));
+            t2 = vsubq_f64(vmulq_f64(x3, ss), vmulq_f64(x4, cc));
+
+            y = vsubq_f64(x2, t2);
+            vst1q_f64(x + i4, vextq_f64(y, y, 1));
+            vst1q_f64(x + i3, vsubq_f64(vnegq_f64(x2), t2));
+            y = vsubq_f64(x1, t1);
+            vst1q_f64(x + i2, vextq_f64(y, y, 1));
+            vst1q_f64(x + i1, vaddq_f64(x1, t1));
+        }
+#endif
+    }
+    return j;
+}
+#endif /* FE_SIMD_SSE2 || FE_SIMD_NEON */
+
 static int
 fe_fft_real(fe_t *fe)
 {
@@ -1070,20 +1222,7 @@ fe_fft_real(fe_t *fe)
     n = fe->fft_size;
 
     /* Bit-reverse the input. */
-    j = 0;
-    for (i = 0; i < n - 1; ++i) {
-        if (i < j) {
-            xt = x[j];
-            x[j] = x[i];
-            x[i] = xt;
-        }
-        k = n / 2;
-        while (k <= j) {
-            j -= k;
-            k /= 2;
-        }
-        j += k;
-    }
+    fe_fft_bitrev(fe);
 
     /* Basic butterflies (2-point FFT, real twiddle factors):
      * x[i]   = x[i] +  1 * x[i+1]
@@ -1124,32 +1263,12 @@ fe_fft_real(fe_t *fe)
             /* Butterflies with complex twiddle factors.
              * There are (1<<k-1) of them.
              */
-            for (j = 1; j < (1 << n4); ++j) {
-                frame_t cc, ss, t1, t2;
-                int i1, i2, i3, i4;
-
-                i1 = i + j;
-                i2 = i + (1 << n2) - j;
-                i3 = i + (1 << n2) + j;
-                i4 = i + (1 << n2) + (1 << n2) - j;
-
-                /*
-                 * cc = real(W[j * n / (1<<(k+1))])
-                 * ss = imag(W[j * n / (1<<(k+1))])
-                 */
-                cc = fe->ccc[j << (m - n1)];
-                ss = fe->sss[j << (m - n1)];
-
-                /* There are some symmetry properties which allow us
-                 * to get away with only four multiplications here. */
-                t1 = COSMUL(x[i3], cc) + COSMUL(x[i4], ss);
-                t2 = COSMUL(x[i3], ss) - COSMUL(x[i4], cc);
-
-                x[i4] = (x[i2] - t2);
-                x[i3] = (-x[i2] - t2);
-                x[i2] = (x[i1] - t1);
-                x[i1] = (x[i1] + t1);
-            }
+#if defined(FE_SIMD_SSE2) || defined(FE_SIMD_NEON)
+            j = fe_fft_butterflies_x2(x, i, n2, n4, fe->ccc, fe->sss);
+#else
+            j = 1;
+#endif
+            fe_fft_butterflies(x, i, n2, n4, fe->ccc, fe->sss, j);
         }
     }
 
@@ -1203,6 +1322,43 @@ fe_spec_magnitude(fe_t * fe)
     }
 }
 
+#ifndef FIXED_POINT
+/*
+ * Dot product of part of a spectrum with filter or DCT coefficients.
+ * The vector versions add up pairs of terms in a different order, so
+ * they can differ from the scalar loop in the last bit.
+ */
+static powspec_t
+fe_dot(powspec_t const *x, mfcc_t const *w, int n)
+{
+    powspec_t sum;
+    int i = 0;
+
+#if defined(FE_SIMD_SSE2)
+    __m128d acc = _mm_setzero_pd();
+
+    for (; i + 2 <= n; i += 2) {
+        __m128d ww = _mm_cvtps_pd(_mm_castsi128_ps
+                                  (_mm_loadl_epi64((__m128i const *)(w + i))));
+        acc = _mm_add_pd(acc, _mm_mul_pd(_mm_loadu_pd(x + i), ww));
+    }
+    sum = _mm_cvtsd_f64(_mm_add_sd(acc, _mm_unpackhi_pd(acc, acc)));
+#elif defined(FE_SIMD_NEON)
+    float64x2_t acc = vdupq_n_f64(0);
+
+    for (; i + 2 <= n; i += 2)
+        acc = vaddq_f64(acc, vmulq_f64(vld1q_f64(x + i),
+                                       vcvt_f64_f32(vld1_f32(w + i))));
+    sum = vaddvq_f64(acc);
+#else
+    sum = 0;
+#endif
+    for (; i < n; ++i)
+        sum += x[i] * w[i];
+    return sum;
+}
+#endif /* !FIXED_POINT */
+
 static void
 fe_mel_spec(fe_t * fe)
 {
@@ -1214,7 +1370,10 @@ fe_mel_spec(fe_t * fe)
     mfspec = fe->mfspec;
 
     for (whichfilt = 0; whichfilt < fe->mel_fb->num_filters; whichfilt++) {
-        int spec_start, filt_start, i;
+        int spec_start, filt_start;
+#ifdef FIXED_POINT
+        int i;
+#endif
 
         spec_start = fe->mel_fb->spec_start[whichfilt];
         filt_start = fe->mel_fb->filt_start[whichfilt];
@@ -1229,11 +1388,9 @@ fe_mel_spec(fe_t * fe)
                                            filt_coeffs[filt_start + i]);
         }
 #else                           /* !FIXED_POINT */
-        mfspec[whichfilt] = 0;
-        for (i = 0; i < fe->mel_fb->filt_width[whichfilt]; i++)
-            mfspec[whichfilt] +=
-                spec[spec_start + i] * fe->mel_fb->filt_coeffs[filt_start +
-                                                               i];
+        mfspec[whichfilt] = fe_dot(spec + spec_start,
+                                   fe->mel_fb->filt_coeffs + filt_start,
+                                   fe->mel_fb->filt_width[whichfilt]);
 #endif                          /* !FIXED_POINT */
     }
 
@@ -1326,10 +1483,15 @@ fe_dct2(fe_t * fe, const powspec_t * mflogspec, mfcc_t * mfcep, int htk)
         mfcep[0] = COSMUL(mfcep[0], fe->mel_fb->sqrt_inv_n);
 
     for (i = 1; i < fe->num_cepstra; ++i) {
+#ifdef FIXED_POINT
         mfcep[i] = 0;
         for (j = 0; j < fe->mel_fb->num_filters; j++) {
             mfcep[i] += COSMUL(mflogspec[j], fe->mel_fb->mel_cosine[i][j]);
         }
+#else
+        mfcep[i] = fe_dot(mflogspec, fe->mel_fb->mel_cosine[i],
+                          fe->mel_fb->num_filters);
+#endif
         mfcep[i] = COSMUL(mfcep[i], fe->mel_fb->sqrt_inv_2n);
     }
 }
@@ -132,9 +132,11 @@ cmn_live(cmn_t *cmn, mfcc_t **incep, int32 varnorm, int32 nfr)
         }
 
         ++cmn->nframe;
-    }
 
-    /* Shift buffer down if we have more than CMN_WIN_HWM frames */
-    if (cmn->nframe > CMN_WIN_HWM)
-        cmn_live_shiftwin(cmn);
+        /* Shift buffer down if we have more than CMN_WIN_HWM frames
+         * (checked per frame so that the result does not depend on
+         * how the input was split up) */
+        if (cmn->nframe > CMN_WIN_HWM)
+            cmn_live_shiftwin(cmn);
+    }
 }
@@ -1304,12 +1304,75 @@ feat_s2mfc2feat_block_utt(feat_t * fcb, mfcc_t ** uttcep,
     return nfr;
 }
 
+/**
+ * Replicate the end of the utterance if needed and compute features
+ * for everything in the live buffer that has enough right context.
+ * nbufcep includes the frames that will be replicated at the end.
+ */
+static int32
+feat_live_compute(feat_t *fcb, int32 nbufcep, int32 endutt, mfcc_t ***ofeat)
+{
+    int32 win, cepsize;
+    int32 i, j, nfeatvec;
+
+    win = feat_window_size(fcb);
+    cepsize = feat_cepsize(fcb);
+
+    /* Replicate last frame into the last win frames if we're at the
+     * end of the utterance (even if there was no input, so we can
+     * flush the output). */
+    if (endutt) {
+        int32 tpos; /* Index of last input frame. */
+        if (fcb->bufpos == 0)
+            tpos = LIVEBUFBLOCKSIZE - 1;
+        else
+            tpos = fcb->bufpos - 1;
+        for (i = 0; i < win; ++i) {
+            memcpy(fcb->cepbuf[fcb->bufpos++], fcb->cepbuf[tpos],
+                   cepsize * sizeof(mfcc_t));
+            fcb->bufpos %= LIVEBUFBLOCKSIZE;
+        }
+    }
+
+    /* We have to leave the trailing window of frames. */
+    nfeatvec = nbufcep - win;
+    if (nfeatvec <= 0)
+        return 0; /* Do nothing. */
+
+    for (i = 0; i < nfeatvec; ++i) {
+        /* Handle wraparound cases. */
+        if (fcb->curpos - win < 0 || fcb->curpos + win >= LIVEBUFBLOCKSIZE) {
+            /* Use tmpcepbuf for this case.  Actually, we just need the pointers. */
+            for (j = -win; j <= win; ++j) {
+                int32 tmppos =
+                    (fcb->curpos + j + LIVEBUFBLOCKSIZE) % LIVEBUFBLOCKSIZE;
+		fcb->tmpcepbuf[win + j] = fcb->cepbuf[tmppos];
+            }
+            fcb->compute_feat(fcb, fcb->tmpcepbuf + win, ofeat[i]);
+        }
+        else {
+            fcb->compute_feat(fcb, fcb->cepbuf + fcb->curpos, ofeat[i]);
+        }
+	/* Move the read pointer forward. */
+        ++fcb->curpos;
+        fcb->curpos %= LIVEBUFBLOCKSIZE;
+    }
+
+    if (fcb->lda)
+        feat_lda_transform(fcb, ofeat, nfeatvec);
+
+    if (fcb->subvecs)
+        feat_subvec_project(fcb, ofeat, nfeatvec);
+
+    return nfeatvec;
+}
+
 int32
 feat_s2mfc2feat_live(feat_t * fcb, mfcc_t ** uttcep, int32 *inout_ncep,
 		     int32 beginutt, int32 endutt, mfcc_t *** ofeat)
 {
     int32 win, cepsize, nbufcep;
-    int32 i, j, nfeatvec;
+    int32 i;
     int32 zero = 0;
 
     /* Avoid having to check this everywhere. */
@@ -1371,53 +1434,84 @@ feat_s2mfc2feat_live(feat_t * fcb, mfcc_t ** uttcep, int32 *inout_ncep,
 	++nbufcep;
     }
 
-    /* Replicate last frame into the last win frames if we're at the
-     * end of the utterance (even if there was no input, so we can
-     * flush the output). */
-    if (endutt) {
-        int32 tpos; /* Index of last input frame. */
-        if (fcb->bufpos == 0)
-            tpos = LIVEBUFBLOCKSIZE - 1;
-        else
-            tpos = fcb->bufpos - 1;
-        for (i = 0; i < win; ++i) {
-            memcpy(fcb->cepbuf[fcb->bufpos++], fcb->cepbuf[tpos],
-                   cepsize * sizeof(mfcc_t));
-            fcb->bufpos %= LIVEBUFBLOCKSIZE;
-        }
+    return feat_live_compute(fcb, nbufcep, endutt, ofeat);
+}
+
+int32
+feat_live_inbuf(feat_t *fcb, int32 beginutt, int32 maxfeat, mfcc_t ***out_cep)
+{
+    int32 win, nbufcep, wpos, n;
+
+    win = feat_window_size(fcb);
+    if (beginutt) {
+        /* The first win slots will be filled by replication. */
+        nbufcep = 0;
+        wpos = (fcb->curpos + win) % LIVEBUFBLOCKSIZE;
+    }
+    else {
+        nbufcep = fcb->bufpos - fcb->curpos;
+        if (nbufcep < 0)
+            nbufcep += LIVEBUFBLOCKSIZE;
+        wpos = fcb->bufpos;
     }
 
-    /* We have to leave the trailing window of frames. */
-    nfeatvec = nbufcep - win;
-    if (nfeatvec <= 0)
-        return 0; /* Do nothing. */
+    /* Leave room for the trailing window and for the frames
+     * replicated at the end of the utterance. */
+    n = LIVEBUFBLOCKSIZE - nbufcep - 2 * win;
+    /* Every frame beyond the first win yields a feature vector. */
+    if (n > maxfeat + win - nbufcep)
+        n = maxfeat + win - nbufcep;
+    /* Only contiguous space is returned. */
+    if (n > LIVEBUFBLOCKSIZE - wpos)
+        n = LIVEBUFBLOCKSIZE - wpos;
+    if (n < 0)
+        n = 0;
+
+    *out_cep = fcb->cepbuf + wpos;
+    return n;
+}
 
-    for (i = 0; i < nfeatvec; ++i) {
-        /* Handle wraparound cases. */
-        if (fcb->curpos - win < 0 || fcb->curpos + win >= LIVEBUFBLOCKSIZE) {
-            /* Use tmpcepbuf for this case.  Actually, we just need the pointers. */
-            for (j = -win; j <= win; ++j) {
-                int32 tmppos =
-                    (fcb->curpos + j + LIVEBUFBLOCKSIZE) % LIVEBUFBLOCKSIZE;
-		fcb->tmpcepbuf[win + j] = fcb->cepbuf[tmppos];
-            }
-            fcb->compute_feat(fcb, fcb->tmpcepbuf + win, ofeat[i]);
-        }
-        else {
-            fcb->compute_feat(fcb, fcb->cepbuf + fcb->curpos, ofeat[i]);
-        }
-	/* Move the read pointer forward. */
-        ++fcb->curpos;
-        fcb->curpos %= LIVEBUFBLOCKSIZE;
+int32
+feat_live_process(feat_t *fcb, int32 ncep, int32 beginutt, int32 endutt,
+                  mfcc_t ***ofeat)
+{
+    int32 win, cepsize, nbufcep;
+    mfcc_t **cep;
+    int32 i;
+
+    win = feat_window_size(fcb);
+    cepsize = feat_cepsize(fcb);
+
+    if (beginutt) {
+        fcb->bufpos = fcb->curpos;
+        cep = fcb->cepbuf + (fcb->curpos + win) % LIVEBUFBLOCKSIZE;
     }
+    else
+        cep = fcb->cepbuf + fcb->bufpos;
+    nbufcep = fcb->bufpos - fcb->curpos;
+    if (nbufcep < 0)
+        nbufcep += LIVEBUFBLOCKSIZE;
 
-    if (fcb->lda)
-        feat_lda_transform(fcb, ofeat, nfeatvec);
+    /* The input is already in place, so normalize it there. */
+    feat_cmn(fcb, cep, ncep, beginutt, endutt);
+    feat_agc(fcb, cep, ncep, beginutt, endutt);
 
-    if (fcb->subvecs)
-        feat_subvec_project(fcb, ofeat, nfeatvec);
+    /* Replicate first frame into the slots left in front of it, as
+     * feat_s2mfc2feat_live() does. */
+    if (beginutt && ncep > 0) {
+        for (i = 0; i < win; i++) {
+            memcpy(fcb->cepbuf[fcb->bufpos++], cep[0],
+                   cepsize * sizeof(mfcc_t));
+            fcb->bufpos %= LIVEBUFBLOCKSIZE;
+        }
+        fcb->curpos = fcb->bufpos;
+    }
+    fcb->bufpos = (fcb->bufpos + ncep) % LIVEBUFBLOCKSIZE;
+    nbufcep += ncep;
+    if (endutt)
+        nbufcep += win;
 
-    return nfeatvec;
+    return feat_live_compute(fcb, nbufcep, endutt, ofeat);
 }
 
 void 
@@ -416,6 +416,48 @@ int32 feat_s2mfc2feat_live(feat_t  *fcb,     /**< In: Descriptor from feat_init(
                                                 about the size of this buffer above. */
     );
 
+/**
+ * Get space to write cepstra directly into the live mode buffer.
+ *
+ * This lets the front end write its output where
+ * feat_live_process() will use it, rather than into a separate
+ * buffer which feat_s2mfc2feat_live() then copies from.  The space
+ * returned is contiguous and always leaves room for end of
+ * utterance processing.
+ *
+ * @return Number of frames that may be written to
+ * <code>*out_cep</code>.
+ */
+int32 feat_live_inbuf(feat_t *fcb,      /**< In: Descriptor from feat_init() */
+                      int32 beginutt,   /**< In: Beginning of utterance flag */
+                      int32 maxfeat,    /**< In: Limit the frames so that no
+                                           more than this many feature vectors
+                                           are produced (not counting end of
+                                           utterance) */
+                      mfcc_t ***out_cep /**< Out: Where to write the frames */
+    );
+
+/**
+ * Compute features from frames written into the space returned by
+ * feat_live_inbuf().
+ *
+ * This is otherwise the same as feat_s2mfc2feat_live(), except that
+ * beginutt and endutt must be the same as they were (or will be) for
+ * feat_live_inbuf(), and that end of utterance processing is always
+ * done.  Whole utterances are not special-cased.
+ *
+ * @return The number of output frames actually computed.
+ */
+int32 feat_live_process(feat_t *fcb,    /**< In: Descriptor from feat_init() */
+                        int32 ncep,     /**< In: Number of frames written */
+                        int32 beginutt, /**< In: Beginning of utterance flag */
+                        int32 endutt,   /**< In: End of utterance flag */
+                        mfcc_t ***ofeat /**< In: Output feature buffer, with room
+                                           for the number of frames passed to
+                                           feat_live_inbuf() plus
+                                           feat_window_size() */
+    );
+
 
 /**
  * Update the normalization stats, possibly in the end of utterance
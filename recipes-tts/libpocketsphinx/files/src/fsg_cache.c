@@ -0,0 +1,187 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/**
+ * @file fsg_cache.c
+ * @brief Compiled JSGF grammars.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <pocketsphinx.h>
+
+#include "util/ckd_alloc.h"
+#include "lm/jsgf_internal.h"
+#include "fsg_cache.h"
+
+#define FNV64_BASIS 0xcbf29ce484222325ULL
+#define FNV64_PRIME 0x100000001b3ULL
+
+static uint64
+fsg_cache_fnv(uint64 h, void const *data, size_t len)
+{
+    uint8 const *p = data;
+
+    for (; len > 0; ++p, --len)
+        h = (h ^ *p) * FNV64_PRIME;
+    return h;
+}
+
+static uint64
+fsg_cache_fnv_str(uint64 h, char const *str)
+{
+    if (str == NULL)
+        str = "";
+    return fsg_cache_fnv(h, str, strlen(str) + 1);
+}
+
+/* Read all of a (small) file, NULL if it can't be read. */
+static char *
+fsg_cache_slurp(char const *path, size_t *out_len)
+{
+    FILE *fh;
+    char *buf;
+    long len;
+
+    if ((fh = fopen(path, "rb")) == NULL)
+        return NULL;
+    if (fseek(fh, 0, SEEK_END) < 0 || (len = ftell(fh)) < 0
+        || fseek(fh, 0, SEEK_SET) < 0) {
+        fclose(fh);
+        return NULL;
+    }
+    buf = ckd_malloc(len + 1);
+    if (fread(buf, 1, len, fh) != (size_t)len) {
+        ckd_free(buf);
+        fclose(fh);
+        return NULL;
+    }
+    buf[len] = '\0';
+    fclose(fh);
+    *out_len = len;
+    return buf;
+}
+
+/* Name of the compiled file for a grammar, everything that goes into
+ * jsgf_build_fsg() is in the hash. */
+static char *
+fsg_cache_path(ps_config_t *config, logmath_t *lmath,
+               char const *text, size_t len)
+{
+    char const *dir = ps_config_str(config, "fsgcache");
+    float64 lw, base;
+    uint64 h = FNV64_BASIS;
+    char *path;
+    size_t n;
+
+    h = fsg_cache_fnv(h, text, len);
+    h = fsg_cache_fnv_str(h, ps_config_str(config, "toprule"));
+    lw = ps_config_float(config, "lw");
+    h = fsg_cache_fnv(h, &lw, sizeof(lw));
+    base = logmath_get_base(lmath);
+    h = fsg_cache_fnv(h, &base, sizeof(base));
+
+    n = strlen(dir) + 32;
+    path = ckd_calloc(n, 1);
+    snprintf(path, n, "%s/%08x%08x.fsgb", dir,
+             (unsigned int)(h >> 32), (unsigned int)(h & 0xffffffff));
+    return path;
+}
+
+static fsg_model_t *
+fsg_cache_build(ps_config_t *config, logmath_t *lmath,
+                jsgf_t *jsgf, char const *what)
+{
+    jsgf_rule_t *rule;
+    char const *toprule;
+
+    /* Take the -toprule if specified. */
+    if ((toprule = ps_config_str(config, "toprule"))) {
+        rule = jsgf_get_rule(jsgf, toprule);
+        if (rule == NULL) {
+            E_ERROR("Start rule %s not found\n", toprule);
+            return NULL;
+        }
+    } else {
+        rule = jsgf_get_public_rule(jsgf);
+        if (rule == NULL) {
+            E_ERROR("No public rules found in %s\n", what);
+            return NULL;
+        }
+    }
+    return jsgf_build_fsg(jsgf, rule, lmath, ps_config_float(config, "lw"));
+}
+
+fsg_model_t *
+fsg_cache_load_jsgf(ps_config_t *config, logmath_t *lmath,
+                    char const *path, char const *string)
+{
+    fsg_model_t *fsg;
+    jsgf_t *jsgf;
+    char *text, *cachepath;
+    size_t len;
+
+    text = cachepath = NULL;
+    if (ps_config_str(config, "fsgcache")) {
+        if (path)
+            text = fsg_cache_slurp(path, &len);
+        else
+            len = strlen(string);
+        if (path == NULL || text)
+            cachepath = fsg_cache_path(config, lmath,
+                                       path ? text : string, len);
+        ckd_free(text);
+    }
+    if (cachepath && fsg_model_is_bin(cachepath)
+        && (fsg = fsg_model_read_bin(cachepath, lmath,
+                                     ps_config_float(config, "lw")))) {
+        ckd_free(cachepath);
+        return fsg;
+    }
+
+    jsgf = path ? jsgf_parse_file(path, NULL) : jsgf_parse_string(string, NULL);
+    if (jsgf == NULL) {
+        ckd_free(cachepath);
+        return NULL;
+    }
+    fsg = fsg_cache_build(config, lmath, jsgf,
+                          path ? path : "input string");
+    if (fsg && cachepath) {
+        if (hash_table_inuse(jsgf->imports) > 0)
+            E_INFO("Not caching %s since it imports other grammars\n",
+                   path ? path : "input string");
+        else
+            fsg_model_writefile_bin(fsg, cachepath);
+    }
+    jsgf_grammar_free(jsgf);
+    ckd_free(cachepath);
+    return fsg;
+}
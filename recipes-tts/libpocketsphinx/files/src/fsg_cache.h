@@ -0,0 +1,80 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/**
+ * @file fsg_cache.h
+ * @brief Compiled JSGF grammars.
+ *
+ * Parsing a JSGF grammar and expanding its rules into an FSG takes
+ * most of the time spent switching to it with ps_add_jsgf_file().
+ * When the "fsgcache" option names a directory, the resulting FSG is
+ * saved there in compiled form (see fsg_model_writefile_bin()) and
+ * later switches to the same grammar map it instead.
+ *
+ * Files are named by a hash of the grammar text, the start rule, the
+ * language weight and the log base, so an edited grammar simply gets
+ * a new file.  Grammars that import others are not cached, since
+ * their text alone doesn't determine the result.  Nothing is ever
+ * removed from the directory.
+ */
+
+#ifndef __FSG_CACHE_H__
+#define __FSG_CACHE_H__
+
+#include <pocketsphinx.h>
+
+#include "lm/fsg_model.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/**
+ * Build the FSG for a JSGF grammar.
+ *
+ * Uses the compiled file in -fsgcache if there is one, otherwise
+ * parses the grammar and (if -fsgcache is set) writes it there.  The
+ * start rule is -toprule, or the first public rule.
+ *
+ * @param path JSGF file, or NULL to use string.
+ * @param string JSGF grammar text, if path is NULL.
+ * @return Newly created FSG, or NULL on error.
+ */
+fsg_model_t *fsg_cache_load_jsgf(ps_config_t *config, logmath_t *lmath,
+                                 char const *path, char const *string);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FSG_CACHE_H__ */
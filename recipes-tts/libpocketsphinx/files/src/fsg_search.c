@@ -67,7 +67,11 @@
 #define __FSG_DBG_CHAN__	0
 #define __FSG_ALLOW_BESTPATH__	1
 
+/* Number of HMMs handed to hmm_vit_eval_batch() at a time. */
+#define FSG_EVAL_BLOCK 64
+
 static ps_seg_t *fsg_search_seg_iter(ps_search_t *search);
+static ps_seg_t *fsg_search_stable_seg_iter(ps_search_t *search);
 static ps_lattice_t *fsg_search_lattice(ps_search_t *search);
 static int fsg_search_prob(ps_search_t *search);
 
@@ -81,6 +85,7 @@ static ps_searchfuncs_t fsg_funcs = {
     /* hyp: */      fsg_search_hyp,
     /* prob: */     fsg_search_prob,
     /* seg_iter: */ fsg_search_seg_iter,
+    /* stable_seg_iter: */ fsg_search_stable_seg_iter,
 };
 
 static int
@@ -280,6 +285,8 @@ fsg_search_free(ps_search_t *search)
     }
     hmm_context_free(fsgs->hmmctx);
     fsg_model_free(fsgs->fsg);
+    bitvec_free(fsgs->live_hist);
+    ckd_free(fsgs->stable_hyp);
     ckd_free(fsgs);
 }
 
@@ -306,6 +313,9 @@ fsg_search_reinit(ps_search_t *search, dict_t *dict, dict2pid_t *d2p)
     /* Inform the history module of the new fsg */
     fsg_history_set_fsg(fsgs->history, fsgs->fsg, dict);
 
+    /* Null transitions are followed from a flat table when decoding */
+    fsg_model_null_compile(fsgs->fsg);
+
     return 0;
 }
 
@@ -348,6 +358,7 @@ fsg_search_hmm_eval(fsg_search_t *fsgs)
         return;
     }
 
+#if __FSG_DBG__ || __FSG_DBG_CHAN__
     for (n = 0, gn = fsgs->pnode_active; gn; gn = gnode_next(gn), n++) {
         int32 score;
 
@@ -370,6 +381,27 @@ fsg_search_hmm_eval(fsg_search_t *fsgs)
         if (score BETTER_THAN bestscore)
             bestscore = score;
     }
+#else
+    /* Hand the active HMMs to hmm_vit_eval_batch() a block at a time. */
+    n = 0;
+    gn = fsgs->pnode_active;
+    while (gn) {
+        hmm_t *block[FSG_EVAL_BLOCK];
+        int32 n_block, score;
+
+        for (n_block = 0; gn && n_block < FSG_EVAL_BLOCK;
+             gn = gnode_next(gn)) {
+            pnode = (fsg_pnode_t *) gnode_ptr(gn);
+            hmm = fsg_pnode_hmmptr(pnode);
+            assert(hmm_frame(hmm) == fsgs->frame);
+            block[n_block++] = hmm;
+        }
+        score = hmm_vit_eval_batch(block, n_block);
+        if (score BETTER_THAN bestscore)
+            bestscore = score;
+        n += n_block;
+    }
+#endif
 
 #if __FSG_DBG__
     E_INFO("[%5d] %6d HMM; bestscr: %11d\n", fsgs->frame, n, bestscore);
@@ -562,16 +594,19 @@ fsg_search_null_prop(fsg_search_t *fsgs)
     int32 bpidx, n_entries, thresh, newscore;
     fsg_hist_entry_t *hist_entry;
     fsg_link_t *l;
-    int32 s;
+    int32 s, i, n_null;
     fsg_model_t *fsg;
 
     fsg = fsgs->fsg;
     thresh = fsgs->bestscore + fsgs->wbeam; /* Which beam really?? */
 
+    /* Null transitions were added since the search was set up. */
+    if (fsg->null_index == NULL)
+        fsg_model_null_compile(fsg);
+
     n_entries = fsg_history_n_entries(fsgs->history);
 
     for (bpidx = fsgs->bpidx_start; bpidx < n_entries; bpidx++) {
-        fsg_arciter_t *itor;
         hist_entry = fsg_history_entry_get(fsgs->history, bpidx);
 
         l = fsg_hist_entry_fsglink(hist_entry);
@@ -584,20 +619,17 @@ fsg_search_null_prop(fsg_search_t *fsgs)
          * propagate one step, since FSG contains transitive closure of null
          * transitions.)
          */
-        /* Add all links from from_state to dst */
-        for (itor = fsg_model_arcs(fsg, s); itor;
-             itor = fsg_arciter_next(itor)) {
-            fsg_link_t *l = fsg_arciter_get(itor);
+        /* FIXME: Need to deal with tag transitions somehow. */
+        n_null = fsg_model_n_null(fsg, s);
+        for (i = 0; i < n_null; ++i) {
+            fsg_link_t *nl = fsg_model_null(fsg, s, i);
 
-            /* FIXME: Need to deal with tag transitions somehow. */
-            if (fsg_link_wid(l) != -1)
-                continue;
             newscore =
                 fsg_hist_entry_score(hist_entry) +
-                (fsg_link_logs2prob(l) >> SENSCR_SHIFT);
+                (fsg_link_logs2prob(nl) >> SENSCR_SHIFT);
 
             if (newscore >= thresh) {
-                fsg_history_entry_add(fsgs->history, l,
+                fsg_history_entry_add(fsgs->history, nl,
                                       fsg_hist_entry_frame(hist_entry),
                                       newscore,
                                       bpidx,
@@ -792,6 +824,10 @@ fsg_search_start(ps_search_t *search)
     fsg_history_reset(fsgs->history);
     fsg_history_utt_start(fsgs->history);
     fsgs->final = FALSE;
+    ckd_free(fsgs->stable_hyp);
+    fsgs->stable_hyp = NULL;
+    fsgs->stable_bp = fsgs->reported_bp = 0;
+    fsgs->stable_frame = 0;
 
     /* Dummy context structure that allows all right contexts to use this entry */
     fsg_pnode_add_all_ctxt(&ctxt);
@@ -974,42 +1010,22 @@ fsg_search_bestpath(ps_search_t *search, int32 *out_score, int backward)
     return search->last_link;
 }
 
-char const *
-fsg_search_hyp(ps_search_t *search, int32 *out_score)
+/**
+ * Build the hypothesis string for the backtrace from bpidx, taking
+ * the words up to stop_bp from prefix if the backtrace reaches it.
+ */
+static char *
+fsg_search_bp_str(fsg_search_t *fsgs, int bpidx,
+                  int stop_bp, char const *prefix)
 {
-    fsg_search_t *fsgs = (fsg_search_t *)search;
-    dict_t *dict = ps_search_dict(search);
-    char *c;
-    size_t len;
-    int bp, bpidx;
-
-    /* Get last backpointer table index. */
-    bpidx = fsg_search_find_exit(fsgs, fsgs->frame, fsgs->final, out_score);
-    /* No hypothesis (yet). */
-    if (bpidx <= 0) {
-        return NULL;
-    }
-
-    /* If bestpath is enabled and the utterance is complete, then run it.
-     * Note that setting bestpath in fsg_search_init is disabled by default. */
-    if (fsgs->bestpath && fsgs->final) {
-        ps_lattice_t *dag;
-        ps_latlink_t *link;
-
-        if ((dag = fsg_search_lattice(search)) == NULL) {
-    	    E_WARN("Failed to obtain the lattice while bestpath enabled\n");
-            return NULL;
-        }
-        if ((link = fsg_search_bestpath(search, out_score, FALSE)) == NULL) {
-    	    E_WARN("Failed to find the bestpath in a lattice\n");
-            return NULL;
-        }
-        return ps_lattice_hyp(dag, link);
-    }
+    dict_t *dict = ps_search_dict(fsgs);
+    char *str, *c;
+    size_t len, plen;
+    int bp;
 
     bp = bpidx;
     len = 0;
-    while (bp > 0) {
+    while (bp > 0 && bp != stop_bp) {
         fsg_hist_entry_t *hist_entry = fsg_history_entry_get(fsgs->history, bp);
         fsg_link_t *fl = fsg_hist_entry_fsglink(hist_entry);
         char const *baseword;
@@ -1024,17 +1040,18 @@ fsg_search_hyp(ps_search_t *search, int32 *out_score)
                                             fsg_model_word_str(fsgs->fsg, wid)));
         len += strlen(baseword) + 1;
     }
-    
-    ckd_free(search->hyp_str);
-    if (len == 0) {
-	search->hyp_str = NULL;
-	return search->hyp_str;
-    }
-    search->hyp_str = ckd_calloc(1, len);
+    plen = (bp > 0 && prefix) ? strlen(prefix) : 0;
+    if (len == 0 && plen == 0)
+        return NULL;
+    if (plen == 0)
+        len -= 1; /* No leading space. */
+    str = ckd_calloc(1, plen + len + 1);
+    if (plen)
+        memcpy(str, prefix, plen);
 
     bp = bpidx;
-    c = search->hyp_str + len - 1;
-    while (bp > 0) {
+    c = str + plen + len;
+    while (bp > 0 && bp != stop_bp) {
         fsg_hist_entry_t *hist_entry = fsg_history_entry_get(fsgs->history, bp);
         fsg_link_t *fl = fsg_hist_entry_fsglink(hist_entry);
         char const *baseword;
@@ -1050,12 +1067,140 @@ fsg_search_hyp(ps_search_t *search, int32 *out_score)
         len = strlen(baseword);
         c -= len;
         memcpy(c, baseword, len);
-        if (c > search->hyp_str) {
+        if (c > str) {
             --c;
             *c = ' ';
         }
     }
 
+    return str;
+}
+
+static void
+fsg_search_mark_live(fsg_search_t *fsgs, int32 bp)
+{
+    if (bp <= 0 || bp < fsgs->stable_bp) {
+        fsgs->live_root = TRUE;
+        return;
+    }
+    if (bitvec_is_clear(fsgs->live_hist, bp)) {
+        bitvec_set(fsgs->live_hist, bp);
+        ++fsgs->n_live;
+    }
+}
+
+/**
+ * Advance stable_bp to the latest history entry shared by every path
+ * still being searched, same as ngram_search_update_stable().
+ */
+static void
+fsg_search_update_stable(fsg_search_t *fsgs)
+{
+    fsg_hist_entry_t *hist_entry;
+    gnode_t *gn;
+    int32 n_hist, bp, lo, frm;
+    char *hyp;
+    int i;
+
+    if (fsgs->frame == fsgs->stable_frame)
+        return;
+    fsgs->stable_frame = fsgs->frame;
+    n_hist = fsg_history_n_entries(fsgs->history);
+    if (fsgs->n_live_hist_alloc < n_hist) {
+        fsgs->live_hist = bitvec_realloc(fsgs->live_hist,
+                                         fsgs->n_live_hist_alloc, n_hist);
+        fsgs->n_live_hist_alloc = n_hist;
+    }
+    fsgs->n_live = 0;
+    fsgs->live_root = FALSE;
+
+    /* Histories of the HMMs to be searched in the next frame. */
+    for (gn = fsgs->pnode_active; gn; gn = gnode_next(gn)) {
+        hmm_t *hmm = fsg_pnode_hmmptr((fsg_pnode_t *) gnode_ptr(gn));
+        for (i = 0; i < hmm_n_emit_state(hmm); ++i)
+            if (hmm_score(hmm, i) BETTER_THAN WORST_SCORE)
+                fsg_search_mark_live(fsgs, hmm_history(hmm, i));
+    }
+    /* Entries in the last frame, which may yet be the final ones. */
+    bp = n_hist - 1;
+    hist_entry = fsg_history_entry_get(fsgs->history, bp);
+    frm = fsg_hist_entry_frame(hist_entry);
+    while (bp > 0 && !fsgs->live_root) {
+        hist_entry = fsg_history_entry_get(fsgs->history, bp);
+        if (fsg_hist_entry_frame(hist_entry) != frm)
+            break;
+        fsg_search_mark_live(fsgs, bp);
+        --bp;
+    }
+    if (n_hist == 1)
+        fsgs->live_root = TRUE;
+
+    lo = (fsgs->stable_bp > 0) ? fsgs->stable_bp : 1;
+    for (bp = n_hist - 1; bp >= lo && !fsgs->live_root; --bp) {
+        if (fsgs->live_hist[bp / BITVEC_BITS] == 0) {
+            bp -= bp % BITVEC_BITS;
+            continue;
+        }
+        if (bitvec_is_clear(fsgs->live_hist, bp))
+            continue;
+        bitvec_clear(fsgs->live_hist, bp);
+        if (fsgs->n_live == 1)
+            break;
+        --fsgs->n_live;
+        hist_entry = fsg_history_entry_get(fsgs->history, bp);
+        fsg_search_mark_live(fsgs, fsg_hist_entry_pred(hist_entry));
+    }
+    if (fsgs->live_root || bp < lo) {
+        memset(fsgs->live_hist + lo / BITVEC_BITS, 0,
+               (bitvec_size(n_hist) - lo / BITVEC_BITS)
+               * sizeof(*fsgs->live_hist));
+        return;
+    }
+    if (bp == fsgs->stable_bp)
+        return;
+
+    hyp = fsg_search_bp_str(fsgs, bp, fsgs->stable_bp, fsgs->stable_hyp);
+    ckd_free(fsgs->stable_hyp);
+    fsgs->stable_hyp = hyp;
+    fsgs->stable_bp = bp;
+}
+
+char const *
+fsg_search_hyp(ps_search_t *search, int32 *out_score)
+{
+    fsg_search_t *fsgs = (fsg_search_t *)search;
+    int bpidx;
+
+    if (!fsgs->final
+        && fsgs->frame >= fsgs->stable_frame + PS_STABLE_HYP_INTERVAL)
+        fsg_search_update_stable(fsgs);
+    /* Get last backpointer table index. */
+    bpidx = fsg_search_find_exit(fsgs, fsgs->frame, fsgs->final, out_score);
+    /* No hypothesis (yet). */
+    if (bpidx <= 0) {
+        return NULL;
+    }
+
+    /* If bestpath is enabled and the utterance is complete, then run it.
+     * Note that setting bestpath in fsg_search_init is disabled by default. */
+    if (fsgs->bestpath && fsgs->final) {
+        ps_lattice_t *dag;
+        ps_latlink_t *link;
+
+        if ((dag = fsg_search_lattice(search)) == NULL) {
+    	    E_WARN("Failed to obtain the lattice while bestpath enabled\n");
+            return NULL;
+        }
+        if ((link = fsg_search_bestpath(search, out_score, FALSE)) == NULL) {
+    	    E_WARN("Failed to find the bestpath in a lattice\n");
+            return NULL;
+        }
+        return ps_lattice_hyp(dag, link);
+    }
+
+    ckd_free(search->hyp_str);
+    search->hyp_str = fsg_search_bp_str(fsgs, bpidx,
+                                        fsgs->stable_bp, fsgs->stable_hyp);
     return search->hyp_str;
 }
 
@@ -1120,30 +1265,10 @@ static ps_segfuncs_t fsg_segfuncs = {
 };
 
 static ps_seg_t *
-fsg_search_seg_iter(ps_search_t *search)
+fsg_search_hist_iter(fsg_search_t *fsgs, int bpidx, int stop_bp)
 {
-    fsg_search_t *fsgs = (fsg_search_t *)search;
     fsg_seg_t *itor;
-    int32 out_score;
-    int bp, bpidx, cur;
-
-    bpidx = fsg_search_find_exit(fsgs, fsgs->frame, fsgs->final, &out_score);
-    /* No hypothesis (yet). */
-    if (bpidx <= 0)
-        return NULL;
-
-    /* If bestpath is enabled and the utterance is complete, then run it.
-     * Note that setting bestpath in fsg_search_init is disabled by default. */
-    if (fsgs->bestpath && fsgs->final) {
-        ps_lattice_t *dag;
-        ps_latlink_t *link;
-
-        if ((dag = fsg_search_lattice(search)) == NULL)
-            return NULL;
-        if ((link = fsg_search_bestpath(search, &out_score, TRUE)) == NULL)
-            return NULL;
-        return ps_lattice_seg_iter(dag, link, 1.0);
-    }
+    int bp, cur;
 
     /* Calling this an "iterator" is a bit of a misnomer since we have
      * to get the entire backtrace in order to produce it.  On the
@@ -1151,11 +1276,11 @@ fsg_search_seg_iter(ps_search_t *search)
      * allocate a fixed-size array of them. */
     itor = ckd_calloc(1, sizeof(*itor));
     itor->base.vt = &fsg_segfuncs;
-    itor->base.search = search;
+    itor->base.search = ps_search_base(fsgs);
     itor->base.lwf = 1.0;
     itor->n_hist = 0;
     bp = bpidx;
-    while (bp > 0) {
+    while (bp > 0 && bp != stop_bp) {
         fsg_hist_entry_t *hist_entry = fsg_history_entry_get(fsgs->history, bp);
         bp = fsg_hist_entry_pred(hist_entry);
         ++itor->n_hist;
@@ -1167,7 +1292,7 @@ fsg_search_seg_iter(ps_search_t *search)
     itor->hist = ckd_calloc(itor->n_hist, sizeof(*itor->hist));
     cur = itor->n_hist - 1;
     bp = bpidx;
-    while (bp > 0) {
+    while (bp > 0 && bp != stop_bp) {
         fsg_hist_entry_t *hist_entry = fsg_history_entry_get(fsgs->history, bp);
         itor->hist[cur] = hist_entry;
         bp = fsg_hist_entry_pred(hist_entry);
@@ -1180,6 +1305,66 @@ fsg_search_seg_iter(ps_search_t *search)
     return (ps_seg_t *)itor;
 }
 
+static ps_seg_t *
+fsg_search_seg_iter(ps_search_t *search)
+{
+    fsg_search_t *fsgs = (fsg_search_t *)search;
+    int32 out_score;
+    int bpidx;
+
+    bpidx = fsg_search_find_exit(fsgs, fsgs->frame, fsgs->final, &out_score);
+    /* No hypothesis (yet). */
+    if (bpidx <= 0)
+        return NULL;
+
+    /* If bestpath is enabled and the utterance is complete, then run it.
+     * Note that setting bestpath in fsg_search_init is disabled by default. */
+    if (fsgs->bestpath && fsgs->final) {
+        ps_lattice_t *dag;
+        ps_latlink_t *link;
+
+        if ((dag = fsg_search_lattice(search)) == NULL)
+            return NULL;
+        if ((link = fsg_search_bestpath(search, &out_score, TRUE)) == NULL)
+            return NULL;
+        return ps_lattice_seg_iter(dag, link, 1.0);
+    }
+
+    return fsg_search_hist_iter(fsgs, bpidx, 0);
+}
+
+static ps_seg_t *
+fsg_search_stable_seg_iter(ps_search_t *search)
+{
+    fsg_search_t *fsgs = (fsg_search_t *)search;
+    ps_seg_t *itor;
+
+    if (fsgs->final) {
+        int bp, bpidx;
+
+        if (fsgs->bestpath)
+            return NULL;
+        bpidx = fsg_search_find_exit(fsgs, fsgs->frame, TRUE, NULL);
+        for (bp = bpidx; bp > fsgs->reported_bp;
+             bp = fsg_hist_entry_pred(fsg_history_entry_get(fsgs->history, bp)))
+            ;
+        if (bpidx < 0 || bp != fsgs->reported_bp)
+            return NULL;
+        itor = fsg_search_hist_iter(fsgs, bpidx, fsgs->reported_bp);
+        fsgs->reported_bp = bpidx;
+        search->stable_ef = MAX_INT32;
+        return itor;
+    }
+    fsg_search_update_stable(fsgs);
+    if (fsgs->stable_bp == fsgs->reported_bp)
+        return NULL;
+    itor = fsg_search_hist_iter(fsgs, fsgs->stable_bp, fsgs->reported_bp);
+    fsgs->reported_bp = fsgs->stable_bp;
+    search->stable_ef = fsg_hist_entry_frame
+        (fsg_history_entry_get(fsgs->history, fsgs->stable_bp));
+    return itor;
+}
+
 static int
 fsg_search_prob(ps_search_t *search)
 {
@@ -1203,24 +1388,75 @@ fsg_search_prob(ps_search_t *search)
     }
 }
 
+/**
+ * Index of lattice nodes by (start frame, word, FSG state), so that
+ * building the lattice doesn't have to search the node list for every
+ * history entry and arc.
+ */
+typedef struct latnode_tab_s {
+    ps_latnode_t **ent; /**< Open addressing, NULL for free slots. */
+    int32 size;         /**< Number of slots, a power of two. */
+    int32 count;        /**< Number of nodes in it. */
+} latnode_tab_t;
+
+static uint32
+latnode_hash(int sf, int32 wid, int32 node_id)
+{
+    uint32 h;
+
+    h = (uint32)sf * 0x9e3779b1U;
+    h ^= (uint32)wid * 0x85ebca6bU;
+    h ^= (uint32)node_id * 0xc2b2ae35U;
+    return h ^ (h >> 15);
+}
+
+static void
+latnode_tab_insert(latnode_tab_t *tab, ps_latnode_t *node)
+{
+    uint32 i;
+
+    if ((tab->count + 1) * 2 > tab->size) {
+        ps_latnode_t **old = tab->ent;
+        int32 j, old_size = tab->size;
+
+        tab->size = old_size ? old_size * 2 : 1024;
+        tab->ent = ckd_calloc(tab->size, sizeof(*tab->ent));
+        tab->count = 0;
+        for (j = 0; j < old_size; ++j)
+            if (old[j])
+                latnode_tab_insert(tab, old[j]);
+        ckd_free(old);
+    }
+    i = latnode_hash(node->sf, node->wid, node->node_id) & (tab->size - 1);
+    while (tab->ent[i])
+        i = (i + 1) & (tab->size - 1);
+    tab->ent[i] = node;
+    ++tab->count;
+}
+
 static ps_latnode_t *
-find_node(ps_lattice_t *dag, fsg_model_t *fsg, int sf, int32 wid, int32 node_id)
+find_node(latnode_tab_t *tab, int sf, int32 wid, int32 node_id)
 {
     ps_latnode_t *node;
+    uint32 i;
 
-    (void)fsg;
-    for (node = dag->nodes; node; node = node->next)
+    if (tab->size == 0)
+        return NULL;
+    i = latnode_hash(sf, wid, node_id) & (tab->size - 1);
+    while ((node = tab->ent[i]) != NULL) {
         if ((node->sf == sf) && (node->wid == wid) && (node->node_id == node_id))
             break;
+        i = (i + 1) & (tab->size - 1);
+    }
     return node;
 }
 
 static ps_latnode_t *
-new_node(ps_lattice_t *dag, fsg_model_t *fsg, int sf, int ef, int32 wid, int32 node_id, int32 ascr)
+new_node(ps_lattice_t *dag, latnode_tab_t *tab, int sf, int ef, int32 wid, int32 node_id, int32 ascr)
 {
     ps_latnode_t *node;
 
-    node = find_node(dag, fsg, sf, wid, node_id);
+    node = tab ? find_node(tab, sf, wid, node_id) : NULL;
 
     if (node) {
         /* Update end frames. */
@@ -1247,11 +1483,99 @@ new_node(ps_lattice_t *dag, fsg_model_t *fsg, int sf, int ef, int32 wid, int32 n
         node->next = dag->nodes;
         dag->nodes = node;
         ++dag->n_nodes;
+        if (tab)
+            latnode_tab_insert(tab, node);
     }
 
     return node;
 }
 
+/**
+ * Words that can follow each FSG state, looking through null
+ * transitions, built as needed while making a lattice.
+ */
+typedef struct succ_tab_s {
+    int32 *start;      /**< First entry in links for each state, or -1. */
+    int32 *count;      /**< Number of entries for each state. */
+    fsg_link_t **links;
+    int32 n_links, n_alloc;
+} succ_tab_t;
+
+static void
+succ_tab_add(succ_tab_t *succ, fsg_link_t *link)
+{
+    if (succ->n_links == succ->n_alloc) {
+        succ->n_alloc = succ->n_alloc ? succ->n_alloc * 2 : 256;
+        succ->links = ckd_realloc(succ->links,
+                                  succ->n_alloc * sizeof(*succ->links));
+    }
+    succ->links[succ->n_links++] = link;
+}
+
+static fsg_link_t **
+succ_tab_get(succ_tab_t *succ, fsg_model_t *fsg, int32 state, int32 *out_n)
+{
+    fsg_arciter_t *itor;
+
+    if (succ->start[state] == -1) {
+        succ->start[state] = succ->n_links;
+        for (itor = fsg_model_arcs(fsg, state);
+             itor; itor = fsg_arciter_next(itor)) {
+            fsg_link_t *link = fsg_arciter_get(itor);
+
+            /* FIXME: Need to figure out what to do about tag transitions. */
+            if (link->wid >= 0) {
+                succ_tab_add(succ, link);
+            }
+            else {
+                /*
+                 * Transitive closure on nulls has already been done, so we
+                 * just need to look one link forward from them.
+                 */
+                fsg_arciter_t *itor2;
+
+                /* Add all non-null links out of j. */
+                for (itor2 = fsg_model_arcs(fsg, fsg_link_to_state(link));
+                     itor2; itor2 = fsg_arciter_next(itor2)) {
+                    fsg_link_t *link = fsg_arciter_get(itor2);
+
+                    if (link->wid != -1)
+                        succ_tab_add(succ, link);
+                }
+            }
+        }
+        succ->count[state] = succ->n_links - succ->start[state];
+    }
+    *out_n = succ->count[state];
+    return succ->links + succ->start[state];
+}
+
+/**
+ * Link src, a node ending in frame ef, to all the nodes that can
+ * follow it in the next frame.  This must only be done once for each
+ * node and frame.
+ */
+static void
+link_successors(ps_lattice_t *dag, fsg_model_t *fsg, latnode_tab_t *tab,
+                succ_tab_t *succ, ps_latnode_t *src, int32 ascr, int ef)
+{
+    latlink_list_t *prev_exits;
+    fsg_link_t **links;
+    int32 i, n;
+
+    /* Links from earlier frames go to nodes starting elsewhere, so
+     * only the ones added here could be duplicates. */
+    prev_exits = src->exits;
+    links = succ_tab_get(succ, fsg, src->node_id, &n);
+    for (i = 0; i < n; ++i) {
+        ps_latnode_t *dest;
+
+        if ((dest = find_node(tab, ef + 1, links[i]->wid,
+                              fsg_link_to_state(links[i]))) != NULL)
+            ps_lattice_link_since(dag, src, dest, ascr, ef, prev_exits);
+    }
+}
+
 static ps_latnode_t *
 find_start_node(fsg_search_t *fsgs, ps_lattice_t *dag)
 {
@@ -1283,7 +1607,7 @@ find_start_node(fsg_search_t *fsgs, ps_lattice_t *dag)
         wid = fsg_model_word_add(fsgs->fsg, "<s>");
         if (fsgs->fsg->silwords)
             bitvec_set(fsgs->fsg->silwords, wid);
-        node = new_node(dag, fsgs->fsg, 0, 0, wid, -1, 0);
+        node = new_node(dag, NULL, 0, 0, wid, -1, 0);
         for (st = start; st; st = gnode_next(st))
             ps_lattice_link(dag, node, gnode_ptr(st), 0, 0);
     }
@@ -1339,7 +1663,7 @@ find_end_node(fsg_search_t *fsgs, ps_lattice_t *dag)
         wid = fsg_model_word_add(fsgs->fsg, "</s>");
         if (fsgs->fsg->silwords)
             bitvec_set(fsgs->fsg->silwords, wid);
-        node = new_node(dag, fsgs->fsg, fsgs->frame, fsgs->frame, wid, -1, 0);
+        node = new_node(dag, NULL, fsgs->frame, fsgs->frame, wid, -1, 0);
         /* Use the "best" (in reality it will be the only) exit link
          * score from this final node as the link score. */
         for (st = end; st; st = gnode_next(st)) {
@@ -1392,7 +1716,11 @@ fsg_search_lattice(ps_search_t *search)
     fsg_model_t *fsg;
     ps_latnode_t *node;
     ps_lattice_t *dag;
-    int32 i, n;
+    latnode_tab_t tab;
+    succ_tab_t succ;
+    ps_latnode_t **grp_src;
+    int32 *grp_ascr;
+    int32 i, n, n_grp_alloc;
 
     fsgs = (fsg_search_t *)search;
 
@@ -1406,6 +1734,7 @@ fsg_search_lattice(ps_search_t *search)
     search->dag = NULL;
     dag = ps_lattice_init_search(search, fsgs->frame);
     fsg = fsgs->fsg;
+    memset(&tab, 0, sizeof(tab));
 
     /*
      * Each history table entry represents a link in the word graph.
@@ -1447,73 +1776,77 @@ fsg_search_lattice(ps_search_t *search)
          * destination node, and thus we need to preserve its score in
          * case it turns out to be utterance-final.
          */
-        new_node(dag, fsg, sf, fh->frame, fh->fsglink->wid, fsg_link_to_state(fh->fsglink), ascr);
+        new_node(dag, &tab, sf, fh->frame, fh->fsglink->wid, fsg_link_to_state(fh->fsglink), ascr);
     }
 
     /*
      * Now, we will create links only to nodes that actually exist.
+     * All the entries for the same node ending in the same frame
+     * lead to the same successors, so only the best of them is
+     * expanded.  The node ID is free until the lattice is complete,
+     * so it holds the node's position in grp_src.
      */
     n = fsg_history_n_entries(fsgs->history);
-    for (i = 0; i < n; ++i) {
-        fsg_hist_entry_t *fh = fsg_history_entry_get(fsgs->history, i);
-        fsg_arciter_t *itor;
-        ps_latnode_t *src, *dest;
-        int32 ascr;
-        int sf;
-
-        /* Skip null transitions. */
-        if (fh->fsglink == NULL || fh->fsglink->wid == -1)
-            continue;
-
-        /* Find the start node of this link and calculate its link score. */
-        if (fh->pred) {
-            fsg_hist_entry_t *pfh = fsg_history_entry_get(fsgs->history, fh->pred);
-            sf = pfh->frame + 1;
-            ascr = fh->score - pfh->score;
-        }
-        else {
-            ascr = fh->score;
-            sf = 0;
-        }
-        src = find_node(dag, fsg, sf, fh->fsglink->wid, fsg_link_to_state(fh->fsglink));
-        sf = fh->frame + 1;
+    memset(&succ, 0, sizeof(succ));
+    succ.start = ckd_malloc(fsg_model_n_state(fsg) * sizeof(*succ.start));
+    memset(succ.start, -1, fsg_model_n_state(fsg) * sizeof(*succ.start));
+    succ.count = ckd_calloc(fsg_model_n_state(fsg), sizeof(*succ.count));
+    n_grp_alloc = 256;
+    grp_src = ckd_calloc(n_grp_alloc, sizeof(*grp_src));
+    grp_ascr = ckd_calloc(n_grp_alloc, sizeof(*grp_ascr));
+    for (i = 0; i < n;) {
+        int32 frame, n_grp, j;
+
+        frame = fsg_hist_entry_frame(fsg_history_entry_get(fsgs->history, i));
+        n_grp = 0;
+        for (; i < n; ++i) {
+            fsg_hist_entry_t *fh = fsg_history_entry_get(fsgs->history, i);
+            ps_latnode_t *src;
+            int32 ascr;
+            int sf;
+
+            if (fh->frame != frame)
+                break;
+            /* Skip null transitions. */
+            if (fh->fsglink == NULL || fh->fsglink->wid == -1)
+                continue;
 
-        for (itor = fsg_model_arcs(fsg, fsg_link_to_state(fh->fsglink));
-             itor; itor = fsg_arciter_next(itor)) {
-            fsg_link_t *link = fsg_arciter_get(itor);
-            
-            /* FIXME: Need to figure out what to do about tag transitions. */
-            if (link->wid >= 0) {
-                /*
-                 * For each non-epsilon link following this one, look for a
-                 * matching node in the lattice and link to it.
-                 */
-                if ((dest = find_node(dag, fsg, sf, link->wid, fsg_link_to_state(link))) != NULL)
-            	    ps_lattice_link(dag, src, dest, ascr, fh->frame);
+            /* Find the start node of this link and calculate its link score. */
+            if (fh->pred) {
+                fsg_hist_entry_t *pfh = fsg_history_entry_get(fsgs->history, fh->pred);
+                sf = pfh->frame + 1;
+                ascr = fh->score - pfh->score;
             }
             else {
-                /*
-                 * Transitive closure on nulls has already been done, so we
-                 * just need to look one link forward from them.
-                 */
-                fsg_arciter_t *itor2;
-                
-                /* Add all non-null links out of j. */
-                for (itor2 = fsg_model_arcs(fsg, fsg_link_to_state(link));
-                     itor2; itor2 = fsg_arciter_next(itor2)) {
-                    fsg_link_t *link = fsg_arciter_get(itor2);
-
-                    if (link->wid == -1)
-                        continue;
-                    
-                    if ((dest = find_node(dag, fsg, sf, link->wid, fsg_link_to_state(link))) != NULL) {
-                        ps_lattice_link(dag, src, dest, ascr, fh->frame);
-                    }
-                }
+                ascr = fh->score;
+                sf = 0;
             }
+            src = find_node(&tab, sf, fh->fsglink->wid, fsg_link_to_state(fh->fsglink));
+            if (src->id >= 0 && src->id < n_grp && grp_src[src->id] == src) {
+                if (ascr BETTER_THAN grp_ascr[src->id])
+                    grp_ascr[src->id] = ascr;
+                continue;
+            }
+            if (n_grp == n_grp_alloc) {
+                n_grp_alloc *= 2;
+                grp_src = ckd_realloc(grp_src, n_grp_alloc * sizeof(*grp_src));
+                grp_ascr = ckd_realloc(grp_ascr, n_grp_alloc * sizeof(*grp_ascr));
+            }
+            src->id = n_grp;
+            grp_src[n_grp] = src;
+            grp_ascr[n_grp] = ascr;
+            ++n_grp;
         }
+        for (j = 0; j < n_grp; ++j)
+            link_successors(dag, fsg, &tab, &succ,
+                            grp_src[j], grp_ascr[j], frame);
     }
-
+    ckd_free(grp_src);
+    ckd_free(grp_ascr);
+    ckd_free(succ.start);
+    ckd_free(succ.count);
+    ckd_free(succ.links);
+    ckd_free(tab.ent);
 
     /* Figure out which nodes are the start and end nodes. */
     if ((dag->start = find_start_node(fsgs, dag)) == NULL) {
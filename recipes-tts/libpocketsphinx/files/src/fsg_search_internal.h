@@ -44,6 +44,7 @@
 #include <pocketsphinx.h>
 
 #include "util/glist.h"
+#include "util/bitvec.h"
 #include "lm/fsg_model.h"
 #include "pocketsphinx_internal.h"
 #include "hmm.h"
@@ -101,6 +102,15 @@ typedef struct fsg_search_s {
 
     int32 bestscore;		/**< For beam pruning */
     int32 bpidx_start;		/**< First history entry index this frame */
+
+    bitvec_t *live_hist;        /**< History entries in use, scratch space. */
+    int32 n_live_hist_alloc;    /**< Number of bits in live_hist. */
+    int32 n_live;               /**< Number of them set in live_hist. */
+    int32 live_root;            /**< Some path goes back to the start. */
+    int32 stable_bp;            /**< Latest entry on every path, or 0. */
+    int32 stable_frame;         /**< Frame when stable_bp was last updated. */
+    int32 reported_bp;          /**< Latest one returned by stable_seg_iter. */
+    char *stable_hyp;           /**< Hypothesis string up to stable_bp. */
   
     int32 ascr, lscr;		/**< Total acoustic and lm score for utt */
   
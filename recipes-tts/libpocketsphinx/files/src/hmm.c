@@ -49,6 +49,14 @@
 #include "util/ckd_alloc.h"
 #include "hmm.h"
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HMM_VIT_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define HMM_VIT_SSE2
+#include <emmintrin.h>
+#endif
+
 hmm_context_t *
 hmm_context_init(int32 n_emit_state,
 		 uint8 ** const *tp,
@@ -804,6 +812,204 @@ hmm_vit_eval(hmm_t * hmm)
     }
 }
 
+/*
+ * Batched evaluation of non-multiplex 3-state HMMs.
+ *
+ * The scalar version above is mostly data-dependent branches, which
+ * the search can't predict.  Here the state scores, histories and
+ * senone scores of a block of HMMs are transposed into one lane per
+ * HMM and the same recursion is done with compares and selects.  It
+ * follows hmm_vit_eval_3st_lr() exactly, including carrying the 1->3
+ * skip score into state 2 when there is no 0->2 skip.
+ */
+#if defined(HMM_VIT_NEON) || defined(HMM_VIT_SSE2)
+#define HMM_VIT_LANES 4
+
+/* Inputs and outputs of one block, one row per quantity. */
+enum {
+    LANE_S0, LANE_S1, LANE_S2,          /* state scores */
+    LANE_H0, LANE_H1, LANE_H2,          /* state histories */
+    LANE_E0, LANE_E1, LANE_E2,          /* senone scores */
+    LANE_OUT, LANE_OUTH,                /* exit state */
+    LANE_T00, LANE_T01, LANE_T02,       /* transition scores */
+    LANE_T11, LANE_T12, LANE_T13,
+    LANE_T22, LANE_T23,
+    LANE_N_IN,
+    LANE_BEST = LANE_N_IN,              /* best score (output only) */
+    LANE_N
+};
+
+#if defined(HMM_VIT_NEON)
+typedef int32x4_t lane_t;
+#define lane_load(p) vld1q_s32(p)
+#define lane_store(p, v) vst1q_s32(p, v)
+#define lane_set1(x) vdupq_n_s32(x)
+#define lane_add(a, b) vaddq_s32(a, b)
+#define lane_max(a, b) vmaxq_s32(a, b)
+#define lane_gt(a, b) vreinterpretq_s32_u32(vcgtq_s32(a, b))
+#define lane_and(a, b) vandq_s32(a, b)
+/* Select a where mask is set, else b. */
+#define lane_sel(m, a, b) vbslq_s32(vreinterpretq_u32_s32(m), a, b)
+#else
+typedef __m128i lane_t;
+#define lane_load(p) _mm_loadu_si128((__m128i const *)(p))
+#define lane_store(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#define lane_set1(x) _mm_set1_epi32(x)
+#define lane_add(a, b) _mm_add_epi32(a, b)
+#define lane_gt(a, b) _mm_cmpgt_epi32(a, b)
+#define lane_and(a, b) _mm_and_si128(a, b)
+#define lane_sel(m, a, b) _mm_or_si128(_mm_and_si128(m, a),     \
+                                       _mm_andnot_si128(m, b))
+#define lane_max(a, b) lane_sel(lane_gt(a, b), a, b)
+#endif
+
+static void
+hmm_vit_eval_3st_lr_lanes(int32 (*v)[HMM_VIT_LANES])
+{
+    lane_t worst = lane_set1(WORST_SCORE);
+    lane_t tmat_worst = lane_set1(TMAT_WORST_SCORE);
+    lane_t s0, s1, s2, s3, h0, h1, h2, t0, t1, t2, m, mh, c, best;
+
+    s0 = lane_add(lane_load(v[LANE_S0]), lane_load(v[LANE_E0]));
+    s1 = lane_add(lane_load(v[LANE_S1]), lane_load(v[LANE_E1]));
+    s2 = lane_add(lane_load(v[LANE_S2]), lane_load(v[LANE_E2]));
+    h0 = lane_load(v[LANE_H0]);
+    h1 = lane_load(v[LANE_H1]);
+    h2 = lane_load(v[LANE_H2]);
+
+    /* Transitions into non-emitting state 3, only where s1 is live. */
+    c = lane_gt(s1, worst);
+    t2 = lane_load(v[LANE_T13]);
+    t2 = lane_sel(lane_and(c, lane_gt(t2, tmat_worst)),
+                  lane_add(s1, t2), lane_set1(INT_MIN));
+    t1 = lane_add(s2, lane_load(v[LANE_T23]));
+    m = lane_gt(t1, t2);
+    s3 = lane_max(lane_sel(m, t1, t2), worst);
+    lane_store(v[LANE_OUTH], lane_sel(c, lane_sel(m, h2, h1),
+                                      lane_load(v[LANE_OUTH])));
+    lane_store(v[LANE_OUT], lane_sel(c, s3, lane_load(v[LANE_OUT])));
+    best = lane_sel(c, s3, worst);
+
+    /* All transitions into state 2 */
+    t0 = lane_add(s2, lane_load(v[LANE_T22]));
+    t1 = lane_add(s1, lane_load(v[LANE_T12]));
+    c = lane_load(v[LANE_T02]);
+    t2 = lane_sel(lane_gt(c, tmat_worst), lane_add(s0, c), t2);
+    c = lane_gt(t0, t1);
+    m = lane_sel(c, t0, t1);
+    mh = lane_sel(c, h2, h1);
+    c = lane_gt(t2, m);
+    s2 = lane_max(lane_sel(c, t2, m), worst);
+    lane_store(v[LANE_H2], lane_sel(c, h0, mh));
+    lane_store(v[LANE_S2], s2);
+    best = lane_max(best, s2);
+
+    /* All transitions into state 1 */
+    t0 = lane_add(s1, lane_load(v[LANE_T11]));
+    t1 = lane_add(s0, lane_load(v[LANE_T01]));
+    c = lane_gt(t0, t1);
+    s1 = lane_max(lane_sel(c, t0, t1), worst);
+    lane_store(v[LANE_H1], lane_sel(c, h1, h0));
+    lane_store(v[LANE_S1], s1);
+    best = lane_max(best, s1);
+
+    /* All transitions into state 0 */
+    s0 = lane_max(lane_add(s0, lane_load(v[LANE_T00])), worst);
+    lane_store(v[LANE_S0], s0);
+    lane_store(v[LANE_BEST], lane_max(best, s0));
+}
+
+static int32
+hmm_vit_eval_3st_lr_block(hmm_t **hmm, int32 n)
+{
+    int32 v[LANE_N][HMM_VIT_LANES];
+    int32 i, bestscore;
+
+    memset(v, 0, sizeof(v));
+    for (i = 0; i < n; ++i) {
+        hmm_t *h = hmm[i];
+        int16 const *senscore = h->ctx->senscore;
+        uint8 const *tp = h->ctx->tp[h->tmatid][0];
+
+        v[LANE_S0][i] = hmm_in_score(h);
+        v[LANE_S1][i] = hmm_score(h, 1);
+        v[LANE_S2][i] = hmm_score(h, 2);
+        v[LANE_H0][i] = hmm_in_history(h);
+        v[LANE_H1][i] = hmm_history(h, 1);
+        v[LANE_H2][i] = hmm_history(h, 2);
+        v[LANE_E0][i] = -senscore[h->senid[0]];
+        v[LANE_E1][i] = -senscore[h->senid[1]];
+        v[LANE_E2][i] = -senscore[h->senid[2]];
+        v[LANE_OUT][i] = hmm_out_score(h);
+        v[LANE_OUTH][i] = hmm_out_history(h);
+        v[LANE_T00][i] = hmm_tprob_3st(0, 0);
+        v[LANE_T01][i] = hmm_tprob_3st(0, 1);
+        v[LANE_T02][i] = hmm_tprob_3st(0, 2);
+        v[LANE_T11][i] = hmm_tprob_3st(1, 1);
+        v[LANE_T12][i] = hmm_tprob_3st(1, 2);
+        v[LANE_T13][i] = hmm_tprob_3st(1, 3);
+        v[LANE_T22][i] = hmm_tprob_3st(2, 2);
+        v[LANE_T23][i] = hmm_tprob_3st(2, 3);
+    }
+
+    hmm_vit_eval_3st_lr_lanes(v);
+
+    bestscore = WORST_SCORE;
+    for (i = 0; i < n; ++i) {
+        hmm_t *h = hmm[i];
+
+        hmm_in_score(h) = v[LANE_S0][i];
+        hmm_score(h, 1) = v[LANE_S1][i];
+        hmm_score(h, 2) = v[LANE_S2][i];
+        hmm_history(h, 1) = v[LANE_H1][i];
+        hmm_history(h, 2) = v[LANE_H2][i];
+        hmm_out_score(h) = v[LANE_OUT][i];
+        hmm_out_history(h) = v[LANE_OUTH][i];
+        hmm_bestscore(h) = v[LANE_BEST][i];
+        if (hmm_bestscore(h) BETTER_THAN bestscore)
+            bestscore = hmm_bestscore(h);
+    }
+    return bestscore;
+}
+#endif /* HMM_VIT_NEON || HMM_VIT_SSE2 */
+
+int32
+hmm_vit_eval_batch(hmm_t **hmm, int32 n)
+{
+    int32 i, score, bestscore;
+#ifdef HMM_VIT_LANES
+    hmm_t *block[HMM_VIT_LANES];
+    int32 n_block = 0;
+#endif
+
+    bestscore = WORST_SCORE;
+    for (i = 0; i < n; ++i) {
+#ifdef HMM_VIT_LANES
+        if (!hmm_is_mpx(hmm[i]) && hmm_n_emit_state(hmm[i]) == 3) {
+            block[n_block++] = hmm[i];
+            if (n_block == HMM_VIT_LANES) {
+                score = hmm_vit_eval_3st_lr_block(block, n_block);
+                if (score BETTER_THAN bestscore)
+                    bestscore = score;
+                n_block = 0;
+            }
+            continue;
+        }
+#endif
+        score = hmm_vit_eval(hmm[i]);
+        if (score BETTER_THAN bestscore)
+            bestscore = score;
+    }
+#ifdef HMM_VIT_LANES
+    if (n_block > 0) {
+        score = hmm_vit_eval_3st_lr_block(block, n_block);
+        if (score BETTER_THAN bestscore)
+            bestscore = score;
+    }
+#endif
+    return bestscore;
+}
+
 int32
 hmm_dump_vit_eval(hmm_t * hmm, FILE * fp)
 {
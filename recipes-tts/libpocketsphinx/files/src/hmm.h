@@ -280,7 +280,19 @@ void hmm_enter(hmm_t *h, int32 score,
  * well.
 */
 int32 hmm_vit_eval(hmm_t *hmm);
-  
+
+/**
+ * Viterbi evaluation of a list of HMMs.
+ *
+ * Non-multiplex 3-state HMMs are gathered into blocks and evaluated
+ * several at a time with SIMD instructions where available, the rest
+ * go through hmm_vit_eval().  The results are the same as calling
+ * hmm_vit_eval() on each of them, so no HMM may appear twice.
+ *
+ * @return Best state score among all of them.
+ */
+int32 hmm_vit_eval_batch(hmm_t **hmm, int32 n);
+
 
 /**
  * Like hmm_vit_eval, but dump HMM state and relevant senscr to fp first, for debugging;.
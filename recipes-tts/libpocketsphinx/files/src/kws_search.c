@@ -37,6 +37,7 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
@@ -50,7 +51,10 @@
 
 /** Access macros */
 #define hmm_is_active(hmm) ((hmm)->frame > 0)
-#define kws_nth_hmm(keyphrase,n) (&((keyphrase)->hmms[n]))
+#define kws_node_hmm(kwss,nid) (&(kwss)->nodes[nid].hmm)
+
+/* Number of active nodes handed to hmm_vit_eval_batch() at a time. */
+#define KWS_EVAL_BLOCK 64
 
 /* Value selected experimentally as maximum difference between triphone
 score and phone loop score, used in confidence computation to make sure
@@ -160,6 +164,7 @@ static ps_searchfuncs_t kws_funcs = {
     /* hyp: */ kws_search_hyp,
     /* prob: */ kws_search_prob,
     /* seg_iter: */ kws_search_seg_iter,
+    /* stable_seg_iter: */ NULL,
 };
 
 
@@ -168,7 +173,6 @@ static void
 kws_search_sen_active(kws_search_t * kwss)
 {
     int i;
-    gnode_t *gn;
 
     acmod_clear_active(ps_search_acmod(kwss));
 
@@ -177,13 +181,9 @@ kws_search_sen_active(kws_search_t * kwss)
         acmod_activate_hmm(ps_search_acmod(kwss), &kwss->pl_hmms[i]);
 
     /* activate hmms in active nodes */
-    for (gn = kwss->keyphrases; gn; gn = gnode_next(gn)) {
-        kws_keyphrase_t *keyphrase = gnode_ptr(gn);
-        for (i = 0; i < keyphrase->n_hmms; i++) {
-            if (hmm_is_active(kws_nth_hmm(keyphrase, i)))
-                acmod_activate_hmm(ps_search_acmod(kwss), kws_nth_hmm(keyphrase, i));
-        }
-    }
+    for (i = 0; i < kwss->n_active; i++)
+        acmod_activate_hmm(ps_search_acmod(kwss),
+                           kws_node_hmm(kwss, kwss->active[i]));
 }
 
 /*
@@ -194,7 +194,6 @@ static void
 kws_search_hmm_eval(kws_search_t * kwss, int16 const *senscr)
 {
     int32 i;
-    gnode_t *gn;
     int32 bestscore = WORST_SCORE;
 
     hmm_context_set_senscore(kwss->hmmctx, senscr);
@@ -209,18 +208,18 @@ kws_search_hmm_eval(kws_search_t * kwss, int16 const *senscr)
             bestscore = score;
     }
     /* evaluate hmms for active nodes */
-    for (gn = kwss->keyphrases; gn; gn = gnode_next(gn)) {
-        kws_keyphrase_t *keyphrase = gnode_ptr(gn);
-        for (i = 0; i < keyphrase->n_hmms; i++) {
-            hmm_t *hmm = kws_nth_hmm(keyphrase, i);
-
-            if (hmm_is_active(hmm)) {
-                int32 score;
-                score = hmm_vit_eval(hmm);
-                if (score BETTER_THAN bestscore)
-                    bestscore = score;
-            }
-        }
+    for (i = 0; i < kwss->n_active; i += KWS_EVAL_BLOCK) {
+        hmm_t *block[KWS_EVAL_BLOCK];
+        int32 j, n, score;
+
+        n = kwss->n_active - i;
+        if (n > KWS_EVAL_BLOCK)
+            n = KWS_EVAL_BLOCK;
+        for (j = 0; j < n; j++)
+            block[j] = kws_node_hmm(kwss, kwss->active[i + j]);
+        score = hmm_vit_eval_batch(block, n);
+        if (score BETTER_THAN bestscore)
+            bestscore = score;
     }
 
     kwss->bestscore = bestscore;
@@ -233,21 +232,37 @@ kws_search_hmm_eval(kws_search_t * kwss, int16 const *senscr)
 static void
 kws_search_hmm_prune(kws_search_t * kwss)
 {
-    int32 thresh, i;
-    gnode_t *gn;
+    int32 thresh, i, n;
 
     thresh = kwss->bestscore + kwss->beam;
 
-    for (gn = kwss->keyphrases; gn; gn = gnode_next(gn)) {
-        kws_keyphrase_t *keyphrase = gnode_ptr(gn);
-        for (i = 0; i < keyphrase->n_hmms; i++) {
-    	    hmm_t *hmm = kws_nth_hmm(keyphrase, i);
-            if (hmm_is_active(hmm) && hmm_bestscore(hmm) < thresh)
-                hmm_clear(hmm);
-        }
+    for (i = n = 0; i < kwss->n_active; i++) {
+        hmm_t *hmm = kws_node_hmm(kwss, kwss->active[i]);
+        if (hmm_bestscore(hmm) < thresh)
+            hmm_clear(hmm);
+        else
+            kwss->active[n++] = kwss->active[i];
     }
+    kwss->n_active = n;
 }
 
+static int
+kws_keyphrase_cmp(const void *a, const void *b)
+{
+    return (*(kws_keyphrase_t * const *)a)->idx
+        - (*(kws_keyphrase_t * const *)b)->idx;
+}
+
+/* Enter a node's HMM, adding it to the active list if it wasn't there. */
+static void
+kws_search_enter(kws_search_t * kwss, int32 nid, int32 score, int32 histid)
+{
+    hmm_t *hmm = kws_node_hmm(kwss, nid);
+
+    if (!hmm_is_active(hmm))
+        kwss->active[kwss->n_active++] = nid;
+    hmm_enter(hmm, score, histid, kwss->frame + 1);
+}
 
 /**
 * Do phone transitions
@@ -257,6 +272,7 @@ kws_search_trans(kws_search_t * kwss)
 {
     hmm_t *pl_best_hmm = NULL;
     int32 best_out_score = WORST_SCORE;
+    int32 n_active, n_spotted, nid;
     int i;
     gnode_t *gn;
 
@@ -272,29 +288,35 @@ kws_search_trans(kws_search_t * kwss)
         return;
 
     /* Check whether keyphrase wasn't spotted yet */
-    for (gn = kwss->keyphrases; gn; gn = gnode_next(gn)) {
-        kws_keyphrase_t *keyphrase = gnode_ptr(gn);
-        hmm_t *last_hmm;
-        
-        if (keyphrase->n_hmms < 1)
-    	    continue;
-        
-        last_hmm = kws_nth_hmm(keyphrase, keyphrase->n_hmms - 1);
-
-        if (hmm_is_active(last_hmm)
-            && hmm_out_score(pl_best_hmm) BETTER_THAN WORST_SCORE) {
+    n_spotted = 0;
+    if (hmm_out_score(pl_best_hmm) BETTER_THAN WORST_SCORE) {
+        for (i = 0; i < kwss->n_active; i++) {
+            kws_node_t *node = &kwss->nodes[kwss->active[i]];
 
-            if (hmm_out_score(last_hmm) - hmm_out_score(pl_best_hmm) 
-                >= keyphrase->threshold) {
+            for (gn = node->keyphrases; gn; gn = gnode_next(gn)) {
+                kws_keyphrase_t *keyphrase = gnode_ptr(gn);
 
-                int32 prob = hmm_out_score(last_hmm) - hmm_out_score(pl_best_hmm) - KWS_MAX;
-                kws_detections_add(kwss->detections, keyphrase->word,
-                                  hmm_out_history(last_hmm),
-                                  kwss->frame, prob,
-                                  hmm_out_score(last_hmm));
-            } /* keyphrase is spotted */
-        } /* last hmm of keyphrase is active */
-    } /* keyphrase loop */
+                if (hmm_out_score(&node->hmm) - hmm_out_score(pl_best_hmm) 
+                    >= keyphrase->threshold)
+                    kwss->spotted[n_spotted++] = keyphrase;
+            }
+        }
+    }
+    /* Report them in keyphrase list order, as kws_detections_add()
+     * merges overlapping detections of the same phrase. */
+    if (n_spotted > 1)
+        qsort(kwss->spotted, n_spotted, sizeof(*kwss->spotted),
+              kws_keyphrase_cmp);
+    for (i = 0; i < n_spotted; i++) {
+        kws_keyphrase_t *keyphrase = kwss->spotted[i];
+        hmm_t *last_hmm = kws_node_hmm(kwss, keyphrase->leaf);
+        int32 prob = hmm_out_score(last_hmm) - hmm_out_score(pl_best_hmm) - KWS_MAX;
+
+        kws_detections_add(kwss->detections, keyphrase->word,
+                           hmm_out_history(last_hmm),
+                           kwss->frame, prob,
+                           hmm_out_score(last_hmm));
+    }
 
     /* Make transition for all phone loop hmms */
     for (i = 0; i < kwss->n_pl; i++) {
@@ -306,31 +328,28 @@ kws_search_trans(kws_search_t * kwss)
         }
     }
 
-    /* Activate new keyphrase nodes, enter their hmms */
-    for (gn = kwss->keyphrases; gn; gn = gnode_next(gn)) {
-        kws_keyphrase_t *keyphrase = gnode_ptr(gn);
-        
-        if (keyphrase->n_hmms < 1)
-    	    continue;
-        
-        for (i = keyphrase->n_hmms - 1; i > 0; i--) {
-            hmm_t *pred_hmm = kws_nth_hmm(keyphrase, i - 1);
-            hmm_t *hmm = kws_nth_hmm(keyphrase, i);
-
-            if (hmm_is_active(pred_hmm)) {    
-                if (!hmm_is_active(hmm)
-                    || hmm_out_score(pred_hmm) BETTER_THAN
-                    hmm_in_score(hmm))
-                        hmm_enter(hmm, hmm_out_score(pred_hmm),
-                                  hmm_out_history(pred_hmm), kwss->frame + 1);
-            }
+    /* Activate successors of active nodes, enter their hmms.  Nodes
+     * entered here are appended past n_active and aren't visited. */
+    n_active = kwss->n_active;
+    for (i = 0; i < n_active; i++) {
+        kws_node_t *pred = &kwss->nodes[kwss->active[i]];
+
+        for (nid = pred->child; nid >= 0; nid = kwss->nodes[nid].sibling) {
+            hmm_t *hmm = kws_node_hmm(kwss, nid);
+
+            if (!hmm_is_active(hmm)
+                || hmm_out_score(&pred->hmm) BETTER_THAN hmm_in_score(hmm))
+                kws_search_enter(kwss, nid, hmm_out_score(&pred->hmm),
+                                 hmm_out_history(&pred->hmm));
         }
+    }
 
-        /* Enter keyphrase start node from phone loop */
+    /* Enter keyphrase start nodes from phone loop */
+    for (nid = kwss->root; nid >= 0; nid = kwss->nodes[nid].sibling) {
         if (hmm_out_score(pl_best_hmm) BETTER_THAN
-            hmm_in_score(kws_nth_hmm(keyphrase, 0)))
-                hmm_enter(kws_nth_hmm(keyphrase, 0), hmm_out_score(pl_best_hmm),
-                    kwss->frame, kwss->frame + 1);
+            hmm_in_score(kws_node_hmm(kwss, nid)))
+            kws_search_enter(kwss, nid, hmm_out_score(pl_best_hmm),
+                             kwss->frame);
     }
 }
 
@@ -439,6 +458,64 @@ kws_search_init(const char *name,
     return ps_search_base(kwss);
 }
 
+static void
+kws_search_free_tree(kws_search_t * kwss)
+{
+    int32 i;
+
+    for (i = 0; i < kwss->n_nodes; i++) {
+        hmm_deinit(kws_node_hmm(kwss, i));
+        glist_free(kwss->nodes[i].keyphrases);
+    }
+    ckd_free(kwss->nodes);
+    ckd_free(kwss->active);
+    ckd_free(kwss->spotted);
+    kwss->nodes = NULL;
+    kwss->active = NULL;
+    kwss->spotted = NULL;
+    kwss->n_nodes = kwss->n_nodes_alloc = kwss->n_active = 0;
+    kwss->root = -1;
+}
+
+/*
+* Find the child of parent (-1 for phrase-initial nodes) with the given
+* HMM, adding it if there isn't one yet.
+*/
+static int32
+kws_search_add_node(kws_search_t * kwss, int32 parent, int32 ssid, int32 tmatid)
+{
+    kws_node_t *node;
+    int32 nid;
+
+    nid = (parent < 0) ? kwss->root : kwss->nodes[parent].child;
+    for (; nid >= 0; nid = kwss->nodes[nid].sibling) {
+        hmm_t *hmm = kws_node_hmm(kwss, nid);
+        if (hmm_nonmpx_ssid(hmm) == ssid && hmm_tmatid(hmm) == tmatid)
+            return nid;
+    }
+
+    if (kwss->n_nodes == kwss->n_nodes_alloc) {
+        kwss->n_nodes_alloc = kwss->n_nodes_alloc ? kwss->n_nodes_alloc * 2 : 64;
+        kwss->nodes = ckd_realloc(kwss->nodes,
+                                  kwss->n_nodes_alloc * sizeof(*kwss->nodes));
+    }
+    nid = kwss->n_nodes++;
+    node = &kwss->nodes[nid];
+    hmm_init(kwss->hmmctx, &node->hmm, FALSE, ssid, tmatid);
+    node->parent = parent;
+    node->child = -1;
+    node->keyphrases = NULL;
+    if (parent < 0) {
+        node->sibling = kwss->root;
+        kwss->root = nid;
+    }
+    else {
+        node->sibling = kwss->nodes[parent].child;
+        kwss->nodes[parent].child = nid;
+    }
+    return nid;
+}
+
 void
 kws_search_free(ps_search_t * search)
 {
@@ -465,9 +542,9 @@ kws_search_free(ps_search_t * search)
     ckd_free(kwss->detections);
 
     ckd_free(kwss->pl_hmms);
+    kws_search_free_tree(kwss);
     for (gn = kwss->keyphrases; gn; gn = gnode_next(gn)) {
 	kws_keyphrase_t *keyphrase = gnode_ptr(gn);
-        ckd_free(keyphrase->hmms);
         ckd_free(keyphrase->word);
         ckd_free(keyphrase);
     }
@@ -481,9 +558,9 @@ kws_search_reinit(ps_search_t * search, dict_t * dict, dict2pid_t * d2p)
     char **wrdptr;
     char *tmp_keyphrase;
     int32 wid, pronlen, in_dict;
-    int32 n_hmms, n_wrds;
-    int32 ssid, tmatid;
-    int i, j, p;
+    int32 n_phones, n_keyphrases, n_wrds;
+    int32 ssid, tmatid, nid;
+    int i, p;
     kws_search_t *kwss = (kws_search_t *) search;
     bin_mdef_t *mdef = search->acmod->mdef;
     int32 silcipid = bin_mdef_silphone(mdef);
@@ -518,43 +595,36 @@ kws_search_reinit(ps_search_t * search, dict_t * dict, dict2pid_t * d2p)
                  bin_mdef_pid2tmatid(search->acmod->mdef, i));
     }
 
+    /* Build the keyphrase tree */
+    kws_search_free_tree(kwss);
+    n_phones = n_keyphrases = 0;
     for (gn = kwss->keyphrases; gn; gn = gnode_next(gn)) {
         kws_keyphrase_t *keyphrase = gnode_ptr(gn);
 
-        /* Initialize keyphrase HMMs */
+        keyphrase->idx = n_keyphrases++;
+        keyphrase->leaf = -1;
         tmp_keyphrase = (char *) ckd_salloc(keyphrase->word);
         n_wrds = str2words(tmp_keyphrase, NULL, 0);
         wrdptr = (char **) ckd_calloc(n_wrds, sizeof(*wrdptr));
         str2words(tmp_keyphrase, wrdptr, n_wrds);
 
-        /* count amount of hmms */
-        n_hmms = 0;
         in_dict = TRUE;
         for (i = 0; i < n_wrds; i++) {
-            wid = dict_wordid(dict, wrdptr[i]);
-            if (wid == BAD_S3WID) {
+            if (dict_wordid(dict, wrdptr[i]) == BAD_S3WID) {
         	E_ERROR("Word '%s' in phrase '%s' is missing in the dictionary\n", wrdptr[i], keyphrase->word);
         	in_dict = FALSE;
         	break;
             }
-            pronlen = dict_pronlen(dict, wid);
-            n_hmms += pronlen;
         }
         
-        if (!in_dict) {
+        if (!in_dict || n_wrds == 0) {
             ckd_free(wrdptr);
             ckd_free(tmp_keyphrase);
     	    continue;
         }
 
-        /* allocate node array */
-        if (keyphrase->hmms)
-            ckd_free(keyphrase->hmms);
-        keyphrase->hmms = (hmm_t *) ckd_calloc(n_hmms, sizeof(hmm_t));
-        keyphrase->n_hmms = n_hmms;
-
-        /* fill node array */
-        j = 0;
+        /* walk down the tree, adding nodes where it branches off */
+        nid = -1;
         for (i = 0; i < n_wrds; i++) {
             wid = dict_wordid(dict, wrdptr[i]);
             pronlen = dict_pronlen(dict, wid);
@@ -578,17 +648,21 @@ kws_search_reinit(ps_search_t * search, dict_t * dict, dict2pid_t * d2p)
                     ssid = dict2pid_internal(d2p, wid, p);
                 }
                 tmatid = bin_mdef_pid2tmatid(mdef, ci);
-                hmm_init(kwss->hmmctx, &keyphrase->hmms[j], FALSE, ssid,
-                         tmatid);
-                j++;
+                nid = kws_search_add_node(kwss, nid, ssid, tmatid);
+                n_phones++;
             }
         }
+        kwss->nodes[nid].keyphrases =
+            glist_add_ptr(kwss->nodes[nid].keyphrases, keyphrase);
+        keyphrase->leaf = nid;
 
         ckd_free(wrdptr);
         ckd_free(tmp_keyphrase);
     }
-
-    
+    kwss->active = ckd_calloc(kwss->n_nodes + 1, sizeof(*kwss->active));
+    kwss->spotted = ckd_calloc(n_keyphrases + 1, sizeof(*kwss->spotted));
+    E_INFO("KWS tree has %d nodes for %d keyphrase phones\n",
+           kwss->n_nodes, n_phones);
 
     return 0;
 }
@@ -67,10 +67,25 @@ typedef struct kws_seg_s {
 typedef struct kws_keyphrase_s {
     char* word;
     int32 threshold;
-    hmm_t* hmms;
-    int32 n_hmms;
+    int32 idx;                    /**< Position in the keyphrase list */
+    int32 leaf;                   /**< Node for the last phone, or -1 */
 } kws_keyphrase_t;
 
+/**
+ * Node of the keyphrase tree.
+ *
+ * Keyphrases are compiled into a prefix tree of HMMs, so phrases that
+ * start with the same phones in the same context share those nodes.
+ * Nodes are stored in an array with every parent before its children.
+ */
+typedef struct kws_node_s {
+    hmm_t hmm;
+    int32 parent;                 /**< Parent node, -1 for phrase-initial nodes */
+    int32 child;                  /**< First child node, or -1 */
+    int32 sibling;                /**< Next node with the same parent, or -1 */
+    glist_t keyphrases;           /**< Keyphrases ending in this node */
+} kws_node_t;
+
 /**
  * Implementation of KWS search structure.
  */
@@ -81,6 +96,14 @@ typedef struct kws_search_s {
 
     glist_t keyphrases;          /**< Keyphrases to spot */
 
+    kws_node_t *nodes;            /**< Keyphrase tree */
+    int32 n_nodes;
+    int32 n_nodes_alloc;
+    int32 root;                   /**< First phrase-initial node, or -1 */
+    int32 *active;                /**< Nodes with active HMMs */
+    int32 n_active;
+    kws_keyphrase_t **spotted;    /**< Keyphrases spotted in current frame */
+
     kws_detections_t *detections; /**< Keyword spotting history */
     frame_idx_t frame;            /**< Frame index */
 
@@ -124,6 +124,44 @@ fsg_model_trans_add(fsg_model_t * fsg,
                             sizeof(link->to_state), gl);
 }
 
+static void
+fsg_model_null_uncompile(fsg_model_t * fsg)
+{
+    ckd_free(fsg->null_index);
+    ckd_free(fsg->null_links);
+    fsg->null_index = NULL;
+    fsg->null_links = NULL;
+}
+
+void
+fsg_model_null_compile(fsg_model_t * fsg)
+{
+    int32 i, n;
+
+    if (fsg->null_index)
+        return;
+    fsg->null_index = ckd_calloc(fsg->n_state + 1,
+                                 sizeof(*fsg->null_index));
+    n = 0;
+    for (i = 0; i < fsg->n_state; ++i) {
+        fsg->null_index[i] = n;
+        if (fsg->trans[i].null_trans)
+            n += hash_table_inuse(fsg->trans[i].null_trans);
+    }
+    fsg->null_index[fsg->n_state] = n;
+    fsg->null_links = ckd_calloc(n ? n : 1, sizeof(*fsg->null_links));
+    for (i = 0; i < fsg->n_state; ++i) {
+        fsg_link_t **link = fsg->null_links + fsg->null_index[i];
+        hash_iter_t *itor;
+
+        if (fsg->trans[i].null_trans == NULL)
+            continue;
+        for (itor = hash_table_iter(fsg->trans[i].null_trans);
+             itor; itor = hash_table_iter_next(itor))
+            *link++ = (fsg_link_t *) hash_entry_val(itor->ent);
+    }
+}
+
 int32
 fsg_model_tag_trans_add(fsg_model_t * fsg, int32 from, int32 to,
                         int32 logp, int32 wid)
@@ -156,6 +194,7 @@ fsg_model_tag_trans_add(fsg_model_t * fsg, int32 from, int32 to,
     }
 
     /* Create null transition object */
+    fsg_model_null_uncompile(fsg);
     link = listelem_malloc(fsg->link_alloc);
     link->from_state = from;
     link->to_state = to;
@@ -727,6 +766,8 @@ fsg_model_readfile(const char *file, logmath_t * lmath, float32 lw)
     FILE *fp;
     fsg_model_t *fsg;
 
+    if (fsg_model_is_bin(file))
+        return fsg_model_read_bin(file, lmath, lw);
     if ((fp = fopen(file, "r")) == NULL) {
         E_ERROR_SYSTEM("Failed to open FSG file '%s' for reading", file);
         return NULL;
@@ -773,12 +814,17 @@ fsg_model_free(fsg_model_t * fsg)
     if (--fsg->refcount > 0)
         return fsg->refcount;
 
-    for (i = 0; i < fsg->n_word; ++i)
+    /* Words read from a compiled file point into it. */
+    for (i = fsg->n_word_mapped; i < fsg->n_word; ++i)
         ckd_free(fsg->vocab[i]);
     for (i = 0; i < fsg->n_state; ++i)
         trans_list_free(fsg, i);
     ckd_free(fsg->trans);
     ckd_free(fsg->vocab);
+    fsg_model_null_uncompile(fsg);
+    ckd_free(fsg->links);
+    if (fsg->filemap)
+        mmio_file_unmap(fsg->filemap);
     listelem_alloc_free(fsg->link_alloc);
     bitvec_free(fsg->silwords);
     bitvec_free(fsg->altwords);
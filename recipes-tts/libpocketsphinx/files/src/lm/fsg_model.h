@@ -58,6 +58,7 @@
 #include "util/bitvec.h"
 #include "util/hash_table.h"
 #include "util/listelem_alloc.h"
+#include "util/mmio.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -121,6 +122,14 @@ typedef struct fsg_model_s {
 			   logprobs */
     trans_list_t *trans; /**< Transitions out of each state, if any. */
     listelem_alloc_t *link_alloc; /**< Allocator for FSG links. */
+    int32 *null_index;  /**< Null transitions out of state s are
+                           null_links[null_index[s]] up to
+                           null_links[null_index[s+1]], or NULL if
+                           not compiled yet. */
+    fsg_link_t **null_links; /**< Compiled null transitions. */
+    fsg_link_t *links;  /**< Links read from a compiled FSG file. */
+    mmio_file_t *filemap; /**< Compiled FSG file, if read from one. */
+    int32 n_word_mapped; /**< Words in vocab that point into filemap. */
 } fsg_model_t;
 
 /* Access macros */
@@ -132,6 +141,9 @@ typedef struct fsg_model_s {
 #define fsg_model_lw(f)			((f)->lw)
 #define fsg_model_n_word(f)		((f)->n_word)
 #define fsg_model_word_str(f,wid)       (wid == -1 ? "(NULL)" : (f)->vocab[wid])
+/* Compiled null transitions, see fsg_model_null_compile() */
+#define fsg_model_n_null(f,s)           ((f)->null_index[(s) + 1] - (f)->null_index[s])
+#define fsg_model_null(f,s,i)           ((f)->null_links[(f)->null_index[s] + (i)])
 
 /**
  * Iterator over arcs.
@@ -224,6 +236,35 @@ int32 fsg_model_tag_trans_add(fsg_model_t * fsg, int32 from, int32 to,
 POCKETSPHINX_EXPORT
 glist_t fsg_model_null_trans_closure(fsg_model_t * fsg, glist_t nulls);
 
+/**
+ * Build the compact per-state table of null transitions read by
+ * fsg_model_n_null() and fsg_model_null(), if not already done.
+ *
+ * Since the null transitions are closed under composition (see
+ * fsg_model_null_trans_closure()), this table lists every state
+ * reachable from each state through nulls alone, in the same order
+ * fsg_model_arcs() visits them.  Adding a null transition discards
+ * it until the next call.
+ */
+void fsg_model_null_compile(fsg_model_t *fsg);
+
+/**
+ * Read a compiled FSG file written by fsg_model_writefile_bin().
+ *
+ * The vocabulary is used in place from the mapped file.  The
+ * transition scores are converted if lmath or lw differ from the
+ * ones it was written with.
+ *
+ * @return FSG, or NULL if the file is not a valid compiled FSG.
+ */
+fsg_model_t *fsg_model_read_bin(const char *file, logmath_t *lmath,
+                                float32 lw);
+
+/**
+ * Is this a compiled FSG file?
+ */
+int fsg_model_is_bin(const char *file);
+
 /**
  * Get the list of transitions (if any) from state i to j.
  */
@@ -0,0 +1,521 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/**
+ * @file fsg_model_bin.c
+ * @brief Compiled binary form of finite-state grammars.
+ *
+ * Parsing an FSG and working out the transitive closure of its null
+ * transitions can take a long time for command grammars made mostly
+ * of optional words, since the closure is quadratic in the length of
+ * such chains.  This saves the result, closure included, so that it
+ * can be mapped and used directly.
+ *
+ * The hash tables of transitions are rebuilt on loading, but the
+ * transitions are written so that entering them in file order gives
+ * tables that iterate in exactly the same order as the original ones.
+ * That keeps the decoder's results identical to those with the FSG
+ * it was compiled from.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <pocketsphinx.h>
+
+#include "util/ckd_alloc.h"
+#include "util/strfuncs.h"
+#include "lm/fsg_model.h"
+
+#define FSG_BIN_VERSION 1
+#define FSG_BIN_BYTEORDER 0x11223344
+/** Sections start on multiples of this. */
+#define FSG_BIN_ALIGN 8
+/** No name. */
+#define FSG_BIN_NONAME 0xffffffff
+
+static const char fsg_bin_magic[8] = "PSFSGB";
+
+/** Silence transitions were added (the silwords section is there). */
+#define FSG_BIN_HAS_SIL 1
+/** Alternate pronunciations were added (the altwords section is there). */
+#define FSG_BIN_HAS_ALT 2
+
+/* Everything is in host byte order; the file is only meant to be
+ * read on the machine that wrote it, or one like it. */
+typedef struct fsg_bin_hdr_s {
+    char magic[8];
+    float64 log_base;   /**< Base of logs2prob */
+    int32 log_shift;    /**< Shift of logs2prob */
+    float32 lw;         /**< Language weight applied to logs2prob */
+    uint32 version;
+    uint32 byteorder;
+    uint32 file_size;
+    uint32 flags;
+    int32 n_state;
+    int32 start_state;
+    int32 final_state;
+    int32 n_word;
+    uint32 n_trans;     /**< Word transitions */
+    uint32 n_null;      /**< Null transitions */
+    uint32 n_str;       /**< Bytes in all strings */
+    uint32 name;        /**< Offset of the name, or FSG_BIN_NONAME */
+} fsg_bin_hdr_t;
+
+enum fsg_bin_section_e {
+    SEC_WORD,           /**< uint32[n_word], offsets of word strings */
+    SEC_SIL,            /**< bitvec_t[bitvec_size(n_word)], if HAS_SIL */
+    SEC_ALT,            /**< bitvec_t[bitvec_size(n_word)], if HAS_ALT */
+    SEC_TRANS_INDEX,    /**< uint32[n_state + 1], start of each state's */
+    SEC_TRANS,          /**< fsg_link_t[n_trans], grouped by from_state */
+    SEC_NULL_INDEX,     /**< uint32[n_state + 1], start of each state's */
+    SEC_NULL,           /**< fsg_link_t[n_null], grouped by from_state */
+    SEC_STR,            /**< char[n_str] */
+    SEC_END
+};
+
+/* Work out where each section goes, returns the total size. */
+static size_t
+fsg_bin_layout(fsg_bin_hdr_t const *hdr, size_t *off)
+{
+    size_t size[SEC_END];
+    size_t nbv, pos;
+    int i;
+
+    nbv = bitvec_size(hdr->n_word) * sizeof(bitvec_t);
+    size[SEC_WORD] = hdr->n_word * sizeof(uint32);
+    size[SEC_SIL] = (hdr->flags & FSG_BIN_HAS_SIL) ? nbv : 0;
+    size[SEC_ALT] = (hdr->flags & FSG_BIN_HAS_ALT) ? nbv : 0;
+    size[SEC_TRANS_INDEX] = (hdr->n_state + 1) * sizeof(uint32);
+    size[SEC_TRANS] = hdr->n_trans * sizeof(fsg_link_t);
+    size[SEC_NULL_INDEX] = size[SEC_TRANS_INDEX];
+    size[SEC_NULL] = hdr->n_null * sizeof(fsg_link_t);
+    size[SEC_STR] = hdr->n_str;
+
+    pos = sizeof(*hdr);
+    for (i = 0; i < SEC_END; ++i) {
+        pos = (pos + FSG_BIN_ALIGN - 1) & ~(size_t)(FSG_BIN_ALIGN - 1);
+        off[i] = pos;
+        pos += size[i];
+    }
+    off[SEC_END] = pos;
+    return pos;
+}
+
+/*
+ * Get the values in h in an order that, entered one by one into a new
+ * table of the same size, gives back one that iterates like h.
+ *
+ * Each bucket iterates as its first entry followed by the others
+ * newest first, so the entries after the first go in reverse.
+ */
+static int32
+fsg_bin_hash_order(hash_table_t *h, void **out)
+{
+    hash_iter_t *itor;
+    size_t idx = 0;
+    int32 n = 0, first = 0;
+
+    for (itor = hash_table_iter(h); itor; itor = hash_table_iter_next(itor)) {
+        if (itor->idx != idx) {
+            idx = itor->idx;
+            first = n;
+        }
+        /* Move this in front of the rest of its bucket. */
+        if (n > first + 1)
+            memmove(out + first + 2, out + first + 1,
+                    (n - first - 1) * sizeof(*out));
+        out[n > first ? first + 1 : n] = hash_entry_val(itor->ent);
+        ++n;
+    }
+    return n;
+}
+
+int
+fsg_model_is_bin(const char *file)
+{
+    char magic[8];
+    FILE *fh;
+    int rv;
+
+    if ((fh = fopen(file, "rb")) == NULL)
+        return FALSE;
+    rv = (fread(magic, 1, sizeof(magic), fh) == sizeof(magic)
+          && memcmp(magic, fsg_bin_magic, sizeof(magic)) == 0);
+    fclose(fh);
+    return rv;
+}
+
+int
+fsg_model_writefile_bin(fsg_model_t *fsg, char const *file)
+{
+    fsg_bin_hdr_t hdr;
+    size_t off[SEC_END + 1];
+    size_t total;
+    uint32 *word, *trans_index, *null_index;
+    fsg_link_t *trans, *null;
+    void **order;
+    char *buf, *str, *tmppath;
+    int32 i, j, k, max_order;
+    FILE *fh;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, fsg_bin_magic, sizeof(hdr.magic));
+    hdr.log_base = logmath_get_base(fsg->lmath);
+    hdr.log_shift = logmath_get_shift(fsg->lmath);
+    hdr.lw = fsg->lw;
+    hdr.version = FSG_BIN_VERSION;
+    hdr.byteorder = FSG_BIN_BYTEORDER;
+    if (fsg_model_has_sil(fsg))
+        hdr.flags |= FSG_BIN_HAS_SIL;
+    if (fsg_model_has_alt(fsg))
+        hdr.flags |= FSG_BIN_HAS_ALT;
+    hdr.n_state = fsg->n_state;
+    hdr.start_state = fsg->start_state;
+    hdr.final_state = fsg->final_state;
+    hdr.n_word = fsg->n_word;
+    max_order = 0;
+    for (i = 0; i < fsg->n_state; ++i) {
+        hash_iter_t *itor;
+
+        if (fsg->trans[i].trans) {
+            int32 n = hash_table_inuse(fsg->trans[i].trans);
+            if (n > max_order)
+                max_order = n;
+            for (itor = hash_table_iter(fsg->trans[i].trans);
+                 itor; itor = hash_table_iter_next(itor))
+                hdr.n_trans += glist_count(hash_entry_val(itor->ent));
+        }
+        if (fsg->trans[i].null_trans) {
+            int32 n = hash_table_inuse(fsg->trans[i].null_trans);
+            if (n > max_order)
+                max_order = n;
+            hdr.n_null += n;
+        }
+    }
+    hdr.name = FSG_BIN_NONAME;
+    if (fsg->name) {
+        hdr.name = 0;
+        hdr.n_str += strlen(fsg->name) + 1;
+    }
+    for (i = 0; i < fsg->n_word; ++i)
+        hdr.n_str += strlen(fsg->vocab[i]) + 1;
+    total = fsg_bin_layout(&hdr, off);
+    if (total > 0xffffffffUL) {
+        E_ERROR("FSG is too large to compile\n");
+        return -1;
+    }
+    hdr.file_size = total;
+
+    buf = ckd_calloc(1, total);
+    memcpy(buf, &hdr, sizeof(hdr));
+    str = buf + off[SEC_STR];
+    if (fsg->name) {
+        strcpy(str, fsg->name);
+        str += strlen(fsg->name) + 1;
+    }
+    word = (uint32 *)(buf + off[SEC_WORD]);
+    for (i = 0; i < fsg->n_word; ++i) {
+        word[i] = str - (buf + off[SEC_STR]);
+        strcpy(str, fsg->vocab[i]);
+        str += strlen(fsg->vocab[i]) + 1;
+    }
+    if (hdr.flags & FSG_BIN_HAS_SIL)
+        memcpy(buf + off[SEC_SIL], fsg->silwords,
+               bitvec_size(fsg->n_word) * sizeof(bitvec_t));
+    if (hdr.flags & FSG_BIN_HAS_ALT)
+        memcpy(buf + off[SEC_ALT], fsg->altwords,
+               bitvec_size(fsg->n_word) * sizeof(bitvec_t));
+
+    order = ckd_calloc(max_order ? max_order : 1, sizeof(*order));
+    trans_index = (uint32 *)(buf + off[SEC_TRANS_INDEX]);
+    trans = (fsg_link_t *)(buf + off[SEC_TRANS]);
+    null_index = (uint32 *)(buf + off[SEC_NULL_INDEX]);
+    null = (fsg_link_t *)(buf + off[SEC_NULL]);
+    trans_index[0] = null_index[0] = 0;
+    for (i = 0; i < fsg->n_state; ++i) {
+        uint32 nt = trans_index[i], nn = null_index[i];
+        int32 n;
+
+        if (fsg->trans[i].trans) {
+            n = fsg_bin_hash_order(fsg->trans[i].trans, order);
+            for (j = 0; j < n; ++j) {
+                /* Each list was built by prepending, so write it
+                 * backwards to have it built the same way again. */
+                glist_t gl = order[j];
+                int32 len = glist_count(gl);
+                gnode_t *gn;
+
+                for (k = len - 1, gn = gl; gn; gn = gnode_next(gn), --k)
+                    trans[nt + k] = *(fsg_link_t *)gnode_ptr(gn);
+                nt += len;
+            }
+        }
+        if (fsg->trans[i].null_trans) {
+            n = fsg_bin_hash_order(fsg->trans[i].null_trans, order);
+            for (j = 0; j < n; ++j)
+                null[nn++] = *(fsg_link_t *)order[j];
+        }
+        trans_index[i + 1] = nt;
+        null_index[i + 1] = nn;
+    }
+    ckd_free(order);
+
+    /* Write it next to the real one and rename it, so that nobody
+     * ever sees a partial file. */
+    tmppath = string_join(file, ".tmp", NULL);
+    if ((fh = fopen(tmppath, "wb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open %s for writing", tmppath);
+        goto error_out;
+    }
+    if (fwrite(buf, 1, total, fh) != total) {
+        E_ERROR_SYSTEM("Failed to write %s", tmppath);
+        fclose(fh);
+        remove(tmppath);
+        goto error_out;
+    }
+    if (fclose(fh) != 0) {
+        E_ERROR_SYSTEM("Failed to write %s", tmppath);
+        remove(tmppath);
+        goto error_out;
+    }
+#ifdef _WIN32
+    remove(file);
+#endif
+    if (rename(tmppath, file) < 0) {
+        E_ERROR_SYSTEM("Failed to rename %s to %s", tmppath, file);
+        remove(tmppath);
+        goto error_out;
+    }
+    E_INFO("Wrote compiled FSG to %s (%d states, %d transitions, %d null)\n",
+           file, hdr.n_state, hdr.n_trans, hdr.n_null);
+    ckd_free(tmppath);
+    ckd_free(buf);
+    return 0;
+
+error_out:
+    ckd_free(tmppath);
+    ckd_free(buf);
+    return -1;
+}
+
+/* Check that a section of links is grouped by state and in range. */
+static int
+fsg_bin_check_links(fsg_bin_hdr_t const *hdr, uint32 const *index,
+                    fsg_link_t const *link, uint32 n_link, int null)
+{
+    int32 i;
+    uint32 j;
+
+    if (index[0] != 0 || index[hdr->n_state] != n_link)
+        return FALSE;
+    for (i = 0; i < hdr->n_state; ++i) {
+        if (index[i + 1] < index[i] || index[i + 1] > n_link)
+            return FALSE;
+        for (j = index[i]; j < index[i + 1]; ++j) {
+            if (link[j].from_state != i
+                || link[j].to_state < 0 || link[j].to_state >= hdr->n_state)
+                return FALSE;
+            if (null ? link[j].wid != -1
+                : (link[j].wid < 0 || link[j].wid >= hdr->n_word))
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static int
+fsg_bin_check(fsg_bin_hdr_t const *hdr, char const *base, size_t const *off)
+{
+    uint32 const *word = (uint32 const *)(base + off[SEC_WORD]);
+    char const *str = base + off[SEC_STR];
+    int32 i;
+
+    if (hdr->n_state <= 0 || hdr->n_word < 0
+        || hdr->start_state < 0 || hdr->start_state >= hdr->n_state
+        || hdr->final_state < 0 || hdr->final_state >= hdr->n_state)
+        return FALSE;
+    /* Every string has to end inside the table. */
+    if (hdr->n_str > 0 && str[hdr->n_str - 1] != '\0')
+        return FALSE;
+    if (hdr->name != FSG_BIN_NONAME && hdr->name >= hdr->n_str)
+        return FALSE;
+    for (i = 0; i < hdr->n_word; ++i)
+        if (word[i] >= hdr->n_str)
+            return FALSE;
+    if (!fsg_bin_check_links(hdr,
+                             (uint32 const *)(base + off[SEC_TRANS_INDEX]),
+                             (fsg_link_t const *)(base + off[SEC_TRANS]),
+                             hdr->n_trans, FALSE))
+        return FALSE;
+    if (!fsg_bin_check_links(hdr,
+                             (uint32 const *)(base + off[SEC_NULL_INDEX]),
+                             (fsg_link_t const *)(base + off[SEC_NULL]),
+                             hdr->n_null, TRUE))
+        return FALSE;
+    return TRUE;
+}
+
+/* Convert scores written with another log base or language weight. */
+static void
+fsg_bin_rescale(fsg_bin_hdr_t const *hdr, fsg_model_t *fsg)
+{
+    float64 scale;
+    uint32 i, n;
+
+    E_INFO("Converting compiled FSG scores to log base %f, lw %.2f\n",
+           logmath_get_base(fsg->lmath), fsg->lw);
+    /* Scores are lw * log(p) / log(base) / (1 << shift). */
+    scale = fsg->lw / hdr->lw
+        * log(hdr->log_base) / log(logmath_get_base(fsg->lmath))
+        * (1 << hdr->log_shift) / (1 << logmath_get_shift(fsg->lmath));
+    n = hdr->n_trans + hdr->n_null;
+    for (i = 0; i < n; ++i)
+        fsg->links[i].logs2prob =
+            (int32)floor(fsg->links[i].logs2prob * scale + 0.5);
+}
+
+fsg_model_t *
+fsg_model_read_bin(const char *file, logmath_t *lmath, float32 lw)
+{
+    fsg_bin_hdr_t hdr;
+    size_t off[SEC_END + 1];
+    mmio_file_t *mf;
+    struct stat st;
+    char const *base;
+    uint32 const *word, *trans_index, *null_index;
+    fsg_model_t *fsg;
+    size_t nbv;
+    int32 i;
+    uint32 j;
+
+    if (stat(file, &st) < 0) {
+        E_ERROR_SYSTEM("Failed to stat compiled FSG %s", file);
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(hdr)) {
+        E_ERROR("Compiled FSG %s is truncated\n", file);
+        return NULL;
+    }
+    if ((mf = mmio_file_read(file)) == NULL)
+        return NULL;
+    base = mmio_file_ptr(mf);
+    memcpy(&hdr, base, sizeof(hdr));
+    if (memcmp(hdr.magic, fsg_bin_magic, sizeof(hdr.magic)) != 0
+        || hdr.version != FSG_BIN_VERSION
+        || hdr.byteorder != FSG_BIN_BYTEORDER) {
+        E_ERROR("%s is not a compiled FSG for this version\n", file);
+        goto error_out;
+    }
+    if (hdr.file_size != (size_t)st.st_size
+        || !(hdr.log_base > 1.0 && hdr.log_base < 2.0)
+        || hdr.log_shift < 0 || hdr.log_shift > 16
+        || !(hdr.lw > 0.001 && hdr.lw < 1000.0)
+        || (hdr.flags & ~(FSG_BIN_HAS_SIL | FSG_BIN_HAS_ALT))
+        || hdr.n_state < 0 || hdr.n_word < 0
+        || fsg_bin_layout(&hdr, off) != hdr.file_size
+        || !fsg_bin_check(&hdr, base, off)) {
+        E_ERROR("Compiled FSG %s is corrupt\n", file);
+        goto error_out;
+    }
+
+    fsg = fsg_model_init(hdr.name == FSG_BIN_NONAME
+                         ? NULL : base + off[SEC_STR] + hdr.name,
+                         lmath, lw, hdr.n_state);
+    fsg->filemap = mf;
+    fsg->start_state = hdr.start_state;
+    fsg->final_state = hdr.final_state;
+
+    /* Words point into the file, new ones added later do not. */
+    fsg->n_word = fsg->n_word_mapped = hdr.n_word;
+    fsg->n_word_alloc = fsg->n_word + 10;
+    fsg->vocab = ckd_calloc(fsg->n_word_alloc, sizeof(*fsg->vocab));
+    word = (uint32 const *)(base + off[SEC_WORD]);
+    for (i = 0; i < hdr.n_word; ++i)
+        fsg->vocab[i] = (char *)base + off[SEC_STR] + word[i];
+    nbv = bitvec_size(hdr.n_word) * sizeof(bitvec_t);
+    if (hdr.flags & FSG_BIN_HAS_SIL) {
+        fsg->silwords = bitvec_alloc(fsg->n_word_alloc);
+        memcpy(fsg->silwords, base + off[SEC_SIL], nbv);
+    }
+    if (hdr.flags & FSG_BIN_HAS_ALT) {
+        fsg->altwords = bitvec_alloc(fsg->n_word_alloc);
+        memcpy(fsg->altwords, base + off[SEC_ALT], nbv);
+    }
+
+    /* The links are copied, as the model may still be modified. */
+    fsg->links = ckd_calloc(hdr.n_trans + hdr.n_null + 1,
+                            sizeof(*fsg->links));
+    memcpy(fsg->links, base + off[SEC_TRANS],
+           hdr.n_trans * sizeof(*fsg->links));
+    memcpy(fsg->links + hdr.n_trans, base + off[SEC_NULL],
+           hdr.n_null * sizeof(*fsg->links));
+    if (hdr.log_base != logmath_get_base(lmath)
+        || hdr.log_shift != logmath_get_shift(lmath)
+        || hdr.lw != lw)
+        fsg_bin_rescale(&hdr, fsg);
+
+    trans_index = (uint32 const *)(base + off[SEC_TRANS_INDEX]);
+    null_index = (uint32 const *)(base + off[SEC_NULL_INDEX]);
+    for (i = 0; i < hdr.n_state; ++i) {
+        if (trans_index[i + 1] > trans_index[i])
+            fsg->trans[i].trans = hash_table_new(5, HASH_CASE_YES);
+        for (j = trans_index[i]; j < trans_index[i + 1]; ++j) {
+            fsg_link_t *link = fsg->links + j;
+            glist_t gl = fsg_model_trans(fsg, i, link->to_state);
+
+            gl = glist_add_ptr(gl, link);
+            hash_table_replace_bkey(fsg->trans[i].trans,
+                                    (char const *) &link->to_state,
+                                    sizeof(link->to_state), gl);
+        }
+        if (null_index[i + 1] > null_index[i])
+            fsg->trans[i].null_trans = hash_table_new(5, HASH_CASE_YES);
+        for (j = null_index[i]; j < null_index[i + 1]; ++j) {
+            fsg_link_t *link = fsg->links + hdr.n_trans + j;
+            hash_table_enter_bkey(fsg->trans[i].null_trans,
+                                  (char const *) &link->to_state,
+                                  sizeof(link->to_state), link);
+        }
+    }
+    fsg_model_null_compile(fsg);
+
+    E_INFO("Read compiled FSG %s (%d states, %d words, "
+           "%d transitions, %d null)\n", file, fsg->n_state, fsg->n_word,
+           hdr.n_trans, hdr.n_null);
+    return fsg;
+
+error_out:
+    mmio_file_unmap(mf);
+    return NULL;
+}
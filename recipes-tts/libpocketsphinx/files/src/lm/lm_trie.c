@@ -54,6 +54,8 @@
 #include "lm/lm_trie_quant.h"
 
 static void lm_trie_alloc_ngram(lm_trie_t * trie, uint32 * counts, int order);
+static size_t lm_trie_ngram_size(lm_trie_t * trie, uint32 * counts, int order);
+static void lm_trie_init_ngram(lm_trie_t * trie, uint32 * counts, int order);
 
 static uint32
 base_size(uint32 entries, uint32 max_vocab, uint8 remaining_bits)
@@ -357,13 +359,22 @@ recursive_insert(lm_trie_t * trie, ngram_raw_t ** raw_ngrams,
 }
 
 static lm_trie_t *
-lm_trie_init(uint32 unigram_count)
+lm_trie_new(void)
 {
     lm_trie_t *trie;
 
     trie = (lm_trie_t *) ckd_calloc(1, sizeof(*trie));
     memset(trie->hist_cache, -1, sizeof(trie->hist_cache)); /* prepare request history */
     memset(trie->backoff_cache, 0, sizeof(trie->backoff_cache));
+    return trie;
+}
+
+static lm_trie_t *
+lm_trie_init(uint32 unigram_count)
+{
+    lm_trie_t *trie;
+
+    trie = lm_trie_new();
     trie->unigrams =
         (unigram_t *) ckd_calloc((unigram_count + 1),
                                  sizeof(*trie->unigrams));
@@ -412,6 +423,76 @@ lm_trie_read_bin(uint32 * counts, int order, FILE * fp)
     return trie;
 }
 
+lm_trie_t *
+lm_trie_read_mmap(uint32 * counts, int order, FILE * fp,
+                  mmio_file_t * mf, size_t file_size)
+{
+    lm_trie_t *trie;
+    uint8 *ptr;
+    long offset;
+    size_t ug_size;
+
+    /* The file is little-endian, so only usable as-is on the same. */
+    if (SWAP_LM_TRIE)
+        return NULL;
+    /* Everything is read as floats and ints, so it has to be aligned.
+     * It always is in files written by lm_trie_write_bin(). */
+    offset = ftell(fp);
+    if (offset < 0 || offset % sizeof(int32) != 0) {
+        E_INFO("LM not aligned, can't use it in place\n");
+        return NULL;
+    }
+    trie = lm_trie_new();
+    ptr = (uint8 *) mmio_file_ptr(mf);
+    if (order > 1) {
+        if ((size_t)offset + lm_trie_quant_bin_size(order) > file_size) {
+            E_ERROR("LM file is truncated\n");
+            goto error_out;
+        }
+        trie->quant = lm_trie_quant_map(ptr + offset, order);
+        offset += lm_trie_quant_bin_size(order);
+    }
+    ug_size = (counts[0] + 1) * sizeof(*trie->unigrams);
+    if (order > 1)
+        trie->ngram_mem_size = lm_trie_ngram_size(trie, counts, order);
+    if ((size_t)offset + ug_size + trie->ngram_mem_size > file_size) {
+        E_ERROR("LM file is truncated\n");
+        goto error_out;
+    }
+
+    ptr += offset;
+    trie->unigrams = (unigram_t *) ptr;
+    trie->unigrams_mapped = TRUE;
+    if (order > 1) {
+        /* Bit arrays are read with memcpy(), so no alignment needed. */
+        trie->ngram_mem = ptr + ug_size;
+        lm_trie_init_ngram(trie, counts, order);
+        E_INFO("#ngram_mem: %ld (memory-mapped)\n", trie->ngram_mem_size);
+    }
+    fseek(fp, offset + ug_size + trie->ngram_mem_size, SEEK_SET);
+    trie->mmap = mf;
+    return trie;
+
+error_out:
+    if (trie->quant)
+        lm_trie_quant_free(trie->quant);
+    ckd_free(trie);
+    return NULL;
+}
+
+void
+lm_trie_unmap_unigrams(lm_trie_t * trie, uint32 unigram_count)
+{
+    unigram_t *unigrams;
+
+    if (!trie->unigrams_mapped)
+        return;
+    unigrams = ckd_calloc(unigram_count + 1, sizeof(*unigrams));
+    memcpy(unigrams, trie->unigrams, (unigram_count + 1) * sizeof(*unigrams));
+    trie->unigrams = unigrams;
+    trie->unigrams_mapped = FALSE;
+}
+
 static size_t
 lm_trie_write_ug(lm_trie_t * trie, uint32 unigram_count, FILE * fp)
 {
@@ -451,35 +532,55 @@ void
 lm_trie_free(lm_trie_t * trie)
 {
     if (trie->ngram_mem) {
-        ckd_free(trie->ngram_mem);
+        if (trie->mmap == NULL)
+            ckd_free(trie->ngram_mem);
         ckd_free(trie->middle_begin);
         ckd_free(trie->longest);
     }
     if (trie->quant)
         lm_trie_quant_free(trie->quant);
-    ckd_free(trie->unigrams);
+    if (!trie->unigrams_mapped)
+        ckd_free(trie->unigrams);
+    if (trie->mmap)
+        mmio_file_unmap(trie->mmap);
     ckd_free(trie);
 }
 
-static void
-lm_trie_alloc_ngram(lm_trie_t * trie, uint32 * counts, int order)
+static size_t
+lm_trie_ngram_size(lm_trie_t * trie, uint32 * counts, int order)
 {
+    size_t size = 0;
     int i;
-    uint8 *mem_ptr;
-    uint8 **middle_starts;
 
-    trie->ngram_mem_size = 0;
     for (i = 1; i < order - 1; i++) {
-        trie->ngram_mem_size +=
+        size +=
             middle_size(lm_trie_quant_msize(trie->quant), counts[i],
                         counts[0], counts[i + 1]);
     }
-    trie->ngram_mem_size +=
+    size +=
         longest_size(lm_trie_quant_lsize(trie->quant), counts[order - 1],
                      counts[0]);
+    return size;
+}
+
+static void
+lm_trie_alloc_ngram(lm_trie_t * trie, uint32 * counts, int order)
+{
+    trie->ngram_mem_size = lm_trie_ngram_size(trie, counts, order);
     trie->ngram_mem =
         (uint8 *) ckd_calloc(trie->ngram_mem_size,
                              sizeof(*trie->ngram_mem));
+    lm_trie_init_ngram(trie, counts, order);
+}
+
+/* Set up the middle and longest n-grams inside trie->ngram_mem. */
+static void
+lm_trie_init_ngram(lm_trie_t * trie, uint32 * counts, int order)
+{
+    int i;
+    uint8 *mem_ptr;
+    uint8 **middle_starts;
+
     mem_ptr = trie->ngram_mem;
     trie->middle_begin =
         (middle_t *) ckd_calloc(order - 2, sizeof(*trie->middle_begin));
@@ -509,23 +610,51 @@ lm_trie_alloc_ngram(lm_trie_t * trie, uint32 * counts, int order)
                  counts[0]);
 }
 
+typedef struct lm_trie_job_s {
+    lm_trie_t *trie;
+    ngram_raw_t **raw_ngrams;
+    uint32 *counts;
+    uint32 *out_counts;
+    int order;
+} lm_trie_job_t;
+
+/* Item 0 counts the n-grams, the others train the quantizer for order
+ * item + 1.  None of them depend on each other. */
+static void
+lm_trie_prepare_range(void *arg, int start, int end, int worker)
+{
+    lm_trie_job_t *job = (lm_trie_job_t *)arg;
+    int i;
+
+    (void)worker;
+    for (i = start; i < end; ++i) {
+        if (i == 0)
+            lm_trie_fix_counts(job->raw_ngrams, job->counts,
+                               job->out_counts, job->order);
+        else if (i + 1 < job->order)
+            lm_trie_quant_train(job->trie->quant, i + 1, job->counts[i],
+                                job->raw_ngrams[i - 1]);
+        else
+            lm_trie_quant_train_prob(job->trie->quant, job->order,
+                                     job->counts[i], job->raw_ngrams[i - 1]);
+    }
+}
+
 void
 lm_trie_build(lm_trie_t * trie, ngram_raw_t ** raw_ngrams, uint32 * counts, uint32 *out_counts,
-              int order)
+              int order, mgau_pool_t * pool)
 {
-    int i;
+    lm_trie_job_t job;
 
-    lm_trie_fix_counts(raw_ngrams, counts, out_counts, order);
-    lm_trie_alloc_ngram(trie, out_counts, order);
-    
     if (order > 1)
         E_INFO("Training quantizer\n");
-    for (i = 2; i < order; i++) {
-        lm_trie_quant_train(trie->quant, i, counts[i - 1],
-                            raw_ngrams[i - 2]);
-    }
-    lm_trie_quant_train_prob(trie->quant, order, counts[order - 1],
-                             raw_ngrams[order - 2]);
+    job.trie = trie;
+    job.raw_ngrams = raw_ngrams;
+    job.counts = counts;
+    job.out_counts = out_counts;
+    job.order = order;
+    mgau_pool_run(pool, lm_trie_prepare_range, &job, order);
+    lm_trie_alloc_ngram(trie, out_counts, order);
 
     E_INFO("Building LM trie\n");
     recursive_insert(trie, raw_ngrams, counts, order);
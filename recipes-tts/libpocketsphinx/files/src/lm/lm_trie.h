@@ -39,9 +39,11 @@
 #define __LM_TRIE_H__
 
 #include "util/pio.h"
+#include "util/mmio.h"
 #include "lm/bitarr.h"
 #include "lm/ngram_model_internal.h"
 #include "lm/lm_trie_quant.h"
+#include "mgau_pool.h"
 
 typedef struct unigram_s {
     float prob;
@@ -83,6 +85,8 @@ typedef struct lm_trie_s {
     middle_t *middle_end;
     longest_t *longest;
     lm_trie_quant_t *quant;
+    mmio_file_t *mmap;        /**< If set, ngram_mem points into it */
+    uint8 unigrams_mapped;    /**< unigrams also point into mmap */
 
     float backoff_cache[NGRAM_MAX_ORDER];
     uint32 hist_cache[NGRAM_MAX_ORDER - 1];
@@ -95,12 +99,37 @@ lm_trie_t *lm_trie_create(uint32 unigram_count, int order);
 
 lm_trie_t *lm_trie_read_bin(uint32 * counts, int order, FILE * fp);
 
+/**
+ * Like lm_trie_read_bin(), but use the quantizer, unigrams and n-grams
+ * in place from the memory-mapped file instead of reading them.
+ *
+ * @param fp Positioned as for lm_trie_read_bin(), left after the
+ *           n-grams on success.
+ * @param mf Mapping of the same file, owned by the trie on success.
+ * @param file_size Size of the file, to check the counts against.
+ * @return NULL if the file can't be used in place (caller should
+ *         rewind fp and use lm_trie_read_bin()).
+ */
+lm_trie_t *lm_trie_read_mmap(uint32 * counts, int order, FILE * fp,
+                             mmio_file_t * mf, size_t file_size);
+
+/**
+ * Make a private copy of memory-mapped unigrams, so they can be modified.
+ */
+void lm_trie_unmap_unigrams(lm_trie_t * trie, uint32 unigram_count);
+
 void lm_trie_write_bin(lm_trie_t * trie, uint32 unigram_count, FILE * fp);
 
 void lm_trie_free(lm_trie_t * trie);
 
+/**
+ * Build the trie from sorted raw ngrams.  Counting and quantizer
+ * training for each order are spread over the threads in pool (which
+ * may be NULL), the trie itself is filled in by the calling thread.
+ */
 void lm_trie_build(lm_trie_t * trie, ngram_raw_t ** raw_ngrams,
-                   uint32 * counts, uint32 *out_counts, int order);
+                   uint32 * counts, uint32 *out_counts, int order,
+                   mgau_pool_t * pool);
 
 void lm_trie_fill_raw_ngram(lm_trie_t * trie,
 			    ngram_raw_t * raw_ngrams, uint32 * raw_ngram_idx,
@@ -59,6 +59,7 @@ struct lm_trie_quant_s {
     bins_t *longest;
     float32 *values;
     size_t nvalues;
+    uint8 values_owned; /* FALSE if memory-mapped */
     uint8 prob_bits;
     uint8 bo_bits;
     uint32 prob_mask;
@@ -122,16 +123,16 @@ quant_size(int order)
     return (order - 2) * middle_table + longest_table;
 }
 
-lm_trie_quant_t *
-lm_trie_quant_create(int order)
+/* Set up the bins in a block of values, owned by the caller. */
+static lm_trie_quant_t *
+quant_init(int order, float32 *values)
 {
     float32 *start;
     int i;
     lm_trie_quant_t *quant =
         (lm_trie_quant_t *) ckd_calloc(1, sizeof(*quant));
     quant->nvalues = quant_size(order);
-    quant->values =
-        (float32 *) ckd_calloc(quant->nvalues, sizeof(*quant->values));
+    quant->values = values;
 
     quant->prob_bits = 16;
     quant->bo_bits = 16;
@@ -150,6 +151,30 @@ lm_trie_quant_create(int order)
     return quant;
 }
 
+lm_trie_quant_t *
+lm_trie_quant_create(int order)
+{
+    lm_trie_quant_t *quant;
+
+    quant = quant_init(order, (float32 *) ckd_calloc(quant_size(order),
+                                                     sizeof(float32)));
+    quant->values_owned = TRUE;
+    return quant;
+}
+
+size_t
+lm_trie_quant_bin_size(int order)
+{
+    return sizeof(int32) + quant_size(order) * sizeof(float32);
+}
+
+lm_trie_quant_t *
+lm_trie_quant_map(uint8 * mem, int order)
+{
+    /* Skip the header word, see lm_trie_quant_write_bin(). */
+    return quant_init(order, (float32 *) (mem + sizeof(int32)));
+}
+
 
 lm_trie_quant_t *
 lm_trie_quant_read_bin(FILE * fp, int order)
@@ -204,7 +229,7 @@ lm_trie_quant_write_bin(lm_trie_quant_t * quant, FILE * fp)
 void
 lm_trie_quant_free(lm_trie_quant_t * quant)
 {
-    if (quant->values)
+    if (quant->values_owned)
         ckd_free(quant->values);
     ckd_free(quant);
 }
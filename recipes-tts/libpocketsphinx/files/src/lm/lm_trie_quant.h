@@ -65,6 +65,17 @@ lm_trie_quant_t *lm_trie_quant_create(int order);
  */
 lm_trie_quant_t *lm_trie_quant_read_bin(FILE * fp, int order);
 
+/**
+ * Number of bytes taken by quant data in a binary file
+ */
+size_t lm_trie_quant_bin_size(int order);
+
+/**
+ * Use quant data in place from a memory-mapped binary file.  The
+ * values must be native-endian and aligned.
+ */
+lm_trie_quant_t *lm_trie_quant_map(uint8 * mem, int order);
+
 /**
  * Write quant data to binary file
  */
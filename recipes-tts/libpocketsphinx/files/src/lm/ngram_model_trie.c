@@ -178,7 +178,6 @@ ngram_model_trie_read_arpa(ps_config_t * config,
     int order;
     int i;
 
-    (void)config;
     E_INFO("Trying to read LM in arpa format\n");
     if ((fp = fopen_comp(path, "r", &is_pipe)) == NULL) {
         E_ERROR("File %s not found\n", path);
@@ -214,17 +213,46 @@ ngram_model_trie_read_arpa(ps_config_t * config,
     }
 
     if (order > 1) {
-        raw_ngrams =
-            ngrams_raw_read_arpa(&li, base->lmath, counts, order,
-                                 base->wid);
+        mgau_pool_t *pool;
+        int mapped = FALSE;
+
+        pool = mgau_pool_init(config ? ps_config_int(config, "nthreads") : 1);
+        raw_ngrams = NULL;
+        /* Parse the n-grams straight from the file if we can, so
+         * they can be split up between threads. */
+        if ((config ? ps_config_bool(config, "mmap") : TRUE) && !is_pipe) {
+            mmio_file_t *mf;
+            long start = ftell(fp);
+            size_t file_size;
+
+            fseek(fp, 0, SEEK_END);
+            file_size = ftell(fp);
+            fseek(fp, start, SEEK_SET);
+            if (start >= 0 && (size_t)start <= file_size
+                && (mf = mmio_file_read(path)) != NULL) {
+                raw_ngrams = ngrams_raw_read_arpa_text
+                    ((char const *) mmio_file_ptr(mf) + start,
+                     file_size - start, lineiter_lineno(li),
+                     base->lmath, counts, order, base->wid, pool);
+                mmio_file_unmap(mf);
+                mapped = TRUE;
+            }
+        }
+        if (!mapped)
+            raw_ngrams =
+                ngrams_raw_read_arpa(&li, base->lmath, counts, order,
+                                     base->wid);
         if (raw_ngrams == NULL) {
+            mgau_pool_free(pool);
             ngram_model_free(base);
             lineiter_free(li);
             fclose_comp(fp, is_pipe);
             return NULL;
         }
-        lm_trie_build(model->trie, raw_ngrams, counts, base->n_counts, order);
+        lm_trie_build(model->trie, raw_ngrams, counts, base->n_counts, order,
+                      pool);
         ngrams_raw_free(raw_ngrams, counts, order);
+        mgau_pool_free(pool);
     }
 
     lineiter_free(li);
@@ -282,8 +310,7 @@ ngram_model_trie_write_arpa(ngram_model_t * base, const char *path)
                            &raw_ngram_idx, base->n_counts, range, hist, 0,
                            i, base->n);
             assert(raw_ngram_idx == base->n_counts[i - 1]);
-            qsort(raw_ngrams, (size_t) base->n_counts[i - 1],
-                  sizeof(ngram_raw_t), &ngram_ord_comparator);
+            ngrams_raw_sort(raw_ngrams, base->n_counts[i - 1], i);
 
             fprintf(fp, "\n\\%d-grams:\n", i);
             for (j = 0; j < base->n_counts[i - 1]; j++) {
@@ -307,23 +334,15 @@ ngram_model_trie_write_arpa(ngram_model_t * base, const char *path)
 }
 
 static void
-read_word_str(ngram_model_t * base, FILE * fp, int do_swap)
+enter_word_str(ngram_model_t * base, char const *word_str, int32 k)
 {
-    int32 k;
     uint32 i, j;
-    char *tmp_word_str;
-    /* read ascii word strings */
+
     base->writable = TRUE;
-    fread(&k, sizeof(k), 1, fp);
-    if (do_swap)
-        SWAP_INT32(&k);
     E_INFO("#word_str: %d\n", k);
-    tmp_word_str = (char *) ckd_calloc((size_t) k, 1);
-    fread(tmp_word_str, 1, (size_t) k, fp);
-
     /* First make sure string just read contains n_counts[0] words (PARANOIA!!) */
     for (i = 0, j = 0; i < (uint32) k; i++)
-        if (tmp_word_str[i] == '\0')
+        if (word_str[i] == '\0')
             j++;
     if (j != base->n_counts[0]) {
         E_ERROR
@@ -333,8 +352,8 @@ read_word_str(ngram_model_t * base, FILE * fp, int do_swap)
 
     /* Break up string just read into words */
     j = 0;
-    for (i = 0; i < base->n_counts[0]; i++) {
-        base->word_str[i] = ckd_salloc(tmp_word_str + j);
+    for (i = 0; i < base->n_counts[0] && j < (uint32) k; i++) {
+        base->word_str[i] = ckd_salloc(word_str + j);
         if (hash_table_enter(base->wid, base->word_str[i],
                              (void *) (size_t) i) != (void *) (size_t) i) {
             E_WARN("Duplicate word in dictionary: %s\n",
@@ -342,9 +361,42 @@ read_word_str(ngram_model_t * base, FILE * fp, int do_swap)
         }
         j += strlen(base->word_str[i]) + 1;
     }
+}
+
+static void
+read_word_str(ngram_model_t * base, FILE * fp, int do_swap)
+{
+    int32 k;
+    char *tmp_word_str;
+    /* read ascii word strings */
+    fread(&k, sizeof(k), 1, fp);
+    if (do_swap)
+        SWAP_INT32(&k);
+    tmp_word_str = (char *) ckd_calloc((size_t) k, 1);
+    fread(tmp_word_str, 1, (size_t) k, fp);
+    enter_word_str(base, tmp_word_str, k);
     free(tmp_word_str);
 }
 
+/* Word strings straight from the memory-mapped file.  They're still
+ * copied so the model stays writable for ngram_model_add_word(). */
+static int
+map_word_str(ngram_model_t * base, mmio_file_t * mf, long offset,
+             size_t file_size)
+{
+    char const *ptr = (char const *) mmio_file_ptr(mf) + offset;
+    int32 k;
+
+    if ((size_t)offset + sizeof(k) > file_size)
+        return -1;
+    memcpy(&k, ptr, sizeof(k));
+    if (k <= 0 || (size_t)offset + sizeof(k) + k > file_size
+        || ptr[sizeof(k) + k - 1] != '\0')
+        return -1;
+    enter_word_str(base, ptr + sizeof(k), k);
+    return 0;
+}
+
 ngram_model_t *
 ngram_model_trie_read_bin(ps_config_t * config,
                           const char *path, logmath_t * lmath)
@@ -358,8 +410,8 @@ ngram_model_trie_read_bin(ps_config_t * config,
     uint32 counts[NGRAM_MAX_ORDER];
     ngram_model_trie_t *model;
     ngram_model_t *base;
+    int do_mmap;
 
-    (void)config;
     E_INFO("Trying to read LM in trie binary format\n");
     if ((fp = fopen_comp(path, "rb", &is_pipe)) == NULL) {
         E_ERROR("File %s not found\n", path);
@@ -390,8 +442,36 @@ ngram_model_trie_read_bin(ps_config_t * config,
         base->n_counts[i] = counts[i];
     }
 
-    model->trie = lm_trie_read_bin(counts, order, fp);
-    read_word_str(base, fp, SWAP_LM_TRIE);
+    /* Use the n-grams in place if we can, so large models load
+     * quickly and share pages between processes. */
+    do_mmap = config ? ps_config_bool(config, "mmap") : TRUE;
+    if (do_mmap && !is_pipe && !SWAP_LM_TRIE) {
+        mmio_file_t *mf;
+        long start = ftell(fp);
+        size_t file_size;
+
+        fseek(fp, 0, SEEK_END);
+        file_size = ftell(fp);
+        fseek(fp, start, SEEK_SET);
+        if ((mf = mmio_file_read(path)) != NULL) {
+            model->trie = lm_trie_read_mmap(counts, order, fp,
+                                            mf, file_size);
+            if (model->trie == NULL) {
+                mmio_file_unmap(mf);
+                fseek(fp, start, SEEK_SET);
+            }
+            else if (map_word_str(base, mf, ftell(fp), file_size) < 0) {
+                E_ERROR("Failed to read word strings\n");
+                fclose_comp(fp, is_pipe);
+                ngram_model_free(base);
+                return NULL;
+            }
+        }
+    }
+    if (model->trie == NULL) {
+        model->trie = lm_trie_read_bin(counts, order, fp);
+        read_word_str(base, fp, SWAP_LM_TRIE);
+    }
     fclose_comp(fp, is_pipe);
 
     return base;
@@ -592,7 +672,8 @@ ngram_model_trie_read_dmp(ps_config_t * config,
             fclose_comp(fp, is_pipe);
             return NULL;
         }
-        lm_trie_build(model->trie, raw_ngrams, counts, base->n_counts, order);        
+        lm_trie_build(model->trie, raw_ngrams, counts, base->n_counts, order,
+                      NULL);
         ngrams_raw_free(raw_ngrams, counts, order);
     }
     
@@ -666,6 +747,7 @@ lm_trie_add_ug(ngram_model_t * base, int32 wid, int32 lweight)
     assert(!NGRAM_IS_CLASSWID(wid));
 
     /* Reallocate unigram array. */
+    lm_trie_unmap_unigrams(model->trie, base->n_counts[0]);
     model->trie->unigrams =
         (unigram_t *) ckd_realloc(model->trie->unigrams,
                                   sizeof(*model->trie->unigrams) *
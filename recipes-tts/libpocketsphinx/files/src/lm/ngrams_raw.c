@@ -46,6 +46,12 @@
 #include "lm/ngram_model_internal.h"
 #include "lm/ngrams_raw.h"
 
+/* Lines parsed by each work item when reading from memory. */
+#define NGRAMS_RAW_BLOCK 16384
+/* Marks an n-gram whose weights have to be read again by the calling
+ * thread, see read_weight(). */
+#define NGRAMS_RAW_DEFERRED ((uint32)-1)
+
 int
 ngram_ord_comparator(const void *a_raw, const void *b_raw)
 {
@@ -67,28 +73,173 @@ ngram_ord_comparator(const void *a_raw, const void *b_raw)
     return a->order - b->order;
 }
 
+void
+ngrams_raw_sort(ngram_raw_t * raw_ngrams, uint32 count, int order)
+{
+    ngram_raw_t *tmp, *src, *dst;
+    uint32 *hist, max_wid, i;
+    int pos, shift;
+
+    if (count < 2)
+        return;
+    max_wid = 0;
+    for (i = 0; i < count; ++i) {
+        for (pos = 0; pos < order; ++pos) {
+            if (raw_ngrams[i].words[pos] > max_wid)
+                max_wid = raw_ngrams[i].words[pos];
+        }
+    }
+    if (max_wid == 0)
+        return;
+
+    tmp = (ngram_raw_t *) ckd_calloc(count, sizeof(*tmp));
+    hist = (uint32 *) ckd_calloc(1 << 16, sizeof(*hist));
+    src = raw_ngrams;
+    dst = tmp;
+    /* Least significant word (the first one) goes last, as it is
+     * the most significant one for ngram_ord_comparator(). */
+    for (pos = order - 1; pos >= 0; --pos) {
+        for (shift = 0; shift < 32 && (max_wid >> shift) != 0; shift += 16) {
+            ngram_raw_t *swap;
+            uint32 sum;
+
+            memset(hist, 0, (1 << 16) * sizeof(*hist));
+            for (i = 0; i < count; ++i)
+                hist[(src[i].words[pos] >> shift) & 0xffff]++;
+            for (sum = 0, i = 0; i < (1 << 16); ++i) {
+                uint32 n = hist[i];
+                hist[i] = sum;
+                sum += n;
+            }
+            for (i = 0; i < count; ++i)
+                dst[hist[(src[i].words[pos] >> shift) & 0xffff]++] = src[i];
+            swap = src;
+            src = dst;
+            dst = swap;
+        }
+    }
+    if (src != raw_ngrams)
+        memcpy(raw_ngrams, src, count * sizeof(*raw_ngrams));
+    ckd_free(hist);
+    ckd_free(tmp);
+}
+
+/*
+ * Read a weight like atof_c() does.  That isn't safe to call from
+ * more than one thread, as it keeps big numbers on a shared free
+ * list, so with threaded set only the numbers that fit exactly in a
+ * double (15 digits, powers of ten up to 22) are read here, which
+ * gives the same result as the correctly rounded atof_c().  Anything
+ * else returns -1.
+ */
 static int
-ngrams_raw_read_line(lineiter_t *li, hash_table_t *wid,
-                    logmath_t *lmath, int order, int order_max,
-                    ngram_raw_t *raw_ngram)
+read_weight(char const *str, int threaded, double *out)
+{
+    static const double tens[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+        1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+        1e21, 1e22
+    };
+    char const *c = str;
+    uint64 mant;
+    int neg, nd, exp, any;
+    double val;
+
+    if (!threaded) {
+        *out = atof_c(str);
+        return 0;
+    }
+    neg = (*c == '-');
+    if (*c == '-' || *c == '+')
+        ++c;
+    mant = 0;
+    nd = exp = any = 0;
+    for (; *c >= '0' && *c <= '9'; ++c, any = 1) {
+        if (mant || *c != '0') {
+            mant = mant * 10 + (*c - '0');
+            ++nd;
+        }
+        if (nd > 15)
+            return -1;
+    }
+    if (*c == '.') {
+        for (++c; *c >= '0' && *c <= '9'; ++c, any = 1) {
+            if (mant || *c != '0') {
+                mant = mant * 10 + (*c - '0');
+                ++nd;
+            }
+            --exp;
+            if (nd > 15)
+                return -1;
+        }
+    }
+    if (!any)
+        return -1;
+    if (*c == 'e' || *c == 'E') {
+        int eneg, e;
+
+        ++c;
+        eneg = (*c == '-');
+        if (*c == '-' || *c == '+')
+            ++c;
+        if (!(*c >= '0' && *c <= '9'))
+            return -1;
+        for (e = 0; *c >= '0' && *c <= '9' && e < 1000; ++c)
+            e = e * 10 + (*c - '0');
+        exp += eneg ? -e : e;
+    }
+    if (*c != '\0')
+        return -1;
+    val = (double)mant;
+    if (exp < 0) {
+        if (exp < -22)
+            return -1;
+        val /= tens[-exp];
+    }
+    else if (exp > 0) {
+        if (exp > 22)
+            return -1;
+        val *= tens[exp];
+    }
+    *out = neg ? -val : val;
+    return 0;
+}
+
+/*
+ * Read one n-gram line from buf (which is modified).
+ * @return 0 on success, -1 for a bad line, 1 if the weights can't be
+ *         read from this thread (see read_weight()).
+ */
+static int
+ngrams_raw_read_line(char *buf, int lineno, hash_table_t *wid,
+                     logmath_t *lmath, int order, int order_max,
+                     int threaded, ngram_raw_t *raw_ngram)
 {
     int n, i;
     int words_expected;
     char *wptr[NGRAM_MAX_ORDER + 1];
     uint32 *word_out;
+    double prob, bo;
 
     words_expected = order + 1;
     if ((n =
-         str2words(li->buf, wptr,
+         str2words(buf, wptr,
                    NGRAM_MAX_ORDER + 1)) < words_expected) {
-        E_ERROR("Format error; %d-gram ignored at line %d\n", order, li->lineno);
+        E_ERROR("Format error; %d-gram ignored at line %d\n", order, lineno);
         return -1;
     }
 
+    bo = 0.0;
+    if (read_weight(wptr[0], threaded, &prob) < 0)
+        return 1;
+    if (order != order_max && n != order + 1
+        && read_weight(wptr[order + 1], threaded, &bo) < 0)
+        return 1;
+
     raw_ngram->order = order;
 
     if (order == order_max) {
-        raw_ngram->prob = atof_c(wptr[0]);
+        raw_ngram->prob = prob;
         if (raw_ngram->prob > 0) {
             E_WARN("%d-gram '%s' has positive probability\n", order, wptr[1]);
             raw_ngram->prob = 0.0f;
@@ -99,7 +250,7 @@ ngrams_raw_read_line(lineiter_t *li, hash_table_t *wid,
     else {
         float weight, backoff;
 
-        weight = atof_c(wptr[0]);
+        weight = prob;
         if (weight > 0) {
             E_WARN("%d-gram '%s' has positive probability\n", order, wptr[1]);
             raw_ngram->prob = 0.0f;
@@ -113,7 +264,7 @@ ngrams_raw_read_line(lineiter_t *li, hash_table_t *wid,
             raw_ngram->backoff = 0.0f;
         }
         else {
-            backoff = atof_c(wptr[order + 1]);
+            backoff = bo;
             raw_ngram->backoff =
                 logmath_log10_to_log_float(lmath, backoff);
         }
@@ -153,13 +304,14 @@ ngrams_raw_read_section(ngram_raw_t ** raw_ngrams, lineiter_t ** li,
                 order);
     	    return -1;
 	}
-        if (ngrams_raw_read_line(*li, wid, lmath, order, order_max,
-                                *raw_ngrams + cur) == 0) {
+        if (ngrams_raw_read_line((*li)->buf, (*li)->lineno, wid, lmath,
+                                 order, order_max, FALSE,
+                                 *raw_ngrams + cur) == 0) {
             cur++;
         }
     }
     *count = cur;
-    qsort(*raw_ngrams, *count, sizeof(ngram_raw_t), &ngram_ord_comparator);
+    ngrams_raw_sort(*raw_ngrams, *count, order);
     return 0;
 }
 
@@ -196,6 +348,236 @@ ngrams_raw_read_arpa(lineiter_t ** li, logmath_t * lmath, uint32 * counts,
     return raw_ngrams;
 }
 
+/**
+ * A run of lines from one n-gram section of an ARPA file in memory.
+ */
+typedef struct ngrams_raw_block_s {
+    char const *start;  /**< Start of the first line. */
+    int lineno;         /**< Line number before the first line. */
+    int order;          /**< Order of the n-grams. */
+    uint32 n;           /**< Number of n-grams. */
+    uint32 n_deferred;  /**< Number left to the calling thread. */
+    ngram_raw_t *out;   /**< Where to put the first n-gram. */
+} ngrams_raw_block_t;
+
+typedef struct ngrams_raw_job_s {
+    ngrams_raw_block_t *blocks;
+    char const *end;
+    hash_table_t *wid;
+    logmath_t *lmath;
+    int order;
+    ngram_raw_t **raw_ngrams;
+    uint32 *counts;
+} ngrams_raw_job_t;
+
+static int
+is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/*
+ * Next line from text that isn't blank or a comment, trimmed like
+ * lineiter_next() does on a clean line iterator.  The line isn't
+ * terminated, its length goes in len.
+ */
+static char const *
+text_next_line(char const **ptr, char const *end, size_t *len, int *lineno)
+{
+    while (*ptr < end) {
+        char const *line, *eol;
+
+        line = *ptr;
+        if ((eol = memchr(line, '\n', end - line)) == NULL)
+            eol = end;
+        *ptr = (eol < end) ? eol + 1 : end;
+        ++*lineno;
+        while (line < eol && is_space(*line))
+            ++line;
+        while (eol > line && is_space(eol[-1]))
+            --eol;
+        if (eol > line && *line != '#') {
+            *len = eol - line;
+            return line;
+        }
+    }
+    return NULL;
+}
+
+static void
+ngrams_raw_parse_block(ngrams_raw_job_t *job, ngrams_raw_block_t *block,
+                       int threaded, char **buf, size_t *bsiz)
+{
+    char const *ptr;
+    uint32 i;
+    int lineno;
+
+    ptr = block->start;
+    lineno = block->lineno;
+    for (i = 0; i < block->n; ++i) {
+        ngram_raw_t *raw_ngram = block->out + i;
+        char const *line;
+        size_t len;
+
+        line = text_next_line(&ptr, job->end, &len, &lineno);
+        if (!threaded && raw_ngram->order != NGRAMS_RAW_DEFERRED)
+            continue;
+        if (len + 1 > *bsiz) {
+            *bsiz = len + 1;
+            *buf = ckd_realloc(*buf, *bsiz);
+        }
+        memcpy(*buf, line, len);
+        (*buf)[len] = '\0';
+        raw_ngram->order = 0;
+        if (ngrams_raw_read_line(*buf, lineno, job->wid, job->lmath,
+                                 block->order, job->order, threaded,
+                                 raw_ngram) > 0) {
+            raw_ngram->order = NGRAMS_RAW_DEFERRED;
+            block->n_deferred++;
+        }
+    }
+}
+
+static void
+ngrams_raw_parse_range(void *arg, int start, int end, int worker)
+{
+    ngrams_raw_job_t *job = (ngrams_raw_job_t *)arg;
+    char *buf = NULL;
+    size_t bsiz = 0;
+    int i;
+
+    (void)worker;
+    for (i = start; i < end; ++i)
+        ngrams_raw_parse_block(job, job->blocks + i, TRUE, &buf, &bsiz);
+    ckd_free(buf);
+}
+
+static void
+ngrams_raw_sort_range(void *arg, int start, int end, int worker)
+{
+    ngrams_raw_job_t *job = (ngrams_raw_job_t *)arg;
+    int i;
+
+    (void)worker;
+    for (i = start; i < end; ++i)
+        ngrams_raw_sort(job->raw_ngrams[i], job->counts[i + 1], i + 2);
+}
+
+ngram_raw_t **
+ngrams_raw_read_arpa_text(char const *text, size_t len, int lineno,
+                          logmath_t * lmath, uint32 * counts, int order,
+                          hash_table_t * wid, mgau_pool_t * pool)
+{
+    ngrams_raw_job_t job;
+    ngram_raw_t **raw_ngrams;
+    ngrams_raw_block_t *blocks;
+    int n_blocks, n_alloc, order_it, i;
+    char const *ptr, *line;
+    char *buf;
+    size_t llen, bsiz;
+
+    raw_ngrams =
+        (ngram_raw_t **) ckd_calloc(order - 1, sizeof(*raw_ngrams));
+    blocks = NULL;
+    n_blocks = n_alloc = 0;
+    ptr = text;
+
+    /* Find the lines in each section and cut them into blocks. */
+    for (order_it = 2; order_it <= order; order_it++) {
+        char expected_header[20];
+        uint32 count = counts[order_it - 1];
+        uint32 j;
+
+        sprintf(expected_header, "\\%d-grams:", order_it);
+        while ((line = text_next_line(&ptr, text + len, &llen, &lineno))) {
+            if (llen == strlen(expected_header)
+                && memcmp(line, expected_header, llen) == 0)
+                break;
+        }
+        if (line == NULL) {
+            E_ERROR("Failed to find '%s', language model file truncated\n",
+                    expected_header);
+            goto error_out;
+        }
+        raw_ngrams[order_it - 2] =
+            (ngram_raw_t *) ckd_calloc(count, sizeof(ngram_raw_t));
+        for (j = 0; j < count; ++j) {
+            char const *prev = ptr;
+            int prev_lineno = lineno;
+
+            if ((line = text_next_line(&ptr, text + len,
+                                       &llen, &lineno)) == NULL) {
+                E_ERROR("Unexpected end of ARPA file. Failed to read %d-gram\n",
+                        order_it);
+                goto error_out;
+            }
+            if (j % NGRAMS_RAW_BLOCK == 0) {
+                ngrams_raw_block_t *block;
+
+                if (n_blocks == n_alloc) {
+                    n_alloc = n_alloc ? n_alloc * 2 : 16;
+                    blocks = ckd_realloc(blocks, n_alloc * sizeof(*blocks));
+                }
+                block = blocks + n_blocks++;
+                block->start = prev;
+                block->lineno = prev_lineno;
+                block->order = order_it;
+                block->n = (count - j < NGRAMS_RAW_BLOCK)
+                    ? count - j : NGRAMS_RAW_BLOCK;
+                block->n_deferred = 0;
+                block->out = raw_ngrams[order_it - 2] + j;
+            }
+        }
+    }
+    if ((line = text_next_line(&ptr, text + len, &llen, &lineno)) == NULL) {
+        E_ERROR("ARPA file ends without end-mark\n");
+        goto error_out;
+    }
+    if (llen != 5 || memcmp(line, "\\end\\", 5) != 0) {
+        E_WARN
+            ("Finished reading ARPA file. Expecting end mark but found '%.*s'\n",
+             (int)llen, line);
+    }
+
+    job.blocks = blocks;
+    job.end = text + len;
+    job.wid = wid;
+    job.lmath = lmath;
+    job.order = order;
+    job.raw_ngrams = raw_ngrams;
+    job.counts = counts;
+    mgau_pool_run(pool, ngrams_raw_parse_range, &job, n_blocks);
+
+    /* Finish whatever the threads couldn't, and drop bad lines. */
+    buf = NULL;
+    bsiz = 0;
+    for (i = 0; i < n_blocks; ++i) {
+        if (blocks[i].n_deferred)
+            ngrams_raw_parse_block(&job, blocks + i, FALSE, &buf, &bsiz);
+    }
+    ckd_free(buf);
+    for (order_it = 2; order_it <= order; order_it++) {
+        ngram_raw_t *raw = raw_ngrams[order_it - 2];
+        uint32 j, cur;
+
+        for (j = cur = 0; j < counts[order_it - 1]; ++j) {
+            if (raw[j].words != NULL)
+                raw[cur++] = raw[j];
+        }
+        counts[order_it - 1] = cur;
+    }
+    mgau_pool_run(pool, ngrams_raw_sort_range, &job, order - 1);
+    ckd_free(blocks);
+    return raw_ngrams;
+
+error_out:
+    for (order_it = 2; order_it <= order; order_it++)
+        ckd_free(raw_ngrams[order_it - 2]);
+    ckd_free(raw_ngrams);
+    ckd_free(blocks);
+    return NULL;
+}
+
 static void
 read_dmp_weight_array(FILE * fp, logmath_t * lmath, uint8 do_swap,
                       int32 counts, ngram_raw_t * raw_ngrams,
@@ -362,12 +744,9 @@ ngrams_raw_read_dmp(FILE * fp, logmath_t * lmath, uint32 * counts,
     ckd_free(bigrams_next);
 
     /* sort raw ngrams for reverse trie */
-    qsort(raw_ngrams[0], (size_t) counts[1], sizeof(*raw_ngrams[0]),
-          &ngram_ord_comparator);
-    if (order > 2) {
-        qsort(raw_ngrams[1], (size_t) counts[2], sizeof(*raw_ngrams[1]),
-              &ngram_ord_comparator);
-    }
+    ngrams_raw_sort(raw_ngrams[0], counts[1], 2);
+    if (order > 2)
+        ngrams_raw_sort(raw_ngrams[1], counts[2], 3);
     return raw_ngrams;
 }
 
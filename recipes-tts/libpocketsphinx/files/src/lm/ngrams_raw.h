@@ -42,6 +42,7 @@
 
 #include "util/hash_table.h"
 #include "util/pio.h"
+#include "mgau_pool.h"
 
 typedef struct ngram_raw_s {
     uint32 *words;              /* array of word indexes, length corresponds to ngram order */
@@ -60,6 +61,12 @@ typedef union {
  */
 int ngram_ord_comparator(const void *a_raw, const void *b_raw);
 
+/**
+ * Sort raw ngrams of the same order in the same order as
+ * ngram_ord_comparator(), with a radix sort on their word indexes.
+ */
+void ngrams_raw_sort(ngram_raw_t * raw_ngrams, uint32 count, int order);
+
 /**
  * Read ngrams of order > 1 from ARPA file
  * @param li     [in] sphinxbase file line iterator that point to bigram description in ARPA file
@@ -73,6 +80,25 @@ ngram_raw_t **ngrams_raw_read_arpa(lineiter_t ** li, logmath_t * lmath,
                                    uint32 * counts, int order,
                                    hash_table_t * wid);
 
+/**
+ * Read ngrams of order > 1 from the text of an ARPA file in memory,
+ * parsing and sorting them with the threads in pool.
+ * @param text   [in] text following the unigrams
+ * @param len    [in] length of text
+ * @param lineno [in] line number of the last line before text
+ * @param lmath  [in] log math used for log convertions
+ * @param counts [in,out] amount of ngrams for each order, less any bad ones on return
+ * @param order  [in] maximum order of ngrams
+ * @param wid    [in] hashtable that maps string word representation to id
+ * @param pool   [in] threads to use, or NULL
+ * @return            raw ngrams of order bigger than 1
+ */
+ngram_raw_t **ngrams_raw_read_arpa_text(char const *text, size_t len,
+                                        int lineno, logmath_t * lmath,
+                                        uint32 * counts, int order,
+                                        hash_table_t * wid,
+                                        mgau_pool_t * pool);
+
 /**
  * Reads ngrams of order > 1 from DMP file.
  * @param fp           [in] file to read from. Position in file corresponds to start of bigram description
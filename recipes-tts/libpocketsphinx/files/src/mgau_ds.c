@@ -0,0 +1,144 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/**
+ * @file mgau_ds.c
+ * @brief Adaptive frame downsampling for acoustic scoring.
+ */
+
+#include <string.h>
+
+#include <pocketsphinx.h>
+
+#include "util/ckd_alloc.h"
+#include "mgau_ds.h"
+
+mgau_ds_t *
+mgau_ds_init(ps_config_t *config, int32 veclen, int32 n_sen)
+{
+    mgau_ds_t *ds;
+    float32 thresh;
+
+    thresh = ps_config_float(config, "dsthresh");
+    if (thresh <= 0 || ps_config_int(config, "dsmax") < 1)
+        return NULL;
+    ds = ckd_calloc(1, sizeof(*ds));
+    ds->thresh = thresh * thresh;
+    ds->max_run = ps_config_int(config, "dsmax");
+    ds->run = -1;
+    /* Compare only the static part, where the stream has one. */
+    ds->veclen = ps_config_int(config, "ceplen");
+    if (ds->veclen <= 0 || ds->veclen > veclen)
+        ds->veclen = veclen;
+    ds->anchor = ckd_calloc(ds->veclen, sizeof(*ds->anchor));
+    ds->sen_epoch = -1;
+    ds->n_sen = n_sen;
+    ds->sen_done = bitvec_alloc(n_sen);
+    /* Bridging large gaps can add up to one entry per 255 senones. */
+    ds->todo = ckd_calloc(n_sen + n_sen / 255 + 1, sizeof(*ds->todo));
+    E_INFO("Reusing acoustic scores for up to %d frames within distance %f\n",
+           ds->max_run, thresh);
+    return ds;
+}
+
+void
+mgau_ds_free(mgau_ds_t *ds)
+{
+    if (ds == NULL)
+        return;
+    if (ds->n_frame)
+        E_INFO("Reused acoustic scores in %d of %d frames (%.1f%%)\n",
+               ds->n_reused, ds->n_frame,
+               ds->n_reused * 100.0 / ds->n_frame);
+    ckd_free(ds->anchor);
+    bitvec_free(ds->sen_done);
+    ckd_free(ds->todo);
+    ckd_free(ds);
+}
+
+int
+mgau_ds_update(mgau_ds_t *ds, mfcc_t const *feat, int32 frame,
+               int can_reuse)
+{
+    int32 i;
+
+    ++ds->n_frame;
+    /* Nothing to compare against at the start of an utterance. */
+    if (frame == 0)
+        ds->run = -1;
+    if (can_reuse && ds->run >= 0 && ds->run < ds->max_run) {
+        float32 dist = 0;
+        for (i = 0; i < ds->veclen; ++i) {
+            float32 d = MFCC2FLOAT(feat[i] - ds->anchor[i]);
+            dist += d * d;
+        }
+        if (dist < ds->thresh) {
+            ++ds->run;
+            ++ds->n_reused;
+            return TRUE;
+        }
+    }
+    memcpy(ds->anchor, feat, ds->veclen * sizeof(*ds->anchor));
+    ds->run = 0;
+    ++ds->epoch;
+    return FALSE;
+}
+
+int32
+mgau_ds_todo(mgau_ds_t *ds, int32 epoch, uint8 **inout_active,
+             int32 n_active, int *out_fresh)
+{
+    int32 i, n, sen, last, out_last;
+
+    *out_fresh = (epoch != ds->sen_epoch);
+    if (*out_fresh) {
+        bitvec_clear_all(ds->sen_done, ds->n_sen);
+        ds->sen_epoch = epoch;
+    }
+    for (n = i = last = out_last = 0; i < n_active; ++i) {
+        int32 delta;
+
+        sen = (*inout_active == NULL) ? i : last + (*inout_active)[i];
+        last = sen;
+        if (bitvec_is_set(ds->sen_done, sen))
+            continue;
+        bitvec_set(ds->sen_done, sen);
+        /* Bridge excessive deltas like acmod_flags2list() does (the
+         * extra senones get scored too, which does no harm). */
+        for (delta = sen - out_last; delta > 255; delta -= 255) {
+            ds->todo[n++] = 255;
+            bitvec_set(ds->sen_done, sen - delta + 255);
+        }
+        ds->todo[n++] = delta;
+        out_last = sen;
+    }
+    *inout_active = ds->todo;
+    return n;
+}
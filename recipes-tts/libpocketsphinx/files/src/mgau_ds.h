@@ -0,0 +1,126 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/**
+ * @file mgau_ds.h
+ * @brief Adaptive frame downsampling for acoustic scoring.
+ *
+ * The semi-continuous and PTM models can skip the full codebook
+ * search on a fixed fraction of frames (the `ds` option).  This
+ * instead looks at how far the cepstrum (the first `ceplen` values of
+ * the first feature stream) has moved since the last frame that was
+ * scored in full, and while
+ * it stays within `dsthresh` the previous frame's top-N codewords are
+ * reused as they are, for at most `dsmax` frames in a row.
+ *
+ * Each frame scored in full starts a new epoch.  Frames in the same
+ * epoch share the same top-N, so senone scores already in the
+ * caller's buffer from that epoch stay valid and only newly active
+ * senones need to be computed.
+ */
+
+#ifndef __MGAU_DS_H__
+#define __MGAU_DS_H__
+
+#include <pocketsphinx.h>
+
+#include "fe/fe.h"
+#include "util/bitvec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+typedef struct mgau_ds_s {
+    float32 thresh;     /**< Squared distance below which frames are reused. */
+    int32 max_run;      /**< Maximum number of frames reused in a row. */
+    int32 run;          /**< Frames reused since the anchor, -1 if none. */
+    int32 veclen;       /**< Number of values compared. */
+    mfcc_t *anchor;     /**< Cepstrum of the last frame scored in full. */
+    int32 epoch;        /**< Number of frames scored in full so far. */
+    int32 sen_epoch;    /**< Epoch of the scores in the senone buffer, or -1. */
+    int32 sen_norm;     /**< Normalizer used for the scores in sen_epoch. */
+    int32 n_sen;        /**< Number of senones. */
+    bitvec_t *sen_done; /**< Senones already scored in sen_epoch. */
+    uint8 *todo;        /**< Senones still to be scored (as deltas). */
+    int32 n_frame;      /**< Frames seen, for statistics. */
+    int32 n_reused;     /**< Frames that reused the previous scores. */
+} mgau_ds_t;
+
+/**
+ * Set up adaptive downsampling from the `dsthresh` and `dsmax`
+ * options.
+ * @return NULL if it is disabled.
+ */
+mgau_ds_t *mgau_ds_init(ps_config_t *config, int32 veclen, int32 n_sen);
+
+/**
+ * Report statistics and free.
+ */
+void mgau_ds_free(mgau_ds_t *ds);
+
+/**
+ * Decide whether a new frame can reuse the top-N of the one before
+ * it.  If it can't, or can_reuse is FALSE, it becomes the anchor and
+ * starts a new epoch.  Frame 0 always does.
+ *
+ * @return TRUE to reuse the previous frame's top-N.
+ */
+int mgau_ds_update(mgau_ds_t *ds, mfcc_t const *feat, int32 frame,
+                   int can_reuse);
+
+/**
+ * Current epoch, to record with the top-N of a frame.
+ */
+#define mgau_ds_epoch(ds) ((ds)->epoch)
+
+/**
+ * Find which active senones still need scoring with top-N from the
+ * given epoch, and mark them as scored.  If the senone buffer holds
+ * scores from some other epoch, they all do, and the caller has to
+ * clear it first.
+ *
+ * @param inout_active In: active senones as deltas, as passed to
+ *        frame_eval (or NULL to use all of them).  Out: the ones to
+ *        score, in the same form.
+ * @param out_fresh Set to TRUE if the senone buffer has to be cleared.
+ * @return Number of entries in *inout_active.
+ */
+int32 mgau_ds_todo(mgau_ds_t *ds, int32 epoch, uint8 **inout_active,
+                   int32 n_active, int *out_fresh);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MGAU_DS_H__ */
@@ -0,0 +1,247 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+
+/**
+ * @file mgau_pool.c
+ * @brief Worker threads for acoustic scoring.
+ */
+
+#include <pocketsphinx.h>
+
+#include "util/ckd_alloc.h"
+#include "mgau_pool.h"
+
+#if defined(_WIN32) || defined(__ADSPBLACKFIN__)
+#define MGAU_POOL_NO_THREADS
+#else
+#include <pthread.h>
+#endif
+
+#ifdef MGAU_POOL_NO_THREADS
+
+mgau_pool_t *
+mgau_pool_init(int n_threads)
+{
+    if (n_threads > 1)
+        E_WARN("Threads not supported, scoring in a single thread\n");
+    return NULL;
+}
+
+int
+mgau_pool_n_workers(mgau_pool_t *pool)
+{
+    (void)pool;
+    return 1;
+}
+
+void
+mgau_pool_run(mgau_pool_t *pool, mgau_pool_func_t func, void *arg,
+              int n_items)
+{
+    (void)pool;
+    (*func)(arg, 0, n_items, 0);
+}
+
+void
+mgau_pool_free(mgau_pool_t *pool)
+{
+    (void)pool;
+}
+
+#else /* !MGAU_POOL_NO_THREADS */
+
+typedef struct mgau_worker_s {
+    mgau_pool_t *pool;
+    pthread_t thread;
+    int id;
+} mgau_worker_t;
+
+struct mgau_pool_s {
+    pthread_mutex_t lock;
+    pthread_cond_t work;    /**< Signalled when a new job is posted. */
+    pthread_cond_t done;    /**< Signalled when the last worker is done. */
+    mgau_worker_t *workers;
+    int n_workers;          /**< Including the calling thread. */
+    int n_started;          /**< Threads actually running. */
+
+    /* Current job, changes under lock. */
+    uint32 generation;
+    int pending;
+    int quit;
+    mgau_pool_func_t func;
+    void *arg;
+    int n_items;
+};
+
+static void
+run_range(mgau_pool_t *pool, mgau_pool_func_t func, void *arg,
+          int n_items, int worker)
+{
+    int start, end;
+
+    /* Same split every time for the same item count. */
+    start = (int)((int64)n_items * worker / pool->n_workers);
+    end = (int)((int64)n_items * (worker + 1) / pool->n_workers);
+    if (start < end)
+        (*func)(arg, start, end, worker);
+}
+
+static void *
+worker_main(void *data)
+{
+    mgau_worker_t *w = (mgau_worker_t *)data;
+    mgau_pool_t *pool = w->pool;
+    uint32 seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        mgau_pool_func_t func;
+        void *arg;
+        int n_items;
+
+        while (!pool->quit && pool->generation == seen)
+            pthread_cond_wait(&pool->work, &pool->lock);
+        if (pool->quit)
+            break;
+        seen = pool->generation;
+        func = pool->func;
+        arg = pool->arg;
+        n_items = pool->n_items;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_range(pool, func, arg, n_items, w->id);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+mgau_pool_t *
+mgau_pool_init(int n_threads)
+{
+    mgau_pool_t *pool;
+    int i;
+
+    if (n_threads <= 1)
+        return NULL;
+    if (n_threads > MGAU_POOL_MAX_WORKERS) {
+        E_WARN("Too many scoring threads (%d), using %d\n",
+               n_threads, MGAU_POOL_MAX_WORKERS);
+        n_threads = MGAU_POOL_MAX_WORKERS;
+    }
+
+    pool = ckd_calloc(1, sizeof(*pool));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->n_workers = n_threads;
+    pool->workers = ckd_calloc(n_threads, sizeof(*pool->workers));
+    /* Worker 0 is whoever calls mgau_pool_run() */
+    for (i = 1; i < n_threads; ++i) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        if (pthread_create(&pool->workers[i].thread, NULL,
+                           worker_main, &pool->workers[i]) != 0) {
+            E_ERROR_SYSTEM("Failed to start scoring thread %d", i);
+            break;
+        }
+        ++pool->n_started;
+    }
+    if (pool->n_started != n_threads - 1) {
+        mgau_pool_free(pool);
+        return NULL;
+    }
+    E_INFO("Scoring with %d threads\n", n_threads);
+    return pool;
+}
+
+int
+mgau_pool_n_workers(mgau_pool_t *pool)
+{
+    if (pool == NULL)
+        return 1;
+    return pool->n_workers;
+}
+
+void
+mgau_pool_run(mgau_pool_t *pool, mgau_pool_func_t func, void *arg,
+              int n_items)
+{
+    if (pool == NULL || n_items < pool->n_workers) {
+        /* Not worth waking anybody up. */
+        if (n_items > 0)
+            (*func)(arg, 0, n_items, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->func = func;
+    pool->arg = arg;
+    pool->n_items = n_items;
+    pool->pending = pool->n_workers - 1;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_range(pool, func, arg, n_items, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void
+mgau_pool_free(mgau_pool_t *pool)
+{
+    int i;
+
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = TRUE;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 1; i <= pool->n_started; ++i)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    ckd_free(pool->workers);
+    ckd_free(pool);
+}
+
+#endif /* !MGAU_POOL_NO_THREADS */
@@ -0,0 +1,97 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+
+/**
+ * @file mgau_pool.h
+ * @brief Worker threads for acoustic scoring.
+ *
+ * A fixed set of threads that the acoustic models use to split up
+ * per-frame work (codebooks, senones) into contiguous ranges.  Each
+ * worker always gets the same range for the same input, and results
+ * are merged in worker order, so scores don't depend on timing.
+ * The ARPA language model reader borrows one to parse and sort
+ * n-grams.
+ *
+ * A NULL pool is valid everywhere and just runs the work in the
+ * calling thread.
+ */
+
+#ifndef __MGAU_POOL_H__
+#define __MGAU_POOL_H__
+
+#include <pocketsphinx/prim_type.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/** Upper bound on workers, including the calling thread. */
+#define MGAU_POOL_MAX_WORKERS 16
+
+typedef struct mgau_pool_s mgau_pool_t;
+
+/**
+ * Work function, called once per worker with the half-open range
+ * [start, end) of items it owns.  worker is 0 for the calling thread
+ * and goes up to mgau_pool_n_workers() - 1.
+ */
+typedef void (*mgau_pool_func_t)(void *arg, int start, int end, int worker);
+
+/**
+ * Start n_threads - 1 worker threads (the caller is the last one).
+ * @return NULL if n_threads is 1 or less, or threads aren't available.
+ */
+mgau_pool_t *mgau_pool_init(int n_threads);
+
+/**
+ * Number of workers, including the calling thread.  1 for a NULL pool.
+ */
+int mgau_pool_n_workers(mgau_pool_t *pool);
+
+/**
+ * Split n_items across the workers and wait for all of them.
+ */
+void mgau_pool_run(mgau_pool_t *pool, mgau_pool_func_t func, void *arg,
+                   int n_items);
+
+/**
+ * Stop and join the worker threads.
+ */
+void mgau_pool_free(mgau_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MGAU_POOL_H__ */
@@ -0,0 +1,632 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+
+/**
+ * @file mgau_simd.c
+ * @brief Vectorized Gaussian and mixture weight evaluation.
+ */
+
+#include <string.h>
+
+#include <pocketsphinx.h>
+
+#include "tied_mgau_common.h"
+#include "mgau_simd.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MGAU_SIMD_NEON
+#include <arm_neon.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#define MGAU_SIMD_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+/* AVX2 and SSSE3 versions are built with target attributes and only
+ * used if the CPU has them. */
+#define MGAU_SIMD_X86_EXT
+#include <immintrin.h>
+#endif
+#endif
+
+typedef mfcc_t (*mgau_dist_func)(mfcc_t d, mfcc_t const *obs,
+                                 mfcc_t const *mean, mfcc_t const *var,
+                                 int32 len, mfcc_t thresh);
+typedef int32 (*mgau_dist_q8_func)(int16 const *obs, int8 const *mean,
+                                   uint8 const *var, int32 len,
+                                   int32 limit);
+typedef void (*mgau_mixw_8b_func)(int16 *out, uint8 const **rows,
+                                  int32 const *scores, int topn,
+                                  uint8 const *tab);
+typedef void (*mgau_mixw_4b_func)(int16 *out, uint8 const **rows,
+                                  uint8 const (*w_den)[16], int topn,
+                                  uint8 const *tab);
+
+/**
+ * Reference version, also used for fixed-point where the subtraction
+ * has to saturate.  This is the loop the models used to carry.
+ */
+static mfcc_t
+dist_scalar(mfcc_t d, mfcc_t const *obs, mfcc_t const *mean,
+            mfcc_t const *var, int32 len, mfcc_t thresh)
+{
+    int32 j;
+
+    for (j = 0; j < len && d >= thresh; ++j) {
+        mfcc_t diff = obs[j] - mean[j];
+        d = GMMSUB(d, MFCCMUL(MFCCMUL(diff, diff), var[j]));
+    }
+    return d;
+}
+
+#if defined(MGAU_SIMD_NEON) && !defined(FIXED_POINT)
+static inline float32_t
+hsum_neon(float32x4_t v)
+{
+#if defined(__aarch64__)
+    return vaddvq_f32(v);
+#else
+    float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    s = vpadd_f32(s, s);
+    return vget_lane_f32(s, 0);
+#endif
+}
+
+/* Eight dimensions per step, the threshold is checked in between.
+ * None of the loads need to be aligned on NEON. */
+static mfcc_t
+dist_neon(mfcc_t d, mfcc_t const *obs, mfcc_t const *mean,
+          mfcc_t const *var, int32 len, mfcc_t thresh)
+{
+    int32 j = 0;
+
+    for (; j + 8 <= len; j += 8) {
+        float32x4_t d0, d1, acc;
+
+        d0 = vsubq_f32(vld1q_f32(obs + j), vld1q_f32(mean + j));
+        d1 = vsubq_f32(vld1q_f32(obs + j + 4), vld1q_f32(mean + j + 4));
+        acc = vmulq_f32(vmulq_f32(d0, d0), vld1q_f32(var + j));
+        acc = vmlaq_f32(acc, vmulq_f32(d1, d1), vld1q_f32(var + j + 4));
+        d -= hsum_neon(acc);
+        if (d < thresh)
+            return d;
+    }
+    if (j + 4 <= len) {
+        float32x4_t d0;
+
+        d0 = vsubq_f32(vld1q_f32(obs + j), vld1q_f32(mean + j));
+        d -= hsum_neon(vmulq_f32(vmulq_f32(d0, d0), vld1q_f32(var + j)));
+        j += 4;
+    }
+    return dist_scalar(d, obs + j, mean + j, var + j, len - j, thresh);
+}
+#endif /* MGAU_SIMD_NEON && !FIXED_POINT */
+
+#if defined(MGAU_SIMD_SSE2) && !defined(FIXED_POINT)
+static inline float
+hsum_sse2(__m128 v)
+{
+    __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+static mfcc_t
+dist_sse2(mfcc_t d, mfcc_t const *obs, mfcc_t const *mean,
+          mfcc_t const *var, int32 len, mfcc_t thresh)
+{
+    int32 j = 0;
+
+    for (; j + 8 <= len; j += 8) {
+        __m128 d0, d1, acc;
+
+        d0 = _mm_sub_ps(_mm_loadu_ps(obs + j), _mm_loadu_ps(mean + j));
+        d1 = _mm_sub_ps(_mm_loadu_ps(obs + j + 4), _mm_loadu_ps(mean + j + 4));
+        acc = _mm_mul_ps(_mm_mul_ps(d0, d0), _mm_loadu_ps(var + j));
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_mul_ps(d1, d1),
+                                         _mm_loadu_ps(var + j + 4)));
+        d -= hsum_sse2(acc);
+        if (d < thresh)
+            return d;
+    }
+    if (j + 4 <= len) {
+        __m128 d0;
+
+        d0 = _mm_sub_ps(_mm_loadu_ps(obs + j), _mm_loadu_ps(mean + j));
+        d -= hsum_sse2(_mm_mul_ps(_mm_mul_ps(d0, d0), _mm_loadu_ps(var + j)));
+        j += 4;
+    }
+    return dist_scalar(d, obs + j, mean + j, var + j, len - j, thresh);
+}
+#endif /* MGAU_SIMD_SSE2 && !FIXED_POINT */
+
+#if defined(MGAU_SIMD_X86_EXT) && !defined(FIXED_POINT)
+/* No FMA here, it would round differently from the other kernels. */
+__attribute__((target("avx2"))) static mfcc_t
+dist_avx2(mfcc_t d, mfcc_t const *obs, mfcc_t const *mean,
+          mfcc_t const *var, int32 len, mfcc_t thresh)
+{
+    int32 j = 0;
+
+    for (; j + 16 <= len; j += 16) {
+        __m256 d0, d1, acc;
+        __m128 s;
+
+        d0 = _mm256_sub_ps(_mm256_loadu_ps(obs + j),
+                           _mm256_loadu_ps(mean + j));
+        d1 = _mm256_sub_ps(_mm256_loadu_ps(obs + j + 8),
+                           _mm256_loadu_ps(mean + j + 8));
+        acc = _mm256_mul_ps(_mm256_mul_ps(d0, d0), _mm256_loadu_ps(var + j));
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_mul_ps(d1, d1),
+                                               _mm256_loadu_ps(var + j + 8)));
+        s = _mm_add_ps(_mm256_castps256_ps128(acc),
+                       _mm256_extractf128_ps(acc, 1));
+        d -= hsum_sse2(s);
+        if (d < thresh)
+            return d;
+    }
+    if (j + 8 <= len) {
+        __m256 d0, acc;
+        __m128 s;
+
+        d0 = _mm256_sub_ps(_mm256_loadu_ps(obs + j),
+                           _mm256_loadu_ps(mean + j));
+        acc = _mm256_mul_ps(_mm256_mul_ps(d0, d0), _mm256_loadu_ps(var + j));
+        s = _mm_add_ps(_mm256_castps256_ps128(acc),
+                       _mm256_extractf128_ps(acc, 1));
+        d -= hsum_sse2(s);
+        j += 8;
+    }
+    /* The compiler won't clear the upper halves before a tail call,
+     * and legacy SSE code after dirty AVX state is very slow. */
+    _mm256_zeroupper();
+    return dist_sse2(d, obs + j, mean + j, var + j, len - j, thresh);
+}
+#endif /* MGAU_SIMD_X86_EXT && !FIXED_POINT */
+
+/*
+ * Mixture weights for semi-continuous models.
+ *
+ * Each kernel scores MGAU_SIMD_SEN_BLOCK consecutive senones: for
+ * every top-N codeword the (quantized, negated) mixture weight plus
+ * the codeword score, log-added together with fast_logmath_add().
+ * The log-add table is cut down to MGAU_SIMD_LOGADD_SIZE entries so
+ * it fits in a couple of vector registers; everything past that is
+ * zero, so clamping the index gives the same result.  Sums are kept
+ * in 16 bits, which is plenty since the inputs are all below 256.
+ */
+
+static inline int
+logadd_block(int x, int y, uint8 const *tab)
+{
+    int d = x > y ? x - y : y - x;
+    int r = x > y ? y : x;
+
+    if (d >= MGAU_SIMD_LOGADD_SIZE)
+        d = MGAU_SIMD_LOGADD_SIZE - 1;
+    return r - tab[d];
+}
+
+static void
+mixw_8b_scalar(int16 *out, uint8 const **rows, int32 const *scores,
+               int topn, uint8 const *tab)
+{
+    int j, k;
+
+    for (j = 0; j < MGAU_SIMD_SEN_BLOCK; ++j) {
+        int tmp = rows[0][j] + scores[0];
+        for (k = 1; k < topn; ++k)
+            tmp = logadd_block(tmp, rows[k][j] + scores[k], tab);
+        out[j] = tmp;
+    }
+}
+
+static void
+mixw_4b_scalar(int16 *out, uint8 const **rows, uint8 const (*w_den)[16],
+               int topn, uint8 const *tab)
+{
+    int j, k;
+
+    for (j = 0; j < MGAU_SIMD_SEN_BLOCK; j += 2) {
+        int tmp0 = w_den[0][rows[0][j/2] & 0x0f];
+        int tmp1 = w_den[0][rows[0][j/2] >> 4];
+        for (k = 1; k < topn; ++k) {
+            tmp0 = logadd_block(tmp0, w_den[k][rows[k][j/2] & 0x0f], tab);
+            tmp1 = logadd_block(tmp1, w_den[k][rows[k][j/2] >> 4], tab);
+        }
+        out[j] = tmp0;
+        out[j + 1] = tmp1;
+    }
+}
+
+#ifdef MGAU_SIMD_NEON
+/* One log-add on 8 lanes, vtbl4 does the 32-entry lookup. */
+static inline int16x8_t
+logadd_neon(int16x8_t x, int16x8_t y, uint8x8x4_t tab)
+{
+    uint8x8_t d;
+
+    d = vqmovun_s16(vminq_s16(vabdq_s16(x, y),
+                              vdupq_n_s16(MGAU_SIMD_LOGADD_SIZE - 1)));
+    return vsubq_s16(vminq_s16(x, y),
+                     vreinterpretq_s16_u16(vmovl_u8(vtbl4_u8(tab, d))));
+}
+
+static inline uint8x8x4_t
+load_tab_neon(uint8 const *tab)
+{
+    uint8x8x4_t t;
+
+    t.val[0] = vld1_u8(tab);
+    t.val[1] = vld1_u8(tab + 8);
+    t.val[2] = vld1_u8(tab + 16);
+    t.val[3] = vld1_u8(tab + 24);
+    return t;
+}
+
+static void
+mixw_8b_neon(int16 *out, uint8 const **rows, int32 const *scores,
+             int topn, uint8 const *tab)
+{
+    uint8x8x4_t t = load_tab_neon(tab);
+    int16x8_t acc0, acc1;
+    int k;
+
+    acc0 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[0])));
+    acc1 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[0] + 8)));
+    acc0 = vaddq_s16(acc0, vdupq_n_s16(scores[0]));
+    acc1 = vaddq_s16(acc1, vdupq_n_s16(scores[0]));
+    for (k = 1; k < topn; ++k) {
+        int16x8_t sc = vdupq_n_s16(scores[k]);
+        int16x8_t v0, v1;
+
+        v0 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[k])));
+        v1 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[k] + 8)));
+        acc0 = logadd_neon(acc0, vaddq_s16(v0, sc), t);
+        acc1 = logadd_neon(acc1, vaddq_s16(v1, sc), t);
+    }
+    vst1q_s16(out, acc0);
+    vst1q_s16(out + 8, acc1);
+}
+
+/* Even senones are in the low nibble, odd ones in the high one. */
+static inline uint8x8x2_t
+lookup_4b_neon(uint8 const *row, uint8 const *w_den)
+{
+    uint8x8_t b = vld1_u8(row);
+    uint8x8x2_t idx, wd;
+
+    idx = vzip_u8(vand_u8(b, vdup_n_u8(0x0f)), vshr_n_u8(b, 4));
+    wd.val[0] = vld1_u8(w_den);
+    wd.val[1] = vld1_u8(w_den + 8);
+    idx.val[0] = vtbl2_u8(wd, idx.val[0]);
+    idx.val[1] = vtbl2_u8(wd, idx.val[1]);
+    return idx;
+}
+
+static void
+mixw_4b_neon(int16 *out, uint8 const **rows, uint8 const (*w_den)[16],
+             int topn, uint8 const *tab)
+{
+    uint8x8x4_t t = load_tab_neon(tab);
+    uint8x8x2_t w;
+    int16x8_t acc0, acc1;
+    int k;
+
+    w = lookup_4b_neon(rows[0], w_den[0]);
+    acc0 = vreinterpretq_s16_u16(vmovl_u8(w.val[0]));
+    acc1 = vreinterpretq_s16_u16(vmovl_u8(w.val[1]));
+    for (k = 1; k < topn; ++k) {
+        w = lookup_4b_neon(rows[k], w_den[k]);
+        acc0 = logadd_neon(acc0, vreinterpretq_s16_u16(vmovl_u8(w.val[0])), t);
+        acc1 = logadd_neon(acc1, vreinterpretq_s16_u16(vmovl_u8(w.val[1])), t);
+    }
+    vst1q_s16(out, acc0);
+    vst1q_s16(out + 8, acc1);
+}
+#endif /* MGAU_SIMD_NEON */
+
+#ifdef MGAU_SIMD_X86_EXT
+/* 16 log-adds at once.  pshufb only sees 16 entries, so look up the
+ * two halves of the table separately; an index with its top bit set
+ * gives zero. */
+__attribute__((target("ssse3"))) static inline void
+logadd_ssse3(__m128i *acc0, __m128i *acc1, __m128i v0, __m128i v1,
+             __m128i tab_lo, __m128i tab_hi)
+{
+    __m128i d, hi, t, zero = _mm_setzero_si128();
+
+    d = _mm_packus_epi16(_mm_abs_epi16(_mm_sub_epi16(*acc0, v0)),
+                         _mm_abs_epi16(_mm_sub_epi16(*acc1, v1)));
+    d = _mm_min_epu8(d, _mm_set1_epi8(MGAU_SIMD_LOGADD_SIZE - 1));
+    hi = _mm_cmpgt_epi8(d, _mm_set1_epi8(15));
+    t = _mm_or_si128(_mm_shuffle_epi8(tab_lo, _mm_or_si128(d, hi)),
+                     _mm_shuffle_epi8(tab_hi,
+                                      _mm_sub_epi8(d, _mm_set1_epi8(16))));
+    *acc0 = _mm_sub_epi16(_mm_min_epi16(*acc0, v0),
+                          _mm_unpacklo_epi8(t, zero));
+    *acc1 = _mm_sub_epi16(_mm_min_epi16(*acc1, v1),
+                          _mm_unpackhi_epi8(t, zero));
+}
+
+__attribute__((target("ssse3"))) static void
+mixw_8b_ssse3(int16 *out, uint8 const **rows, int32 const *scores,
+              int topn, uint8 const *tab)
+{
+    __m128i tab_lo = _mm_loadu_si128((__m128i const *)tab);
+    __m128i tab_hi = _mm_loadu_si128((__m128i const *)(tab + 16));
+    __m128i zero = _mm_setzero_si128();
+    __m128i b, sc, acc0, acc1;
+    int k;
+
+    b = _mm_loadu_si128((__m128i const *)rows[0]);
+    sc = _mm_set1_epi16(scores[0]);
+    acc0 = _mm_add_epi16(_mm_unpacklo_epi8(b, zero), sc);
+    acc1 = _mm_add_epi16(_mm_unpackhi_epi8(b, zero), sc);
+    for (k = 1; k < topn; ++k) {
+        b = _mm_loadu_si128((__m128i const *)rows[k]);
+        sc = _mm_set1_epi16(scores[k]);
+        logadd_ssse3(&acc0, &acc1,
+                     _mm_add_epi16(_mm_unpacklo_epi8(b, zero), sc),
+                     _mm_add_epi16(_mm_unpackhi_epi8(b, zero), sc),
+                     tab_lo, tab_hi);
+    }
+    _mm_storeu_si128((__m128i *)out, acc0);
+    _mm_storeu_si128((__m128i *)(out + 8), acc1);
+}
+
+/* Even senones are in the low nibble, odd ones in the high one. */
+__attribute__((target("ssse3"))) static inline __m128i
+lookup_4b_ssse3(uint8 const *row, uint8 const *w_den)
+{
+    __m128i b = _mm_loadl_epi64((__m128i const *)row);
+    __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i idx;
+
+    idx = _mm_unpacklo_epi8(_mm_and_si128(b, mask),
+                            _mm_and_si128(_mm_srli_epi16(b, 4), mask));
+    return _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)w_den), idx);
+}
+
+__attribute__((target("ssse3"))) static void
+mixw_4b_ssse3(int16 *out, uint8 const **rows, uint8 const (*w_den)[16],
+              int topn, uint8 const *tab)
+{
+    __m128i tab_lo = _mm_loadu_si128((__m128i const *)tab);
+    __m128i tab_hi = _mm_loadu_si128((__m128i const *)(tab + 16));
+    __m128i zero = _mm_setzero_si128();
+    __m128i w, acc0, acc1;
+    int k;
+
+    w = lookup_4b_ssse3(rows[0], w_den[0]);
+    acc0 = _mm_unpacklo_epi8(w, zero);
+    acc1 = _mm_unpackhi_epi8(w, zero);
+    for (k = 1; k < topn; ++k) {
+        w = lookup_4b_ssse3(rows[k], w_den[k]);
+        logadd_ssse3(&acc0, &acc1, _mm_unpacklo_epi8(w, zero),
+                     _mm_unpackhi_epi8(w, zero), tab_lo, tab_hi);
+    }
+    _mm_storeu_si128((__m128i *)out, acc0);
+    _mm_storeu_si128((__m128i *)(out + 8), acc1);
+}
+#endif /* MGAU_SIMD_X86_EXT */
+
+/* Quantized Gaussians, MGAU_SIMD_Q8_ALIGN dimensions at a time with
+ * the limit checked in between like the vector versions. */
+static int32
+dist_q8_scalar(int16 const *obs, int8 const *mean, uint8 const *var,
+               int32 len, int32 limit)
+{
+    int32 j, acc = 0;
+
+    for (j = 0; j < len; ++j) {
+        int32 diff = obs[j] - mean[j];
+
+        if (diff > MGAU_SIMD_Q8_MAX_DIFF)
+            diff = MGAU_SIMD_Q8_MAX_DIFF;
+        else if (diff < -MGAU_SIMD_Q8_MAX_DIFF)
+            diff = -MGAU_SIMD_Q8_MAX_DIFF;
+        acc += diff * diff * var[j];
+        if (j % MGAU_SIMD_Q8_ALIGN == MGAU_SIMD_Q8_ALIGN - 1 && acc > limit)
+            break;
+    }
+    return acc;
+}
+
+#ifdef MGAU_SIMD_NEON
+/* The squares fit in 16 bits thanks to the clamping, so they can be
+ * multiplied by the variances and accumulated with vmlal. */
+static int32
+dist_q8_neon(int16 const *obs, int8 const *mean, uint8 const *var,
+             int32 len, int32 limit)
+{
+    const int16x8_t maxd = vdupq_n_s16(MGAU_SIMD_Q8_MAX_DIFF);
+    const int16x8_t mind = vdupq_n_s16(-MGAU_SIMD_Q8_MAX_DIFF);
+    int32x4_t acc = vdupq_n_s32(0);
+    int32 j, sum = 0;
+
+    for (j = 0; j < len; j += 8) {
+        int16x8_t diff, sq, v;
+
+        v = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(var + j)));
+        diff = vqsubq_s16(vld1q_s16(obs + j), vmovl_s8(vld1_s8(mean + j)));
+        diff = vminq_s16(vmaxq_s16(diff, mind), maxd);
+        sq = vmulq_s16(diff, diff);
+        acc = vmlal_s16(acc, vget_low_s16(sq), vget_low_s16(v));
+        acc = vmlal_s16(acc, vget_high_s16(sq), vget_high_s16(v));
+#if defined(__aarch64__)
+        sum = vaddvq_s32(acc);
+#else
+        {
+            int32x2_t s = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+            sum = vget_lane_s32(vpadd_s32(s, s), 0);
+        }
+#endif
+        if (sum > limit)
+            break;
+    }
+    return sum;
+}
+#endif /* MGAU_SIMD_NEON */
+
+#ifdef MGAU_SIMD_SSE2
+static int32
+dist_q8_sse2(int16 const *obs, int8 const *mean, uint8 const *var,
+             int32 len, int32 limit)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i maxd = _mm_set1_epi16(MGAU_SIMD_Q8_MAX_DIFF);
+    const __m128i mind = _mm_set1_epi16(-MGAU_SIMD_Q8_MAX_DIFF);
+    __m128i acc = zero;
+    int32 j, sum = 0;
+
+    for (j = 0; j < len; j += 8) {
+        __m128i m, v, diff, s;
+
+        /* Sign-extend the means, zero-extend the variances. */
+        m = _mm_loadl_epi64((__m128i const *)(mean + j));
+        m = _mm_srai_epi16(_mm_unpacklo_epi8(m, m), 8);
+        v = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const *)(var + j)),
+                              zero);
+        diff = _mm_subs_epi16(_mm_loadu_si128((__m128i const *)(obs + j)), m);
+        diff = _mm_min_epi16(_mm_max_epi16(diff, mind), maxd);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_mullo_epi16(diff, diff),
+                                                v));
+        s = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum = _mm_cvtsi128_si32(s);
+        if (sum > limit)
+            break;
+    }
+    return sum;
+}
+#endif /* MGAU_SIMD_SSE2 */
+
+static mgau_dist_func mgau_dist = dist_scalar;
+static mgau_dist_q8_func mgau_dist_q8 = dist_q8_scalar;
+static mgau_mixw_8b_func mgau_mixw_8b = mixw_8b_scalar;
+static mgau_mixw_4b_func mgau_mixw_4b = mixw_4b_scalar;
+
+const char *
+mgau_simd_init(void)
+{
+    mgau_dist_func dist = dist_scalar;
+    mgau_dist_q8_func dist_q8 = dist_q8_scalar;
+    mgau_mixw_8b_func mixw_8b = mixw_8b_scalar;
+    mgau_mixw_4b_func mixw_4b = mixw_4b_scalar;
+    const char *name = "scalar";
+    const char *mixw_name = "scalar";
+
+#if defined(MGAU_SIMD_NEON)
+#ifndef FIXED_POINT
+    dist = dist_neon;
+    name = "NEON";
+#endif
+    dist_q8 = dist_q8_neon;
+    mixw_8b = mixw_8b_neon;
+    mixw_4b = mixw_4b_neon;
+    mixw_name = "NEON";
+#elif defined(MGAU_SIMD_SSE2)
+#ifndef FIXED_POINT
+    dist = dist_sse2;
+    name = "SSE2";
+#endif
+    dist_q8 = dist_q8_sse2;
+#if defined(MGAU_SIMD_X86_EXT)
+    __builtin_cpu_init();
+#ifndef FIXED_POINT
+    if (__builtin_cpu_supports("avx2")) {
+        dist = dist_avx2;
+        name = "AVX2";
+    }
+#endif
+    if (__builtin_cpu_supports("ssse3")) {
+        mixw_8b = mixw_8b_ssse3;
+        mixw_4b = mixw_4b_ssse3;
+        mixw_name = "SSSE3";
+    }
+#endif
+#endif
+    if (dist != mgau_dist || mixw_8b != mgau_mixw_8b)
+        E_INFO("Using %s Gaussian evaluation, %s mixture weights\n",
+               name, mixw_name);
+    /* Every decoder picks the same ones, so racing here is harmless. */
+    mgau_dist = dist;
+    mgau_dist_q8 = dist_q8;
+    mgau_mixw_8b = mixw_8b;
+    mgau_mixw_4b = mixw_4b;
+    return name;
+}
+
+mfcc_t
+mgau_simd_dist(mfcc_t d, mfcc_t const *obs, mfcc_t const *mean,
+               mfcc_t const *var, int32 len, mfcc_t thresh)
+{
+    return (*mgau_dist)(d, obs, mean, var, len, thresh);
+}
+
+int32
+mgau_simd_dist_q8(int16 const *obs, int8 const *mean, uint8 const *var,
+                  int32 len, int32 limit)
+{
+    return (*mgau_dist_q8)(obs, mean, var, len, limit);
+}
+
+int
+mgau_simd_logadd_table(logmath_t *lmath_8b, uint8 *tab)
+{
+    logadd_t *t = LOGMATH_TABLE(lmath_8b);
+    uint8 const *table = (uint8 const *)t->table;
+    uint32 i;
+
+    if (t->width != 1 || t->table_size < MGAU_SIMD_LOGADD_SIZE)
+        return FALSE;
+    /* Clamping the index is only exact if the rest is all zero */
+    for (i = MGAU_SIMD_LOGADD_SIZE - 1; i < t->table_size; ++i) {
+        if (table[i] != 0)
+            return FALSE;
+    }
+    memcpy(tab, table, MGAU_SIMD_LOGADD_SIZE);
+    return TRUE;
+}
+
+void
+mgau_simd_mixw_8b(int16 *out, uint8 const **rows, int32 const *scores,
+                  int topn, uint8 const *tab)
+{
+    (*mgau_mixw_8b)(out, rows, scores, topn, tab);
+}
+
+void
+mgau_simd_mixw_4b(int16 *out, uint8 const **rows, uint8 const (*w_den)[16],
+                  int topn, uint8 const *tab)
+{
+    (*mgau_mixw_4b)(out, rows, w_den, topn, tab);
+}
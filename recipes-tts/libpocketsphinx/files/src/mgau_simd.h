@@ -0,0 +1,163 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/**
+ * @file mgau_simd.h
+ * @brief Vectorized Gaussian and mixture weight evaluation.
+ *
+ * All of the acoustic models spend most of their time in the same
+ * loop: subtract the mean from the observation, square it, weight it
+ * by the precomputed inverse variance and subtract that from the
+ * log-determinant.  This provides that loop for NEON, SSE2 and AVX2,
+ * chosen once at runtime, with the plain C version as a fallback.
+ *
+ * The SIMD versions add up the dimensions in a different order, so
+ * they match the scalar one to within float rounding, not bit for
+ * bit.  Fixed-point builds always use the scalar version.
+ *
+ * PTM models can instead keep their means and inverse variances in 8
+ * bits, see mgau_simd_dist_q8().  That's all integer arithmetic, so
+ * every version of it gives exactly the same result.
+ *
+ * Semi-continuous models then spend most of the rest looking up
+ * quantized mixture weights for every senone.  The mixw kernels do
+ * that for a block of consecutive senones at a time, with table
+ * lookups done as byte shuffles (NEON vtbl, SSSE3 pshufb).  Those
+ * are integer-only and give the same results as the scalar code.
+ */
+
+#ifndef __MGAU_SIMD_H__
+#define __MGAU_SIMD_H__
+
+#include <float.h>
+
+#include <pocketsphinx/prim_type.h>
+#include <pocketsphinx/logmath.h>
+
+#include "fe/fe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+/** Threshold to pass to mgau_simd_dist() to never stop early. */
+#ifdef FIXED_POINT
+#define MGAU_SIMD_NO_THRESH INT_MIN
+#else
+#define MGAU_SIMD_NO_THRESH (-FLT_MAX)
+#endif
+
+/** Quantized Gaussians are padded to a multiple of this many dimensions. */
+#define MGAU_SIMD_Q8_ALIGN 8
+/** Largest difference (in mean steps) mgau_simd_dist_q8() accounts for. */
+#define MGAU_SIMD_Q8_MAX_DIFF 181
+/** Most dimensions mgau_simd_dist_q8() can add up without overflow. */
+#define MGAU_SIMD_Q8_MAX_LEN 256
+
+/** Senones scored by one call to the mixture weight kernels. */
+#define MGAU_SIMD_SEN_BLOCK 16
+/** Log-add table entries used by the mixture weight kernels. */
+#define MGAU_SIMD_LOGADD_SIZE 32
+
+/**
+ * Select the fastest kernel this CPU supports.  Safe to call more
+ * than once.
+ * @return Name of the selected kernel.
+ */
+const char *mgau_simd_init(void);
+
+/**
+ * Compute d - sum((obs[i] - mean[i])^2 * var[i]) over len dimensions.
+ *
+ * Since every term is positive the result only decreases, so once it
+ * drops below thresh the Gaussian can't make it into the top-N and
+ * the kernel may return early.  Any return value below thresh means
+ * "knocked out" and should not be used as a score.
+ */
+mfcc_t mgau_simd_dist(mfcc_t d, mfcc_t const *obs, mfcc_t const *mean,
+                      mfcc_t const *var, int32 len, mfcc_t thresh);
+
+/**
+ * Compute sum(min(|obs[i] - mean[i]|, MGAU_SIMD_Q8_MAX_DIFF)^2 * var[i])
+ * over len dimensions of a quantized Gaussian.
+ *
+ * The caller scales the observation to the same steps as the means,
+ * and folds those steps into var, so that this times a scale factor
+ * is what mgau_simd_dist() would subtract from the determinant.
+ *
+ * @param len Number of dimensions, a multiple of MGAU_SIMD_Q8_ALIGN no
+ *            more than MGAU_SIMD_Q8_MAX_LEN.
+ * @param limit The kernel may stop and return early once the sum is
+ *              above this.
+ */
+int32 mgau_simd_dist_q8(int16 const *obs, int8 const *mean,
+                        uint8 const *var, int32 len, int32 limit);
+
+/**
+ * Copy the start of an 8-bit log-add table for the mixw kernels.
+ * @param tab Output, MGAU_SIMD_LOGADD_SIZE entries.
+ * @return TRUE if the table is short enough for them to be exact,
+ *         FALSE if the caller has to stick to fast_logmath_add().
+ */
+int mgau_simd_logadd_table(logmath_t *lmath_8b, uint8 *tab);
+
+/**
+ * Score MGAU_SIMD_SEN_BLOCK senones from 8-bit mixture weights.
+ * @param out Output, log-added density for each senone.
+ * @param rows Mixture weights for each top-N codeword, starting at
+ *             the first senone of the block.
+ * @param scores Score of each top-N codeword.
+ * @param topn Number of codewords, at least 1.
+ * @param tab Table from mgau_simd_logadd_table().
+ *
+ * Each weight plus score has to fit in 8 bits, which it does since
+ * they're clipped to MAX_NEG_MIXW and MAX_NEG_ASCR.
+ */
+void mgau_simd_mixw_8b(int16 *out, uint8 const **rows, int32 const *scores,
+                       int topn, uint8 const *tab);
+
+/**
+ * Score MGAU_SIMD_SEN_BLOCK senones from 4-bit mixture weights.
+ * Like mgau_simd_mixw_8b(), but rows hold two senones per byte (even
+ * ones in the low nibble) and w_den[k] is the mixture weight codebook
+ * with the score of codeword k already added.
+ */
+void mgau_simd_mixw_4b(int16 *out, uint8 const **rows,
+                       uint8 const (*w_den)[16], int topn,
+                       uint8 const *tab);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MGAU_SIMD_H__ */
@@ -0,0 +1,185 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/**
+ * @file model_cache.c
+ * @brief Process-wide cache of read-only model objects.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <pocketsphinx.h>
+
+#include "util/ckd_alloc.h"
+#include "bin_mdef.h"
+#include "tmat.h"
+#include "dict.h"
+#include "dict2pid.h"
+#include "model_cache.h"
+
+#if defined(_WIN32) || defined(__ADSPBLACKFIN__)
+#define MODEL_CACHE_LOCK()
+#define MODEL_CACHE_UNLOCK()
+#else
+#include <pthread.h>
+static pthread_mutex_t model_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define MODEL_CACHE_LOCK() pthread_mutex_lock(&model_cache_lock)
+#define MODEL_CACHE_UNLOCK() pthread_mutex_unlock(&model_cache_lock)
+#endif
+
+typedef struct model_cache_entry_s model_cache_entry_t;
+struct model_cache_entry_s {
+    model_cache_type_t type;
+    char *key;
+    void *obj;
+    model_cache_entry_t *next;
+};
+
+/* There are only ever a handful of these, a list will do. */
+static model_cache_entry_t *model_cache_entries;
+
+static void *
+model_cache_retain(model_cache_type_t type, void *obj)
+{
+    switch (type) {
+    case MODEL_CACHE_MDEF:
+        return bin_mdef_retain(obj);
+    case MODEL_CACHE_TMAT:
+        return tmat_retain(obj);
+    case MODEL_CACHE_DICT:
+        return dict_retain(obj);
+    case MODEL_CACHE_D2P:
+        return dict2pid_retain(obj);
+    }
+    return NULL;
+}
+
+static int
+model_cache_release(model_cache_type_t type, void *obj)
+{
+    switch (type) {
+    case MODEL_CACHE_MDEF:
+        return bin_mdef_free(obj);
+    case MODEL_CACHE_TMAT:
+        return tmat_free(obj);
+    case MODEL_CACHE_DICT:
+        return dict_free(obj);
+    case MODEL_CACHE_D2P:
+        return dict2pid_free(obj);
+    }
+    return 0;
+}
+
+static model_cache_entry_t *
+model_cache_find(model_cache_type_t type, char const *key)
+{
+    model_cache_entry_t *ent;
+
+    for (ent = model_cache_entries; ent; ent = ent->next)
+        if (ent->type == type && 0 == strcmp(ent->key, key))
+            return ent;
+    return NULL;
+}
+
+char *
+model_cache_key(char const *fmt, ...)
+{
+    va_list args;
+    char *key;
+    int len;
+
+    va_start(args, fmt);
+    len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+    key = ckd_malloc(len + 1);
+    va_start(args, fmt);
+    vsnprintf(key, len + 1, fmt, args);
+    va_end(args);
+
+    return key;
+}
+
+void *
+model_cache_get(model_cache_type_t type, char const *key)
+{
+    model_cache_entry_t *ent;
+    void *obj = NULL;
+
+    MODEL_CACHE_LOCK();
+    if ((ent = model_cache_find(type, key)) != NULL)
+        obj = model_cache_retain(type, ent->obj);
+    MODEL_CACHE_UNLOCK();
+
+    return obj;
+}
+
+void *
+model_cache_put(model_cache_type_t type, char const *key, void *obj)
+{
+    model_cache_entry_t *ent;
+
+    MODEL_CACHE_LOCK();
+    if ((ent = model_cache_find(type, key)) != NULL) {
+        /* Lost the race, use the one that's already there. */
+        model_cache_release(type, obj);
+        obj = model_cache_retain(type, ent->obj);
+    }
+    else {
+        ent = ckd_calloc(1, sizeof(*ent));
+        ent->type = type;
+        ent->key = ckd_salloc(key);
+        ent->obj = model_cache_retain(type, obj);
+        ent->next = model_cache_entries;
+        model_cache_entries = ent;
+    }
+    MODEL_CACHE_UNLOCK();
+
+    return obj;
+}
+
+void
+ps_model_cache_clear(void)
+{
+    model_cache_entry_t *ent, *next;
+
+    MODEL_CACHE_LOCK();
+    ent = model_cache_entries;
+    model_cache_entries = NULL;
+    MODEL_CACHE_UNLOCK();
+
+    for (; ent; ent = next) {
+        next = ent->next;
+        model_cache_release(ent->type, ent->obj);
+        ckd_free(ent->key);
+        ckd_free(ent);
+    }
+}
@@ -0,0 +1,109 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/**
+ * @file model_cache.h
+ * @brief Process-wide cache of read-only model objects.
+ *
+ * When the "model_cache" option is set, decoders look up their model
+ * definition, transition matrices, dictionary and dict2pid mapping
+ * here before reading them from disk, so a second decoder using the
+ * same files just takes another reference.  The cache holds its own
+ * reference to everything it has seen until ps_model_cache_clear().
+ *
+ * Objects are keyed by type and a string describing everything they
+ * were built from (see model_cache_key()).  Only objects that nothing
+ * modifies after loading belong here; the decoder makes a private
+ * copy of the dictionary before adding words to it.
+ */
+
+#ifndef __MODEL_CACHE_H__
+#define __MODEL_CACHE_H__
+
+#include <pocketsphinx/prim_type.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+typedef enum model_cache_type_e {
+    MODEL_CACHE_MDEF,   /**< bin_mdef_t */
+    MODEL_CACHE_TMAT,   /**< tmat_t */
+    MODEL_CACHE_DICT,   /**< dict_t */
+    MODEL_CACHE_D2P     /**< dict2pid_t */
+} model_cache_type_t;
+
+/**
+ * Build a cache key with printf-style formatting.
+ * @return Newly allocated key, free with ckd_free().
+ */
+char *model_cache_key(char const *fmt, ...);
+
+/**
+ * Look up a cached object.
+ * @return New reference to the object, or NULL if there is none.
+ */
+void *model_cache_get(model_cache_type_t type, char const *key);
+
+/**
+ * Add an object to the cache, which takes its own reference to it.
+ *
+ * If another thread got there first, obj is released and the cached
+ * object is returned instead, so always use the return value.
+ * @return A reference to the cached object, owned by the caller.
+ */
+void *model_cache_put(model_cache_type_t type, char const *key, void *obj);
+
+/**
+ * Reference counting for the objects above.  A decoder being freed in
+ * one thread drops its references while model_cache_get() takes new
+ * ones in another, and only the latter holds the cache lock, so the
+ * counts have to be updated atomically.  Both return the new count.
+ */
+#if defined(__GNUC__)
+#define model_cache_ref(rc) __atomic_add_fetch(&(rc), 1, __ATOMIC_RELAXED)
+#define model_cache_unref(rc) __atomic_sub_fetch(&(rc), 1, __ATOMIC_ACQ_REL)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define model_cache_ref(rc) _InterlockedIncrement((long volatile *)&(rc))
+#define model_cache_unref(rc) _InterlockedDecrement((long volatile *)&(rc))
+#else
+#define model_cache_ref(rc) (++(rc))
+#define model_cache_unref(rc) (--(rc))
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MODEL_CACHE_H__ */
@@ -45,6 +45,7 @@
 #include "util/bio.h"
 #include "util/ckd_alloc.h"
 
+#include "mgau_simd.h"
 #include "ms_gauden.h"
 
 #define GAUDEN_PARAM_VERSION	"1.0"
@@ -351,6 +352,7 @@ gauden_init(char const *meanfile, char const *varfile, float32 varfloor, logmath
     ckd_free(flen);
 
     gauden_dist_precompute(g, lmath, varfloor);
+    mgau_simd_init();
 
     return g;
 }
@@ -379,7 +381,7 @@ compute_dist_all(gauden_dist_t * out_dist, mfcc_t* obs, int32 featlen,
                  mfcc_t ** mean, mfcc_t ** var, mfcc_t * det,
                  int32 n_density)
 {
-    int32 i, d;
+    int32 d;
 
     for (d = 0; d < n_density; ++d) {
         mfcc_t *m;
@@ -390,24 +392,21 @@ compute_dist_all(gauden_dist_t * out_dist, mfcc_t* obs, int32 featlen,
         v = var[d];
         dval = det[d];
 
-        for (i = 0; i < featlen; i++) {
-            mfcc_t diff;
 #ifdef FIXED_POINT
+        int32 i;
+        for (i = 0; i < featlen; i++) {
             /* Have to check for underflows here. */
             mfcc_t pdval = dval;
-            diff = obs[i] - m[i];
+            mfcc_t diff = obs[i] - m[i];
             dval -= MFCCMUL(MFCCMUL(diff, diff), v[i]);
             if (dval > pdval) {
                 dval = WORST_SCORE;
                 break;
             }
+        }
 #else
-            diff = obs[i] - m[i];
-            /* The compiler really likes this to be a single
-             * expression, for whatever reason. */
-            dval -= diff * diff * v[i];
+        dval = mgau_simd_dist(dval, obs, m, v, featlen, MGAU_SIMD_NO_THRESH);
 #endif
-        }
 
         out_dist[d].dist = dval;
         out_dist[d].id = d;
@@ -448,26 +447,25 @@ compute_dist(gauden_dist_t * out_dist, int32 n_top,
         v = var[d];
         dval = det[d];
 
-        for (i = 0; (i < featlen) && (dval >= worst->dist); i++) {
-            mfcc_t diff;
 #ifdef FIXED_POINT
+        for (i = 0; (i < featlen) && (dval >= worst->dist); i++) {
             /* Have to check for underflows here. */
             mfcc_t pdval = dval;
-            diff = obs[i] - m[i];
+            mfcc_t diff = obs[i] - m[i];
             dval -= MFCCMUL(MFCCMUL(diff, diff), v[i]);
             if (dval > pdval) {
                 dval = WORST_SCORE;
                 break;
             }
+        }
+        if (i < featlen)        /* Stopped early, so worse than worst */
+            continue;
 #else
-            diff = obs[i] - m[i];
-            /* The compiler really likes this to be a single
-             * expression, for whatever reason. */
-            dval -= diff * diff * v[i];
+        /* Stops as soon as dval falls below the worst one */
+        dval = mgau_simd_dist(dval, obs, m, v, featlen, worst->dist);
 #endif
-        }
 
-        if ((i < featlen) || (dval < worst->dist))     /* Codeword d worse than worst */
+        if (dval < worst->dist)     /* Codeword d worse than worst */
             continue;
 
         /* Codeword d at least as good as worst so far; insert in the ordered list */
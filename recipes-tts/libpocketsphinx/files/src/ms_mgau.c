@@ -74,7 +74,8 @@ static ps_mgaufuncs_t ms_mgau_funcs = {
     "ms",
     ms_cont_mgau_frame_eval, /* frame_eval */
     ms_mgau_mllr_transform,  /* transform */
-    ms_mgau_free             /* free */
+    ms_mgau_free,            /* free */
+    NULL                     /* batch_eval */
 };
 
 ps_mgau_t *
@@ -152,6 +153,8 @@ ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
         ckd_calloc_3d(g->n_mgau, g->n_feat, msg->topn,
                       sizeof(gauden_dist_t));
     msg->mgau_active = ckd_calloc(g->n_mgau, sizeof(int8));
+    msg->mgau_list = ckd_calloc(g->n_mgau, sizeof(int32));
+    msg->senone_list = ckd_calloc(s->n_sen, sizeof(int32));
 
     mg = (ps_mgau_t *)msg;
     mg->vt = &ms_mgau_funcs;
@@ -176,6 +179,8 @@ ms_mgau_free(ps_mgau_t * mg)
         ckd_free_3d((void *) msg->dist);
     if (msg->mgau_active)
         ckd_free(msg->mgau_active);
+    ckd_free(msg->mgau_list);
+    ckd_free(msg->senone_list);
     
     ckd_free(msg);
 }
@@ -188,6 +193,51 @@ ms_mgau_mllr_transform(ps_mgau_t *s,
     return gauden_mllr_transform(msg->g, mllr, msg->config);
 }
 
+/**
+ * Work shared with the scoring threads for one frame.
+ */
+typedef struct ms_job_s {
+    ms_mgau_model_t *msg;
+    mfcc_t **feat;
+    int16 *senscr;
+    int32 best[MGAU_POOL_MAX_WORKERS];
+} ms_job_t;
+
+/* Each codebook has its own top-N buffer in msg->dist */
+static void
+gauden_dist_range(void *arg, int start, int end, int worker)
+{
+    ms_job_t *job = (ms_job_t *)arg;
+    ms_mgau_model_t *msg = job->msg;
+    int32 i;
+
+    (void)worker;
+    for (i = start; i < end; i++) {
+        int32 gid = msg->mgau_list[i];
+        gauden_dist(msg->g, gid, msg->topn, job->feat, msg->dist[gid]);
+    }
+}
+
+static void
+senone_eval_range(void *arg, int start, int end, int worker)
+{
+    ms_job_t *job = (ms_job_t *)arg;
+    ms_mgau_model_t *msg = job->msg;
+    senone_t *sen = msg->s;
+    int32 i, best;
+
+    best = MAX_INT32;
+    for (i = start; i < end; i++) {
+        int32 s = msg->senone_list[i];
+        job->senscr[s] = senone_eval(sen, s, msg->dist[sen->mgau[s]],
+                                     msg->topn);
+        if (best > job->senscr[s]) {
+            best = job->senscr[s];
+        }
+    }
+    job->best[worker] = best;
+}
+
 int32
 ms_cont_mgau_frame_eval(ps_mgau_t * mg,
 			int16 *senscr,
@@ -198,43 +248,27 @@ ms_cont_mgau_frame_eval(ps_mgau_t * mg,
 			int32 compallsen)
 {
     ms_mgau_model_t *msg = (ms_mgau_model_t *)mg;
-    int32 gid;
-    int32 topn;
+    ms_job_t job;
+    int32 gid, i, n_gid;
     int32 best;
     gauden_t *g;
     senone_t *sen;
 
     (void)frame;
-    topn = ms_mgau_topn(msg);
     g = ms_mgau_gauden(msg);
     sen = ms_mgau_senone(msg);
 
     if (compallsen) {
-	int32 s;
-
 	for (gid = 0; gid < g->n_mgau; gid++)
-	    gauden_dist(g, gid, topn, feat, msg->dist[gid]);
-
-	best = MAX_INT32;
-	for (s = 0; (uint32)s < sen->n_sen; s++) {
-	    senscr[s] = senone_eval(sen, s, msg->dist[sen->mgau[s]], topn);
-	    if (best > senscr[s]) {
-		best = senscr[s];
-	    }
-	}
+	    msg->mgau_list[gid] = gid;
+	n_gid = g->n_mgau;
 
-	/* Normalize senone scores */
-	for (s = 0; (uint32)s < sen->n_sen; s++) {
-	    int32 bs = senscr[s] - best;
-	    if (bs > 32767)
-		bs = 32767;
-	    if (bs < -32768)
-		bs = -32768;
-	    senscr[s] = bs;
-	}
+	for (i = 0; (uint32)i < sen->n_sen; i++)
+	    msg->senone_list[i] = i;
+	n_senone_active = sen->n_sen;
     }
     else {
-	int32 i, n;
+	int32 n;
 	/* Flag all active mixture-gaussian codebooks */
 	for (gid = 0; gid < g->n_mgau; gid++)
 	    msg->mgau_active[gid] = 0;
@@ -244,38 +278,42 @@ ms_cont_mgau_frame_eval(ps_mgau_t * mg,
 	    /* senone_active consists of deltas. */
 	    int32 s = senone_active[i] + n;
 	    msg->mgau_active[sen->mgau[s]] = 1;
+	    msg->senone_list[i] = s;
 	    n = s;
 	}
 
-	/* Compute topn gaussian density values (for active codebooks) */
+	n_gid = 0;
 	for (gid = 0; gid < g->n_mgau; gid++) {
 	    if (msg->mgau_active[gid])
-		gauden_dist(g, gid, topn, feat, msg->dist[gid]);
+		msg->mgau_list[n_gid++] = gid;
 	}
+    }
 
-	best = MAX_INT32;
-	n = 0;
-	for (i = 0; i < n_senone_active; i++) {
-	    int32 s = senone_active[i] + n;
-	    senscr[s] = senone_eval(sen, s, msg->dist[sen->mgau[s]], topn);
-	    if (best > senscr[s]) {
-		best = senscr[s];
-	    }
-	    n = s;
-	}
+    job.msg = msg;
+    job.feat = feat;
+    job.senscr = senscr;
+    for (i = 0; i < MGAU_POOL_MAX_WORKERS; i++)
+	job.best[i] = MAX_INT32;
 
-	/* Normalize senone scores */
-	n = 0;
-	for (i = 0; i < n_senone_active; i++) {
-	    int32 s = senone_active[i] + n;
-	    int32 bs = senscr[s] - best;
-	    if (bs > 32767)
-		bs = 32767;
-	    if (bs < -32768)
-		bs = -32768;
-	    senscr[s] = bs;
-	    n = s;
-	}
+    /* Compute topn gaussian density values (for active codebooks) */
+    mgau_pool_run(mg->pool, gauden_dist_range, &job, n_gid);
+    mgau_pool_run(mg->pool, senone_eval_range, &job, n_senone_active);
+
+    best = MAX_INT32;
+    for (i = 0; i < MGAU_POOL_MAX_WORKERS; i++) {
+	if (best > job.best[i])
+	    best = job.best[i];
+    }
+
+    /* Normalize senone scores */
+    for (i = 0; i < n_senone_active; i++) {
+	int32 s = msg->senone_list[i];
+	int32 bs = senscr[s] - best;
+	if (bs > 32767)
+	    bs = 32767;
+	if (bs < -32768)
+	    bs = -32768;
+	senscr[s] = bs;
     }
 
     return 0;
@@ -124,6 +124,8 @@ typedef struct ms_mgau_model_s {
     /**< Intermediate used in computation */
     gauden_dist_t ***dist;  
     uint8 *mgau_active;
+    int32 *mgau_list;    /**< Active codebooks for this frame */
+    int32 *senone_list;  /**< Active senones for this frame (not deltas) */
     cmd_ln_t *config;
 } ms_mgau_model_t;  
 
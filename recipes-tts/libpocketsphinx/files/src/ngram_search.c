@@ -57,6 +57,7 @@ static int ngram_search_reinit(ps_search_t *search, dict_t *dict, dict2pid_t *d2
 static char const *ngram_search_hyp(ps_search_t *search, int32 *out_score);
 static int32 ngram_search_prob(ps_search_t *search);
 static ps_seg_t *ngram_search_seg_iter(ps_search_t *search);
+static ps_seg_t *ngram_search_stable_seg_iter(ps_search_t *search);
 
 static ps_searchfuncs_t ngram_funcs = {
     /* start: */  ngram_search_start,
@@ -68,6 +69,7 @@ static ps_searchfuncs_t ngram_funcs = {
     /* hyp: */      ngram_search_hyp,
     /* prob: */     ngram_search_prob,
     /* seg_iter: */ ngram_search_seg_iter,
+    /* stable_seg_iter: */ ngram_search_stable_seg_iter,
 };
 
 static ngram_model_t *default_lm;
@@ -169,6 +171,7 @@ ngram_search_init(const char *name,
     ngs->word_lat_idx = ckd_calloc(dict_size(dict),
                                    sizeof(*ngs->word_lat_idx));
     ngs->word_active = bitvec_alloc(dict_size(dict));
+    ngs->stable_bp = ngs->reported_bp = NO_BP;
     ngs->last_ltrans = ckd_calloc(dict_size(dict),
                                   sizeof(*ngs->last_ltrans));
 
@@ -311,6 +314,8 @@ ngram_search_free(ps_search_t *search)
     ckd_free(ngs->word_chan);
     ckd_free(ngs->word_lat_idx);
     bitvec_free(ngs->word_active);
+    bitvec_free(ngs->live_bp);
+    ckd_free(ngs->stable_hyp);
     ckd_free(ngs->bp_table);
     ckd_free(ngs->bscore_stack);
     if (ngs->bp_table_idx != NULL)
@@ -541,54 +546,179 @@ ngram_search_find_exit(ngram_search_t *ngs, int frame_idx, int32 *out_best_score
     return best_exit;
 }
 
-char const *
-ngram_search_bp_hyp(ngram_search_t *ngs, int bpidx)
+/**
+ * Build the hypothesis string for the backtrace from bpidx.
+ *
+ * If the backtrace passes through stop_bp, the words up to and
+ * including it are taken from prefix rather than traced again.
+ * Returns NULL if there are no real words.
+ */
+static char *
+ngram_search_bp_str(ngram_search_t *ngs, int bpidx,
+                    int stop_bp, char const *prefix)
 {
-    ps_search_t *base = ps_search_base(ngs);
-    char *c;
-    size_t len;
+    dict_t *dict = ps_search_dict(ngs);
+    char *str, *c;
+    size_t len, plen;
     int bp;
 
-    if (bpidx == NO_BP)
-        return NULL;
-
     bp = bpidx;
     len = 0;
-    while (bp != NO_BP) {
+    while (bp != NO_BP && bp != stop_bp) {
         bptbl_t *be = &ngs->bp_table[bp];
         bp = be->bp;
-        if (dict_real_word(ps_search_dict(ngs), be->wid))
-            len += strlen(dict_basestr(ps_search_dict(ngs), be->wid)) + 1;
+        if (dict_real_word(dict, be->wid))
+            len += strlen(dict_basestr(dict, be->wid)) + 1;
     }
-
-    ckd_free(base->hyp_str);
-    if (len == 0) {
-	base->hyp_str = NULL;
-	return base->hyp_str;
-    }
-    base->hyp_str = ckd_calloc(1, len);
+    plen = (bp != NO_BP && prefix) ? strlen(prefix) : 0;
+    if (len == 0 && plen == 0)
+        return NULL;
+    if (plen == 0)
+        len -= 1; /* No leading space. */
+    str = ckd_calloc(1, plen + len + 1);
+    if (plen)
+        memcpy(str, prefix, plen);
 
     bp = bpidx;
-    c = base->hyp_str + len - 1;
-    while (bp != NO_BP) {
+    c = str + plen + len;
+    while (bp != NO_BP && bp != stop_bp) {
         bptbl_t *be = &ngs->bp_table[bp];
-        size_t len;
+        size_t wlen;
 
         bp = be->bp;
-        if (dict_real_word(ps_search_dict(ngs), be->wid)) {
-            len = strlen(dict_basestr(ps_search_dict(ngs), be->wid));
-            c -= len;
-            memcpy(c, dict_basestr(ps_search_dict(ngs), be->wid), len);
-            if (c > base->hyp_str) {
+        if (dict_real_word(dict, be->wid)) {
+            wlen = strlen(dict_basestr(dict, be->wid));
+            c -= wlen;
+            memcpy(c, dict_basestr(dict, be->wid), wlen);
+            if (c > str) {
                 --c;
                 *c = ' ';
             }
         }
     }
 
+    return str;
+}
+
+char const *
+ngram_search_bp_hyp(ngram_search_t *ngs, int bpidx)
+{
+    ps_search_t *base = ps_search_base(ngs);
+
+    if (bpidx == NO_BP)
+        return NULL;
+
+    ckd_free(base->hyp_str);
+    base->hyp_str = ngram_search_bp_str(ngs, bpidx,
+                                        ngs->stable_bp, ngs->stable_hyp);
     return base->hyp_str;
 }
 
+void
+ngram_search_mark_live(ngram_search_t *ngs, int32 bp)
+{
+    if (bp == NO_BP || bp < ngs->stable_bp) {
+        ngs->live_root = TRUE;
+        return;
+    }
+    if (bitvec_is_clear(ngs->live_bp, bp)) {
+        bitvec_set(ngs->live_bp, bp);
+        ++ngs->n_live;
+    }
+}
+
+void
+ngram_search_mark_live_hmm(ngram_search_t *ngs, hmm_t *hmm)
+{
+    int i;
+
+    for (i = 0; i < hmm_n_emit_state(hmm); ++i)
+        if (hmm_score(hmm, i) BETTER_THAN WORST_SCORE)
+            ngram_search_mark_live(ngs, hmm_history(hmm, i));
+}
+
+void
+ngram_search_reset_stable(ngram_search_t *ngs)
+{
+    ckd_free(ngs->stable_hyp);
+    ngs->stable_hyp = NULL;
+    ngs->stable_bp = NO_BP;
+    ngs->reported_bp = NO_BP;
+    ngs->stable_nf = 0;
+}
+
+/**
+ * Advance stable_bp to the latest backpointer shared by every path
+ * still being searched.
+ *
+ * Every path either ends in an active HMM state or in the last frame
+ * of the backpointer table, and all of those are later than
+ * stable_bp, so we mark their histories and then walk the table
+ * backwards replacing each marked entry with its predecessor until
+ * only one is left.  Only the part of the table after the old
+ * stable_bp is ever scanned.
+ */
+static void
+ngram_search_update_stable(ngram_search_t *ngs)
+{
+    int32 bp, lo, f, end;
+    char *hyp;
+
+    if (ngs->n_frame == ngs->stable_nf)
+        return;
+    ngs->stable_nf = ngs->n_frame;
+    if (ngs->n_live_bp_alloc < ngs->bp_table_size) {
+        ngs->live_bp = bitvec_realloc(ngs->live_bp, ngs->n_live_bp_alloc,
+                                      ngs->bp_table_size);
+        ngs->n_live_bp_alloc = ngs->bp_table_size;
+    }
+    ngs->n_live = 0;
+    ngs->live_root = FALSE;
+
+    /* Histories of the HMMs to be searched in the next frame. */
+    if (ngs->fwdtree)
+        ngram_fwdtree_mark_live(ngs);
+    else
+        ngram_fwdflat_mark_live(ngs);
+    /* Exits in the last frame that has any, which can still be extended. */
+    f = ngs->n_frame - 1;
+    end = ngs->bp_table_idx[f];
+    while (f >= 0 && ngs->bp_table_idx[f] == end)
+        --f;
+    if (f >= 0)
+        for (bp = ngs->bp_table_idx[f]; bp < end; ++bp)
+            ngram_search_mark_live(ngs, bp);
+
+    lo = (ngs->stable_bp == NO_BP) ? 0 : ngs->stable_bp;
+    for (bp = ngs->bpidx - 1; bp >= lo && !ngs->live_root; --bp) {
+        if (ngs->live_bp[bp / BITVEC_BITS] == 0) {
+            bp -= bp % BITVEC_BITS;
+            continue;
+        }
+        if (bitvec_is_clear(ngs->live_bp, bp))
+            continue;
+        bitvec_clear(ngs->live_bp, bp);
+        if (ngs->n_live == 1)
+            break;
+        --ngs->n_live;
+        ngram_search_mark_live(ngs, ngs->bp_table[bp].bp);
+    }
+    if (ngs->live_root || bp < lo) {
+        /* Nothing new is shared, just clean up. */
+        memset(ngs->live_bp + lo / BITVEC_BITS, 0,
+               (bitvec_size(ngs->bpidx) - lo / BITVEC_BITS)
+               * sizeof(*ngs->live_bp));
+        return;
+    }
+    if (bp == ngs->stable_bp)
+        return;
+
+    hyp = ngram_search_bp_str(ngs, bp, ngs->stable_bp, ngs->stable_hyp);
+    ckd_free(ngs->stable_hyp);
+    ngs->stable_hyp = hyp;
+    ngs->stable_bp = bp;
+}
+
 void
 ngram_search_alloc_all_rc(ngram_search_t *ngs, int32 w)
 {
@@ -724,6 +854,7 @@ ngram_search_start(ps_search_t *search)
     ngram_search_t *ngs = (ngram_search_t *)search;
 
     ngs->done = FALSE;
+    ngram_search_reset_stable(ngs);
     ngram_model_flush(ngs->lmset);
     if (ngs->fwdtree)
         ngram_fwdtree_start(ngs);
@@ -795,6 +926,7 @@ ngram_search_finish(ps_search_t *search)
             if (acmod_rewind(ps_search_acmod(ngs)) < 0)
                 return -1;
             /* Now redo search. */
+            ngram_search_reset_stable(ngs);
             ngram_fwdflat_start(ngs);
             i = 0;
             while (ps_search_acmod(ngs)->n_feat_frame > 0) {
@@ -874,6 +1006,9 @@ ngram_search_hyp(ps_search_t *search, int32 *out_score)
     else {
         int32 bpidx;
 
+        if (!ngs->done
+            && ngs->n_frame >= ngs->stable_nf + PS_STABLE_HYP_INTERVAL)
+            ngram_search_update_stable(ngs);
         /* fwdtree and fwdflat use same backpointer table. */
         bpidx = ngram_search_find_exit(ngs, -1, out_score);
         if (bpidx != NO_BP)
@@ -956,7 +1091,7 @@ static ps_segfuncs_t ngram_bp_segfuncs = {
 };
 
 static ps_seg_t *
-ngram_search_bp_iter(ngram_search_t *ngs, int bpidx, float32 lwf)
+ngram_search_bp_iter(ngram_search_t *ngs, int bpidx, int stop_bp, float32 lwf)
 {
     bptbl_seg_t *itor;
     int bp, cur;
@@ -971,7 +1106,7 @@ ngram_search_bp_iter(ngram_search_t *ngs, int bpidx, float32 lwf)
     itor->base.lwf = lwf;
     itor->n_bpidx = 0;
     bp = bpidx;
-    while (bp != NO_BP) {
+    while (bp != stop_bp) {
         bptbl_t *be = &ngs->bp_table[bp];
         bp = be->bp;
         ++itor->n_bpidx;
@@ -983,7 +1118,7 @@ ngram_search_bp_iter(ngram_search_t *ngs, int bpidx, float32 lwf)
     itor->bpidx = ckd_calloc(itor->n_bpidx, sizeof(*itor->bpidx));
     cur = itor->n_bpidx - 1;
     bp = bpidx;
-    while (bp != NO_BP) {
+    while (bp != stop_bp) {
         bptbl_t *be = &ngs->bp_table[bp];
         itor->bpidx[cur] = bp;
         bp = be->bp;
@@ -1032,7 +1167,7 @@ ngram_search_seg_iter(ps_search_t *search)
 
         /* fwdtree and fwdflat use same backpointer table. */
         bpidx = ngram_search_find_exit(ngs, -1, NULL);
-        return ngram_search_bp_iter(ngs, bpidx,
+        return ngram_search_bp_iter(ngs, bpidx, NO_BP,
                                     /* but different language weights... */
                                     (ngs->done && ngs->fwdflat)
                                     ? ngs->fwdflat_fwdtree_lw_ratio : 1.0);
@@ -1041,6 +1176,38 @@ ngram_search_seg_iter(ps_search_t *search)
     return NULL;
 }
 
+static ps_seg_t *
+ngram_search_stable_seg_iter(ps_search_t *search)
+{
+    ngram_search_t *ngs = (ngram_search_t *)search;
+    ps_seg_t *itor;
+
+    if (ngs->done) {
+        int32 bp, bpidx;
+
+        /* After fwdflat the backpointer table is a different one. */
+        if (ngs->bestpath
+            || (ngs->reported_bp == NO_BP && search->stable_ef >= 0))
+            return NULL;
+        bpidx = ngram_search_find_exit(ngs, -1, NULL);
+        for (bp = bpidx; bp > ngs->reported_bp; bp = ngs->bp_table[bp].bp)
+            ;
+        if (bp != ngs->reported_bp)
+            return NULL;
+        itor = ngram_search_bp_iter(ngs, bpidx, ngs->reported_bp, 1.0);
+        ngs->reported_bp = bpidx;
+        search->stable_ef = MAX_INT32;
+        return itor;
+    }
+    ngram_search_update_stable(ngs);
+    if (ngs->stable_bp == ngs->reported_bp)
+        return NULL;
+    itor = ngram_search_bp_iter(ngs, ngs->stable_bp, ngs->reported_bp, 1.0);
+    ngs->reported_bp = ngs->stable_bp;
+    search->stable_ef = ngs->bp_table[ngs->stable_bp].frame;
+    return itor;
+}
+
 static int32
 ngram_search_prob(ps_search_t *search)
 {
@@ -313,6 +313,19 @@ struct ngram_search_s {
     int32 *word_lat_idx; /* BPTable index for any word in current frame;
                             cleared before each frame */
 
+    /*
+     * Words that every path still being searched goes through, see
+     * ngram_search_update_stable().
+     */
+    bitvec_t *live_bp;       /**< Backpointers in use, scratch space. */
+    int32 n_live_bp_alloc;   /**< Number of bits in live_bp. */
+    int32 n_live;            /**< Number of them set in live_bp. */
+    int32 live_root;         /**< Some path has no backpointer yet. */
+    int32 stable_bp;         /**< Latest backpointer on every path, or NO_BP. */
+    int32 stable_nf;         /**< n_frame when stable_bp was last updated. */
+    int32 reported_bp;       /**< Latest one returned by stable_seg_iter. */
+    char *stable_hyp;        /**< Hypothesis string up to stable_bp. */
+
     /*
      * Flat lexicon (2nd pass) search stuff.
      */
@@ -405,6 +418,23 @@ void ngram_search_free_all_rc(ngram_search_t *ngs, int32 w);
  */
 int ngram_search_find_exit(ngram_search_t *ngs, int frame_idx, int32 *out_best_score);
 
+/**
+ * Note that a backpointer is the history of an HMM that is still
+ * active, while looking for the words every path goes through.
+ */
+void ngram_search_mark_live(ngram_search_t *ngs, int32 bp);
+
+/**
+ * Mark the histories of all live states of an HMM.
+ */
+void ngram_search_mark_live_hmm(ngram_search_t *ngs, hmm_t *hmm);
+
+/**
+ * Forget the words every path goes through, when the backpointer
+ * table is cleared.
+ */
+void ngram_search_reset_stable(ngram_search_t *ngs);
+
 /**
  * Backtrace from a given backpointer index to obtain a word hypothesis.
  *
@@ -960,3 +960,26 @@ ngram_fwdflat_finish(ngram_search_t *ngs)
                ngs->fwdflat_perf.t_elapsed / n_speech);
     }
 }
+
+void
+ngram_fwdflat_mark_live(ngram_search_t *ngs)
+{
+    int32 i, nw, nf;
+    int32 *awl;
+    root_chan_t *rhmm;
+    chan_t *hmm;
+
+    /* Same channels as compute_fwdflat_sen_active() for the next frame. */
+    nf = ngs->n_frame;
+    nw = ngs->n_active_word[nf & 0x1];
+    awl = ngs->active_word_list[nf & 0x1];
+    for (i = 0; i < nw; i++) {
+        rhmm = (root_chan_t *)ngs->word_chan[*(awl++)];
+        if (hmm_frame(&rhmm->hmm) == nf)
+            ngram_search_mark_live_hmm(ngs, &rhmm->hmm);
+        for (hmm = rhmm->next; hmm; hmm = hmm->next) {
+            if (hmm_frame(&hmm->hmm) == nf)
+                ngram_search_mark_live_hmm(ngs, &hmm->hmm);
+        }
+    }
+}
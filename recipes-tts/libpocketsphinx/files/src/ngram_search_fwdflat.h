@@ -81,6 +81,12 @@ int ngram_fwdflat_search(ngram_search_t *ngs, int frame_idx);
  */
 void ngram_fwdflat_finish(ngram_search_t *ngs);
 
+/**
+ * Mark the histories of all HMMs active in the next frame with
+ * ngram_search_mark_live().
+ */
+void ngram_fwdflat_mark_live(ngram_search_t *ngs);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
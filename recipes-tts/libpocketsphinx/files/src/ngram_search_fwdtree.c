@@ -59,6 +59,9 @@
 #define chan_v_eval(chan) hmm_vit_eval(&(chan)->hmm)
 #endif
 
+/* Number of channels handed to hmm_vit_eval_batch() at a time. */
+#define CHAN_EVAL_BLOCK 64
+
 /*
  * Allocate that part of the search channel tree structure that is independent of the
  * LM in use.
@@ -631,12 +634,30 @@ eval_nonroot_chan(ngram_search_t *ngs, int frame_idx)
     bestscore = WORST_SCORE;
     ngs->st.n_nonroot_chan_eval += i;
 
+#if __CHAN_DUMP__
     for (hmm = *(acl++); i > 0; --i, hmm = *(acl++)) {
         int32 score = chan_v_eval(hmm);
         assert(hmm_frame(&hmm->hmm) == frame_idx);
         if (score BETTER_THAN bestscore)
             bestscore = score;
     }
+#else
+    while (i > 0) {
+        hmm_t *block[CHAN_EVAL_BLOCK];
+        int32 j, n, score;
+
+        n = (i < CHAN_EVAL_BLOCK) ? i : CHAN_EVAL_BLOCK;
+        for (j = 0; j < n; ++j) {
+            hmm = *(acl++);
+            assert(hmm_frame(&hmm->hmm) == frame_idx);
+            block[j] = &hmm->hmm;
+        }
+        score = hmm_vit_eval_batch(block, n);
+        if (score BETTER_THAN bestscore)
+            bestscore = score;
+        i -= n;
+    }
+#endif
 
     return bestscore;
 }
@@ -647,6 +668,8 @@ eval_word_chan(ngram_search_t *ngs, int frame_idx)
     root_chan_t *rhmm;
     chan_t *hmm;
     int32 i, w, bestscore, *awl, j, k;
+    hmm_t *block[CHAN_EVAL_BLOCK];
+    int32 n_block = 0;
 
     k = 0;
     bestscore = WORST_SCORE;
@@ -659,18 +682,31 @@ eval_word_chan(ngram_search_t *ngs, int frame_idx)
         assert(ngs->word_chan[w] != NULL);
 
         for (hmm = ngs->word_chan[w]; hmm; hmm = hmm->next) {
-            int32 score;
-
             assert(hmm_frame(&hmm->hmm) == frame_idx);
-            score = chan_v_eval(hmm);
-            /*printf("eval word chan %d score %d\n", w, score); */
-
-            if (score BETTER_THAN bestscore)
-                bestscore = score;
-
+#if __CHAN_DUMP__
+            {
+                int32 score = chan_v_eval(hmm);
+                if (score BETTER_THAN bestscore)
+                    bestscore = score;
+            }
+#else
+            /* Last phones are evaluated in blocks, see eval_nonroot_chan(). */
+            if (n_block == CHAN_EVAL_BLOCK) {
+                int32 score = hmm_vit_eval_batch(block, n_block);
+                if (score BETTER_THAN bestscore)
+                    bestscore = score;
+                n_block = 0;
+            }
+            block[n_block++] = &hmm->hmm;
+#endif
             k++;
         }
     }
+    if (n_block > 0) {
+        int32 score = hmm_vit_eval_batch(block, n_block);
+        if (score BETTER_THAN bestscore)
+            bestscore = score;
+    }
 
     /* Similarly for statically allocated single-phone words */
     j = 0;
@@ -750,7 +786,8 @@ prune_root_chan(ngram_search_t *ngs, int frame_idx)
             /* transitions out of this root channel */
             /* transition to all next-level channels in the HMM tree */
             newphone_score = hmm_out_score(&rhmm->hmm) + ngs->pip;
-            if (pls != NULL || newphone_score BETTER_THAN newphone_thresh) {
+            if (newphone_score + phone_loop_search_max_score(pls)
+                BETTER_THAN newphone_thresh) {
                 for (hmm = rhmm->next; hmm; hmm = hmm->alt) {
                     int32 pl_newphone_score = newphone_score
                         + phone_loop_search_score(pls, hmm->ciphone);
@@ -770,7 +807,8 @@ prune_root_chan(ngram_search_t *ngs, int frame_idx)
              * penultimate phone (the last phones may need multiple right contexts).
              * Remember to remove the temporary newword_penalty.
              */
-            if (pls != NULL || newphone_score BETTER_THAN lastphn_thresh) {
+            if (newphone_score + phone_loop_search_max_score(pls)
+                BETTER_THAN lastphn_thresh) {
                 for (w = rhmm->penult_phn_wid; w >= 0;
                      w = ngs->homophone_set[w]) {
                     int32 pl_newphone_score = newphone_score
@@ -829,7 +867,8 @@ prune_nonroot_chan(ngram_search_t *ngs, int frame_idx)
 
             /* transition to all next-level channel in the HMM tree */
             newphone_score = hmm_out_score(&hmm->hmm) + ngs->pip;
-            if (pls != NULL || newphone_score BETTER_THAN newphone_thresh) {
+            if (newphone_score + phone_loop_search_max_score(pls)
+                BETTER_THAN newphone_thresh) {
                 for (nexthmm = hmm->next; nexthmm; nexthmm = nexthmm->alt) {
                     int32 pl_newphone_score = newphone_score
                         + phone_loop_search_score(pls, nexthmm->ciphone);
@@ -852,7 +891,8 @@ prune_nonroot_chan(ngram_search_t *ngs, int frame_idx)
              * penultimate phone (the last phones may need multiple right contexts).
              * Remember to remove the temporary newword_penalty.
              */
-            if (pls != NULL || newphone_score BETTER_THAN lastphn_thresh) {
+            if (newphone_score + phone_loop_search_max_score(pls)
+                BETTER_THAN lastphn_thresh) {
                 for (w = hmm->info.penult_phn_wid; w >= 0;
                      w = ngs->homophone_set[w]) {
                     int32 pl_newphone_score = newphone_score
@@ -1567,3 +1607,34 @@ ngram_fwdtree_finish(ngram_search_t *ngs)
     }
     /* dump_bptable(ngs); */
 }
+
+void
+ngram_fwdtree_mark_live(ngram_search_t *ngs)
+{
+    root_chan_t *rhmm;
+    chan_t *hmm, **acl;
+    int32 i, w, *awl, nf;
+
+    /* Same channels as compute_sen_active() for the next frame. */
+    nf = ngs->n_frame;
+    for (i = ngs->n_root_chan, rhmm = ngs->root_chan; i > 0; --i, rhmm++) {
+        if (hmm_frame(&rhmm->hmm) == nf)
+            ngram_search_mark_live_hmm(ngs, &rhmm->hmm);
+    }
+    i = ngs->n_active_chan[nf & 0x1];
+    acl = ngs->active_chan_list[nf & 0x1];
+    for (hmm = *(acl++); i > 0; --i, hmm = *(acl++))
+        ngram_search_mark_live_hmm(ngs, &hmm->hmm);
+    i = ngs->n_active_word[nf & 0x1];
+    awl = ngs->active_word_list[nf & 0x1];
+    for (w = *(awl++); i > 0; --i, w = *(awl++)) {
+        for (hmm = ngs->word_chan[w]; hmm; hmm = hmm->next)
+            ngram_search_mark_live_hmm(ngs, &hmm->hmm);
+    }
+    for (i = 0; i < ngs->n_1ph_words; i++) {
+        w = ngs->single_phone_wid[i];
+        rhmm = (root_chan_t *) ngs->word_chan[w];
+        if (hmm_frame(&rhmm->hmm) == nf)
+            ngram_search_mark_live_hmm(ngs, &rhmm->hmm);
+    }
+}
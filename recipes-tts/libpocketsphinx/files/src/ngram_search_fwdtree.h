@@ -83,6 +83,12 @@ int ngram_fwdtree_search(ngram_search_t *ngs, int frame_idx);
  */
 void ngram_fwdtree_finish(ngram_search_t *ngs);
 
+/**
+ * Mark the histories of all HMMs active in the next frame with
+ * ngram_search_mark_live().
+ */
+void ngram_fwdtree_mark_live(ngram_search_t *ngs);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -62,6 +62,7 @@ static ps_searchfuncs_t phone_loop_search_funcs = {
     /* hyp: */      phone_loop_search_hyp,
     /* prob: */     phone_loop_search_prob,
     /* seg_iter: */ phone_loop_search_seg_iter,
+    /* stable_seg_iter: */ NULL,
 };
 
 static int
@@ -174,6 +175,7 @@ phone_loop_search_start(ps_search_t *search)
         hmm_enter(hmm, 0, -1, 0);
     }
     memset(pls->penalties, 0, pls->n_phones * sizeof(*pls->penalties));
+    pls->max_penalty = 0;
     for (i = 0; i < pls->window; i++)
         memset(pls->pen_buf[i], 0, pls->n_phones * sizeof(*pls->pen_buf[i]));
     phone_loop_search_free_renorm(pls);
@@ -234,6 +236,7 @@ store_scores(phone_loop_search_t *pls, int frame_idx)
     pls->pen_buf_ptr = pls->pen_buf_ptr % pls->window;
 
     /* update penalties */
+    pls->max_penalty = WORST_SCORE;
     for (i = 0; i < pls->n_phones; ++i) {
         pls->penalties[i] = WORST_SCORE;
         for (j = 0, itr = pls->pen_buf_ptr + 1; j < pls->window; j++, itr++) {
@@ -241,6 +244,8 @@ store_scores(phone_loop_search_t *pls, int frame_idx)
             if (pls->pen_buf[itr][i] > pls->penalties[i])
                 pls->penalties[i] = pls->pen_buf[itr][i];
         }
+        if (pls->penalties[i] > pls->max_penalty)
+            pls->max_penalty = pls->penalties[i];
     }
 }
 
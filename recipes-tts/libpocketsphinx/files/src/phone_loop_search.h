@@ -82,6 +82,7 @@ struct phone_loop_search_s {
     int32 **pen_buf;                /**< Penalty buffer */
     int16 pen_buf_ptr;                 /**< Pointer for frame to fill in penalty buffer */
     int32 *penalties;                  /**< Penalties for CI phones in current frame */
+    int32 max_penalty;                 /**< Best of penalties[] in current frame */
     float64 penalty_weight;            /**< Weighting factor for penalties */
 
     int32 best_score;                  /**< Best Viterbi score in current frame. */
@@ -103,6 +104,13 @@ ps_search_t *phone_loop_search_init(cmd_ln_t *config,
 #define phone_loop_search_score(pls,ci) \
     ((pls == NULL) ? 0 : (pls->penalties[ci]))
 
+/**
+ * Return the best lookahead score over all phones, so that the search
+ * can rule out a whole set of successors before scoring each of them.
+ */
+#define phone_loop_search_max_score(pls) \
+    ((pls == NULL) ? 0 : (pls->max_penalty))
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
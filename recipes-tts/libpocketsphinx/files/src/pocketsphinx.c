@@ -48,7 +48,6 @@
 #include "util/strfuncs.h"
 #include "util/filename.h"
 #include "util/pio.h"
-#include "lm/jsgf.h"
 #include "util/hash_table.h"
 #include "pocketsphinx_internal.h"
 #include "ps_lattice_internal.h"
@@ -61,6 +60,9 @@
 #include "ngram_search_fwdflat.h"
 #include "allphone_search.h"
 #include "state_align_search.h"
+#include "model_cache.h"
+#include "dict_cache.h"
+#include "fsg_cache.h"
 #include "fe/fe_internal.h"
 
 /* I'm not sure what the portable way to do this is. */
@@ -225,6 +227,78 @@ ps_reinit_feat(ps_decoder_t *ps, ps_config_t *config)
     return acmod_reinit_feat(ps->acmod, NULL, NULL);
 }
 
+/* Load the dictionary and dict2pid, or share them with other decoders
+ * if the model cache is on.  Both depend on the phone set, so they're
+ * keyed on the (cached) mdef too. */
+static int
+ps_init_dict(ps_decoder_t *ps)
+{
+    bin_mdef_t *mdef = ps->acmod->mdef;
+    char const *fdict;
+    char *key;
+
+    ps->shared_dict = FALSE;
+    if (!ps_config_bool(ps->config, "model_cache"))
+        return dict_cache_load(ps->config, mdef, &ps->dict, &ps->d2p);
+
+    fdict = ps_config_str(ps->config, "fdict");
+    key = model_cache_key("%s|%s|%d|%p",
+                          ps_config_str(ps->config, "dict"),
+                          fdict ? fdict : "",
+                          (int)ps_config_bool(ps->config, "dictcase"),
+                          (void *)mdef);
+    if ((ps->dict = model_cache_get(MODEL_CACHE_DICT, key)) != NULL) {
+        E_INFO("Using cached dictionary (%d words)\n",
+               dict_size(ps->dict));
+        ps->d2p = model_cache_get(MODEL_CACHE_D2P, key);
+    }
+    else {
+        dict2pid_t *d2p;
+        dict_t *dict;
+
+        if (dict_cache_load(ps->config, mdef, &dict, &d2p) < 0) {
+            ckd_free(key);
+            return -1;
+        }
+        ps->dict = model_cache_put(MODEL_CACHE_DICT, key, dict);
+        if (ps->dict == dict)
+            ps->d2p = model_cache_put(MODEL_CACHE_D2P, key, d2p);
+        else /* Another decoder got there first, d2p isn't for its dict */
+            dict2pid_free(d2p);
+    }
+    if (ps->d2p == NULL) {
+        if ((ps->d2p = dict2pid_build(mdef, ps->dict)) == NULL) {
+            ckd_free(key);
+            return -1;
+        }
+        ps->d2p = model_cache_put(MODEL_CACHE_D2P, key, ps->d2p);
+    }
+    ckd_free(key);
+    ps->shared_dict = TRUE;
+
+    return 0;
+}
+
+/* Replace a cached dictionary with a private copy before modifying
+ * it.  Searches keep using the shared one until they are reinit'd. */
+static int
+ps_unshare_dict(ps_decoder_t *ps)
+{
+    dict2pid_t *d2p;
+    dict_t *dict;
+
+    E_INFO("Loading a private copy of the dictionary to add words\n");
+    if (dict_cache_load(ps->config, ps->acmod->mdef, &dict, &d2p) < 0)
+        return -1;
+    dict_free(ps->dict);
+    ps->dict = dict;
+    dict2pid_free(ps->d2p);
+    ps->d2p = d2p;
+    ps->shared_dict = FALSE;
+
+    return 0;
+}
+
 int
 ps_reinit(ps_decoder_t *ps, ps_config_t *config)
 {
@@ -321,9 +395,7 @@ ps_reinit(ps_decoder_t *ps, ps_config_t *config)
 
     /* Dictionary and triphone mappings (depends on acmod). */
     /* FIXME: pass config, change arguments, implement LTS, etc. */
-    if ((ps->dict = dict_init(ps->config, ps->acmod->mdef)) == NULL)
-        return -1;
-    if ((ps->d2p = dict2pid_build(ps->acmod->mdef, ps->dict)) == NULL)
+    if (ps_init_dict(ps) < 0)
         return -1;
 
     lw = ps_config_float(ps->config, "lw");
@@ -796,38 +868,13 @@ int
 ps_add_jsgf_file(ps_decoder_t *ps, const char *name, const char *path)
 {
   fsg_model_t *fsg;
-  jsgf_rule_t *rule;
-  char const *toprule;
-  jsgf_t *jsgf = jsgf_parse_file(path, NULL);
-  float lw;
   int result;
 
-  if (!jsgf)
+  fsg = fsg_cache_load_jsgf(ps->config, ps->lmath, path, NULL);
+  if (!fsg)
       return -1;
-
-  rule = NULL;
-  /* Take the -toprule if specified. */
-  if ((toprule = ps_config_str(ps->config, "toprule"))) {
-      rule = jsgf_get_rule(jsgf, toprule);
-      if (rule == NULL) {
-          E_ERROR("Start rule %s not found\n", toprule);
-          jsgf_grammar_free(jsgf);
-          return -1;
-      }
-  } else {
-      rule = jsgf_get_public_rule(jsgf);
-      if (rule == NULL) {
-          E_ERROR("No public rules found in %s\n", path);
-          jsgf_grammar_free(jsgf);
-          return -1;
-      }
-  }
-
-  lw = ps_config_float(ps->config, "lw");
-  fsg = jsgf_build_fsg(jsgf, rule, ps->lmath, lw);
   result = ps_add_fsg(ps, name, fsg);
   fsg_model_free(fsg);
-  jsgf_grammar_free(jsgf);
   return result;
 }
 
@@ -835,38 +882,13 @@ int
 ps_add_jsgf_string(ps_decoder_t *ps, const char *name, const char *jsgf_string)
 {
   fsg_model_t *fsg;
-  jsgf_rule_t *rule;
-  char const *toprule;
-  jsgf_t *jsgf = jsgf_parse_string(jsgf_string, NULL);
-  float lw;
   int result;
 
-  if (!jsgf)
+  fsg = fsg_cache_load_jsgf(ps->config, ps->lmath, NULL, jsgf_string);
+  if (!fsg)
       return -1;
-
-  rule = NULL;
-  /* Take the -toprule if specified. */
-  if ((toprule = ps_config_str(ps->config, "toprule"))) {
-      rule = jsgf_get_rule(jsgf, toprule);
-      if (rule == NULL) {
-          E_ERROR("Start rule %s not found\n", toprule);
-          jsgf_grammar_free(jsgf);
-          return -1;
-      }
-  } else {
-      rule = jsgf_get_public_rule(jsgf);
-      if (rule == NULL) {
-          E_ERROR("No public rules found in input string\n");
-          jsgf_grammar_free(jsgf);
-          return -1;
-      }
-  }
-
-  lw = ps_config_float(ps->config, "lw");
-  fsg = jsgf_build_fsg(jsgf, rule, ps->lmath, lw);
   result = ps_add_fsg(ps, name, fsg);
   fsg_model_free(fsg);
-  jsgf_grammar_free(jsgf);
   return result;
 }
 
@@ -912,6 +934,7 @@ ps_load_dict(ps_decoder_t *ps, char const *dictfile,
     ps->dict = dict;
     dict2pid_free(ps->d2p);
     ps->d2p = d2p;
+    ps->shared_dict = FALSE;
 
     /* And tell all searches to reconfigure themselves. */
     for (search_it = hash_table_iter(ps->searches); search_it;
@@ -965,7 +988,12 @@ ps_add_word(ps_decoder_t *ps,
     ckd_free(phonestr);
     ckd_free(tmp);
 
-    /* Add it to the dictionary. */
+    /* Add it to the dictionary, which mustn't be one other decoders
+     * are using. */
+    if (ps->shared_dict && ps_unshare_dict(ps) < 0) {
+        ckd_free(pron);
+        return -1;
+    }
     if ((wid = dict_add_word(ps->dict, word, pron, np)) == -1) {
         ckd_free(pron);
         return -1;
@@ -1114,6 +1142,7 @@ ps_start_utt(ps_decoder_t *ps)
     ps->search->post = 0;
     ckd_free(ps->search->hyp_str);
     ps->search->hyp_str = NULL;
+    ps->search->stable_ef = -1;
     if ((rv = acmod_start_utt(ps->acmod)) < 0)
         return rv;
 
@@ -1165,30 +1194,44 @@ ps_start_utt(ps_decoder_t *ps)
     return ps_search_start(ps->search);
 }
 
+int
+ps_search_forward_frame(ps_decoder_t *ps)
+{
+    int k;
+
+    if (ps->pl_window > 0)
+        if ((k = ps_search_step(ps->phone_loop, ps->acmod->output_frame)) < 0)
+            return k;
+    if (ps->acmod->output_frame >= ps->pl_window)
+        if ((k = ps_search_step(ps->search,
+                                ps->acmod->output_frame - ps->pl_window)) < 0)
+            return k;
+    acmod_advance(ps->acmod);
+    ++ps->n_frame;
+    return 0;
+}
+
 static int
 ps_search_forward(ps_decoder_t *ps)
 {
-    int nfr;
+    int nfr, prev_stage;
 
     if (ps->search == NULL) {
         E_ERROR("No search module is selected, did you forget to "
                 "specify a language model or grammar?\n");
         return -1;
     }
+    prev_stage = acmod_enter_stage(ps->acmod, PS_STAGE_SEARCH);
     nfr = 0;
     while (ps->acmod->n_feat_frame > 0) {
         int k;
-        if (ps->pl_window > 0)
-            if ((k = ps_search_step(ps->phone_loop, ps->acmod->output_frame)) < 0)
-                return k;
-        if (ps->acmod->output_frame >= ps->pl_window)
-            if ((k = ps_search_step(ps->search,
-                                    ps->acmod->output_frame - ps->pl_window)) < 0)
-                return k;
-        acmod_advance(ps->acmod);
-        ++ps->n_frame;
+        if ((k = ps_search_forward_frame(ps)) < 0) {
+            acmod_enter_stage(ps->acmod, prev_stage);
+            return k;
+        }
         ++nfr;
     }
+    acmod_enter_stage(ps->acmod, prev_stage);
     return nfr;
 }
 
@@ -1221,6 +1264,7 @@ ps_process_raw(ps_decoder_t *ps,
                int full_utt)
 {
     int n_searchfr = 0;
+    int prev_stage;
 
     if (ps->acmod->state == ACMOD_IDLE) {
 	E_ERROR("Failed to process data, utterance is not started. Use start_utt to start it\n");
@@ -1234,8 +1278,10 @@ ps_process_raw(ps_decoder_t *ps,
         int nfr;
 
         /* Process some data into features. */
-        if ((nfr = acmod_process_raw(ps->acmod, &data,
-                                     &n_samples, full_utt)) < 0)
+        prev_stage = acmod_enter_stage(ps->acmod, PS_STAGE_FE);
+        nfr = acmod_process_raw(ps->acmod, &data, &n_samples, full_utt);
+        acmod_enter_stage(ps->acmod, prev_stage);
+        if (nfr < 0)
             return nfr;
 
         /* Score and search as much data as possible */
@@ -1257,6 +1303,7 @@ ps_process_cep(ps_decoder_t *ps,
                int full_utt)
 {
     int n_searchfr = 0;
+    int prev_stage;
 
 #ifdef FIXED_POINT
     mfcc_t **idata, **ptr;
@@ -1275,8 +1322,10 @@ ps_process_cep(ps_decoder_t *ps,
         int nfr;
 
         /* Process some data into features. */
-        if ((nfr = acmod_process_cep(ps->acmod, &ptr,
-                                     &n_frames, full_utt)) < 0)
+        prev_stage = acmod_enter_stage(ps->acmod, PS_STAGE_FEAT);
+        nfr = acmod_process_cep(ps->acmod, &ptr, &n_frames, full_utt);
+        acmod_enter_stage(ps->acmod, prev_stage);
+        if (nfr < 0)
             return nfr;
 
         /* Score and search as much data as possible */
@@ -1296,7 +1345,7 @@ ps_process_cep(ps_decoder_t *ps,
 int
 ps_end_utt(ps_decoder_t *ps)
 {
-    int rv, i;
+    int rv, i, prev_stage;
 
     if (ps->search == NULL) {
         E_ERROR("No search module is selected, did you forget to "
@@ -1307,16 +1356,20 @@ ps_end_utt(ps_decoder_t *ps)
 	E_ERROR("Utterance is not started\n");
 	return -1;
     }
+    prev_stage = acmod_enter_stage(ps->acmod, PS_STAGE_FE);
     acmod_end_utt(ps->acmod);
 
     /* Search any remaining frames. */
+    acmod_enter_stage(ps->acmod, PS_STAGE_SEARCH);
     if ((rv = ps_search_forward(ps)) < 0) {
+        acmod_enter_stage(ps->acmod, prev_stage);
         ptmr_stop(&ps->perf);
         return rv;
     }
     /* Finish phone loop search. */
     if (ps->phone_loop) {
         if ((rv = ps_search_finish(ps->phone_loop)) < 0) {
+            acmod_enter_stage(ps->acmod, prev_stage);
             ptmr_stop(&ps->perf);
             return rv;
         }
@@ -1328,11 +1381,11 @@ ps_end_utt(ps_decoder_t *ps)
             ps_search_step(ps->search, i);
     }
     /* Finish main search. */
-    if ((rv = ps_search_finish(ps->search)) < 0) {
-        ptmr_stop(&ps->perf);
-        return rv;
-    }
+    rv = ps_search_finish(ps->search);
+    acmod_enter_stage(ps->acmod, prev_stage);
     ptmr_stop(&ps->perf);
+    if (rv < 0)
+        return rv;
 
     /* Log a backtrace if requested. */
     if (ps_config_bool(ps->config, "backtrace")) {
@@ -1368,6 +1421,7 @@ char const *
 ps_get_hyp(ps_decoder_t *ps, int32 *out_best_score)
 {
     char const *hyp;
+    int prev_stage;
 
     if (ps->search == NULL) {
         E_ERROR("No search module is selected, did you forget to "
@@ -1375,7 +1429,9 @@ ps_get_hyp(ps_decoder_t *ps, int32 *out_best_score)
         return NULL;
     }
     ptmr_start(&ps->perf);
+    prev_stage = acmod_enter_stage(ps->acmod, PS_STAGE_LATTICE);
     hyp = ps_search_hyp(ps->search, out_best_score);
+    acmod_enter_stage(ps->acmod, prev_stage);
     ptmr_stop(&ps->perf);
     return hyp;
 }
@@ -1384,6 +1440,7 @@ int32
 ps_get_prob(ps_decoder_t *ps)
 {
     int32 prob;
+    int prev_stage;
 
     if (ps->search == NULL) {
         E_ERROR("No search module is selected, did you forget to "
@@ -1391,7 +1448,9 @@ ps_get_prob(ps_decoder_t *ps)
         return -1;
     }
     ptmr_start(&ps->perf);
+    prev_stage = acmod_enter_stage(ps->acmod, PS_STAGE_LATTICE);
     prob = ps_search_prob(ps->search);
+    acmod_enter_stage(ps->acmod, prev_stage);
     ptmr_stop(&ps->perf);
     return prob;
 }
@@ -1400,6 +1459,7 @@ ps_seg_t *
 ps_seg_iter(ps_decoder_t *ps)
 {
     ps_seg_t *itor;
+    int prev_stage;
 
     if (ps->search == NULL) {
         E_ERROR("No search module is selected, did you forget to "
@@ -1407,7 +1467,36 @@ ps_seg_iter(ps_decoder_t *ps)
         return NULL;
     }
     ptmr_start(&ps->perf);
+    prev_stage = acmod_enter_stage(ps->acmod, PS_STAGE_LATTICE);
     itor = ps_search_seg_iter(ps->search);
+    acmod_enter_stage(ps->acmod, prev_stage);
+    ptmr_stop(&ps->perf);
+    return itor;
+}
+
+ps_seg_t *
+ps_stable_seg_iter(ps_decoder_t *ps)
+{
+    ps_seg_t *itor;
+    int prev_stage;
+
+    if (ps->search == NULL || ps->search->vt->stable_seg_iter == NULL)
+        return NULL;
+    if (ps->acmod->state == ACMOD_ENDED
+        && ps_search_stable_ef(ps->search) == MAX_INT32)
+        return NULL;
+    ptmr_start(&ps->perf);
+    prev_stage = acmod_enter_stage(ps->acmod, PS_STAGE_LATTICE);
+    itor = ps_search_stable_seg_iter(ps->search);
+    if (ps->acmod->state == ACMOD_ENDED
+        && ps_search_stable_ef(ps->search) != MAX_INT32) {
+        /* The final hypothesis went another way, so go by time. */
+        itor = ps_search_seg_iter(ps->search);
+        while (itor && itor->ef <= ps_search_stable_ef(ps->search))
+            itor = ps_seg_next(itor);
+        ps_search_stable_ef(ps->search) = MAX_INT32;
+    }
+    acmod_enter_stage(ps->acmod, prev_stage);
     ptmr_stop(&ps->perf);
     return itor;
 }
@@ -1449,12 +1538,18 @@ ps_seg_free(ps_seg_t *seg)
 ps_lattice_t *
 ps_get_lattice(ps_decoder_t *ps)
 {
+    ps_lattice_t *dag;
+    int prev_stage;
+
     if (ps->search == NULL) {
         E_ERROR("No search module is selected, did you forget to "
                 "specify a language model or grammar?\n");
         return NULL;
     }
-    return ps_search_lattice(ps->search);
+    prev_stage = acmod_enter_stage(ps->acmod, PS_STAGE_LATTICE);
+    dag = ps_search_lattice(ps->search);
+    acmod_enter_stage(ps->acmod, prev_stage);
+    return dag;
 }
 
 ps_nbest_t *
@@ -1464,6 +1559,7 @@ ps_nbest(ps_decoder_t *ps)
     ngram_model_t *lmset;
     ps_astar_t *nbest;
     float32 lwf;
+    int prev_stage;
 
     if (ps->search == NULL) {
         E_ERROR("No search module is selected, did you forget to "
@@ -1484,9 +1580,11 @@ ps_nbest(ps_decoder_t *ps)
         lwf = ((ngram_search_t *)ps->search)->bestpath_fwdtree_lw_ratio;
     }
 
+    prev_stage = acmod_enter_stage(ps->acmod, PS_STAGE_LATTICE);
     nbest = ps_astar_start(dag, lmset, lwf, 0, -1, -1, -1);
 
     nbest = ps_nbest_next(nbest);
+    acmod_enter_stage(ps->acmod, prev_stage);
 
     return (ps_nbest_t *)nbest;
 }
@@ -1560,6 +1658,19 @@ ps_get_all_time(ps_decoder_t *ps, double *out_nspeech,
     *out_nwall = ps->perf.t_tot_elapsed;
 }
 
+int
+ps_get_stage_time(ps_decoder_t *ps, ps_stage_t stage,
+                  double *out_ncpu, double *out_nwall,
+                  int64 *out_nalloc)
+{
+    if (!ps->acmod->stage_time || stage < 0 || stage >= PS_N_STAGE)
+        return -1;
+    *out_ncpu = ps->acmod->stage_perf[stage].t_cpu;
+    *out_nwall = ps->acmod->stage_perf[stage].t_elapsed;
+    *out_nalloc = ps->acmod->stage_alloc[stage];
+    return 0;
+}
+
 void
 ps_search_init(ps_search_t *search, ps_searchfuncs_t *vt,
 	       const char *type,
@@ -1589,6 +1700,7 @@ ps_search_init(ps_search_t *search, ps_searchfuncs_t *vt,
         search->start_wid = search->finish_wid = search->silence_wid = -1;
         search->n_words = 0;
     }
+    search->stable_ef = -1;
 }
 
 void
@@ -94,6 +94,14 @@ typedef struct ps_searchfuncs_s {
     char const *(*hyp)(ps_search_t *search, int32 *out_score);
     int32 (*prob)(ps_search_t *search);
     ps_seg_t *(*seg_iter)(ps_search_t *search);
+    /**
+     * Words that became final since the last call (NULL if not
+     * supported).  Updates stable_ef.  Once the utterance is done,
+     * returns the rest of the final hypothesis and sets stable_ef to
+     * MAX_INT32, or leaves it alone if the final hypothesis doesn't
+     * follow on from the words already returned.
+     */
+    ps_seg_t *(*stable_seg_iter)(ps_search_t *search);
 } ps_searchfuncs_t;
 
 /**
@@ -119,6 +127,8 @@ struct ps_search_s {
     int32 post;            /**< Utterance posterior probability. */
     int32 n_words;         /**< Number of words known to search (may
                               be less than in the dictionary) */
+    int32 stable_ef;       /**< End frame of the last word returned by
+                              ps_stable_seg_iter(), or -1 */
 
     /* Magical word IDs that must exist in the dictionary: */
     int32 start_wid;       /**< Start word ID. */
@@ -148,6 +158,14 @@ struct ps_search_s {
 #define ps_search_hyp(s,sc) (*(ps_search_base(s)->vt->hyp))(s,sc)
 #define ps_search_prob(s) (*(ps_search_base(s)->vt->prob))(s)
 #define ps_search_seg_iter(s) (*(ps_search_base(s)->vt->seg_iter))(s)
+#define ps_search_stable_seg_iter(s) (*(ps_search_base(s)->vt->stable_seg_iter))(s)
+#define ps_search_stable_ef(s) ps_search_base(s)->stable_ef
+
+/**
+ * How often (in frames) partial hypotheses bring the stable words up
+ * to date, if nobody is asking for them more often than that.
+ */
+#define PS_STABLE_HYP_INTERVAL 10
 
 /* For convenience... */
 #define ps_search_silence_wid(s) ps_search_base(s)->silence_wid
@@ -174,6 +192,11 @@ void ps_search_base_free(ps_search_t *search);
 void ps_search_base_reinit(ps_search_t *search, dict_t *dict,
                            dict2pid_t *d2p);
 
+/**
+ * Search the next available frame of input.
+ */
+int ps_search_forward_frame(ps_decoder_t *ps);
+
 typedef struct ps_segfuncs_s {
     ps_seg_t *(*seg_next)(ps_seg_t *seg);
     void (*seg_free)(ps_seg_t *seg);
@@ -215,6 +238,7 @@ struct ps_decoder_s {
     acmod_t *acmod;    /**< Acoustic model. */
     dict_t *dict;    /**< Pronunciation dictionary. */
     dict2pid_t *d2p;   /**< Dictionary to senone mapping. */
+    int shared_dict;   /**< dict and d2p came from the model cache. */
     logmath_t *lmath;  /**< Log math computation. */
 
     /* Search modules. */
@@ -0,0 +1,210 @@
+/* -*- c-basic-offset:4; indent-tabs-mode: nil -*- */
+/* ====================================================================
+ * Copyright (c) 2024 The openQTI developers.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer. 
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ====================================================================
+ */
+
+/**
+ * @file ps_batch.c
+ * @brief Decoding several streams at once
+ */
+
+#include <pocketsphinx.h>
+
+#include "util/ckd_alloc.h"
+#include "acmod.h"
+#include "pocketsphinx_internal.h"
+
+struct ps_batch_s {
+    int refcount;
+    int n_stream;
+    ps_decoder_t **ps;
+    /* Scratch space for ps_batch_process_raw() */
+    int16 const **data;
+    size_t *n_samples;
+    ps_decoder_t **ready;  /**< Streams with a frame to search. */
+    acmod_t **acmods;      /**< Their acoustic models. */
+};
+
+ps_batch_t *
+ps_batch_init(ps_config_t *config, int n_streams)
+{
+    ps_batch_t *batch;
+    int i;
+
+    if (n_streams < 1) {
+        E_ERROR("Invalid number of streams: %d\n", n_streams);
+        return NULL;
+    }
+    batch = ckd_calloc(1, sizeof(*batch));
+    batch->refcount = 1;
+    batch->n_stream = n_streams;
+    batch->ps = ckd_calloc(n_streams, sizeof(*batch->ps));
+    for (i = 0; i < n_streams; ++i) {
+        if ((batch->ps[i] = ps_init(config)) == NULL) {
+            ps_batch_free(batch);
+            return NULL;
+        }
+    }
+    batch->data = ckd_calloc(n_streams, sizeof(*batch->data));
+    batch->n_samples = ckd_calloc(n_streams, sizeof(*batch->n_samples));
+    batch->ready = ckd_calloc(n_streams, sizeof(*batch->ready));
+    batch->acmods = ckd_calloc(n_streams, sizeof(*batch->acmods));
+
+    return batch;
+}
+
+ps_batch_t *
+ps_batch_retain(ps_batch_t *batch)
+{
+    ++batch->refcount;
+    return batch;
+}
+
+int
+ps_batch_free(ps_batch_t *batch)
+{
+    int i;
+
+    if (batch == NULL)
+        return 0;
+    if (--batch->refcount > 0)
+        return batch->refcount;
+    for (i = 0; i < batch->n_stream; ++i)
+        ps_free(batch->ps[i]);
+    ckd_free(batch->ps);
+    ckd_free(batch->data);
+    ckd_free(batch->n_samples);
+    ckd_free(batch->ready);
+    ckd_free(batch->acmods);
+    ckd_free(batch);
+    return 0;
+}
+
+int
+ps_batch_size(ps_batch_t *batch)
+{
+    return batch->n_stream;
+}
+
+ps_decoder_t *
+ps_batch_decoder(ps_batch_t *batch, int stream)
+{
+    if (stream < 0 || stream >= batch->n_stream)
+        return NULL;
+    return batch->ps[stream];
+}
+
+/* Search one frame of every stream that has one, with the Gaussians
+ * for all of them evaluated together, until none are left. */
+static int
+ps_batch_search_forward(ps_batch_t *batch)
+{
+    int i, n_ready, nfr;
+
+    nfr = 0;
+    while (TRUE) {
+        for (n_ready = i = 0; i < batch->n_stream; ++i) {
+            ps_decoder_t *ps = batch->ps[i];
+            if (ps->acmod->state == ACMOD_IDLE
+                || ps->acmod->n_feat_frame == 0)
+                continue;
+            if (ps->search == NULL) {
+                E_ERROR("No search module is selected for stream %d\n", i);
+                return -1;
+            }
+            batch->ready[n_ready] = ps;
+            batch->acmods[n_ready] = ps->acmod;
+            ++n_ready;
+        }
+        if (n_ready == 0)
+            break;
+        if (acmod_batch_eval(batch->acmods, n_ready) < 0)
+            return -1;
+        for (i = 0; i < n_ready; ++i) {
+            acmod_t *acmod = batch->acmods[i];
+            int k, prev_stage;
+
+            prev_stage = acmod_enter_stage(acmod, PS_STAGE_SEARCH);
+            k = ps_search_forward_frame(batch->ready[i]);
+            acmod_enter_stage(acmod, prev_stage);
+            if (k < 0)
+                return k;
+            ++nfr;
+        }
+    }
+    return nfr;
+}
+
+int
+ps_batch_process_raw(ps_batch_t *batch,
+                     int16 const **data,
+                     size_t const *n_samples,
+                     int full_utt)
+{
+    int i, n_searchfr = 0;
+    int remaining;
+
+    for (i = 0; i < batch->n_stream; ++i) {
+        batch->data[i] = data[i];
+        batch->n_samples[i] = n_samples[i];
+        if (n_samples[i] && batch->ps[i]->acmod->state == ACMOD_IDLE) {
+            E_ERROR("Failed to process data for stream %d, utterance "
+                    "is not started. Use start_utt to start it\n", i);
+            batch->n_samples[i] = 0;
+        }
+    }
+
+    do {
+        int nfr;
+
+        /* Process some data into features for every stream. */
+        remaining = FALSE;
+        for (i = 0; i < batch->n_stream; ++i) {
+            acmod_t *acmod = batch->ps[i]->acmod;
+            int prev_stage;
+
+            if (batch->n_samples[i] == 0)
+                continue;
+            prev_stage = acmod_enter_stage(acmod, PS_STAGE_FE);
+            nfr = acmod_process_raw(acmod, &batch->data[i],
+                                    &batch->n_samples[i], full_utt);
+            acmod_enter_stage(acmod, prev_stage);
+            if (nfr < 0)
+                return nfr;
+            if (batch->n_samples[i])
+                remaining = TRUE;
+        }
+
+        /* Score and search as much data as possible */
+        if ((nfr = ps_batch_search_forward(batch)) < 0)
+            return nfr;
+        n_searchfr += nfr;
+    } while (remaining);
+
+    return n_searchfr;
+}
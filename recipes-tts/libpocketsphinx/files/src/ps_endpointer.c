@@ -43,9 +43,16 @@ struct ps_endpointer_s {
     int in_speech;
     int frame_size;
     int maxlen;
-    int16 *buf;
+    int16 *bufs;               /* Two halves of maxlen + 1 frames. */
+    int16 *buf;                /* Active half, the last frame of which
+                                  holds a partial block-mode frame. */
+    const int16 **frames;      /* Queued frames, possibly in caller's data. */
     int8 *is_speech;
+    int8 *tmp_is_speech;
     int pos, n;
+    int n_partial;
+    ps_endpointer_span_t *spans;
+    int n_spans, n_spans_alloc;
     double qstart_time, timestamp;
     double speech_start, speech_end;
 };
@@ -83,9 +90,12 @@ ps_endpointer_init(double window,
            (int)(ratio * 100.0 + 0.5),
            ep->maxlen * ep->frame_length, ep->start_frames, ep->end_frames, ep->maxlen);
     ep->frame_size = ps_endpointer_frame_size(ep);
-    ep->buf = ckd_calloc(sizeof(*ep->buf),
-                         ep->maxlen * ep->frame_size);
+    ep->bufs = ckd_calloc(sizeof(*ep->bufs),
+                          2 * (ep->maxlen + 1) * ep->frame_size);
+    ep->buf = ep->bufs;
+    ep->frames = ckd_calloc(ep->maxlen, sizeof(*ep->frames));
     ep->is_speech = ckd_calloc(1, ep->maxlen);
+    ep->tmp_is_speech = ckd_calloc(1, ep->maxlen);
     ep->pos = ep->n = 0;
     return ep;
 error_out:
@@ -108,10 +118,11 @@ ps_endpointer_free(ps_endpointer_t *ep)
     if (--ep->refcount > 0)
         return ep->refcount;
     ps_vad_free(ep->vad);
-    if (ep->buf)
-        ckd_free(ep->buf);
-    if (ep->is_speech)
-        ckd_free(ep->is_speech);
+    ckd_free(ep->bufs);
+    ckd_free(ep->frames);
+    ckd_free(ep->is_speech);
+    ckd_free(ep->tmp_is_speech);
+    ckd_free(ep->spans);
     ckd_free(ep);
     return 0;
 }
@@ -165,11 +176,17 @@ ep_speech_count(ps_endpointer_t *ep)
 }
 
 static int
-ep_push(ps_endpointer_t *ep, int is_speech, const int16 *frame)
+ep_push(ps_endpointer_t *ep, int is_speech, const int16 *frame, int copy)
 {
     int i = (ep->pos + ep->n) % ep->maxlen;
-    int16 *dest = ep->buf + (i * ep->frame_size);
-    memcpy(dest, frame, sizeof(*ep->buf) * ep->frame_size);
+    if (copy) {
+        /* Nothing else in the queue points at this slot's storage
+           (see ep_settle()), so it is free to reuse. */
+        int16 *dest = ep->buf + (i * ep->frame_size);
+        memcpy(dest, frame, sizeof(*ep->buf) * ep->frame_size);
+        frame = dest;
+    }
+    ep->frames[i] = frame;
     ep->is_speech[i] = is_speech;
     if (ep_full(ep)) {
         ep->qstart_time += ep->frame_length;
@@ -180,54 +197,52 @@ ep_push(ps_endpointer_t *ep, int is_speech, const int16 *frame)
     return ep->n;
 }
 
-static int16 *
+static const int16 *
 ep_pop(ps_endpointer_t *ep, int *out_is_speech)
 {
-    int16 *pcm;
+    const int16 *pcm;
     if (ep_empty(ep))
         return NULL;
     ep->qstart_time += ep->frame_length;
     if (out_is_speech)
         *out_is_speech = ep->is_speech[ep->pos];
-    pcm = ep->buf + (ep->pos * ep->frame_size);
+    pcm = ep->frames[ep->pos];
     ep->pos = (ep->pos + 1) % ep->maxlen;
     ep->n--;
     return pcm;
 }
 
+/**
+ * Copy the queue (and any partial frame) into the other half of the
+ * buffer, in order, starting at slot 0.  Frames in the queue may
+ * point into the caller's data or anywhere in the active half, so
+ * this is the only safe way to make it contiguous.  The half we
+ * leave behind stays untouched until the next call to this, so
+ * anything already returned from it remains valid until then.
+ */
 static void
-ep_linearize(ps_endpointer_t *ep)
+ep_settle(ps_endpointer_t *ep)
 {
-    int16 *tmp_pcm;
-    uint8 *tmp_is_speech;
-
-    if (ep->pos == 0)
-        return;
-    /* Second part of data: | **** ^ .. | */
-    tmp_pcm = ckd_calloc(sizeof(*ep->buf),
-                         ep->pos * ep->frame_size);
-    tmp_is_speech = ckd_calloc(sizeof(*ep->is_speech), ep->pos);
-    memcpy(tmp_pcm, ep->buf,
-           sizeof(*ep->buf) * ep->pos * ep->frame_size);
-    memcpy(tmp_is_speech, ep->is_speech,
-           sizeof(*ep->is_speech) * ep->pos);
+    size_t half = (ep->maxlen + 1) * ep->frame_size;
+    int16 *spare = (ep->buf == ep->bufs) ? ep->bufs + half : ep->bufs;
+    int i;
 
-    /* First part of data: | .... ^ ** | -> | ** ---- |  */
-    memmove(ep->buf, ep->buf + ep->pos * ep->frame_size,
-            sizeof(*ep->buf) * (ep->maxlen - ep->pos) * ep->frame_size);
-    memmove(ep->is_speech, ep->is_speech + ep->pos,
-            sizeof(*ep->is_speech) * (ep->maxlen - ep->pos));
-
-    /* Second part of data: | .. **** | */
-    memcpy(ep->buf + (ep->maxlen - ep->pos) * ep->frame_size, tmp_pcm,
-           sizeof(*ep->buf) * ep->pos * ep->frame_size);
-    memcpy(ep->is_speech + (ep->maxlen - ep->pos), tmp_is_speech,
-           sizeof(*ep->is_speech) * ep->pos);
-
-    /* Update pointer */
+    for (i = 0; i < ep->n; ++i) {
+        int j = (ep->pos + i) % ep->maxlen;
+        memcpy(spare + i * ep->frame_size, ep->frames[j],
+               sizeof(*spare) * ep->frame_size);
+        ep->tmp_is_speech[i] = ep->is_speech[j];
+    }
+    for (i = 0; i < ep->n; ++i) {
+        ep->frames[i] = spare + i * ep->frame_size;
+        ep->is_speech[i] = ep->tmp_is_speech[i];
+    }
+    if (ep->n_partial)
+        memcpy(spare + ep->maxlen * ep->frame_size,
+               ep->buf + ep->maxlen * ep->frame_size,
+               sizeof(*spare) * ep->n_partial);
+    ep->buf = spare;
     ep->pos = 0;
-    ckd_free(tmp_pcm);
-    ckd_free(tmp_is_speech);
 }
 
 const int16 *
@@ -244,14 +259,22 @@ ps_endpointer_end_stream(ps_endpointer_t *ep,
     
     if (out_nsamp)
         *out_nsamp = 0;
-    if (!ep->in_speech)
+    if (!ep->in_speech) {
+        ep->n_partial = 0;
         return NULL;
+    }
     ep->in_speech = FALSE;
     ep->speech_end = ep->qstart_time;
 
     /* Rotate the buffer so we can return data in a single call. */
-    ep_linearize(ep);
+    ep_settle(ep);
     assert(ep->pos == 0);
+    /* Trailing samples left over from ps_endpointer_process_block(). */
+    if (frame == NULL) {
+        frame = ep->buf + ep->maxlen * ep->frame_size;
+        nsamp = ep->n_partial;
+    }
+    ep->n_partial = 0;
     while (!ep_empty(ep)) {
         int is_speech;
         ep_pop(ep, &is_speech);
@@ -265,37 +288,30 @@ ps_endpointer_end_stream(ps_endpointer_t *ep,
     }
     /* If we used all the VAD queue, add the trailing samples. */
     if (ep_empty(ep) && ep->speech_end == ep->qstart_time) {
-        if (ep->pos == ep->maxlen) {
-            E_ERROR("VAD queue overflow (should not happen)");
-            /* Not fatal, we just lose data. */
-        }
-        else {
-            ep->timestamp +=
-                (double)nsamp / ps_endpointer_sample_rate(ep);
-            if (out_nsamp)
-                *out_nsamp += nsamp;
-            memcpy(ep->buf + ep->pos * ep->frame_size,
-                   frame, nsamp * sizeof(*ep->buf));
-            ep->speech_end = ep->timestamp;
-        }
+        /* There is always room for it since the buffer has one more
+           frame than the queue (and it may already be there). */
+        ep->timestamp +=
+            (double)nsamp / ps_endpointer_sample_rate(ep);
+        if (out_nsamp)
+            *out_nsamp += nsamp;
+        memmove(ep->buf + ep->pos * ep->frame_size,
+                frame, nsamp * sizeof(*ep->buf));
+        ep->speech_end = ep->timestamp;
     }
     ep_clear(ep);
     return ep->buf;
 }
 
-const int16 *
-ps_endpointer_process(ps_endpointer_t *ep,
-                      const int16 *frame)
+static const int16 *
+ep_process(ps_endpointer_t *ep, const int16 *frame, int copy)
 {
     int is_speech, speech_count;
-    if (ep == NULL || ep->vad == NULL)
-        return NULL;
     if (ep->in_speech && ep_full(ep)) {
         E_ERROR("VAD queue overflow (should not happen)");
         /* Not fatal, we just lose data. */
     }
     is_speech = ps_vad_classify(ep->vad, frame);
-    ep_push(ep, is_speech, frame);
+    ep_push(ep, is_speech, frame, copy);
     ep->timestamp += ep->frame_length;
     speech_count = ep_speech_count(ep);
     E_DEBUG("%.2f %d %d %d\n", ep->timestamp, speech_count,
@@ -306,7 +322,7 @@ ps_endpointer_process(ps_endpointer_t *ep,
                arbitrary, but this avoids having to drain the queue to
                prevent overlapping segments.  It's also closer to what
                human annotators will do. */
-            int16 *pcm = ep_pop(ep, NULL);
+            const int16 *pcm = ep_pop(ep, NULL);
             ep->speech_end = ep->qstart_time;
             ep->in_speech = FALSE;
             return pcm;
@@ -325,6 +341,111 @@ ps_endpointer_process(ps_endpointer_t *ep,
         return NULL;
 }
 
+const int16 *
+ps_endpointer_process(ps_endpointer_t *ep,
+                      const int16 *frame)
+{
+    if (ep == NULL || ep->vad == NULL)
+        return NULL;
+    return ep_process(ep, frame, TRUE);
+}
+
+static void
+ep_add_span(ps_endpointer_t *ep, const int16 *pcm, int flags)
+{
+    ps_endpointer_span_t *span = NULL;
+
+    if (ep->n_spans > 0)
+        span = &ep->spans[ep->n_spans - 1];
+    /* Frames taken straight from the caller's data come out
+       contiguous, so merge them unless a segment starts or ends. */
+    if (span && !(span->flags & PS_ENDPOINTER_SPAN_END)
+        && !(flags & PS_ENDPOINTER_SPAN_START)
+        && span->pcm + span->nsamp == pcm) {
+        span->nsamp += ep->frame_size;
+        span->flags |= flags;
+        return;
+    }
+    if (ep->n_spans == ep->n_spans_alloc) {
+        ep->n_spans_alloc = ep->n_spans_alloc ? ep->n_spans_alloc * 2 : 8;
+        ep->spans = ckd_realloc(ep->spans,
+                                ep->n_spans_alloc * sizeof(*ep->spans));
+    }
+    span = &ep->spans[ep->n_spans++];
+    span->pcm = pcm;
+    span->nsamp = ep->frame_size;
+    span->start = ep->qstart_time - ep->frame_length;
+    span->flags = flags;
+}
+
+static void
+ep_process_block_frame(ps_endpointer_t *ep, const int16 *frame)
+{
+    int prev_in_speech = ep->in_speech;
+    const int16 *pcm = ep_process(ep, frame, FALSE);
+
+    if (pcm)
+        ep_add_span(ep, pcm,
+                    (prev_in_speech ? 0 : PS_ENDPOINTER_SPAN_START)
+                    | (ep->in_speech ? 0 : PS_ENDPOINTER_SPAN_END));
+}
+
+const ps_endpointer_span_t *
+ps_endpointer_process_block(ps_endpointer_t *ep,
+                            const int16 *pcm, size_t nsamp,
+                            int *out_nspans)
+{
+    size_t frame_size;
+    int16 *partial;
+    int n_frames = 0;
+
+    if (out_nspans)
+        *out_nspans = 0;
+    if (ep == NULL || ep->vad == NULL)
+        return NULL;
+    frame_size = ep->frame_size;
+    partial = ep->buf + ep->maxlen * frame_size;
+    ep->n_spans = 0;
+
+    /* Finish the frame left over from last time. */
+    if (ep->n_partial) {
+        size_t take = frame_size - ep->n_partial;
+        if (take > nsamp)
+            take = nsamp;
+        memcpy(partial + ep->n_partial, pcm, take * sizeof(*pcm));
+        ep->n_partial += take;
+        pcm += take;
+        nsamp -= take;
+        if ((size_t)ep->n_partial == frame_size) {
+            ep->n_partial = 0;
+            ep_process_block_frame(ep, partial);
+            ++n_frames;
+        }
+    }
+    /* Everything else is used in place. */
+    while (nsamp >= frame_size) {
+        ep_process_block_frame(ep, pcm);
+        pcm += frame_size;
+        nsamp -= frame_size;
+        ++n_frames;
+    }
+    /* Now copy what's still queued, since the caller's data goes
+       away after this, and keep the remainder for next time.  If
+       nothing was queued, it is all still where the last call left
+       it. */
+    if (n_frames)
+        ep_settle(ep);
+    if (nsamp) {
+        memcpy(ep->buf + ep->maxlen * frame_size, pcm,
+               nsamp * sizeof(*pcm));
+        ep->n_partial = nsamp;
+    }
+
+    if (out_nspans)
+        *out_nspans = ep->n_spans;
+    return ep->n_spans ? ep->spans : NULL;
+}
+
 int
 ps_endpointer_in_speech(ps_endpointer_t *ep)
 {
@@ -62,15 +62,22 @@
 void
 ps_lattice_link(ps_lattice_t *dag, ps_latnode_t *from, ps_latnode_t *to,
                 int32 score, int32 ef)
+{
+    ps_lattice_link_since(dag, from, to, score, ef, NULL);
+}
+
+void
+ps_lattice_link_since(ps_lattice_t *dag, ps_latnode_t *from, ps_latnode_t *to,
+                    int32 score, int32 ef, latlink_list_t *old_exits)
 {
     latlink_list_t *fwdlink;
 
     /* Look for an existing link between "from" and "to" nodes */
-    for (fwdlink = from->exits; fwdlink; fwdlink = fwdlink->next)
+    for (fwdlink = from->exits; fwdlink != old_exits; fwdlink = fwdlink->next)
         if (fwdlink->link->to == to)
             break;
 
-    if (fwdlink == NULL) {
+    if (fwdlink == old_exits) {
         latlink_list_t *revlink;
         ps_latlink_t *link;
 
@@ -671,6 +678,7 @@ ps_lattice_free(ps_lattice_t *dag)
     listelem_alloc_free(dag->latnode_alloc);
     listelem_alloc_free(dag->latlink_alloc);
     listelem_alloc_free(dag->latlink_list_alloc);    
+    ckd_free(dag->q);
     ckd_free(dag->hyp_str);
     ckd_free(dag);
     return 0;
@@ -1054,38 +1062,31 @@ latlink_list_new(ps_lattice_t *dag, ps_latlink_t *link, latlink_list_t *next)
 void
 ps_lattice_pushq(ps_lattice_t *dag, ps_latlink_t *link)
 {
-    if (dag->q_head == NULL)
-        dag->q_head = dag->q_tail = latlink_list_new(dag, link, NULL);
-    else {
-        dag->q_tail->next = latlink_list_new(dag, link, NULL);
-        dag->q_tail = dag->q_tail->next;
+    if (dag->q_tail == dag->q_alloc) {
+        dag->q_alloc = dag->q_alloc ? dag->q_alloc * 2 : 256;
+        dag->q = ckd_realloc(dag->q, dag->q_alloc * sizeof(*dag->q));
     }
-
+    dag->q[dag->q_tail++] = link;
 }
 
 ps_latlink_t *
 ps_lattice_popq(ps_lattice_t *dag)
 {
-    latlink_list_t *x;
     ps_latlink_t *link;
 
-    if (dag->q_head == NULL)
+    if (dag->q_head == dag->q_tail)
         return NULL;
-    link = dag->q_head->link;
-    x = dag->q_head->next;
-    listelem_free(dag->latlink_list_alloc, dag->q_head);
-    dag->q_head = x;
-    if (dag->q_head == NULL)
-        dag->q_tail = NULL;
+    link = dag->q[dag->q_head++];
+    /* Start over at the beginning once it's empty. */
+    if (dag->q_head == dag->q_tail)
+        dag->q_head = dag->q_tail = 0;
     return link;
 }
 
 void
 ps_lattice_delq(ps_lattice_t *dag)
 {
-    while (ps_lattice_popq(dag)) {
-        /* Do nothing. */
-    }
+    dag->q_head = dag->q_tail = 0;
 }
 
 ps_latlink_t *
@@ -90,9 +90,10 @@ struct ps_lattice_s {
     listelem_alloc_t *latlink_alloc;     /**< Link allocator for this DAG. */
     listelem_alloc_t *latlink_list_alloc; /**< List element allocator for this DAG. */
 
-    /* This will probably be replaced with a heap. */
-    latlink_list_t *q_head; /**< Queue of links for traversal. */
-    latlink_list_t *q_tail; /**< Queue of links for traversal. */
+    ps_latlink_t **q;   /**< Queue of links for traversal. */
+    int32 q_head;       /**< Next link to pop from q. */
+    int32 q_tail;       /**< Next free slot in q. */
+    int32 q_alloc;      /**< Allocated size of q. */
 };
 
 /**
@@ -208,6 +209,14 @@ typedef struct astar_seg_s {
  */
 ps_lattice_t *ps_lattice_init_search(ps_search_t *search, int n_frame);
 
+/**
+ * Like ps_lattice_link(), but only look for an existing link among
+ * the exits added to from since it had old_exits, for callers that
+ * know the older ones can't go to the same node.
+ */
+void ps_lattice_link_since(ps_lattice_t *dag, ps_latnode_t *from, ps_latnode_t *to,
+                         int32 score, int32 ef, latlink_list_t *old_exits);
+
 /**
  * Insert penalty for fillers
  */
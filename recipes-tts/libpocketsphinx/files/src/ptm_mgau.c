@@ -52,22 +52,17 @@
 #include "util/ckd_alloc.h"
 #include "util/bio.h"
 #include "tied_mgau_common.h"
+#include "mgau_simd.h"
 #include "ptm_mgau.h"
 
 static ps_mgaufuncs_t ptm_mgau_funcs = {
     "ptm",
     ptm_mgau_frame_eval,      /* frame_eval */
     ptm_mgau_mllr_transform,  /* transform */
-    ptm_mgau_free             /* free */
+    ptm_mgau_free,            /* free */
+    ptm_mgau_batch_eval       /* batch_eval */
 };
 
-#define COMPUTE_GMM_MAP(_idx)                           \
-    diff[_idx] = obs[_idx] - mean[_idx];                \
-    sqdiff[_idx] = MFCCMUL(diff[_idx], diff[_idx]);     \
-    compl[_idx] = MFCCMUL(sqdiff[_idx], var[_idx]);
-#define COMPUTE_GMM_REDUCE(_idx)                \
-    d = GMMSUB(d, compl[_idx]);
-
 static void
 insertion_sort_topn(ptm_topn_t *topn, int i, int32 d)
 {
@@ -85,47 +80,22 @@ insertion_sort_topn(ptm_topn_t *topn, int i, int32 d)
 }
 
 static int
-eval_topn(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
+eval_topn(gauden_t *g, ptm_topn_t *topn, int max_topn,
+          int cb, int feat, mfcc_t *z)
 {
-    ptm_topn_t *topn;
     int i, ceplen;
 
-    topn = s->f->topn[cb][feat];
-    ceplen = s->g->featlen[feat];
+    ceplen = g->featlen[feat];
 
-    for (i = 0; i < s->max_topn; i++) {
-        mfcc_t *mean, diff[4], sqdiff[4], compl[4]; /* diff, diff^2, component likelihood */
-        mfcc_t *var, d;
-        mfcc_t *obs;
-        int32 cw, j;
+    for (i = 0; i < max_topn; i++) {
+        mfcc_t *mean, *var, d;
+        int32 cw;
 
         cw = topn[i].cw;
-        mean = s->g->mean[cb][feat][0] + cw * ceplen;
-        var = s->g->var[cb][feat][0] + cw * ceplen;
-        d = s->g->det[cb][feat][cw];
-        obs = z;
-        for (j = 0; j < ceplen % 4; ++j) {
-            diff[0] = *obs++ - *mean++;
-            sqdiff[0] = MFCCMUL(diff[0], diff[0]);
-            compl[0] = MFCCMUL(sqdiff[0], *var);
-            d = GMMSUB(d, compl[0]);
-            ++var;
-        }
-        /* We could vectorize this but it's unlikely to make much
-         * difference as the outer loop here isn't very big. */
-        for (;j < ceplen; j += 4) {
-            COMPUTE_GMM_MAP(0);
-            COMPUTE_GMM_MAP(1);
-            COMPUTE_GMM_MAP(2);
-            COMPUTE_GMM_MAP(3);
-            COMPUTE_GMM_REDUCE(0);
-            COMPUTE_GMM_REDUCE(1);
-            COMPUTE_GMM_REDUCE(2);
-            COMPUTE_GMM_REDUCE(3);
-            var += 4;
-            obs += 4;
-            mean += 4;
-        }
+        mean = g->mean[cb][feat][0] + cw * ceplen;
+        var = g->var[cb][feat][0] + cw * ceplen;
+        d = mgau_simd_dist(g->det[cb][feat][cw], z, mean, var, ceplen,
+                           MGAU_SIMD_NO_THRESH);
         if (d < (mfcc_t)MAX_NEG_INT32)  /* Redundant if FIXED_POINT */
             insertion_sort_topn(topn, i, MAX_NEG_INT32);
         else
@@ -135,6 +105,32 @@ eval_topn(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
     return topn[0].score;
 }
 
+/* Same as eval_topn(), with quantized Gaussians q and observation obs. */
+static int
+eval_topn_q(gauden_t *g, ptm_quant_t *q, ptm_topn_t *topn, int max_topn,
+            int cb, int feat, int16 const *obs)
+{
+    int i, veclen;
+
+    veclen = q->veclen[feat];
+    for (i = 0; i < max_topn; i++) {
+        mfcc_t d;
+        int32 cw, k;
+
+        cw = topn[i].cw;
+        k = cb * g->n_density + cw;
+        d = g->det[cb][feat][cw] - q->scale[feat][k]
+            * mgau_simd_dist_q8(obs, q->mean[feat] + k * veclen,
+                                q->var[feat] + k * veclen, veclen, MAX_INT32);
+        if (d < (mfcc_t)MAX_NEG_INT32)
+            insertion_sort_topn(topn, i, MAX_NEG_INT32);
+        else
+            insertion_sort_topn(topn, i, (int32)d);
+    }
+
+    return topn[0].score;
+}
+
 /* This looks bad, but it actually isn't.  Less than 1% of eval_cb's
  * time is spent doing this. */
 static void
@@ -148,75 +144,101 @@ insertion_sort_cb(ptm_topn_t **cur, ptm_topn_t *worst, ptm_topn_t *best,
     (*cur)->score = intd;
 }
 
+/* Evaluate densities [start, end) of a codebook. */
 static int
-eval_cb(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
+eval_cb(gauden_t *g, ptm_topn_t *topn, int max_topn,
+        int cb, int feat, mfcc_t *z, int start, int end)
 {
-    ptm_topn_t *worst, *best, *topn;
+    ptm_topn_t *worst, *best;
     mfcc_t *mean;
     mfcc_t *var, *det, *detP, *detE;
     int32 i, ceplen;
 
-    best = topn = s->f->topn[cb][feat];
-    worst = topn + (s->max_topn - 1);
-    mean = s->g->mean[cb][feat][0];
-    var = s->g->var[cb][feat][0];
-    det = s->g->det[cb][feat];
-    detE = det + s->g->n_density;
-    ceplen = s->g->featlen[feat];
+    best = topn;
+    worst = topn + (max_topn - 1);
+    ceplen = g->featlen[feat];
+    mean = g->mean[cb][feat][0] + start * ceplen;
+    var = g->var[cb][feat][0] + start * ceplen;
+    det = g->det[cb][feat];
+    detE = det + end;
 
-    for (detP = det; detP < detE; ++detP) {
-        mfcc_t diff[4], sqdiff[4], compl[4]; /* diff, diff^2, component likelihood */
+    for (detP = det + start; detP < detE; ++detP) {
         mfcc_t d, thresh;
-        mfcc_t *obs;
         ptm_topn_t *cur;
-        int32 cw, j;
+        int32 cw;
 
-        d = *detP;
         thresh = (mfcc_t) worst->score; /* Avoid int-to-float conversions */
-        obs = z;
         cw = (int)(detP - det);
 
-        /* Unroll the loop starting with the first dimension(s).  In
-         * theory this might be a bit faster if this Gaussian gets
-         * "knocked out" by C0. In practice not. */
-        for (j = 0; (j < ceplen % 4) && (d >= thresh); ++j) {
-            diff[0] = *obs++ - *mean++;
-            sqdiff[0] = MFCCMUL(diff[0], diff[0]);
-            compl[0] = MFCCMUL(sqdiff[0], *var++);
-            d = GMMSUB(d, compl[0]);
-        }
-        /* Now do 4 dimensions at a time.  You'd think that GCC would
-         * vectorize this?  Apparently not.  And it's right, because
-         * that won't make this any faster, at least on x86-64. */
-        for (; j < ceplen && d >= thresh; j += 4) {
-            COMPUTE_GMM_MAP(0);
-            COMPUTE_GMM_MAP(1);
-            COMPUTE_GMM_MAP(2);
-            COMPUTE_GMM_MAP(3);
-            COMPUTE_GMM_REDUCE(0);
-            COMPUTE_GMM_REDUCE(1);
-            COMPUTE_GMM_REDUCE(2);
-            COMPUTE_GMM_REDUCE(3);
-            var += 4;
-            obs += 4;
-            mean += 4;
-        }
-        if (j < ceplen) {
-            /* terminated early, so not in topn */
-            mean += (ceplen - j);
-            var += (ceplen - j);
+        /* Anything that drops below the worst of the top-N on the
+         * way is knocked out, the kernel stops there. */
+        d = mgau_simd_dist(*detP, z, mean, var, ceplen, thresh);
+        mean += ceplen;
+        var += ceplen;
+        if (d < thresh)
             continue;
+        for (i = 0; i < max_topn; i++) {
+            /* already there, so don't need to insert */
+            if (topn[i].cw == cw)
+                break;
         }
+        if (i < max_topn)
+            continue;       /* already there.  Don't insert */
+        if (d < (mfcc_t)MAX_NEG_INT32)  /* Redundant if FIXED_POINT */
+            insertion_sort_cb(&cur, worst, best, cw, MAX_NEG_INT32);
+        else
+            insertion_sort_cb(&cur, worst, best, cw, (int32)d);
+    }
+
+    return best->score;
+}
+
+/* Same as eval_cb(), with quantized Gaussians q and observation obs. */
+static int
+eval_cb_q(gauden_t *g, ptm_quant_t *q, ptm_topn_t *topn, int max_topn,
+          int cb, int feat, int16 const *obs, int start, int end)
+{
+    ptm_topn_t *worst, *best;
+    mfcc_t *det;
+    float32 *scale;
+    int8 *mean;
+    uint8 *var;
+    int32 i, veclen, cw;
+
+    best = topn;
+    worst = topn + (max_topn - 1);
+    veclen = q->veclen[feat];
+    mean = q->mean[feat] + (cb * g->n_density + start) * veclen;
+    var = q->var[feat] + (cb * g->n_density + start) * veclen;
+    scale = q->scale[feat] + cb * g->n_density;
+    det = g->det[cb][feat];
+
+    for (cw = start; cw < end; ++cw, mean += veclen, var += veclen) {
+        mfcc_t d, thresh, lim;
+        ptm_topn_t *cur;
+        int32 limit, acc;
+
+        thresh = (mfcc_t) worst->score;
+        /* Convert the threshold to the kernel's units, so it can
+         * knock out this density on the way. */
+        lim = (det[cw] - thresh) / scale[cw];
+        if (lim < 0)
+            continue;
+        limit = (lim >= (mfcc_t)MAX_INT32) ? MAX_INT32 : (int32)lim;
+        acc = mgau_simd_dist_q8(obs, mean, var, veclen, limit);
+        if (acc > limit)
+            continue;
+        d = det[cw] - scale[cw] * acc;
         if (d < thresh)
             continue;
-        for (i = 0; i < s->max_topn; i++) {
+        for (i = 0; i < max_topn; i++) {
             /* already there, so don't need to insert */
             if (topn[i].cw == cw)
                 break;
         }
-        if (i < s->max_topn)
+        if (i < max_topn)
             continue;       /* already there.  Don't insert */
-        if (d < (mfcc_t)MAX_NEG_INT32)  /* Redundant if FIXED_POINT */
+        if (d < (mfcc_t)MAX_NEG_INT32)
             insertion_sort_cb(&cur, worst, best, cw, MAX_NEG_INT32);
         else
             insertion_sort_cb(&cur, worst, best, cw, (int32)d);
@@ -226,30 +248,152 @@ eval_cb(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
 }
 
 /**
- * Compute top-N densities for active codebooks (and prune)
+ * Scale the observation for each stream to the steps of the quantized
+ * means.  The padding stays at zero, like the means.
  */
-static int
-ptm_mgau_codebook_eval(ptm_mgau_t *s, mfcc_t **z, int frame)
+static void
+ptm_quant_obs(gauden_t *g, ptm_quant_t *q, mfcc_t **z)
+{
+    int f, i;
+
+    for (f = 0; f < g->n_feat; ++f) {
+        for (i = 0; i < g->featlen[f]; ++i) {
+            float32 x = MFCC2FLOAT(z[f][i]) * q->step[f][i];
+            if (x > 32767.0f)
+                x = 32767.0f;
+            else if (x < -32767.0f)
+                x = -32767.0f;
+            q->obs[f][i] = (int16)lrintf(x);
+        }
+    }
+}
+
+/**
+ * Work shared with the scoring threads for one frame.
+ */
+typedef struct ptm_job_s {
+    ptm_mgau_t *s;
+    mfcc_t **z;
+    int frame;
+    int16 *senone_scores;
+    int32 bestscore[MGAU_POOL_MAX_WORKERS];
+} ptm_job_t;
+
+/* Each codebook only touches its own top-N, so they can be split
+ * between threads as-is. */
+static void
+codebook_eval_range(void *arg, int start, int end, int worker)
 {
+    ptm_job_t *job = (ptm_job_t *)arg;
+    ptm_mgau_t *s = job->s;
     int i, j;
 
-    /* First evaluate top-N from previous frame. */
-    for (i = 0; i < s->g->n_mgau; ++i)
-        for (j = 0; j < s->g->n_feat; ++j)
-            eval_topn(s, i, j, z[j]);
+    (void)worker;
+    for (i = start; i < end; ++i) {
+        /* First evaluate top-N from previous frame. */
+        for (j = 0; j < s->g->n_feat; ++j) {
+            if (s->q)
+                eval_topn_q(s->g, s->q, s->f->topn[i][j], s->max_topn,
+                            i, j, s->q->obs[j]);
+            else
+                eval_topn(s->g, s->f->topn[i][j], s->max_topn,
+                          i, j, job->z[j]);
+        }
 
-    /* If frame downsampling is in effect, possibly do nothing else. */
-    if (frame % s->ds_ratio)
-        return 0;
+        /* If frame downsampling is in effect, possibly do nothing else. */
+        if (job->frame % s->ds_ratio)
+            continue;
 
-    /* Evaluate remaining codebooks. */
-    for (i = 0; i < s->g->n_mgau; ++i) {
+        /* Evaluate remaining codebooks. */
         if (bitvec_is_clear(s->f->mgau_active, i))
             continue;
         for (j = 0; j < s->g->n_feat; ++j) {
-            eval_cb(s, i, j, z[j]);
+            if (s->q)
+                eval_cb_q(s->g, s->q, s->f->topn[i][j], s->max_topn,
+                          i, j, s->q->obs[j], 0, s->g->n_density);
+            else
+                eval_cb(s->g, s->f->topn[i][j], s->max_topn, i, j,
+                        job->z[j], 0, s->g->n_density);
+        }
+    }
+}
+
+/**
+ * Work shared with the scoring threads for a batch of frames.
+ */
+typedef struct ptm_batch_job_s {
+    ptm_mgau_t **s;
+    mfcc_t ***z;
+    int32 const *frame;
+    int n;
+} ptm_batch_job_t;
+
+/* Like codebook_eval_range(), but for several streams using the
+ * Gaussians of the first one, and for every codebook since we don't
+ * know yet which ones their searches will want.  Each block of
+ * densities is run through all the streams while it's in cache.  Every
+ * stream still sees the densities in the same order, so its top-N come
+ * out exactly as if it had been evaluated on its own. */
+static void
+batch_eval_range(void *arg, int start, int end, int worker)
+{
+    ptm_batch_job_t *job = (ptm_batch_job_t *)arg;
+    gauden_t *g = job->s[0]->g;
+    ptm_quant_t *q = job->s[0]->q;
+    int i, j, k, d;
+
+    (void)worker;
+    for (i = start; i < end; ++i) {
+        for (k = 0; k < job->n; ++k) {
+            ptm_mgau_t *s = job->s[k];
+            for (j = 0; j < g->n_feat; ++j) {
+                if (q)
+                    eval_topn_q(g, q, s->f->topn[i][j], s->max_topn,
+                                i, j, s->q->obs[j]);
+                else
+                    eval_topn(g, s->f->topn[i][j], s->max_topn,
+                              i, j, job->z[k][j]);
+            }
+            /* Keep these in case the codebook turns out to be inactive. */
+            memcpy(s->batch_topn[i][0], s->f->topn[i][0],
+                   g->n_feat * s->max_topn * sizeof(ptm_topn_t));
+        }
+        for (d = 0; d < g->n_density; d += PTM_BATCH_DENSITIES) {
+            int dend = d + PTM_BATCH_DENSITIES;
+            if (dend > g->n_density)
+                dend = g->n_density;
+            for (k = 0; k < job->n; ++k) {
+                ptm_mgau_t *s = job->s[k];
+                if (job->frame[k] % s->ds_ratio)
+                    continue;
+                for (j = 0; j < g->n_feat; ++j) {
+                    if (q)
+                        eval_cb_q(g, q, s->f->topn[i][j], s->max_topn,
+                                  i, j, s->q->obs[j], d, dend);
+                    else
+                        eval_cb(g, s->f->topn[i][j], s->max_topn,
+                                i, j, job->z[k][j], d, dend);
+                }
+            }
         }
     }
+}
+
+/**
+ * Compute top-N densities for active codebooks (and prune)
+ */
+static int
+ptm_mgau_codebook_eval(ptm_mgau_t *s, mfcc_t **z, int frame)
+{
+    ptm_job_t job;
+
+    if (s->q)
+        ptm_quant_obs(s->g, s->q, z);
+    job.s = s;
+    job.z = z;
+    job.frame = frame;
+    mgau_pool_run(ps_mgau_base(s)->pool, codebook_eval_range, &job,
+                  s->g->n_mgau);
     return 0;
 }
 
@@ -320,6 +464,54 @@ ptm_mgau_calc_cb_active(ptm_mgau_t *s, uint8 *senone_active,
     return 0;
 }
 
+static void
+senone_eval_range(void *arg, int start, int end, int worker)
+{
+    ptm_job_t *job = (ptm_job_t *)arg;
+    ptm_mgau_t *s = job->s;
+    int i, bestscore;
+
+    bestscore = 0x7fffffff;
+    for (i = start; i < end; ++i) {
+        int sen, f, cb;
+        int ascore;
+
+        sen = s->senone_list[i];
+        cb = s->sen2cb[sen];
+        /* For each feature, log-sum codeword scores + mixw to get
+         * feature density, then sum (multiply) to get ascore */
+        ascore = 0;
+        for (f = 0; f < s->g->n_feat; ++f) {
+            ptm_topn_t *topn;
+            int j, fden = 0;
+            topn = s->f->topn[cb][f];
+            for (j = 0; j < s->max_topn; ++j) {
+                int mixw;
+                /* Find mixture weight for this codeword. */
+                if (s->mixw_cb) {
+                    int dcw = s->mixw[f][topn[j].cw][sen/2];
+                    dcw = (dcw & 1) ? dcw >> 4 : dcw & 0x0f;
+                    mixw = s->mixw_cb[dcw];
+                }
+                else {
+                    mixw = s->mixw[f][topn[j].cw][sen];
+                }
+                if (j == 0)
+                    fden = mixw + topn[j].score;
+                else
+                    fden = fast_logmath_add(s->lmath_8b, fden,
+                                       mixw + topn[j].score);
+                E_DEBUG("fden[%d][%d] l+= %d + %d = %d\n",
+                        sen, f, mixw, topn[j].score, fden);
+            }
+            ascore += fden;
+        }
+        if (ascore < bestscore) bestscore = ascore;
+        job->senone_scores[sen] = ascore;
+    }
+    job->bestscore[worker] = bestscore;
+}
+
 /**
  * Compute senone scores from top-N densities for active codebooks.
  */
@@ -328,9 +520,21 @@ ptm_mgau_senone_eval(ptm_mgau_t *s, int16 *senone_scores,
                      uint8 *senone_active, int32 n_senone_active,
                      int compall)
 {
-    int i, lastsen, bestscore;
-
-    memset(senone_scores, 0, s->n_sen * sizeof(*senone_scores));
+    ptm_job_t job;
+    int i, lastsen, bestscore, fresh = TRUE;
+
+    /* Keep the scores from earlier frames with the same top-N. */
+    if (s->ds) {
+        if (compall) {
+            senone_active = NULL;
+            n_senone_active = s->n_sen;
+        }
+        n_senone_active = mgau_ds_todo(s->ds, s->f->epoch, &senone_active,
+                                       n_senone_active, &fresh);
+        compall = FALSE;
+    }
+    if (fresh)
+        memset(senone_scores, 0, s->n_sen * sizeof(*senone_scores));
     /* FIXME: This is the non-cache-efficient way to do this.  We want
      * to evaluate one codeword at a time but this requires us to have
      * a reverse codebook to senone mapping, which we don't have
@@ -338,16 +542,16 @@ ptm_mgau_senone_eval(ptm_mgau_t *s, int16 *senone_scores,
      * codewords. */
     if (compall)
         n_senone_active = s->n_sen;
-    bestscore = 0x7fffffff;
+    /* Undo the deltas first so the senones can be split up. */
     for (lastsen = i = 0; i < n_senone_active; ++i) {
         int sen, f, cb;
-        int ascore;
 
         if (compall)
             sen = i;
         else
             sen = senone_active[i] + lastsen;
         lastsen = sen;
+        s->senone_list[i] = sen;
         cb = s->sen2cb[sen];
 
         if (bitvec_is_clear(s->f->mgau_active, cb)) {
@@ -362,42 +566,161 @@ ptm_mgau_senone_eval(ptm_mgau_t *s, int16 *senone_scores,
                 }
             }
         }
-        /* For each feature, log-sum codeword scores + mixw to get
-         * feature density, then sum (multiply) to get ascore */
-        ascore = 0;
-        for (f = 0; f < s->g->n_feat; ++f) {
-            ptm_topn_t *topn;
-            int j, fden = 0;
-            topn = s->f->topn[cb][f];
-            for (j = 0; j < s->max_topn; ++j) {
-                int mixw;
-                /* Find mixture weight for this codeword. */
-                if (s->mixw_cb) {
-                    int dcw = s->mixw[f][topn[j].cw][sen/2];
-                    dcw = (dcw & 1) ? dcw >> 4 : dcw & 0x0f;
-                    mixw = s->mixw_cb[dcw];
-                }
-                else {
-                    mixw = s->mixw[f][topn[j].cw][sen];
-                }
-                if (j == 0)
-                    fden = mixw + topn[j].score;
-                else
-                    fden = fast_logmath_add(s->lmath_8b, fden,
-                                       mixw + topn[j].score);
-                E_DEBUG("fden[%d][%d] l+= %d + %d = %d\n",
-                        sen, f, mixw, topn[j].score, fden);
-            }
-            ascore += fden;
-        }
-        if (ascore < bestscore) bestscore = ascore;
-        senone_scores[sen] = ascore;
     }
+
+    job.s = s;
+    job.senone_scores = senone_scores;
+    for (i = 0; i < MGAU_POOL_MAX_WORKERS; ++i)
+        job.bestscore[i] = 0x7fffffff;
+    mgau_pool_run(ps_mgau_base(s)->pool, senone_eval_range, &job,
+                  n_senone_active);
+    bestscore = 0x7fffffff;
+    for (i = 0; i < MGAU_POOL_MAX_WORKERS; ++i)
+        if (job.bestscore[i] < bestscore)
+            bestscore = job.bestscore[i];
+
     /* Normalize the scores again (finishing the job we started above
      * in ptm_mgau_codebook_eval...) */
+    if (!fresh) {
+        /* The others in the buffer were normalized with this. */
+        for (i = 0; i < n_senone_active; ++i)
+            senone_scores[s->senone_list[i]] -= s->ds->sen_norm;
+        return 0;
+    }
     for (i = 0; i < s->n_sen; ++i) {
         senone_scores[i] -= bestscore;
     }
+    if (s->ds)
+        s->ds->sen_norm = bestscore;
+
+    return 0;
+}
+
+/**
+ * Point s->f at the history entry for a new frame and start it off
+ * with the previous frame's top-N codewords.
+ */
+static void
+ptm_mgau_start_frame(ptm_mgau_t *s, int frame)
+{
+    ptm_fast_eval_t *lastf;
+    int fast_eval_idx;
+
+    fast_eval_idx = frame % s->n_fast_hist;
+    s->f = s->hist + fast_eval_idx;
+    /* Get the previous frame's top-N information (on the first frame
+     * of the input this is just all WORST_DIST, no harm in that) */
+    if (fast_eval_idx == 0)
+        lastf = s->hist + s->n_fast_hist - 1;
+    else
+        lastf = s->hist + fast_eval_idx - 1;
+    /* Copy in initial top-N info */
+    memcpy(s->f->topn[0][0], lastf->topn[0][0],
+           s->g->n_mgau * s->g->n_feat * s->max_topn * sizeof(ptm_topn_t));
+}
+
+/**
+ * Decide whether the frame just started can keep the previous frame's
+ * top-N.  They are already normalized, but only for the codebooks
+ * that were active there, so it can't need any others.
+ */
+static int
+ptm_mgau_ds_update(ptm_mgau_t *s, mfcc_t **z, int frame)
+{
+    ptm_fast_eval_t *lastf;
+    int i, can_reuse = TRUE;
+
+    lastf = s->hist + (frame + s->n_fast_hist - 1) % s->n_fast_hist;
+    for (i = 0; i < s->g->n_mgau; ++i) {
+        if (bitvec_is_set(s->f->mgau_active, i)
+            && bitvec_is_clear(lastf->mgau_active, i)) {
+            can_reuse = FALSE;
+            break;
+        }
+    }
+    if (mgau_ds_update(s->ds, z[0], frame, can_reuse)) {
+        memcpy(s->f->mgau_active, lastf->mgau_active,
+               bitvec_size(s->g->n_mgau) * sizeof(bitvec_t));
+        s->f->epoch = lastf->epoch;
+        return TRUE;
+    }
+    s->f->epoch = mgau_ds_epoch(s->ds);
+    return FALSE;
+}
+
+/**
+ * Undo ptm_mgau_batch_eval()'s full evaluation of codebooks that
+ * turned out to be inactive for this frame.
+ */
+static void
+ptm_mgau_batch_restore(ptm_mgau_t *s)
+{
+    int i;
+
+    for (i = 0; i < s->g->n_mgau; ++i) {
+        if (bitvec_is_set(s->f->mgau_active, i))
+            continue;
+        memcpy(s->f->topn[i][0], s->batch_topn[i][0],
+               s->g->n_feat * s->max_topn * sizeof(ptm_topn_t));
+    }
+}
+
+/**
+ * Throw away ptm_mgau_batch_eval()'s results for a frame that reuses
+ * the previous frame's top-N after all.
+ */
+static void
+ptm_mgau_batch_discard(ptm_mgau_t *s, int frame)
+{
+    ptm_fast_eval_t *lastf;
+
+    lastf = s->hist + (frame + s->n_fast_hist - 1) % s->n_fast_hist;
+    memcpy(s->f->topn[0][0], lastf->topn[0][0],
+           s->g->n_mgau * s->g->n_feat * s->max_topn * sizeof(ptm_topn_t));
+}
+
+int
+ptm_mgau_batch_eval(ps_mgau_t **ps, mfcc_t ***featbuf,
+                    int32 const *frame, int32 n)
+{
+    ptm_mgau_t **s = (ptm_mgau_t **)ps;
+    gauden_t *g = s[0]->g;
+    ptm_batch_job_t job;
+    int i, j;
+
+    for (i = 0; i < n; ++i) {
+        if (s[i]->g->n_mgau != g->n_mgau
+            || s[i]->g->n_feat != g->n_feat
+            || s[i]->g->n_density != g->n_density
+            || s[i]->max_topn != s[0]->max_topn
+            || (s[i]->q == NULL) != (s[0]->q == NULL)) {
+            E_ERROR("Acoustic models in batch do not match\n");
+            return -1;
+        }
+        for (j = 0; j < g->n_feat; ++j) {
+            if (s[i]->g->featlen[j] != g->featlen[j]) {
+                E_ERROR("Acoustic models in batch do not match\n");
+                return -1;
+            }
+        }
+    }
+    for (i = 0; i < n; ++i) {
+        ptm_mgau_start_frame(s[i], frame[i]);
+        if (s[i]->batch_topn == NULL)
+            s[i]->batch_topn = ckd_calloc_3d(g->n_mgau, g->n_feat,
+                                             s[i]->max_topn,
+                                             sizeof(ptm_topn_t));
+        s[i]->batch_frame = frame[i];
+        if (s[i]->q)
+            ptm_quant_obs(s[i]->g, s[i]->q, featbuf[i]);
+    }
+
+    job.s = s;
+    job.z = featbuf;
+    job.frame = frame;
+    job.n = n;
+    mgau_pool_run(ps_mgau_base(s[0])->pool, batch_eval_range, &job,
+                  g->n_mgau);
 
     return 0;
 }
@@ -414,7 +737,6 @@ ptm_mgau_frame_eval(ps_mgau_t *ps,
                     int32 compallsen)
 {
     ptm_mgau_t *s = (ptm_mgau_t *)ps;
-    int fast_eval_idx;
 
     /* Find the appropriate frame in the rotating history buffer
      * corresponding to the requested input frame.  No bounds checking
@@ -422,29 +744,44 @@ ptm_mgau_frame_eval(ps_mgau_t *ps,
      * you request a frame in the future or one that's too far in the
      * past.  Since the history buffer is just used for fast match
      * that might not be fatal. */
-    fast_eval_idx = frame % s->n_fast_hist;
-    s->f = s->hist + fast_eval_idx;
+    s->f = s->hist + frame % s->n_fast_hist;
     /* Compute the top-N codewords for every codebook, unless this
      * is a past frame, in which case we already have them (we
      * hope!) */
     if (frame >= ps_mgau_base(ps)->frame_idx) {
-        ptm_fast_eval_t *lastf;
-        /* Get the previous frame's top-N information (on the
-         * first frame of the input this is just all WORST_DIST,
-         * no harm in that) */
-        if (fast_eval_idx == 0)
-            lastf = s->hist + s->n_fast_hist - 1;
-        else
-            lastf = s->hist + fast_eval_idx - 1;
-        /* Copy in initial top-N info */
-        memcpy(s->f->topn[0][0], lastf->topn[0][0],
-               s->g->n_mgau * s->g->n_feat * s->max_topn * sizeof(ptm_topn_t));
-        /* Generate initial active codebook list (this might not be
-         * necessary) */
-        ptm_mgau_calc_cb_active(s, senone_active, n_senone_active, compallsen);
-        /* Now evaluate top-N, prune, and evaluate remaining codebooks. */
-        ptm_mgau_codebook_eval(s, featbuf, frame);
-        ptm_mgau_codebook_norm(s, featbuf, frame);
+        int reused = FALSE;
+
+        if (s->batch_frame == frame) {
+            /* Already evaluated by ptm_mgau_batch_eval(). */
+            ptm_mgau_calc_cb_active(s, senone_active, n_senone_active,
+                                    compallsen);
+            /* Make the same decision as below, so a batched stream
+             * scores exactly like one decoded on its own. */
+            if (s->ds)
+                reused = ptm_mgau_ds_update(s, featbuf, frame);
+            if (reused)
+                ptm_mgau_batch_discard(s, frame);
+            else
+                ptm_mgau_batch_restore(s);
+            s->batch_frame = -1;
+        }
+        else {
+            ptm_mgau_start_frame(s, frame);
+            /* Generate initial active codebook list (this might not be
+             * necessary) */
+            ptm_mgau_calc_cb_active(s, senone_active, n_senone_active,
+                                    compallsen);
+            /* If the input hasn't changed much, keep the top-N that
+             * were just copied from the previous frame. */
+            if (s->ds)
+                reused = ptm_mgau_ds_update(s, featbuf, frame);
+            /* Now evaluate top-N, prune, and evaluate remaining
+             * codebooks. */
+            if (!reused)
+                ptm_mgau_codebook_eval(s, featbuf, frame);
+        }
+        if (!reused)
+            ptm_mgau_codebook_norm(s, featbuf, frame);
     }
     /* Evaluate intersection of active senones and active codebooks. */
     ptm_mgau_senone_eval(s, senone_scores, senone_active,
@@ -792,8 +1129,124 @@ ptm_mgau_reset_fast_hist(ps_mgau_t *ps)
         /* Start with them all on, prune them later. */
         bitvec_set_all(s->hist[i].mgau_active, s->g->n_mgau);
     }
+    s->batch_frame = -1;
 }
 
+static void
+ptm_quant_free(ptm_quant_t *q, int n_feat)
+{
+    int f;
+
+    if (q == NULL)
+        return;
+    for (f = 0; f < n_feat; ++f) {
+        ckd_free(q->step[f]);
+        ckd_free(q->mean[f]);
+        ckd_free(q->var[f]);
+        ckd_free(q->scale[f]);
+        ckd_free(q->obs[f]);
+    }
+    ckd_free(q->veclen);
+    ckd_free(q->step);
+    ckd_free(q->mean);
+    ckd_free(q->var);
+    ckd_free(q->scale);
+    ckd_free(q->obs);
+    ckd_free(q);
+}
+
+#ifndef FIXED_POINT
+/**
+ * Quantize the means and variances in g to 8 bits.
+ *
+ * Each dimension gets a mean step that covers the largest mean
+ * in that dimension in 127 steps, so the observation can be scaled
+ * once per frame.  The variances, multiplied by the squared step,
+ * are then scaled per codeword to 255.
+ */
+static ptm_quant_t *
+ptm_quant_init(gauden_t *g)
+{
+    ptm_quant_t *q;
+    int32 n_cw, f;
+
+    n_cw = g->n_mgau * g->n_density;
+    q = ckd_calloc(1, sizeof(*q));
+    q->veclen = ckd_calloc(g->n_feat, sizeof(*q->veclen));
+    q->step = ckd_calloc(g->n_feat, sizeof(*q->step));
+    q->mean = ckd_calloc(g->n_feat, sizeof(*q->mean));
+    q->var = ckd_calloc(g->n_feat, sizeof(*q->var));
+    q->scale = ckd_calloc(g->n_feat, sizeof(*q->scale));
+    q->obs = ckd_calloc(g->n_feat, sizeof(*q->obs));
+    for (f = 0; f < g->n_feat; ++f) {
+        float32 *step;
+        int32 flen, veclen, cb, cw, i;
+
+        flen = g->featlen[f];
+        veclen = (flen + MGAU_SIMD_Q8_ALIGN - 1)
+            / MGAU_SIMD_Q8_ALIGN * MGAU_SIMD_Q8_ALIGN;
+        if (veclen > MGAU_SIMD_Q8_MAX_LEN) {
+            E_ERROR("Stream %d is too long to quantize: %d > %d\n",
+                    f, flen, MGAU_SIMD_Q8_MAX_LEN);
+            ptm_quant_free(q, g->n_feat);
+            return NULL;
+        }
+        q->veclen[f] = veclen;
+        q->step[f] = ckd_calloc(veclen, sizeof(**q->step));
+        q->mean[f] = ckd_calloc(n_cw * veclen, sizeof(**q->mean));
+        q->var[f] = ckd_calloc(n_cw * veclen, sizeof(**q->var));
+        q->scale[f] = ckd_calloc(n_cw, sizeof(**q->scale));
+        q->obs[f] = ckd_calloc(veclen, sizeof(**q->obs));
+
+        step = ckd_calloc(flen, sizeof(*step));
+        for (cb = 0; cb < g->n_mgau; ++cb) {
+            for (cw = 0; cw < g->n_density; ++cw) {
+                for (i = 0; i < flen; ++i) {
+                    float32 m = fabsf(MFCC2FLOAT(g->mean[cb][f][cw][i]));
+                    if (m > step[i])
+                        step[i] = m;
+                }
+            }
+        }
+        for (i = 0; i < flen; ++i) {
+            step[i] = (step[i] > 0) ? step[i] / 127.0f : 1.0f;
+            q->step[f][i] = 1.0f / step[i];
+        }
+
+        for (cb = 0; cb < g->n_mgau; ++cb) {
+            for (cw = 0; cw < g->n_density; ++cw) {
+                int32 k = cb * g->n_density + cw;
+                int8 *mean = q->mean[f] + k * veclen;
+                uint8 *var = q->var[f] + k * veclen;
+                float32 wmax, scale;
+
+                wmax = 0;
+                for (i = 0; i < flen; ++i) {
+                    float32 w = MFCC2FLOAT(g->var[cb][f][cw][i])
+                        * step[i] * step[i];
+                    if (w > wmax)
+                        wmax = w;
+                }
+                scale = (wmax > 0) ? wmax / 255.0f : 1.0f;
+                q->scale[f][k] = scale;
+                for (i = 0; i < flen; ++i) {
+                    long m, v;
+
+                    m = lrintf(MFCC2FLOAT(g->mean[cb][f][cw][i]) / step[i]);
+                    v = lrintf(MFCC2FLOAT(g->var[cb][f][cw][i])
+                               * step[i] * step[i] / scale);
+                    mean[i] = (int8)(m > 127 ? 127 : (m < -127 ? -127 : m));
+                    var[i] = (uint8)(v > 255 ? 255 : (v < 0 ? 0 : v));
+                }
+            }
+        }
+        ckd_free(step);
+    }
+
+    return q;
+}
+#endif /* !FIXED_POINT */
+
 ps_mgau_t *
 ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
 {
@@ -861,7 +1314,17 @@ ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
             goto error_out;
         }
     }
+    if (ps_config_bool(s->config, "gauquant")) {
+#ifdef FIXED_POINT
+        E_WARN("Quantized Gaussians are not supported in fixed-point, ignoring -gauquant\n");
+#else
+        if ((s->q = ptm_quant_init(s->g)) == NULL)
+            goto error_out;
+        E_INFO("Using 8-bit quantized means and variances\n");
+#endif
+    }
     s->ds_ratio = ps_config_int(s->config, "ds");
+    s->ds = mgau_ds_init(s->config, s->g->featlen[0], s->n_sen);
     s->max_topn = ps_config_int(s->config, "topn");
     E_INFO("Maximum top-N: %d\n", s->max_topn);
 
@@ -870,6 +1333,7 @@ ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
     s->sen2cb = ckd_calloc(s->n_sen, sizeof(*s->sen2cb));
     for (i = 0; i < s->n_sen; ++i)
         s->sen2cb[i] = bin_mdef_sen2cimap(acmod->mdef, i);
+    s->senone_list = ckd_calloc(s->n_sen, sizeof(*s->senone_list));
 
     /* Allocate fast-match history buffers.  We need enough for the
      * phoneme lookahead window, plus the current frame, plus one for
@@ -893,7 +1357,18 @@ ptm_mgau_mllr_transform(ps_mgau_t *ps,
                             ps_mllr_t *mllr)
 {
     ptm_mgau_t *s = (ptm_mgau_t *)ps;
-    return gauden_mllr_transform(s->g, mllr, s->config);
+    int rv;
+
+    rv = gauden_mllr_transform(s->g, mllr, s->config);
+#ifndef FIXED_POINT
+    /* Quantize the adapted model over again. */
+    if (rv == 0 && s->q) {
+        ptm_quant_free(s->q, s->g->n_feat);
+        if ((s->q = ptm_quant_init(s->g)) == NULL)
+            return -1;
+    }
+#endif
+    return rv;
 }
 
 void
@@ -912,13 +1387,18 @@ ptm_mgau_free(ps_mgau_t *ps)
         ckd_free_3d(s->mixw);
     }
     ckd_free(s->sen2cb);
+    ckd_free(s->senone_list);
     
     for (i = 0; i < s->n_fast_hist; i++) {
 	ckd_free_3d(s->hist[i].topn);
 	bitvec_free(s->hist[i].mgau_active);
     }
     ckd_free(s->hist);
+    ckd_free_3d(s->batch_topn);
+    mgau_ds_free(s->ds);
     
+    if (s->g)
+        ptm_quant_free(s->q, s->g->n_feat);
     gauden_free(s->g);
     ckd_free(s);
 }
@@ -50,6 +50,7 @@
 #include "hmm.h"
 #include "bin_mdef.h"
 #include "ms_gauden.h"
+#include "mgau_ds.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -60,6 +61,9 @@ extern "C" {
 
 typedef struct ptm_mgau_s ptm_mgau_t;
 
+/** Densities evaluated for all streams of a batch at a time. */
+#define PTM_BATCH_DENSITIES 32
+
 typedef struct ptm_topn_s {
     int32 cw;    /**< Codeword index. */
     int32 score; /**< Score. */
@@ -68,24 +72,47 @@ typedef struct ptm_topn_s {
 typedef struct ptm_fast_eval_s {
     ptm_topn_t ***topn;     /**< Top-N for each codebook (mgau x feature x topn) */
     bitvec_t *mgau_active; /**< Set of active codebooks */
+    int32 epoch;           /**< Adaptive downsampling epoch of topn. */
 } ptm_fast_eval_t;
 
+/**
+ * Means and inverse variances quantized to 8 bits (the `gauquant`
+ * option).  Codewords are padded to veclen dimensions and stored one
+ * after the other, for codebook cb at cb * n_density.
+ */
+typedef struct ptm_quant_s {
+    int32 *veclen;    /**< Padded length of each stream. */
+    float32 **step;   /**< Inverse of the mean step for each stream and dimension. */
+    int8 **mean;      /**< Means, in steps. */
+    uint8 **var;      /**< Inverse variances times step squared, over scale. */
+    float32 **scale;  /**< Scale of var for each codeword. */
+    int16 **obs;      /**< Current observation, in steps. */
+} ptm_quant_t;
+
 struct ptm_mgau_s {
     ps_mgau_t base;     /**< base structure. */
     cmd_ln_t *config;   /**< Configuration parameters */
     gauden_t *g;        /**< Set of Gaussians. */
+    ptm_quant_t *q;     /**< Quantized copy of g, or NULL to use g. */
     int32 n_sen;       /**< Number of senones. */
     uint8 *sen2cb;     /**< Senone to codebook mapping. */
+    int32 *senone_list; /**< Active senones for this frame (not deltas). */
     uint8 ***mixw;     /**< Mixture weight distributions by feature, codeword, senone */
     mmio_file_t *sendump_mmap;/* Memory map for mixw (or NULL if not mmap) */
     uint8 *mixw_cb;    /* Mixture weight codebook, if any (assume it contains 16 values) */
     int16 max_topn;
     int16 ds_ratio;
+    mgau_ds_t *ds;      /**< Adaptive downsampling, or NULL. */
 
     ptm_fast_eval_t *hist;   /**< Fast evaluation info for past frames. */
     ptm_fast_eval_t *f;      /**< Fast eval info for current frame. */
     int n_fast_hist;         /**< Number of past frames tracked. */
 
+    /* Top-N before full evaluation, for codebooks that are
+     * inactive in a frame from ptm_mgau_batch_eval(). */
+    ptm_topn_t ***batch_topn;
+    int batch_frame;         /**< Frame done by ptm_mgau_batch_eval(), or -1. */
+
     /* Log-add table for compressed values. */
     logmath_t *lmath_8b;
     /* Log-add object for reloading means/variances. */
@@ -104,6 +131,10 @@ int ptm_mgau_frame_eval(ps_mgau_t *s,
 int ptm_mgau_mllr_transform(ps_mgau_t *s,
                             ps_mllr_t *mllr);
 void ptm_mgau_reset_fast_hist(ps_mgau_t *ps);
+int ptm_mgau_batch_eval(ps_mgau_t **s,
+                        mfcc_t ***featbuf,
+                        int32 const *frame,
+                        int32 n);
 
 #ifdef __cplusplus
 } /* extern "C" */
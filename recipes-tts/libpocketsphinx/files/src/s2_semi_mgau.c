@@ -53,12 +53,14 @@
 #include "util/bio.h"
 #include "s2_semi_mgau.h"
 #include "tied_mgau_common.h"
+#include "mgau_simd.h"
 
 static ps_mgaufuncs_t s2_semi_mgau_funcs = {
     "s2_semi",
     s2_semi_mgau_frame_eval,      /* frame_eval */
     s2_semi_mgau_mllr_transform,  /* transform */
-    s2_semi_mgau_free             /* free */
+    s2_semi_mgau_free,            /* free */
+    NULL                          /* batch_eval */
 };
 
 struct vqFeature_s {
@@ -76,24 +78,15 @@ eval_topn(s2_semi_mgau_t *s, int32 feat, mfcc_t *z)
     ceplen = s->g->featlen[feat];
 
     for (i = 0; i < s->max_topn; i++) {
-        mfcc_t *mean, diff, sqdiff, compl; /* diff, diff^2, component likelihood */
         vqFeature_t vtmp;
-        mfcc_t *var, d;
-        mfcc_t *obs;
+        mfcc_t *mean, *var, d;
         int32 cw, j;
 
         cw = topn[i].codeword;
         mean = s->g->mean[0][feat][0] + cw * ceplen;
         var = s->g->var[0][feat][0] + cw * ceplen;
-        d = s->g->det[0][feat][cw];
-        obs = z;
-        for (j = 0; j < ceplen; j++) {
-            diff = *obs++ - *mean++;
-            sqdiff = MFCCMUL(diff, diff);
-            compl = MFCCMUL(sqdiff, *var);
-            d = GMMSUB(d, compl);
-            ++var;
-        }
+        d = mgau_simd_dist(s->g->det[0][feat][cw], z, mean, var, ceplen,
+                           MGAU_SIMD_NO_THRESH);
         if (d < (mfcc_t)MAX_NEG_INT32)  /* Redundant if FIXED_POINT */
             topn[i].score = MAX_NEG_INT32;
         else
@@ -125,28 +118,17 @@ eval_cb(s2_semi_mgau_t *s, int32 feat, mfcc_t *z)
     ceplen = s->g->featlen[feat];
 
     for (detP = det; detP < detE; ++detP) {
-        mfcc_t diff, sqdiff, compl; /* diff, diff^2, component likelihood */
         mfcc_t d;
-        mfcc_t *obs;
         vqFeature_t *cur;
-        int32 cw, j, d_int;
+        int32 cw, d_int;
 
-        d = *detP;
-        obs = z;
         cw = (int)(detP - det);
-        for (j = 0; (j < ceplen) && (d >= worst->score); ++j) {
-            diff = *obs++ - *mean++;
-            sqdiff = MFCCMUL(diff, diff);
-            compl = MFCCMUL(sqdiff, *var);
-            d = GMMSUB(d, compl);
-            ++var;
-        }
-        if (j < ceplen) {
-            /* terminated early, so not in topn */
-            mean += (ceplen - j);
-            var += (ceplen - j);
-            continue;
-        }
+        d = mgau_simd_dist(*detP, z, mean, var, ceplen,
+                           (mfcc_t)worst->score);
+        mean += ceplen;
+        var += ceplen;
+        if (d < (mfcc_t)worst->score)
+            continue;           /* knocked out, so not in topn */
         if (d < (mfcc_t)MAX_NEG_INT32)
             d_int = MAX_NEG_INT32;
         else
@@ -202,632 +184,169 @@ mgau_norm(s2_semi_mgau_t *s, int feat)
     return j;
 }
 
-static int32
-get_scores_8b_feat_6(s2_semi_mgau_t * s, int i,
-                     int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
-{
-    int32 j, l;
-    uint8 *pid_cw0, *pid_cw1, *pid_cw2, *pid_cw3, *pid_cw4, *pid_cw5;
-
-    pid_cw0 = s->mixw[i][s->f[i][0].codeword];
-    pid_cw1 = s->mixw[i][s->f[i][1].codeword];
-    pid_cw2 = s->mixw[i][s->f[i][2].codeword];
-    pid_cw3 = s->mixw[i][s->f[i][3].codeword];
-    pid_cw4 = s->mixw[i][s->f[i][4].codeword];
-    pid_cw5 = s->mixw[i][s->f[i][5].codeword];
-
-    for (l = j = 0; j < n_senone_active; j++) {
-        int sen = senone_active[j] + l;
-        int32 tmp = pid_cw0[sen] + s->f[i][0].score;
-
-        tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw1[sen] + s->f[i][1].score);
-        tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw2[sen] + s->f[i][2].score);
-        tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw3[sen] + s->f[i][3].score);
-        tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw4[sen] + s->f[i][4].score);
-        tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw5[sen] + s->f[i][5].score);
-
-        senone_scores[sen] += tmp;
-        l = sen;
-    }
-    return 0;
-}
-
-static int32
-get_scores_8b_feat_5(s2_semi_mgau_t * s, int i,
-                     int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
-{
-    int32 j, l;
-    uint8 *pid_cw0, *pid_cw1, *pid_cw2, *pid_cw3, *pid_cw4;
-
-    pid_cw0 = s->mixw[i][s->f[i][0].codeword];
-    pid_cw1 = s->mixw[i][s->f[i][1].codeword];
-    pid_cw2 = s->mixw[i][s->f[i][2].codeword];
-    pid_cw3 = s->mixw[i][s->f[i][3].codeword];
-    pid_cw4 = s->mixw[i][s->f[i][4].codeword];
-
-    for (l = j = 0; j < n_senone_active; j++) {
-        int sen = senone_active[j] + l;
-        int32 tmp = pid_cw0[sen] + s->f[i][0].score;
-
-        tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw1[sen] + s->f[i][1].score);
-        tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw2[sen] + s->f[i][2].score);
-        tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw3[sen] + s->f[i][3].score);
-        tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw4[sen] + s->f[i][4].score);
-
-        senone_scores[sen] += tmp;
-        l = sen;
-    }
-    return 0;
-}
-
-static int32
-get_scores_8b_feat_4(s2_semi_mgau_t * s, int i,
-                     int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
-{
-    int32 j, l;
-    uint8 *pid_cw0, *pid_cw1, *pid_cw2, *pid_cw3;
-
-    pid_cw0 = s->mixw[i][s->f[i][0].codeword];
-    pid_cw1 = s->mixw[i][s->f[i][1].codeword];
-    pid_cw2 = s->mixw[i][s->f[i][2].codeword];
-    pid_cw3 = s->mixw[i][s->f[i][3].codeword];
-
-    for (l = j = 0; j < n_senone_active; j++) {
-        int sen = senone_active[j] + l;
-        int32 tmp = pid_cw0[sen] + s->f[i][0].score;
-
-        tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw1[sen] + s->f[i][1].score);
-        tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw2[sen] + s->f[i][2].score);
-        tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw3[sen] + s->f[i][3].score);
-
-        senone_scores[sen] += tmp;
-        l = sen;
-    }
-    return 0;
-}
+/*
+ * Senone scores are computed MGAU_SIMD_SEN_BLOCK senones at a time,
+ * straight from the mixture weights for each top-N codeword (which
+ * are stored codeword-major, so a block is contiguous).  A partial
+ * block at the end, or everything if the log-add table is too big for
+ * the vector kernels, is done one senone at a time instead.
+ */
 
+/* Mixture weight of senone sen for top-N codeword k. */
 static int32
-get_scores_8b_feat_3(s2_semi_mgau_t * s, int i,
-                     int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+get_mixw_sen(s2_semi_mgau_t * s, int i, int k, int sen)
 {
-    int32 j, l;
-    uint8 *pid_cw0, *pid_cw1, *pid_cw2;
-
-    pid_cw0 = s->mixw[i][s->f[i][0].codeword];
-    pid_cw1 = s->mixw[i][s->f[i][1].codeword];
-    pid_cw2 = s->mixw[i][s->f[i][2].codeword];
-
-    for (l = j = 0; j < n_senone_active; j++) {
-        int sen = senone_active[j] + l;
-        int32 tmp = pid_cw0[sen] + s->f[i][0].score;
-
-        tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw1[sen] + s->f[i][1].score);
-        tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw2[sen] + s->f[i][2].score);
-
-        senone_scores[sen] += tmp;
-        l = sen;
-    }
-    return 0;
+    uint8 *pid_cw = s->mixw[i][s->f[i][k].codeword];
+
+    if (s->mixw_cb == NULL)
+        return pid_cw[sen];
+    if (sen & 1)
+        return s->mixw_cb[pid_cw[sen/2] >> 4];
+    else
+        return s->mixw_cb[pid_cw[sen/2] & 0x0f];
 }
 
+/* One senone, same result as the block kernels. */
 static int32
-get_scores_8b_feat_2(s2_semi_mgau_t * s, int i,
-                     int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+get_score_sen(s2_semi_mgau_t * s, int i, int topn, int sen)
 {
-    int32 j, l;
-    uint8 *pid_cw0, *pid_cw1;
-
-    pid_cw0 = s->mixw[i][s->f[i][0].codeword];
-    pid_cw1 = s->mixw[i][s->f[i][1].codeword];
-
-    for (l = j = 0; j < n_senone_active; j++) {
-        int sen = senone_active[j] + l;
-        int32 tmp = pid_cw0[sen] + s->f[i][0].score;
+    int32 tmp, k;
 
+    tmp = get_mixw_sen(s, i, 0, sen) + s->f[i][0].score;
+    for (k = 1; k < topn; ++k)
         tmp = fast_logmath_add(s->lmath_8b, tmp,
-                               pid_cw1[sen] + s->f[i][1].score);
-
-        senone_scores[sen] += tmp;
-        l = sen;
-    }
-    return 0;
-}
-
-static int32
-get_scores_8b_feat_1(s2_semi_mgau_t * s, int i,
-                     int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
-{
-    int32 j, l;
-    uint8 *pid_cw0;
-
-    pid_cw0 = s->mixw[i][s->f[i][0].codeword];
-    for (l = j = 0; j < n_senone_active; j++) {
-        int sen = senone_active[j] + l;
-        int32 tmp = pid_cw0[sen] + s->f[i][0].score;
-        senone_scores[sen] += tmp;
-        l = sen;
-    }
-    return 0;
+                               get_mixw_sen(s, i, k, sen) + s->f[i][k].score);
+    return tmp;
 }
 
-static int32
-get_scores_8b_feat_any(s2_semi_mgau_t * s, int i, int topn,
-                       int16 *senone_scores, uint8 *senone_active,
-                       int32 n_senone_active)
-{
-    int32 j, k, l;
-
-    for (l = j = 0; j < n_senone_active; j++) {
-        int sen = senone_active[j] + l;
-        uint8 *pid_cw;
-        int32 tmp;
-        pid_cw = s->mixw[i][s->f[i][0].codeword];
-        tmp = pid_cw[sen] + s->f[i][0].score;
-        for (k = 1; k < topn; ++k) {
-            pid_cw = s->mixw[i][s->f[i][k].codeword];
-            tmp = fast_logmath_add(s->lmath_8b, tmp,
-                                   pid_cw[sen] + s->f[i][k].score);
-        }
-        senone_scores[sen] += tmp;
-        l = sen;
-    }
-    return 0;
-}
-
-static int32
-get_scores_8b_feat(s2_semi_mgau_t * s, int i, int topn,
-                   int16 *senone_scores, uint8 *senone_active, int32 n_senone_active)
+/* Set up the kernel inputs for feature i in this frame. */
+static void
+setup_blocks(s2_semi_mgau_t * s, int i, int topn)
 {
-    switch (topn) {
-    case 6:
-        return get_scores_8b_feat_6(s, i, senone_scores,
-                                    senone_active, n_senone_active);
-    case 5:
-        return get_scores_8b_feat_5(s, i, senone_scores,
-                                    senone_active, n_senone_active);
-    case 4:
-        return get_scores_8b_feat_4(s, i, senone_scores,
-                                    senone_active, n_senone_active);
-    case 3:
-        return get_scores_8b_feat_3(s, i, senone_scores,
-                                    senone_active, n_senone_active);
-    case 2:
-        return get_scores_8b_feat_2(s, i, senone_scores,
-                                    senone_active, n_senone_active);
-    case 1:
-        return get_scores_8b_feat_1(s, i, senone_scores,
-                                    senone_active, n_senone_active);
-    default:
-        return get_scores_8b_feat_any(s, i, topn, senone_scores,
-                                      senone_active, n_senone_active);
-    }
-}
+    int k, j;
 
-static int32
-get_scores_8b_feat_all(s2_semi_mgau_t * s, int i, int topn, int16 *senone_scores)
-{
-    int32 j, k;
-
-    for (j = 0; j < s->n_sen; j++) {
-        uint8 *pid_cw;
-        int32 tmp;
-        pid_cw = s->mixw[i][s->f[i][0].codeword];
-        tmp = pid_cw[j] + s->f[i][0].score;
-        for (k = 1; k < topn; ++k) {
-            pid_cw = s->mixw[i][s->f[i][k].codeword];
-            tmp = fast_logmath_add(s->lmath_8b, tmp,
-                                   pid_cw[j] + s->f[i][k].score);
+    for (k = 0; k < topn; ++k) {
+        s->topn_rows[k] = s->mixw[i][s->f[i][k].codeword];
+        s->topn_scores[k] = s->f[i][k].score;
+        if (s->mixw_cb) {
+            for (j = 0; j < 16; ++j)
+                s->w_den[k][j] = s->mixw_cb[j] + s->f[i][k].score;
         }
-        senone_scores[j] += tmp;
     }
-    return 0;
 }
 
-static int32
-get_scores_4b_feat_6(s2_semi_mgau_t * s, int i,
-                     int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+/* Score the block starting at senone sen0. */
+static void
+get_scores_block(s2_semi_mgau_t * s, int topn, int sen0, int16 *out)
 {
-    int32 j, l;
-    uint8 *pid_cw0, *pid_cw1, *pid_cw2, *pid_cw3, *pid_cw4, *pid_cw5;
-    uint8 w_den[6][16];
-
-    /* Precompute scaled densities. */
-    for (j = 0; j < 16; ++j) {
-        w_den[0][j] = s->mixw_cb[j] + s->f[i][0].score;
-        w_den[1][j] = s->mixw_cb[j] + s->f[i][1].score;
-        w_den[2][j] = s->mixw_cb[j] + s->f[i][2].score;
-        w_den[3][j] = s->mixw_cb[j] + s->f[i][3].score;
-        w_den[4][j] = s->mixw_cb[j] + s->f[i][4].score;
-        w_den[5][j] = s->mixw_cb[j] + s->f[i][5].score;
-    }
+    int k;
 
-    pid_cw0 = s->mixw[i][s->f[i][0].codeword];
-    pid_cw1 = s->mixw[i][s->f[i][1].codeword];
-    pid_cw2 = s->mixw[i][s->f[i][2].codeword];
-    pid_cw3 = s->mixw[i][s->f[i][3].codeword];
-    pid_cw4 = s->mixw[i][s->f[i][4].codeword];
-    pid_cw5 = s->mixw[i][s->f[i][5].codeword];
-
-    for (l = j = 0; j < n_senone_active; j++) {
-        int n = senone_active[j] + l;
-        int tmp, cw;
-
-        if (n & 1) {
-            cw = pid_cw0[n/2] >> 4;
-            tmp = w_den[0][cw];
-            cw = pid_cw1[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[1][cw]);
-            cw = pid_cw2[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[2][cw]);
-            cw = pid_cw3[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[3][cw]);
-            cw = pid_cw4[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[4][cw]);
-            cw = pid_cw5[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[5][cw]);
-        }
-        else {
-            cw = pid_cw0[n/2] & 0x0f;
-            tmp = w_den[0][cw];
-            cw = pid_cw1[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[1][cw]);
-            cw = pid_cw2[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[2][cw]);
-            cw = pid_cw3[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[3][cw]);
-            cw = pid_cw4[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[4][cw]);
-            cw = pid_cw5[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[5][cw]);
-        }
-        senone_scores[n] += tmp;
-        l = n;
-    }
-    return 0;
-}
-
-static int32
-get_scores_4b_feat_5(s2_semi_mgau_t * s, int i,
-                     int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
-{
-    int32 j, l;
-    uint8 *pid_cw0, *pid_cw1, *pid_cw2, *pid_cw3, *pid_cw4;
-    uint8 w_den[5][16];
-
-    /* Precompute scaled densities. */
-    for (j = 0; j < 16; ++j) {
-        w_den[0][j] = s->mixw_cb[j] + s->f[i][0].score;
-        w_den[1][j] = s->mixw_cb[j] + s->f[i][1].score;
-        w_den[2][j] = s->mixw_cb[j] + s->f[i][2].score;
-        w_den[3][j] = s->mixw_cb[j] + s->f[i][3].score;
-        w_den[4][j] = s->mixw_cb[j] + s->f[i][4].score;
+    if (s->mixw_cb) {
+        for (k = 0; k < topn; ++k)
+            s->block_rows[k] = s->topn_rows[k] + sen0 / 2;
+        mgau_simd_mixw_4b(out, s->block_rows,
+                          (uint8 const (*)[16])s->w_den,
+                          topn, s->logadd_tab);
     }
-
-    pid_cw0 = s->mixw[i][s->f[i][0].codeword];
-    pid_cw1 = s->mixw[i][s->f[i][1].codeword];
-    pid_cw2 = s->mixw[i][s->f[i][2].codeword];
-    pid_cw3 = s->mixw[i][s->f[i][3].codeword];
-    pid_cw4 = s->mixw[i][s->f[i][4].codeword];
-
-    for (l = j = 0; j < n_senone_active; j++) {
-        int n = senone_active[j] + l;
-        int tmp, cw;
-
-        if (n & 1) {
-            cw = pid_cw0[n/2] >> 4;
-            tmp = w_den[0][cw];
-            cw = pid_cw1[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[1][cw]);
-            cw = pid_cw2[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[2][cw]);
-            cw = pid_cw3[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[3][cw]);
-            cw = pid_cw4[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[4][cw]);
-        }
-        else {
-            cw = pid_cw0[n/2] & 0x0f;
-            tmp = w_den[0][cw];
-            cw = pid_cw1[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[1][cw]);
-            cw = pid_cw2[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[2][cw]);
-            cw = pid_cw3[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[3][cw]);
-            cw = pid_cw4[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[4][cw]);
-        }
-        senone_scores[n] += tmp;
-        l = n;
+    else {
+        for (k = 0; k < topn; ++k)
+            s->block_rows[k] = s->topn_rows[k] + sen0;
+        mgau_simd_mixw_8b(out, s->block_rows, s->topn_scores,
+                          topn, s->logadd_tab);
     }
-    return 0;
 }
 
+/* End of the senones that can be scored in full blocks. */
 static int32
-get_scores_4b_feat_4(s2_semi_mgau_t * s, int i,
-                     int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+block_end(s2_semi_mgau_t * s)
 {
-    int32 j, l;
-    uint8 *pid_cw0, *pid_cw1, *pid_cw2, *pid_cw3;
-    uint8 w_den[4][16];
-
-    /* Precompute scaled densities. */
-    for (j = 0; j < 16; ++j) {
-        w_den[0][j] = s->mixw_cb[j] + s->f[i][0].score;
-        w_den[1][j] = s->mixw_cb[j] + s->f[i][1].score;
-        w_den[2][j] = s->mixw_cb[j] + s->f[i][2].score;
-        w_den[3][j] = s->mixw_cb[j] + s->f[i][3].score;
-    }
-
-    pid_cw0 = s->mixw[i][s->f[i][0].codeword];
-    pid_cw1 = s->mixw[i][s->f[i][1].codeword];
-    pid_cw2 = s->mixw[i][s->f[i][2].codeword];
-    pid_cw3 = s->mixw[i][s->f[i][3].codeword];
-
-    for (l = j = 0; j < n_senone_active; j++) {
-        int n = senone_active[j] + l;
-        int tmp, cw;
-
-        if (n & 1) {
-            cw = pid_cw0[n/2] >> 4;
-            tmp = w_den[0][cw];
-            cw = pid_cw1[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[1][cw]);
-            cw = pid_cw2[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[2][cw]);
-            cw = pid_cw3[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[3][cw]);
-        }
-        else {
-            cw = pid_cw0[n/2] & 0x0f;
-            tmp = w_den[0][cw];
-            cw = pid_cw1[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[1][cw]);
-            cw = pid_cw2[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[2][cw]);
-            cw = pid_cw3[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[3][cw]);
-        }
-        senone_scores[n] += tmp;
-        l = n;
-    }
-    return 0;
+    if (!s->simd_mixw)
+        return 0;
+    return s->n_sen & ~(MGAU_SIMD_SEN_BLOCK - 1);
 }
 
 static int32
-get_scores_4b_feat_3(s2_semi_mgau_t * s, int i,
-                     int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+get_scores_feat(s2_semi_mgau_t * s, int i, int topn,
+                int16 *senone_scores, uint8 *senone_active,
+                int32 n_senone_active)
 {
-    int32 j, l;
-    uint8 *pid_cw0, *pid_cw1, *pid_cw2;
-    uint8 w_den[3][16];
-
-    /* Precompute scaled densities. */
-    for (j = 0; j < 16; ++j) {
-        w_den[0][j] = s->mixw_cb[j] + s->f[i][0].score;
-        w_den[1][j] = s->mixw_cb[j] + s->f[i][1].score;
-        w_den[2][j] = s->mixw_cb[j] + s->f[i][2].score;
-    }
-
-    pid_cw0 = s->mixw[i][s->f[i][0].codeword];
-    pid_cw1 = s->mixw[i][s->f[i][1].codeword];
-    pid_cw2 = s->mixw[i][s->f[i][2].codeword];
-
+    int16 block[MGAU_SIMD_SEN_BLOCK];
+    int32 j, l, sen0, end;
+
+    if (topn < 1)
+        topn = 1;
+    end = block_end(s);
+    setup_blocks(s, i, topn);
+    /* Active senones are sorted, so each block is scored only once,
+     * when the first senone in it comes up. */
+    sen0 = -MGAU_SIMD_SEN_BLOCK;
     for (l = j = 0; j < n_senone_active; j++) {
-        int n = senone_active[j] + l;
-        int tmp, cw;
-
-        if (n & 1) {
-            cw = pid_cw0[n/2] >> 4;
-            tmp = w_den[0][cw];
-            cw = pid_cw1[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[1][cw]);
-            cw = pid_cw2[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[2][cw]);
-        }
-        else {
-            cw = pid_cw0[n/2] & 0x0f;
-            tmp = w_den[0][cw];
-            cw = pid_cw1[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[1][cw]);
-            cw = pid_cw2[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[2][cw]);
-        }
-        senone_scores[n] += tmp;
-        l = n;
-    }
-    return 0;
-}
-
-static int32
-get_scores_4b_feat_2(s2_semi_mgau_t * s, int i,
-                     int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
-{
-    int32 j, l;
-    uint8 *pid_cw0, *pid_cw1;
-    uint8 w_den[2][16];
-
-    /* Precompute scaled densities. */
-    for (j = 0; j < 16; ++j) {
-        w_den[0][j] = s->mixw_cb[j] + s->f[i][0].score;
-        w_den[1][j] = s->mixw_cb[j] + s->f[i][1].score;
-    }
-
-    pid_cw0 = s->mixw[i][s->f[i][0].codeword];
-    pid_cw1 = s->mixw[i][s->f[i][1].codeword];
+        int sen = senone_active[j] + l;
 
-    for (l = j = 0; j < n_senone_active; j++) {
-        int n = senone_active[j] + l;
-        int tmp, cw;
-
-        if (n & 1) {
-            cw = pid_cw0[n/2] >> 4;
-            tmp = w_den[0][cw];
-            cw = pid_cw1[n/2] >> 4;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[1][cw]);
-        }
-        else {
-            cw = pid_cw0[n/2] & 0x0f;
-            tmp = w_den[0][cw];
-            cw = pid_cw1[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp, w_den[1][cw]);
+        if (sen < end) {
+            if (sen - sen0 >= MGAU_SIMD_SEN_BLOCK) {
+                sen0 = sen & ~(MGAU_SIMD_SEN_BLOCK - 1);
+                get_scores_block(s, topn, sen0, block);
+            }
+            senone_scores[sen] += block[sen - sen0];
         }
-        senone_scores[n] += tmp;
-        l = n;
+        else
+            senone_scores[sen] += get_score_sen(s, i, topn, sen);
+        l = sen;
     }
     return 0;
 }
 
 static int32
-get_scores_4b_feat_1(s2_semi_mgau_t * s, int i,
-                     int16 *senone_scores, uint8 *senone_active,
-                     int32 n_senone_active)
+get_scores_feat_all(s2_semi_mgau_t * s, int i, int topn, int16 *senone_scores)
 {
-    int32 j, l;
-    uint8 *pid_cw0;
-    uint8 w_den[16];
-
-    /* Precompute scaled densities. */
-    for (j = 0; j < 16; ++j) {
-        w_den[j] = s->mixw_cb[j] + s->f[i][0].score;
-    }
-
-    pid_cw0 = s->mixw[i][s->f[i][0].codeword];
-
-    for (l = j = 0; j < n_senone_active; j++) {
-        int n = senone_active[j] + l;
-        int tmp, cw;
-
-        if (n & 1) {
-            cw = pid_cw0[n/2] >> 4;
-            tmp = w_den[cw];
-        }
-        else {
-            cw = pid_cw0[n/2] & 0x0f;
-            tmp = w_den[cw];
-        }
-        senone_scores[n] += tmp;
-        l = n;
-    }
+    int16 block[MGAU_SIMD_SEN_BLOCK];
+    int32 j, sen0, end;
+
+    if (topn < 1)
+        topn = 1;
+    end = block_end(s);
+    setup_blocks(s, i, topn);
+    for (sen0 = 0; sen0 < end; sen0 += MGAU_SIMD_SEN_BLOCK) {
+        get_scores_block(s, topn, sen0, block);
+        for (j = 0; j < MGAU_SIMD_SEN_BLOCK; ++j)
+            senone_scores[sen0 + j] += block[j];
+    }
+    for (j = end; j < s->n_sen; ++j)
+        senone_scores[j] += get_score_sen(s, i, topn, j);
     return 0;
 }
 
-static int32
-get_scores_4b_feat_any(s2_semi_mgau_t * s, int i, int topn,
-                       int16 *senone_scores, uint8 *senone_active,
-                       int32 n_senone_active)
-{
-    int32 j, k, l;
-
-    for (l = j = 0; j < n_senone_active; j++) {
-        int n = senone_active[j] + l;
-        int tmp, cw;
-        uint8 *pid_cw;
-    
-        pid_cw = s->mixw[i][s->f[i][0].codeword];
-        if (n & 1)
-            cw = pid_cw[n/2] >> 4;
-        else
-            cw = pid_cw[n/2] & 0x0f;
-        tmp = s->mixw_cb[cw] + s->f[i][0].score;
-        for (k = 1; k < topn; ++k) {
-            pid_cw = s->mixw[i][s->f[i][k].codeword];
-            if (n & 1)
-                cw = pid_cw[n/2] >> 4;
-            else
-                cw = pid_cw[n/2] & 0x0f;
-            tmp = fast_logmath_add(s->lmath_8b, tmp,
-                                   s->mixw_cb[cw] + s->f[i][k].score);
-        }
-        senone_scores[n] += tmp;
-        l = n;
-    }
-    return 0;
-}
+/**
+ * Work shared with the scoring threads for one frame.
+ */
+typedef struct s2_job_s {
+    s2_semi_mgau_t *s;
+    mfcc_t **featbuf;
+    int32 frame;
+    int topn_idx;
+} s2_job_t;
 
-static int32
-get_scores_4b_feat(s2_semi_mgau_t * s, int i, int topn,
-                   int16 *senone_scores, uint8 *senone_active, int32 n_senone_active)
+/* There's a single codebook per feature stream, so streams are the
+ * only thing that can be split up. */
+static void
+feat_eval_range(void *arg, int start, int end, int worker)
 {
-    switch (topn) {
-    case 6:
-        return get_scores_4b_feat_6(s, i, senone_scores,
-                                    senone_active, n_senone_active);
-    case 5:
-        return get_scores_4b_feat_5(s, i, senone_scores,
-                                    senone_active, n_senone_active);
-    case 4:
-        return get_scores_4b_feat_4(s, i, senone_scores,
-                                    senone_active, n_senone_active);
-    case 3:
-        return get_scores_4b_feat_3(s, i, senone_scores,
-                                    senone_active, n_senone_active);
-    case 2:
-        return get_scores_4b_feat_2(s, i, senone_scores,
-                                    senone_active, n_senone_active);
-    case 1:
-        return get_scores_4b_feat_1(s, i, senone_scores,
-                                    senone_active, n_senone_active);
-    default:
-        return get_scores_4b_feat_any(s, i, topn, senone_scores,
-                                      senone_active, n_senone_active);
-    }
-}
+    s2_job_t *job = (s2_job_t *)arg;
+    s2_semi_mgau_t *s = job->s;
+    vqFeature_t **lastf;
+    int i;
 
-static int32
-get_scores_4b_feat_all(s2_semi_mgau_t * s, int i, int topn, int16 *senone_scores)
-{
-    int j, last_sen;
-
-    j = 0;
-    /* Number of senones is always even, but don't overrun if it isn't. */
-    last_sen = s->n_sen & ~1;
-    while (j < last_sen) {
-        uint8 *pid_cw;
-        int32 tmp0, tmp1;
-        int k;
-
-        pid_cw = s->mixw[i][s->f[i][0].codeword];
-        tmp0 = s->mixw_cb[pid_cw[j/2] & 0x0f] + s->f[i][0].score;
-        tmp1 = s->mixw_cb[pid_cw[j/2] >> 4] + s->f[i][0].score;
-        for (k = 1; k < topn; ++k) {
-            int32 w_den0, w_den1;
-
-            pid_cw = s->mixw[i][s->f[i][k].codeword];
-            w_den0 = s->mixw_cb[pid_cw[j/2] & 0x0f] + s->f[i][k].score;
-            w_den1 = s->mixw_cb[pid_cw[j/2] >> 4] + s->f[i][k].score;
-            tmp0 = fast_logmath_add(s->lmath_8b, tmp0, w_den0);
-            tmp1 = fast_logmath_add(s->lmath_8b, tmp1, w_den1);
-        }
-        senone_scores[j++] += tmp0;
-        senone_scores[j++] += tmp1;
+    (void)worker;
+    if (job->topn_idx == 0)
+        lastf = s->topn_hist[s->n_topn_hist-1];
+    else
+        lastf = s->topn_hist[job->topn_idx-1];
+    for (i = start; i < end; ++i) {
+        memcpy(s->f[i], lastf[i], sizeof(vqFeature_t) * s->max_topn);
+        mgau_dist(s, job->frame, i, job->featbuf[i]);
+        s->topn_hist_n[job->topn_idx][i] = mgau_norm(s, i);
     }
-    return 0;
 }
 
 /*
@@ -842,42 +361,71 @@ s2_semi_mgau_frame_eval(ps_mgau_t *ps,
 			int32 compallsen)
 {
     s2_semi_mgau_t *s = (s2_semi_mgau_t *)ps;
-    int i, topn_idx;
+    int i, topn_idx, fresh = TRUE;
     int n_feat = s->g->n_feat;
 
-    memset(senone_scores, 0, s->n_sen * sizeof(*senone_scores));
     /* No bounds checking is done here, which just means you'll get
      * semi-random crap if you request a frame in the future or one
      * that's too far in the past. */
     topn_idx = frame % s->n_topn_hist;
     s->f = s->topn_hist[topn_idx];
-    for (i = 0; i < n_feat; ++i) {
-        /* For past frames this will already be computed. */
-        if (frame >= ps_mgau_base(ps)->frame_idx) {
-            vqFeature_t **lastf;
-            if (topn_idx == 0)
-                lastf = s->topn_hist[s->n_topn_hist-1];
-            else
-                lastf = s->topn_hist[topn_idx-1];
-            memcpy(s->f[i], lastf[i], sizeof(vqFeature_t) * s->max_topn);
-            mgau_dist(s, frame, i, featbuf[i]);
-            s->topn_hist_n[topn_idx][i] = mgau_norm(s, i);
-        }
-        if (s->mixw_cb) {
-            if (compallsen)
-                get_scores_4b_feat_all(s, i, s->topn_hist_n[topn_idx][i], senone_scores);
-            else
-                get_scores_4b_feat(s, i, s->topn_hist_n[topn_idx][i], senone_scores,
-                                   senone_active, n_senone_active);
+    /* For past frames this will already be computed. */
+    if (frame >= ps_mgau_base(ps)->frame_idx) {
+        int last_idx = (topn_idx + s->n_topn_hist - 1) % s->n_topn_hist;
+
+        /* If the input hasn't changed much, keep the previous
+         * frame's top-N. */
+        if (s->ds && mgau_ds_update(s->ds, featbuf[0], frame, TRUE)) {
+            for (i = 0; i < n_feat; ++i) {
+                memcpy(s->f[i], s->topn_hist[last_idx][i],
+                       sizeof(vqFeature_t) * s->max_topn);
+                s->topn_hist_n[topn_idx][i] = s->topn_hist_n[last_idx][i];
+            }
+            s->topn_hist_epoch[topn_idx] = s->topn_hist_epoch[last_idx];
         }
         else {
-            if (compallsen)
-                get_scores_8b_feat_all(s, i, s->topn_hist_n[topn_idx][i], senone_scores);
-            else
-                get_scores_8b_feat(s, i, s->topn_hist_n[topn_idx][i], senone_scores,
-                                   senone_active, n_senone_active);
+            s2_job_t job;
+
+            job.s = s;
+            job.featbuf = featbuf;
+            job.frame = frame;
+            job.topn_idx = topn_idx;
+            mgau_pool_run(ps->pool, feat_eval_range, &job, n_feat);
+            if (s->ds)
+                s->topn_hist_epoch[topn_idx] = mgau_ds_epoch(s->ds);
+        }
+    }
+    /* Keep the scores from earlier frames with the same top-N, and
+     * only clear the ones that are about to be summed up again. */
+    if (s->ds) {
+        if (compallsen) {
+            senone_active = NULL;
+            n_senone_active = s->n_sen;
+        }
+        n_senone_active = mgau_ds_todo(s->ds, s->topn_hist_epoch[topn_idx],
+                                       &senone_active, n_senone_active,
+                                       &fresh);
+        compallsen = FALSE;
+        if (!fresh) {
+            int32 l, sen;
+            for (l = i = 0; i < n_senone_active; ++i) {
+                sen = senone_active[i] + l;
+                senone_scores[sen] = 0;
+                l = sen;
+            }
         }
     }
+    if (fresh)
+        memset(senone_scores, 0, s->n_sen * sizeof(*senone_scores));
+    /* Senone scores are summed over streams, so do that here. */
+    for (i = 0; i < n_feat; ++i) {
+        if (compallsen)
+            get_scores_feat_all(s, i, s->topn_hist_n[topn_idx][i],
+                                senone_scores);
+        else
+            get_scores_feat(s, i, s->topn_hist_n[topn_idx][i],
+                            senone_scores, senone_active, n_senone_active);
+    }
 
     return 0;
 }
@@ -1248,6 +796,8 @@ s2_semi_mgau_init(acmod_t *acmod)
                 logmath_get_base(s->lmath_8b));
         goto error_out;
     }
+    /* The vector mixture weight kernels only take a short table. */
+    s->simd_mixw = mgau_simd_logadd_table(s->lmath_8b, s->logadd_tab);
 
     /* Read means and variances. */
     if ((s->g = gauden_init(ps_config_str(s->config, "mean"),
@@ -1290,6 +840,7 @@ s2_semi_mgau_init(acmod_t *acmod)
         }
     }
     s->ds_ratio = ps_config_int(s->config, "ds");
+    s->ds = mgau_ds_init(s->config, s->g->featlen[0], s->n_sen);
 
     /* Determine top-N for each feature */
     s->topn_beam = ckd_calloc(n_feat, sizeof(*s->topn_beam));
@@ -1301,6 +852,10 @@ s2_semi_mgau_init(acmod_t *acmod)
         E_INFOCONT(" %d", s->topn_beam[i]);
     }
     E_INFOCONT("\n");
+    s->topn_rows = ckd_calloc(s->max_topn, sizeof(*s->topn_rows));
+    s->block_rows = ckd_calloc(s->max_topn, sizeof(*s->block_rows));
+    s->topn_scores = ckd_calloc(s->max_topn, sizeof(*s->topn_scores));
+    s->w_den = ckd_calloc(s->max_topn, sizeof(*s->w_den));
 
     /* Top-N scores from recent frames */
     s->n_topn_hist = ps_config_int(s->config, "pl_window") + 2;
@@ -1309,6 +864,8 @@ s2_semi_mgau_init(acmod_t *acmod)
                       sizeof(***s->topn_hist));
     s->topn_hist_n = ckd_calloc_2d(s->n_topn_hist, n_feat,
                                    sizeof(**s->topn_hist_n));
+    s->topn_hist_epoch = ckd_calloc(s->n_topn_hist,
+                                    sizeof(*s->topn_hist_epoch));
     for (i = 0; i < s->n_topn_hist; ++i) {
         int j;
         for (j = 0; j < n_feat; ++j) {
@@ -1354,7 +911,13 @@ s2_semi_mgau_free(ps_mgau_t *ps)
     }
     gauden_free(s->g);
     ckd_free(s->topn_beam);
+    ckd_free(s->topn_rows);
+    ckd_free(s->block_rows);
+    ckd_free(s->topn_scores);
+    ckd_free(s->w_den);
     ckd_free_2d(s->topn_hist_n);
     ckd_free_3d((void **)s->topn_hist);
+    ckd_free(s->topn_hist_epoch);
+    mgau_ds_free(s->ds);
     ckd_free(s);
 }
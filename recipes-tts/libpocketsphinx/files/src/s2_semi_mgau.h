@@ -50,6 +50,8 @@
 #include "hmm.h"
 #include "bin_mdef.h"
 #include "ms_gauden.h"
+#include "mgau_simd.h"
+#include "mgau_ds.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -75,12 +77,22 @@ struct s2_semi_mgau_s {
     uint8 *topn_beam;   /* Beam for determining per-frame top-N densities */
     int16 max_topn;
     int16 ds_ratio;
+    mgau_ds_t *ds;      /**< Adaptive downsampling, or NULL. */
 
     vqFeature_t ***topn_hist; /**< Top-N scores and codewords for past frames. */
     uint8 **topn_hist_n;      /**< Variable top-N for past frames. */
+    int32 *topn_hist_epoch;   /**< Adaptive downsampling epoch of past frames. */
     vqFeature_t **f;          /**< Topn-N for currently scoring frame. */
     int n_topn_hist;          /**< Number of past frames tracked. */
 
+    /* Inputs to the mixture weight kernels for the current stream. */
+    uint8 const **topn_rows;  /**< Mixture weights for each top-N codeword. */
+    uint8 const **block_rows; /**< Same, offset to the current block. */
+    int32 *topn_scores;       /**< Score of each top-N codeword. */
+    uint8 (*w_den)[16];       /**< 4-bit only: mixw_cb plus each score. */
+    uint8 logadd_tab[MGAU_SIMD_LOGADD_SIZE]; /**< Start of lmath_8b's table. */
+    int simd_mixw;            /**< Whether logadd_tab is usable. */
+
     /* Log-add table for compressed values. */
     logmath_t *lmath_8b;
     /* Log-add object for reloading means/variances. */
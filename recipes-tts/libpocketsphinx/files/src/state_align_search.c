@@ -423,6 +423,7 @@ static ps_searchfuncs_t state_align_search_funcs = {
     /* hyp: */      state_align_search_hyp,
     /* prob: */     NULL,
     /* seg_iter: */ state_align_search_seg_iter,
+    /* stable_seg_iter: */ NULL,
 };
 
 ps_search_t *
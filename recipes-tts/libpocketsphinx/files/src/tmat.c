@@ -45,6 +45,7 @@
 
 #include "tmat.h"
 #include "hmm.h"
+#include "model_cache.h"
 
 #define TMAT_PARAM_VERSION		"1.0"
 
@@ -149,6 +150,7 @@ tmat_init(char const *file_name, logmath_t *lmath, float64 tpfloor, int32 brepor
     }
 
     t = (tmat_t *) ckd_calloc(1, sizeof(tmat_t));
+    t->refcnt = 1;
 
     if ((fp = fopen(file_name, "rb")) == NULL)
         E_FATAL_SYSTEM("Failed to open transition file '%s' for reading", file_name);
@@ -267,15 +269,27 @@ tmat_report(tmat_t * t)
 
 }
 
+tmat_t *
+tmat_retain(tmat_t *t)
+{
+    model_cache_ref(t->refcnt);
+    return t;
+}
+
 /* 
  *  RAH, Free memory allocated in tmat_init ()
  */
-void
+int
 tmat_free(tmat_t * t)
 {
-    if (t) {
-        if (t->tp)
-            ckd_free_3d(t->tp);
-        ckd_free(t);
-    }
+    int rc;
+
+    if (t == NULL)
+        return 0;
+    if ((rc = model_cache_unref(t->refcnt)) > 0)
+        return rc;
+    if (t->tp)
+        ckd_free_3d(t->tp);
+    ckd_free(t);
+    return 0;
 }
@@ -62,6 +62,7 @@ typedef struct tmat_s {
     int16 n_tmat;	/**< Number matrices */
     int16 n_state;	/**< Number source states in matrix (only the emitting states);
 			   Number destination states = n_state+1, it includes the exit state */
+    int refcnt;         /**< Reference count */
 } tmat_t;
 
 
@@ -83,10 +84,15 @@ void tmat_dump (tmat_t *tmat,  /**< In: transition matrix */
 
 
 /**
- * RAH, add code to remove memory allocated by tmat_init
+ * Retain a pointer to a transition matrix.
  */
+tmat_t *tmat_retain(tmat_t *t);
 
-void tmat_free (tmat_t *t /**< In: transition matrix */
+/**
+ * RAH, add code to remove memory allocated by tmat_init
+ * @return new reference count (0 if freed completely)
+ */
+int tmat_free (tmat_t *t /**< In: transition matrix */
     );
 
 /**
@@ -106,6 +106,46 @@
 static jmp_buf *ckd_target;
 static int jmp_abort;
 
+/**
+ * Allocation counter for profiling.  It is per-thread, so that
+ * decoders (and scoring workers) in other threads don't show up in
+ * each other's counts, and only kept while someone is profiling.
+ */
+#if defined(__GNUC__)
+static __thread int64 ckd_n_alloc;
+#elif defined(_MSC_VER)
+static __declspec(thread) int64 ckd_n_alloc;
+#else
+static int64 ckd_n_alloc;
+#endif
+static int32 ckd_n_counting;
+#if defined(__GNUC__)
+#define ckd_counting() __atomic_load_n(&ckd_n_counting, __ATOMIC_RELAXED)
+#else
+#define ckd_counting() ckd_n_counting
+#endif
+#define ckd_count_alloc()                       \
+    do {                                        \
+        if (ckd_counting())                     \
+            ++ckd_n_alloc;                      \
+    } while (0)
+
+void
+ckd_alloc_count_enable(int enable)
+{
+#if defined(__GNUC__)
+    __atomic_fetch_add(&ckd_n_counting, enable ? 1 : -1, __ATOMIC_RELAXED);
+#else
+    ckd_n_counting += enable ? 1 : -1;
+#endif
+}
+
+int64
+ckd_alloc_count(void)
+{
+    return ckd_n_alloc;
+}
+
 jmp_buf *
 ckd_set_jump(jmp_buf *env, int abort)
 {
@@ -161,7 +201,7 @@ __ckd_calloc__(size_t n_elem, size_t elem_size,
 	}
 #endif
 
-
+    ckd_count_alloc();
     return mem;
 }
 
@@ -180,6 +220,7 @@ __ckd_malloc__(size_t size, const char *caller_file, int caller_line)
 	        ckd_fail("malloc(%d) failed from %s(%d)\n", size,
                 caller_file, caller_line);
 
+    ckd_count_alloc();
     return mem;
 }
 
@@ -198,6 +239,7 @@ __ckd_realloc__(void *ptr, size_t new_size,
                 caller_file, caller_line);
     }
 
+    ckd_count_alloc();
     return mem;
 }
 
@@ -235,6 +235,22 @@ void ckd_free_4d(void *ptr);
  * One should use these, rather than target functions directly.
  */
 
+/**
+ * Start (or stop) counting allocations for ckd_alloc_count().  Calls
+ * nest, counting goes on until every enable has been matched by a
+ * disable.
+ */
+POCKETSPHINX_EXPORT
+void ckd_alloc_count_enable(int enable);
+
+/**
+ * Number of allocations made by the calling thread through
+ * ckd_malloc(), ckd_calloc() and ckd_realloc() (and everything built
+ * on them) while counting was enabled.
+ */
+POCKETSPHINX_EXPORT
+int64 ckd_alloc_count(void);
+
 /**
  * Macro for __ckd_calloc__
  */
@@ -0,0 +1,250 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/**
+ * @file test_fe_simd.c
+ * @brief Check the vectorized FFT and dot product against the scalar code.
+ *
+ * This includes fe_sigproc.c directly so that its static functions
+ * can be called.  On random inputs:
+ *
+ *  - fe_fft_butterflies_x2() followed by fe_fft_butterflies() for the
+ *    leftover has to give the same group of complex butterflies as
+ *    fe_fft_butterflies() alone, for every stage of FFTs of 8 to 1024
+ *    points.  It does the same operations in the same order, so this
+ *    is exact unless the compiler fuses the scalar multiply-adds,
+ *    which is allowed within a few DBL_EPSILON of the inputs.
+ *  - fe_fft_real() has to agree with a plain DFT within
+ *    log2(n) * 4 * DBL_EPSILON of the sum of the input magnitudes.
+ *  - fe_dot() adds in a different order from the scalar loop, so it
+ *    has to agree within (n + 1) * DBL_EPSILON of the sum of the
+ *    magnitudes of the products, for every length up to a few vectors.
+ *
+ * There is nothing to check in fixed-point builds.  Returns non-zero
+ * on any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+
+#include "../src/fe/fe_sigproc.c"
+
+#define N_TRIALS 200
+#define MAX_LEN 67
+#define MIN_ORDER 3
+#define MAX_ORDER 10
+
+static uint32 rng_state = 12345;
+
+static uint32
+rng(void)
+{
+    /* Numerical Recipes LCG, plenty for this and the same everywhere. */
+    rng_state = rng_state * 1664525 + 1013904223;
+    return rng_state >> 8;
+}
+
+#ifndef FIXED_POINT
+static double
+rng_double(double lo, double hi)
+{
+    return lo + (hi - lo) * (rng() / (double)(1 << 24));
+}
+
+/* Just enough of a front end to run the FFT. */
+static void
+init_fft(fe_t *fe, int order)
+{
+    memset(fe, 0, sizeof(*fe));
+    fe->fft_order = order;
+    fe->fft_size = 1 << order;
+    fe->ccc = ckd_calloc(fe->fft_size / 2, sizeof(*fe->ccc));
+    fe->sss = ckd_calloc(fe->fft_size / 2, sizeof(*fe->sss));
+    fe->fft_bitrev = ckd_calloc(fe->fft_size, sizeof(*fe->fft_bitrev));
+    fe->frame = ckd_calloc(fe->fft_size, sizeof(*fe->frame));
+    fe_create_twiddle(fe);
+}
+
+static void
+free_fft(fe_t *fe)
+{
+    ckd_free(fe->ccc);
+    ckd_free(fe->sss);
+    ckd_free(fe->fft_bitrev);
+    ckd_free(fe->frame);
+}
+
+#if defined(FE_SIMD_SSE2) || defined(FE_SIMD_NEON)
+static int
+check_butterflies(void)
+{
+    frame_t ref[1 << MAX_ORDER], out[1 << MAX_ORDER];
+    int order, n_bad = 0, n_cases = 0, n_exact = 0;
+
+    for (order = MIN_ORDER; order <= MAX_ORDER; ++order) {
+        fe_t fe;
+        int trial, k, n;
+
+        init_fft(&fe, order);
+        n = fe.fft_size;
+        for (trial = 0; trial < N_TRIALS; ++trial) {
+            for (k = 2; k < order; ++k) {
+                int n2 = k, n4 = k - 1, i, j;
+                double mag = 0, tol;
+
+                for (i = 0; i < n; ++i) {
+                    ref[i] = out[i] = rng_double(-1e4, 1e4);
+                    if (fabs(ref[i]) > mag)
+                        mag = fabs(ref[i]);
+                }
+                /* Every group of the stage starts at a multiple of
+                 * 1 << (k + 1); just do the last one. */
+                i = n - (1 << (k + 1));
+                fe_fft_butterflies(ref, i, n2, n4, fe.ccc, fe.sss, 1);
+                j = fe_fft_butterflies_x2(out, i, n2, n4, fe.ccc, fe.sss);
+                fe_fft_butterflies(out, i, n2, n4, fe.ccc, fe.sss, j);
+
+                tol = 4 * DBL_EPSILON * mag;
+                if (memcmp(ref, out, n * sizeof(*ref)) == 0)
+                    ++n_exact;
+                for (i = 0; i < n; ++i) {
+                    if (fabs(ref[i] - out[i]) > tol) {
+                        if (n_bad++ < 10)
+                            printf("butterflies n=%d k=%d [%d]: "
+                                   "%.17g != %.17g\n",
+                                   n, k, i, out[i], ref[i]);
+                        break;
+                    }
+                }
+                ++n_cases;
+            }
+        }
+        free_fft(&fe);
+    }
+    printf("butterflies: %d cases, %d exact, %d bad\n",
+           n_cases, n_exact, n_bad);
+
+    return n_bad;
+}
+#endif /* FE_SIMD_SSE2 || FE_SIMD_NEON */
+
+static int
+check_fft(void)
+{
+    double in[1 << MAX_ORDER];
+    int order, n_bad = 0, n_cases = 0;
+
+    for (order = MIN_ORDER; order <= MAX_ORDER; ++order) {
+        fe_t fe;
+        int trial, n;
+
+        init_fft(&fe, order);
+        n = fe.fft_size;
+        for (trial = 0; trial < N_TRIALS / 10; ++trial) {
+            double mag = 0, tol;
+            int i, j;
+
+            for (i = 0; i < n; ++i) {
+                in[i] = fe.frame[i] = rng_double(-32768, 32767);
+                mag += fabs(in[i]);
+            }
+            fe_fft_real(&fe);
+
+            /* Real parts come first, then the imaginary ones
+             * backwards. */
+            tol = order * 4 * DBL_EPSILON * mag;
+            for (j = 0; j <= n / 2; ++j) {
+                long double re = 0, im = 0;
+
+                /* Keep the angles small, so the reference is
+                 * accurate. */
+                for (i = 0; i < n; ++i) {
+                    double a = 2 * M_PI * ((i * j) % n) / n;
+                    re += in[i] * cos(a);
+                    im -= in[i] * sin(a);
+                }
+                if (fabs(fe.frame[j] - (double)re) > tol
+                    || (j > 0 && j < n / 2
+                        && fabs(fe.frame[n - j] - (double)im) > tol)) {
+                    if (n_bad++ < 10)
+                        printf("fft n=%d bin %d: %.17g%+.17gi != "
+                               "%.17g%+.17gi\n", n, j, fe.frame[j],
+                               (j > 0 && j < n / 2) ? fe.frame[n - j] : 0,
+                               (double)re, (double)im);
+                    break;
+                }
+            }
+            ++n_cases;
+        }
+        free_fft(&fe);
+    }
+    printf("fft: %d cases, %d bad\n", n_cases, n_bad);
+
+    return n_bad;
+}
+
+static int
+check_dot(void)
+{
+    /* One extra element so the vectors can start unaligned. */
+    powspec_t x_buf[MAX_LEN + 1];
+    mfcc_t w_buf[MAX_LEN + 1];
+    int trial, len, n_bad = 0, n_cases = 0;
+
+    for (trial = 0; trial < N_TRIALS * 10; ++trial) {
+        for (len = 0; len <= MAX_LEN; ++len) {
+            powspec_t *x = x_buf + (trial & 1);
+            mfcc_t *w = w_buf + ((trial >> 1) & 1);
+            double ref = 0, mag = 0, out, tol;
+            int j;
+
+            for (j = 0; j < len; ++j) {
+                /* Power spectra and filter weights, or log
+                 * spectra and DCT coefficients. */
+                if (trial & 4) {
+                    x[j] = rng_double(0, 1e10);
+                    w[j] = (mfcc_t)rng_double(0, 1);
+                }
+                else {
+                    x[j] = rng_double(-100, 100);
+                    w[j] = (mfcc_t)rng_double(-1, 1);
+                }
+                ref += x[j] * w[j];
+                mag += fabs(x[j] * w[j]);
+            }
+            out = fe_dot(x, w, len);
+            tol = (len + 1) * DBL_EPSILON * mag;
+            if (fabs(out - ref) > tol && n_bad++ < 10)
+                printf("dot len=%d: %.17g != %.17g\n", len, out, ref);
+            ++n_cases;
+        }
+    }
+    printf("dot: %d cases, %d bad\n", n_cases, n_bad);
+
+    return n_bad;
+}
+#endif /* !FIXED_POINT */
+
+int
+main(int argc, char *argv[])
+{
+    int n_bad = 0;
+
+    (void)argc;
+    (void)argv;
+#ifdef FIXED_POINT
+    (void)rng;
+    printf("Fixed-point build, nothing to compare\n");
+#else
+#if defined(FE_SIMD_SSE2) || defined(FE_SIMD_NEON)
+    n_bad += check_butterflies();
+#else
+    printf("No vectorized kernels built, checking the scalar code only\n");
+#endif
+    n_bad += check_fft();
+    n_bad += check_dot();
+#endif
+    printf("%s\n", n_bad ? "FAILED" : "PASSED");
+
+    return n_bad != 0;
+}
@@ -0,0 +1,198 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/**
+ * @file test_hmm_simd.c
+ * @brief Check hmm_vit_eval_batch() against hmm_vit_eval().
+ *
+ * This includes hmm.c directly so that it is the one being tested
+ * whatever the library was built with.  Lists of 1 to 13 HMMs, mixing
+ * non-multiplex 3-state ones (which go through the vector blocks,
+ * whole and partial) with multiplex and 5-state ones (which don't),
+ * are made up with random transition matrices, some with the skips
+ * turned off, random senone scores, and state scores that are dead,
+ * close to the floor or anywhere in between.  Each list is copied and
+ * run for a few frames, one copy through hmm_vit_eval() and the other
+ * through hmm_vit_eval_batch().  Everything is integer, so every HMM
+ * and the best score have to come out identical.
+ *
+ * Returns non-zero on any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/hmm.c"
+
+#define N_TRIALS 50000
+#define N_FRAMES 8
+#define MAX_HMM 13
+#define N_TMAT 16
+#define N_SSEQ 64
+#define N_SEN 256
+
+static uint32 rng_state = 12345;
+
+static uint32
+rng(void)
+{
+    /* Numerical Recipes LCG, plenty for this and the same everywhere. */
+    rng_state = rng_state * 1664525 + 1013904223;
+    return rng_state >> 8;
+}
+
+static int
+rng_range(int lo, int hi)
+{
+    return lo + (int)(rng() % (uint32)(hi - lo + 1));
+}
+
+/* Left-to-right with optional skips, like tmat.c would load. */
+static uint8 ***
+random_tmat(int n_emit)
+{
+    uint8 ***tp;
+    int t, i, j;
+
+    tp = (uint8 ***)ckd_calloc_3d(N_TMAT, n_emit, n_emit + 1, 1);
+    for (t = 0; t < N_TMAT; ++t) {
+        for (i = 0; i < n_emit; ++i) {
+            for (j = 0; j <= n_emit; ++j) {
+                if (j < i || j > i + 2)
+                    tp[t][i][j] = 255;
+                else if (j == i + 2 && rng_range(0, 2) == 0)
+                    tp[t][i][j] = 255;
+                else
+                    tp[t][i][j] = rng_range(0, 254);
+            }
+        }
+    }
+    return tp;
+}
+
+static int32
+random_score(void)
+{
+    switch (rng_range(0, 3)) {
+    case 0:
+        return WORST_SCORE;
+    case 1:
+        return WORST_SCORE + rng_range(0, 40000);
+    default:
+        return -rng_range(0, 200000);
+    }
+}
+
+static void
+random_hmm(hmm_context_t *ctx3, hmm_context_t *ctx5, hmm_t *h)
+{
+    int kind = rng_range(0, 3), i;
+
+    /* Half of them non-multiplex 3-state, to fill the blocks. */
+    if (kind < 2)
+        hmm_init(ctx3, h, FALSE, rng_range(0, N_SSEQ - 1),
+                 rng_range(0, N_TMAT - 1));
+    else
+        hmm_init(kind == 2 ? ctx3 : ctx5, h, rng_range(0, 1),
+                 rng_range(0, N_SSEQ - 1), rng_range(0, N_TMAT - 1));
+    if (hmm_is_mpx(h)) {
+        for (i = 1; i < hmm_n_emit_state(h); ++i)
+            if (rng_range(0, 3))
+                h->senid[i] = rng_range(0, N_SSEQ - 1);
+    }
+    for (i = 0; i < hmm_n_emit_state(h); ++i) {
+        hmm_score(h, i) = random_score();
+        hmm_history(h, i) = (int32)rng();
+    }
+    hmm_out_score(h) = random_score();
+    hmm_out_history(h) = (int32)rng();
+}
+
+int
+main(int argc, char *argv[])
+{
+    hmm_t ref[MAX_HMM], out[MAX_HMM];
+    hmm_t *ref_list[MAX_HMM], *out_list[MAX_HMM];
+    hmm_context_t *ctx3, *ctx5;
+    uint8 ***tp3, ***tp5;
+    uint16 **sseq;
+    int16 senscore[N_SEN];
+    int trial, frame, n, i;
+    int n_bad = 0, n_cases = 0, n_blocks = 0;
+
+    (void)argc;
+    (void)argv;
+    tp3 = random_tmat(3);
+    tp5 = random_tmat(5);
+    sseq = (uint16 **)ckd_calloc_2d(N_SSEQ, 5, sizeof(**sseq));
+    for (i = 0; i < N_SSEQ * 5; ++i)
+        sseq[0][i] = rng_range(0, N_SEN - 1);
+    ctx3 = hmm_context_init(3, (uint8 ** const *)tp3, senscore, sseq);
+    ctx5 = hmm_context_init(5, (uint8 ** const *)tp5, senscore, sseq);
+
+    for (trial = 0; trial < N_TRIALS; ++trial) {
+        n = rng_range(1, MAX_HMM);
+        for (i = 0; i < n; ++i) {
+            random_hmm(ctx3, ctx5, &ref[i]);
+            out[i] = ref[i];
+            ref_list[i] = &ref[i];
+            out_list[i] = &out[i];
+        }
+        for (frame = 0; frame < N_FRAMES; ++frame) {
+            int32 ref_best, out_best, n3 = 0;
+
+            for (i = 0; i < N_SEN; ++i)
+                senscore[i] = rng_range(0, 8) ? rng_range(0, 3000)
+                    : rng_range(0, 32767);
+            ref_best = WORST_SCORE;
+            for (i = 0; i < n; ++i) {
+                int32 score = hmm_vit_eval(ref_list[i]);
+                if (score BETTER_THAN ref_best)
+                    ref_best = score;
+                if (!hmm_is_mpx(ref_list[i])
+                    && hmm_n_emit_state(ref_list[i]) == 3)
+                    ++n3;
+            }
+            out_best = hmm_vit_eval_batch(out_list, n);
+            n_blocks += (n3 + 3) / 4;
+
+            for (i = 0; i < n; ++i) {
+                if (memcmp(&ref[i], &out[i], sizeof(ref[i])) != 0) {
+                    if (n_bad++ < 10) {
+                        printf("trial %d frame %d hmm %d of %d "
+                               "(%d states%s) differs:\n", trial, frame,
+                               i, n, hmm_n_emit_state(&ref[i]),
+                               hmm_is_mpx(&ref[i]) ? ", mpx" : "");
+                        hmm_dump(&ref[i], stdout);
+                        hmm_dump(&out[i], stdout);
+                    }
+                    break;
+                }
+            }
+            if (out_best != ref_best && n_bad++ < 10)
+                printf("trial %d frame %d: best %d != %d\n",
+                       trial, frame, out_best, ref_best);
+            ++n_cases;
+            /* Fresh scores now and then, or everything dies off. */
+            for (i = 0; i < n; ++i) {
+                if (rng_range(0, 3) == 0) {
+                    int32 score = random_score();
+                    int32 hist = (int32)rng();
+
+                    hmm_enter(&ref[i], score, hist, frame);
+                    hmm_enter(&out[i], score, hist, frame);
+                }
+            }
+        }
+    }
+    printf("hmm_vit_eval_batch: %d cases, %d blocks, %d bad\n",
+           n_cases, n_blocks, n_bad);
+
+    hmm_context_free(ctx3);
+    hmm_context_free(ctx5);
+    ckd_free_3d(tp3);
+    ckd_free_3d(tp5);
+    ckd_free_2d(sseq);
+    printf("%s\n", n_bad ? "FAILED" : "PASSED");
+
+    return n_bad != 0;
+}
@@ -0,0 +1,343 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/**
+ * @file test_mgau_simd.c
+ * @brief Check the vectorized kernels against the scalar ones.
+ *
+ * This includes mgau_simd.c directly so that every kernel built for
+ * this machine can be called, not just the one mgau_simd_init()
+ * picks.  Each one is run on random and edge-case inputs (every
+ * length up to a few vectors, so all the tails get exercised,
+ * unaligned buffers, zero variances, identical vectors, saturating
+ * differences) next to the scalar version:
+ *
+ *  - mgau_simd_dist(): the SIMD versions add in a different order, so
+ *    they have to agree within (len + 1) * FLT_EPSILON of the sum of
+ *    the magnitudes involved, which bounds the rounding error of
+ *    either order.  With a threshold, both have to agree on whether
+ *    the Gaussian was knocked out unless the scalar result is within
+ *    that tolerance of the threshold.
+ *  - mgau_simd_dist_q8(), mgau_simd_mixw_8b() and mgau_simd_mixw_4b():
+ *    integer only, so the results have to be identical (or, for
+ *    dist_q8 stopped early, both above the limit).
+ *
+ * Returns non-zero if any kernel disagrees.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../src/mgau_simd.c"
+
+#define N_TRIALS 2000
+#define MAX_LEN 67
+
+static uint32 rng_state = 12345;
+
+static uint32
+rng(void)
+{
+    /* Numerical Recipes LCG, plenty for this and the same everywhere. */
+    rng_state = rng_state * 1664525 + 1013904223;
+    return rng_state >> 8;
+}
+
+static int
+rng_range(int lo, int hi)
+{
+    return lo + (int)(rng() % (uint32)(hi - lo + 1));
+}
+
+#ifndef FIXED_POINT
+static float
+rng_float(float lo, float hi)
+{
+    return lo + (hi - lo) * (rng() / (float)(1 << 24));
+}
+
+typedef struct dist_kernel_s {
+    const char *name;
+    mgau_dist_func func;
+} dist_kernel_t;
+
+static int
+check_dist(dist_kernel_t *k)
+{
+    /* One extra element so the vectors can start unaligned. */
+    float obs_buf[MAX_LEN + 1], mean_buf[MAX_LEN + 1], var_buf[MAX_LEN + 1];
+    int trial, len, n_bad = 0, n_cases = 0;
+
+    for (trial = 0; trial < N_TRIALS; ++trial) {
+        for (len = 0; len <= MAX_LEN; ++len) {
+            int off = trial & 1, kind = trial % 5, j;
+            float *obs = obs_buf + off, *mean = mean_buf + off;
+            float *var = var_buf + off;
+            float d = rng_float(-50.0f, 50.0f), thresh;
+            float ref, out;
+            double mag, tol;
+
+            for (j = 0; j < len; ++j) {
+                obs[j] = rng_float(-40.0f, 40.0f);
+                mean[j] = rng_float(-40.0f, 40.0f);
+                var[j] = rng_float(0.0f, 2.0f);
+                switch (kind) {
+                case 1: /* Identical vectors. */
+                    mean[j] = obs[j];
+                    break;
+                case 2: /* Some dimensions ignored. */
+                    if (rng() & 1)
+                        var[j] = 0.0f;
+                    break;
+                case 3: /* Wide dynamic range. */
+                    obs[j] *= 1000.0f;
+                    var[j] *= 1e-4f;
+                    break;
+                }
+            }
+            mag = fabs(d);
+            for (j = 0; j < len; ++j) {
+                double diff = (double)obs[j] - mean[j];
+                mag += diff * diff * var[j];
+            }
+            tol = (len + 1) * FLT_EPSILON * mag;
+
+            /* Full evaluation. */
+            ref = dist_scalar(d, obs, mean, var, len, MGAU_SIMD_NO_THRESH);
+            out = (*k->func)(d, obs, mean, var, len, MGAU_SIMD_NO_THRESH);
+            ++n_cases;
+            if (fabs((double)out - ref) > tol) {
+                if (n_bad++ < 10)
+                    printf("dist %s: len %d: %.9g != %.9g (tolerance %.3g)\n",
+                           k->name, len, out, ref, tol);
+            }
+
+            /* Knocked out about half way through. */
+            thresh = d - (float)((mag - fabs(d)) * rng_float(0.0f, 1.0f));
+            ref = dist_scalar(d, obs, mean, var, len, thresh);
+            out = (*k->func)(d, obs, mean, var, len, thresh);
+            ++n_cases;
+            if ((ref < thresh) != (out < thresh)) {
+                if (fabs((double)ref - thresh) > tol && n_bad++ < 10)
+                    printf("dist %s: len %d: knocked out %d != %d "
+                           "(%.9g, %.9g, threshold %.9g)\n", k->name, len,
+                           out < thresh, ref < thresh, out, ref, thresh);
+            }
+            else if (ref >= thresh && fabs((double)out - ref) > tol) {
+                if (n_bad++ < 10)
+                    printf("dist %s: len %d: %.9g != %.9g above threshold\n",
+                           k->name, len, out, ref);
+            }
+        }
+    }
+    printf("dist %s: %d cases, %d bad\n", k->name, n_cases, n_bad);
+
+    return n_bad;
+}
+#endif /* !FIXED_POINT */
+
+typedef struct dist_q8_kernel_s {
+    const char *name;
+    mgau_dist_q8_func func;
+} dist_q8_kernel_t;
+
+static int
+check_dist_q8(dist_q8_kernel_t *k)
+{
+    int16 obs_buf[MGAU_SIMD_Q8_MAX_LEN + 1];
+    int8 mean_buf[MGAU_SIMD_Q8_MAX_LEN + 1];
+    uint8 var_buf[MGAU_SIMD_Q8_MAX_LEN + 1];
+    int trial, len, n_bad = 0, n_cases = 0;
+
+    for (trial = 0; trial < N_TRIALS / 4; ++trial) {
+        for (len = 0; len <= MGAU_SIMD_Q8_MAX_LEN;
+             len += MGAU_SIMD_Q8_ALIGN) {
+            int off = trial & 1, kind = trial % 4, j;
+            int16 *obs = obs_buf + off;
+            int8 *mean = mean_buf + off;
+            uint8 *var = var_buf + off;
+            int32 ref, out, limit;
+
+            for (j = 0; j < len; ++j) {
+                obs[j] = rng_range(-300, 300);
+                mean[j] = rng_range(-128, 127);
+                var[j] = rng_range(0, 255);
+                switch (kind) {
+                case 1: /* Saturating differences, worst case sums. */
+                    obs[j] = (rng() & 1) ? 32767 : -32768;
+                    mean[j] = (obs[j] > 0) ? -128 : 127;
+                    var[j] = 255;
+                    break;
+                case 2: /* Identical vectors. */
+                    obs[j] = mean[j];
+                    break;
+                }
+            }
+
+            ref = dist_q8_scalar(obs, mean, var, len, MAX_INT32);
+            out = (*k->func)(obs, mean, var, len, MAX_INT32);
+            ++n_cases;
+            if (out != ref && n_bad++ < 10)
+                printf("dist_q8 %s: len %d: %d != %d\n",
+                       k->name, len, out, ref);
+
+            /* Stopping early only has to agree that it's above. */
+            limit = ref / 2;
+            ref = dist_q8_scalar(obs, mean, var, len, limit);
+            out = (*k->func)(obs, mean, var, len, limit);
+            ++n_cases;
+            if ((ref > limit || out > limit) ? !(ref > limit && out > limit)
+                : out != ref) {
+                if (n_bad++ < 10)
+                    printf("dist_q8 %s: len %d: %d != %d with limit %d\n",
+                           k->name, len, out, ref, limit);
+            }
+        }
+    }
+    printf("dist_q8 %s: %d cases, %d bad\n", k->name, n_cases, n_bad);
+
+    return n_bad;
+}
+
+typedef struct mixw_kernel_s {
+    const char *name;
+    mgau_mixw_8b_func func_8b;
+    mgau_mixw_4b_func func_4b;
+} mixw_kernel_t;
+
+#define MAX_TOPN 8
+
+static int
+check_mixw(mixw_kernel_t *k, uint8 const *tab)
+{
+    uint8 row_buf[MAX_TOPN][MGAU_SIMD_SEN_BLOCK + 1];
+    uint8 const *rows[MAX_TOPN];
+    uint8 w_den[MAX_TOPN][16];
+    int32 scores[MAX_TOPN];
+    int16 ref[MGAU_SIMD_SEN_BLOCK], out[MGAU_SIMD_SEN_BLOCK];
+    int trial, topn, i, j, n_bad = 0, n_cases = 0;
+
+    for (trial = 0; trial < N_TRIALS; ++trial) {
+        for (topn = 1; topn <= MAX_TOPN; ++topn) {
+            int off = trial & 1, close = trial % 3 == 0;
+
+            for (i = 0; i < topn; ++i) {
+                /* Close scores exercise the log-add table, far ones
+                 * the clamped index. */
+                scores[i] = close ? rng_range(0, 8)
+                    : rng_range(0, MAX_NEG_ASCR);
+                for (j = 0; j < MGAU_SIMD_SEN_BLOCK; ++j)
+                    row_buf[i][j + off] = close ? rng_range(0, 8)
+                        : rng_range(0, MAX_NEG_MIXW);
+                rows[i] = row_buf[i] + off;
+                for (j = 0; j < 16; ++j)
+                    w_den[i][j] = close ? rng_range(0, 8)
+                        : rng_range(0, 255);
+            }
+
+            mixw_8b_scalar(ref, rows, scores, topn, tab);
+            (*k->func_8b)(out, rows, scores, topn, tab);
+            ++n_cases;
+            if (memcmp(ref, out, sizeof(ref)) != 0 && n_bad++ < 10)
+                printf("mixw_8b %s: topn %d differs\n", k->name, topn);
+
+            mixw_4b_scalar(ref, rows, (uint8 const (*)[16])w_den,
+                           topn, tab);
+            (*k->func_4b)(out, rows, (uint8 const (*)[16])w_den,
+                          topn, tab);
+            ++n_cases;
+            if (memcmp(ref, out, sizeof(ref)) != 0 && n_bad++ < 10)
+                printf("mixw_4b %s: topn %d differs\n", k->name, topn);
+        }
+    }
+    printf("mixw %s: %d cases, %d bad\n", k->name, n_cases, n_bad);
+
+    return n_bad;
+}
+
+int
+main(int argc, char *argv[])
+{
+#ifndef FIXED_POINT
+    dist_kernel_t dist_kernels[] = {
+#if defined(MGAU_SIMD_NEON)
+        { "NEON", dist_neon },
+#endif
+#if defined(MGAU_SIMD_SSE2)
+        { "SSE2", dist_sse2 },
+#endif
+#if defined(MGAU_SIMD_X86_EXT)
+        { "AVX2", dist_avx2 },
+#endif
+        { NULL, NULL }
+    };
+#endif
+    dist_q8_kernel_t dist_q8_kernels[] = {
+#if defined(MGAU_SIMD_NEON)
+        { "NEON", dist_q8_neon },
+#endif
+#if defined(MGAU_SIMD_SSE2)
+        { "SSE2", dist_q8_sse2 },
+#endif
+        { NULL, NULL }
+    };
+    mixw_kernel_t mixw_kernels[] = {
+#if defined(MGAU_SIMD_NEON)
+        { "NEON", mixw_8b_neon, mixw_4b_neon },
+#endif
+#if defined(MGAU_SIMD_X86_EXT)
+        { "SSSE3", mixw_8b_ssse3, mixw_4b_ssse3 },
+#endif
+        { NULL, NULL, NULL }
+    };
+    logmath_t *lmath;
+    uint8 tab[MGAU_SIMD_LOGADD_SIZE];
+    int i, n_bad = 0, n_kernels = 0;
+
+    (void)argc;
+    (void)argv;
+#if defined(MGAU_SIMD_X86_EXT)
+    __builtin_cpu_init();
+#endif
+#ifndef FIXED_POINT
+    for (i = 0; dist_kernels[i].name; ++i) {
+#if defined(MGAU_SIMD_X86_EXT)
+        if (dist_kernels[i].func == dist_avx2
+            && !__builtin_cpu_supports("avx2")) {
+            printf("dist AVX2: not supported here, skipped\n");
+            continue;
+        }
+#endif
+        n_bad += check_dist(&dist_kernels[i]);
+        ++n_kernels;
+    }
+#endif
+    for (i = 0; dist_q8_kernels[i].name; ++i) {
+        n_bad += check_dist_q8(&dist_q8_kernels[i]);
+        ++n_kernels;
+    }
+
+    /* Same 8-bit log table as s2_semi_mgau uses. */
+    lmath = logmath_init(1.0001, 10, TRUE);
+    if (!mgau_simd_logadd_table(lmath, tab)) {
+        printf("mixw: log table too long, kernels unused, skipped\n");
+        mixw_kernels[0].name = NULL;
+    }
+    for (i = 0; mixw_kernels[i].name; ++i) {
+#if defined(MGAU_SIMD_X86_EXT)
+        if (mixw_kernels[i].func_8b == mixw_8b_ssse3
+            && !__builtin_cpu_supports("ssse3")) {
+            printf("mixw SSSE3: not supported here, skipped\n");
+            continue;
+        }
+#endif
+        n_bad += check_mixw(&mixw_kernels[i], tab);
+        ++n_kernels;
+    }
+    logmath_free(lmath);
+
+    if (n_kernels == 0)
+        printf("No vectorized kernels built, nothing to compare\n");
+    printf("%s\n", n_bad ? "FAILED" : "PASSED");
+
+    return n_bad != 0;
+}
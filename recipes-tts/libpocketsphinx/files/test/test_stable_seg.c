@@ -0,0 +1,221 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/**
+ * @file test_stable_seg.c
+ * @brief Check ps_stable_seg_iter() against ps_seg_iter() with a grammar.
+ *
+ * A JSGF grammar is decoded in blocks of 1, 5 and 50 frames, calling
+ * ps_stable_seg_iter() after each one and once more after
+ * ps_end_utt(), and the segments it returned are compared with the
+ * ones from ps_seg_iter() at the end:
+ *
+ *  - Without -bestpath the final hypothesis comes from the same
+ *    history as the stable words, so the concatenation has to be
+ *    exactly the final segmentation, words and frames.
+ *  - With -bestpath the final hypothesis comes from the lattice and
+ *    is free to go another way, so only the time guarantee holds:
+ *    stable words never overlap or go back in time, and after
+ *    ps_end_utt() the rest is the part of the final segmentation
+ *    that ends after the last stable word.
+ *
+ * The audio, data/commands.raw, is a few of the commands in the
+ * grammar read out by a speech synthesizer (16 kHz, 16-bit,
+ * little-endian).
+ *
+ * Returns non-zero on any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pocketsphinx.h>
+
+#ifndef MODELDIR
+#define MODELDIR "model"
+#endif
+#ifndef DATADIR
+#define DATADIR "test/data"
+#endif
+
+#define FRAME_SAMPLES 160
+#define MAX_SEGS 2048
+#define MAX_WORD 64
+
+static const char *grammar =
+    "#JSGF V1.0;\n"
+    "grammar robot;\n"
+    "public <cmds> = ( [ <polite> ] <action> [ <polite> ] )+ ;\n"
+    "<polite> = please | could you ;\n"
+    "<action> = <move> | <turn> | stop ;\n"
+    "<move> = go ( forward | backward | left | right )"
+    " [ <num> ( meters | steps ) ] ;\n"
+    "<turn> = turn ( left | right | around ) [ <num> degrees ] ;\n"
+    "<num> = one | two | three | four | five | ten | twenty | ninety ;\n";
+
+typedef struct seg_s {
+    char word[MAX_WORD];
+    int sf, ef;
+} seg_t;
+
+static int16 *
+read_audio(const char *path, size_t *out_nsamp)
+{
+    FILE *fh;
+    int16 *pcm;
+    long len;
+
+    if ((fh = fopen(path, "rb")) == NULL) {
+        printf("Failed to open %s\n", path);
+        return NULL;
+    }
+    fseek(fh, 0, SEEK_END);
+    len = ftell(fh);
+    rewind(fh);
+    pcm = malloc(len);
+    *out_nsamp = fread(pcm, sizeof(*pcm), len / sizeof(*pcm), fh);
+    fclose(fh);
+    return pcm;
+}
+
+static int
+append_segs(ps_seg_t *itor, seg_t *segs, int n)
+{
+    for (; itor; itor = ps_seg_next(itor)) {
+        if (n == MAX_SEGS) {
+            ps_seg_free(itor);
+            break;
+        }
+        snprintf(segs[n].word, MAX_WORD, "%s", ps_seg_word(itor));
+        ps_seg_frames(itor, &segs[n].sf, &segs[n].ef);
+        ++n;
+    }
+    return n;
+}
+
+static void
+print_segs(const char *name, seg_t *segs, int n)
+{
+    int i;
+
+    printf("  %s:", name);
+    for (i = 0; i < n; ++i)
+        printf(" %s:%d:%d", segs[i].word, segs[i].sf, segs[i].ef);
+    printf("\n");
+}
+
+static int
+seg_equal(seg_t *a, seg_t *b)
+{
+    return a->sf == b->sf && a->ef == b->ef && 0 == strcmp(a->word, b->word);
+}
+
+static int
+check(ps_decoder_t *ps, int bestpath, int16 *pcm, size_t nsamp, int every)
+{
+    static seg_t stable[MAX_SEGS], final[MAX_SEGS];
+    int n_stable, n_during, n_final, i, first, last_ef, bad;
+    size_t blk = (size_t)every * FRAME_SAMPLES, pos;
+
+    bad = 0;
+    n_stable = 0;
+    ps_start_utt(ps);
+    for (pos = 0; pos < nsamp; pos += blk) {
+        size_t n = nsamp - pos < blk ? nsamp - pos : blk;
+        ps_process_raw(ps, pcm + pos, n, FALSE, FALSE);
+        n_stable = append_segs(ps_stable_seg_iter(ps), stable, n_stable);
+    }
+    n_during = n_stable;
+    ps_end_utt(ps);
+    n_stable = append_segs(ps_stable_seg_iter(ps), stable, n_stable);
+    if (ps_stable_seg_iter(ps) != NULL) {
+        printf("  stable words after the end of the utterance\n");
+        bad = 1;
+    }
+    n_final = append_segs(ps_seg_iter(ps), final, 0);
+
+    /* Stable words are reported in order and never overlap. */
+    last_ef = -2;
+    for (i = 0; i < n_stable; ++i) {
+        if (stable[i].sf < last_ef || stable[i].ef < stable[i].sf) {
+            printf("  %s:%d:%d is out of order\n",
+                   stable[i].word, stable[i].sf, stable[i].ef);
+            bad = 1;
+        }
+        last_ef = stable[i].ef;
+    }
+
+    if (!bestpath) {
+        /* Same history, so it has to be the final segmentation. */
+        if (n_stable != n_final)
+            bad = 1;
+        for (i = 0; !bad && i < n_final; ++i)
+            if (!seg_equal(&stable[i], &final[i]))
+                bad = 1;
+    }
+    else {
+        /* What came after the end is the final path, by time. */
+        last_ef = n_during ? stable[n_during - 1].ef : -2;
+        for (first = 0; first < n_final; ++first)
+            if (final[first].ef > last_ef)
+                break;
+        if (n_stable - n_during != n_final - first)
+            bad = 1;
+        for (i = 0; !bad && first + i < n_final; ++i)
+            if (!seg_equal(&stable[n_during + i], &final[first + i]))
+                bad = 1;
+    }
+
+    printf("bestpath=%d every=%d: %d stable during the utterance, "
+           "%d after, %d final: %s\n", bestpath, every,
+           n_during, n_stable - n_during, n_final, bad ? "FAIL" : "ok");
+    if (bad) {
+        print_segs("stable", stable, n_stable);
+        print_segs("final", final, n_final);
+    }
+    /* Nothing was ever stable before the end: not much of a test. */
+    if (n_during == 0) {
+        printf("  no stable words before the end of the utterance\n");
+        bad = 1;
+    }
+    return bad;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const int every[] = { 1, 5, 50 };
+    size_t nsamp;
+    int16 *pcm;
+    int bestpath, i, fail;
+
+    (void)argc;
+    (void)argv;
+    err_set_loglevel(ERR_WARN);
+    if ((pcm = read_audio(DATADIR "/commands.raw", &nsamp)) == NULL)
+        return 1;
+    fail = 0;
+    for (bestpath = 0; bestpath < 2; ++bestpath) {
+        ps_config_t *config = ps_config_init(NULL);
+        ps_decoder_t *ps;
+
+        ps_config_set_str(config, "hmm", MODELDIR "/en-us/en-us");
+        ps_config_set_str(config, "dict", MODELDIR "/en-us/cmudict-en-us.dict");
+        ps_config_set_bool(config, "bestpath", bestpath);
+        if ((ps = ps_init(config)) == NULL) {
+            printf("Failed to initialize the decoder\n");
+            return 1;
+        }
+        if (ps_add_jsgf_string(ps, "robot", grammar) < 0
+            || ps_activate_search(ps, "robot") < 0) {
+            printf("Failed to set up the grammar\n");
+            return 1;
+        }
+        for (i = 0; i < (int)(sizeof(every) / sizeof(every[0])); ++i)
+            fail |= check(ps, bestpath, pcm, nsamp, every[i]);
+        ps_free(ps);
+        ps_config_free(config);
+    }
+    free(pcm);
+
+    return fail;
+}